@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+import os
+import sys
+import re
+import random
+import argparse
+import tempfile
+import subprocess
+from collections import Counter
+
+
+DESC = "Trains a tiny model with --multi-node --sync-sgd on several MPI " \
+       "processes and checks that validation runs once per validation step."
+
+
+def main():
+    args = parse_args()
+    workdir = args.workdir or tempfile.mkdtemp(prefix="marian-multi-node-")
+    os.makedirs(workdir, exist_ok=True)
+    if os.listdir(workdir):
+        fail("working directory is not empty: " + workdir)
+
+    src, trg = write_corpus(workdir, args.sentences)
+    model = os.path.join(workdir, "model.npz")
+    valid_log = os.path.join(workdir, "valid.log")
+
+    cmd = args.mpirun.split() + ["-np", str(args.np), args.marian,
+        "--type", "s2s", "-m", model,
+        "-t", src, trg,
+        "-v", src + ".yml", trg + ".yml",
+        "--dim-emb", "16", "--dim-rnn", "32",
+        "--mini-batch", "16", "--maxi-batch", "10", "--no-shuffle",
+        "--after-batches", str(args.batches), "--disp-freq", "10",
+        "--save-freq", str(args.valid_freq),
+        "--valid-sets", src, trg,
+        "--valid-freq", str(args.valid_freq),
+        "--valid-metrics", "cross-entropy", "perplexity",
+        "--valid-log", valid_log, "--keep-best",
+        "--multi-node", "--sync-sgd", "--seed", "1111",
+        # one CPU device per process, GPU builds would otherwise require
+        # devices in the multi-node format
+        "--cpu-threads", "1"]
+
+    print(" ".join(cmd), file=sys.stderr)
+    try:
+        subprocess.run(cmd, timeout=args.timeout, check=True)
+    except subprocess.TimeoutExpired:
+        fail("training did not finish within {}s".format(args.timeout))
+    except subprocess.CalledProcessError as e:
+        fail("training failed with exit code {}".format(e.returncode))
+
+    check_validations(valid_log, args.batches // args.valid_freq)
+    for path in [model, model + ".progress.yml",
+                 model + ".best-cross-entropy.npz",
+                 model + ".best-perplexity.npz"]:
+        if not os.path.exists(path):
+            fail("missing file: " + path)
+
+    print("OK: " + workdir, file=sys.stderr)
+
+
+def write_corpus(workdir, sentences):
+    random.seed(1234)
+    words = ["w{}".format(i) for i in range(50)]
+    src = os.path.join(workdir, "corpus.src")
+    trg = os.path.join(workdir, "corpus.trg")
+    with open(src, "w") as fs, open(trg, "w") as ft:
+        for _ in range(sentences):
+            line = random.choices(words, k=random.randint(3, 12))
+            fs.write(" ".join(line) + "\n")
+            ft.write(" ".join(reversed(line)) + "\n")
+
+    # the vocabularies are written upfront, as all processes would create them
+    # at the same time otherwise
+    for path in [src, trg]:
+        with open(path + ".yml", "w") as fv:
+            for i, word in enumerate(["</s>", "<unk>"] + words):
+                fv.write("{}: {}\n".format(word, i))
+    return src, trg
+
+
+def check_validations(valid_log, expected):
+    """Each update and metric has to be logged once: every process used to
+    validate on its own and to write its own entry."""
+    if not os.path.exists(valid_log):
+        fail("missing validation log: " + valid_log)
+
+    pattern = re.compile(r"\] (\d+) : (\S+) : ")
+    counts = Counter()
+    with open(valid_log) as f:
+        for line in f:
+            m = pattern.search(line)
+            if m:
+                counts[(int(m.group(1)), m.group(2))] += 1
+
+    updates = set(update for update, _ in counts)
+    if len(updates) != expected:
+        fail("expected {} validation steps, found {}".format(
+            expected, sorted(updates)))
+    for (update, metric), count in sorted(counts.items()):
+        if count != 1:
+            fail("{} validated {} times at update {}".format(
+                metric, count, update))
+
+
+def fail(message):
+    print("FAILED: " + message, file=sys.stderr)
+    exit(1)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=DESC)
+    parser.add_argument("-m", "--marian", required=True,
+                        help="path to the marian training executable")
+    parser.add_argument("--mpirun", default="mpirun --oversubscribe",
+                        help="MPI launcher command")
+    parser.add_argument("--np", type=int, default=2,
+                        help="number of MPI processes")
+    parser.add_argument("--workdir", help="directory for data and models")
+    parser.add_argument("--sentences", type=int, default=500)
+    parser.add_argument("--batches", type=int, default=40)
+    parser.add_argument("--valid-freq", type=int, default=10)
+    parser.add_argument("--timeout", type=int, default=600,
+                        help="timeout in seconds")
+    return parser.parse_args()
+
+
+if __name__ == "__main__":
+    main()
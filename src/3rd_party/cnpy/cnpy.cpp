@@ -17,6 +17,186 @@ char cnpy::BigEndianTest() {
     return y == 1 ? '<' : '>';
 }
 
+std::vector<char> cnpy::create_npy_header(char type, unsigned int word_size, const unsigned int* shape, const unsigned int ndims) {
+
+    std::vector<char> dict;
+    dict += "{'descr': '";
+    dict += BigEndianTest();
+    dict += type;
+    dict += tostring(word_size);
+    dict += "', 'fortran_order': False, 'shape': (";
+    dict += tostring(shape[0]);
+    for(int i = 1;i < ndims;i++) {
+        dict += ", ";
+        dict += tostring(shape[i]);
+    }
+    if(ndims == 1) dict += ",";
+    dict += "), }";
+    //pad with spaces so that preamble+dict is modulo 16 bytes. preamble is 10 bytes. dict needs to end with \n
+    int remainder = 16 - (10 + dict.size()) % 16;
+    dict.insert(dict.end(),remainder,' ');
+    dict.back() = '\n';
+
+    std::vector<char> header;
+    header += (char) 0x93;
+    header += "NUMPY";
+    header += (char) 0x01; //major version of numpy format
+    header += (char) 0x00; //minor version of numpy format
+    header += (unsigned short) dict.size();
+    header.insert(header.end(),dict.begin(),dict.end());
+
+    return header;
+}
+
+unsigned int cnpy::crc32_chunked(unsigned int crc, const char* data, unsigned long long size) {
+    const unsigned long long chunk = 1ull << 30;
+    while(size > 0) {
+        unsigned long long n = std::min(size, chunk);
+        crc = crc32(crc,(const unsigned char*)data,(uInt)n);
+        data += n;
+        size -= n;
+    }
+    return crc;
+}
+
+namespace {
+    //sizes and offsets from this value on are stored in zip64 extra fields
+    const unsigned long long ZIP64_LIMIT = 0xffffffffull;
+
+    unsigned int limit32(unsigned long long x) {
+        return x >= ZIP64_LIMIT ? 0xffffffff : (unsigned int) x;
+    }
+}
+
+void cnpy::npz_save(std::string zipname, const std::vector<NpzItem>& items) {
+    FILE* fp = fopen(zipname.c_str(),"wb");
+    if(!fp)
+        throw std::runtime_error("npz_save: unable to open file " + zipname);
+
+    //the global header is collected while the arrays are written and appended once
+    std::vector<char> global_header;
+    unsigned long long offset = 0;
+
+    for(auto& item : items) {
+        std::string fname = item.name + ".npy";
+
+        std::vector<char> npy_header = create_npy_header(item.type,item.word_size,item.shape.data(),item.shape.size());
+
+        unsigned long long nels = 1;
+        for(auto dim : item.shape) nels *= dim;
+        unsigned long long nbytes_data = nels*item.word_size;
+        unsigned long long nbytes = nbytes_data + npy_header.size();
+
+        unsigned int crc = crc32(0L,(unsigned char*)&npy_header[0],npy_header.size());
+        crc = crc32_chunked(crc,item.data,nbytes_data);
+
+        bool zip64_size = nbytes >= ZIP64_LIMIT;
+        bool zip64_offset = offset >= ZIP64_LIMIT;
+        unsigned short version = (zip64_size || zip64_offset) ? 45 : 20;
+
+        //local zip64 extra field, both sizes are required
+        std::vector<char> local_extra;
+        if(zip64_size) {
+            local_extra += (unsigned short) 0x0001; //zip64 tag
+            local_extra += (unsigned short) 16; //size of the field
+            local_extra += (unsigned long long) nbytes; //uncompressed size
+            local_extra += (unsigned long long) nbytes; //compressed size
+        }
+
+        std::vector<char> local_header;
+        local_header += "PK"; //first part of sig
+        local_header += (unsigned short) 0x0403; //second part of sig
+        local_header += (unsigned short) version; //min version to extract
+        local_header += (unsigned short) 0; //general purpose bit flag
+        local_header += (unsigned short) 0; //compression method
+        local_header += (unsigned short) 0; //file last mod time
+        local_header += (unsigned short) 0;     //file last mod date
+        local_header += (unsigned int) crc; //crc
+        local_header += (unsigned int) limit32(nbytes); //compressed size
+        local_header += (unsigned int) limit32(nbytes); //uncompressed size
+        local_header += (unsigned short) fname.size(); //fname length
+        local_header += (unsigned short) local_extra.size(); //extra field length
+        local_header += fname;
+        local_header.insert(local_header.end(),local_extra.begin(),local_extra.end());
+
+        //central zip64 extra field, only the values that overflowed
+        std::vector<char> global_extra;
+        if(zip64_size || zip64_offset) {
+            global_extra += (unsigned short) 0x0001; //zip64 tag
+            global_extra += (unsigned short) ((zip64_size ? 16 : 0) + (zip64_offset ? 8 : 0)); //size of the field
+            if(zip64_size) {
+                global_extra += (unsigned long long) nbytes; //uncompressed size
+                global_extra += (unsigned long long) nbytes; //compressed size
+            }
+            if(zip64_offset)
+                global_extra += (unsigned long long) offset; //offset of local header
+        }
+
+        global_header += "PK"; //first part of sig
+        global_header += (unsigned short) 0x0201; //second part of sig
+        global_header += (unsigned short) version; //version made by
+        global_header.insert(global_header.end(),local_header.begin()+4,local_header.begin()+28);
+        global_header += (unsigned short) global_extra.size(); //extra field length
+        global_header += (unsigned short) 0; //file comment length
+        global_header += (unsigned short) 0; //disk number where file starts
+        global_header += (unsigned short) 0; //internal file attributes
+        global_header += (unsigned int) 0; //external file attributes
+        global_header += (unsigned int) limit32(offset); //relative offset of local file header
+        global_header += fname;
+        global_header.insert(global_header.end(),global_extra.begin(),global_extra.end());
+
+        fwrite(&local_header[0],sizeof(char),local_header.size(),fp);
+        fwrite(&npy_header[0],sizeof(char),npy_header.size(),fp);
+        fwrite(item.data,sizeof(char),nbytes_data,fp);
+
+        offset += local_header.size() + nbytes;
+    }
+
+    unsigned long long nrecs = items.size();
+    unsigned long long global_header_size = global_header.size();
+
+    std::vector<char> footer;
+    if(nrecs >= 0xffff || global_header_size >= ZIP64_LIMIT || offset >= ZIP64_LIMIT) {
+        unsigned long long zip64_footer_offset = offset + global_header_size;
+
+        footer += "PK"; //first part of sig
+        footer += (unsigned short) 0x0606; //second part of sig, zip64 end of central directory
+        footer += (unsigned long long) 44; //size of the remaining record
+        footer += (unsigned short) 45; //version made by
+        footer += (unsigned short) 45; //version needed to extract
+        footer += (unsigned int) 0; //number of this disk
+        footer += (unsigned int) 0; //disk where footer starts
+        footer += (unsigned long long) nrecs; //number of records on this disk
+        footer += (unsigned long long) nrecs; //total number of records
+        footer += (unsigned long long) global_header_size; //nbytes of global headers
+        footer += (unsigned long long) offset; //offset of start of global headers
+
+        footer += "PK"; //first part of sig
+        footer += (unsigned short) 0x0706; //second part of sig, zip64 locator
+        footer += (unsigned int) 0; //disk of the zip64 footer
+        footer += (unsigned long long) zip64_footer_offset; //offset of the zip64 footer
+        footer += (unsigned int) 1; //total number of disks
+    }
+
+    footer += "PK"; //first part of sig
+    footer += (unsigned short) 0x0605; //second part of sig
+    footer += (unsigned short) 0; //number of this disk
+    footer += (unsigned short) 0; //disk where footer starts
+    footer += (unsigned short) std::min(nrecs, 0xffffull); //number of records on this disk
+    footer += (unsigned short) std::min(nrecs, 0xffffull); //total number of records
+    footer += (unsigned int) limit32(global_header_size); //nbytes of global headers
+    footer += (unsigned int) limit32(offset); //offset of start of global headers
+    footer += (unsigned short) 0; //zip file comment length
+
+    if(!global_header.empty())
+        fwrite(&global_header[0],sizeof(char),global_header.size(),fp);
+    fwrite(&footer[0],sizeof(char),footer.size(),fp);
+
+    bool failed = ferror(fp) != 0;
+    if(fclose(fp) != 0 || failed)
+        throw std::runtime_error("npz_save: error while writing file " + zipname);
+}
+
 char cnpy::map_type(const std::type_info& t)
 {
     if(t == typeid(float) ) return 'f';
@@ -146,101 +326,186 @@ cnpy::NpyArrayPtr load_the_npy_file(FILE* fp) {
     return arr;
 }
 
-cnpy::npz_t cnpy::npz_load(std::string fname) {
-    FILE* fp = fopen(fname.c_str(),"rb");
-
-    if(!fp) printf("npz_load: Error! Unable to open file %s!\n",fname.c_str());
-    assert(fp);
+namespace {
+    template<typename T> T read_le(const char* p) {
+        T x;
+        memcpy(&x,p,sizeof(T));
+        return x;
+    }
+}
 
-    cnpy::npz_t arrays;
+cnpy::NpzReader::NpzReader(const std::string& fname) : fname_(fname) {
+    fp_ = fopen(fname.c_str(),"rb");
+    if(!fp_)
+        throw std::runtime_error("npz_load: unable to open file " + fname);
+
+    try {
+        //the end of central directory record is followed by a comment of at most 64KB
+        fseeko(fp_,0,SEEK_END);
+        unsigned long long file_size = ftello(fp_);
+        unsigned long long tail_size = std::min(file_size, 22ull + 0xffff);
+        std::vector<char> tail(tail_size);
+        read_at(file_size - tail_size,tail.data(),tail_size);
+
+        long long pos = (long long) tail_size - 22;
+        while(pos >= 0 && read_le<unsigned int>(&tail[pos]) != 0x06054b50)
+            pos--;
+        if(pos < 0)
+            throw std::runtime_error("npz_load: no zip footer found in " + fname);
+
+        unsigned long long nrecs = read_le<unsigned short>(&tail[pos+10]);
+        unsigned long long global_header_size = read_le<unsigned int>(&tail[pos+12]);
+        unsigned long long global_header_offset = read_le<unsigned int>(&tail[pos+16]);
+
+        //the zip64 locator precedes the footer and points to the zip64 footer
+        unsigned long long footer_offset = file_size - tail_size + pos;
+        if(footer_offset >= 20) {
+            char locator[20];
+            read_at(footer_offset - 20,locator,20);
+            if(read_le<unsigned int>(locator) == 0x07064b50) {
+                char footer64[56];
+                read_at(read_le<unsigned long long>(locator+8),footer64,56);
+                if(read_le<unsigned int>(footer64) != 0x06064b50)
+                    throw std::runtime_error("npz_load: invalid zip64 footer in " + fname);
+                nrecs = read_le<unsigned long long>(footer64+32);
+                global_header_size = read_le<unsigned long long>(footer64+40);
+                global_header_offset = read_le<unsigned long long>(footer64+48);
+            }
+        }
 
-    while(1) {
-        std::vector<char> local_header(30);
-        size_t headerres = fread(&local_header[0],sizeof(char),30,fp);
-        if(headerres != 30)
-            throw std::runtime_error("npz_load: failed fread");
-
-        //if we've reached the global header, stop reading
-        if(local_header[2] != 0x03 || local_header[3] != 0x04) break;
-
-        //read in the variable name
-        unsigned short name_len = *(unsigned short*) &local_header[26];
-        std::string varname(name_len,' ');
-        size_t vname_res = fread(&varname[0],sizeof(char),name_len,fp);
-        if(vname_res != name_len)
-            throw std::runtime_error("npz_load: failed fread");
-
-        //erase the lagging .npy
-        varname.erase(varname.end()-4, varname.end());
-
-        //read in the extra field
-        unsigned short extra_field_len = *(unsigned short*) &local_header[28];
-        if(extra_field_len > 0) {
-            std::vector<char> buff(extra_field_len);
-            size_t efield_res = fread(&buff[0],sizeof(char),extra_field_len,fp);
-            if(efield_res != extra_field_len)
-                throw std::runtime_error("npz_load: failed fread");
+        std::vector<char> global_header(global_header_size);
+        read_at(global_header_offset,global_header.data(),global_header_size);
+
+        std::vector<std::pair<std::string, unsigned long long>> locals;
+        size_t p = 0;
+        for(unsigned long long i = 0; i < nrecs; ++i) {
+            if(p + 46 > global_header.size() || read_le<unsigned int>(&global_header[p]) != 0x02014b50)
+                throw std::runtime_error("npz_load: invalid central directory in " + fname);
+
+            unsigned short method = read_le<unsigned short>(&global_header[p+10]);
+            unsigned long long usize = read_le<unsigned int>(&global_header[p+24]);
+            unsigned long long csize = read_le<unsigned int>(&global_header[p+20]);
+            unsigned short name_len = read_le<unsigned short>(&global_header[p+28]);
+            unsigned short extra_len = read_le<unsigned short>(&global_header[p+30]);
+            unsigned short comment_len = read_le<unsigned short>(&global_header[p+32]);
+            unsigned long long offset = read_le<unsigned int>(&global_header[p+42]);
+            std::string name(&global_header[p+46],name_len);
+
+            //values that do not fit into 32 bits follow in the zip64 extra field
+            const char* extra = &global_header[p+46+name_len];
+            const char* extra_end = extra + extra_len;
+            while(extra + 4 <= extra_end) {
+                unsigned short tag = read_le<unsigned short>(extra);
+                unsigned short size = read_le<unsigned short>(extra+2);
+                const char* field = extra + 4;
+                if(tag == 0x0001) {
+                    if(usize == 0xffffffff) { usize = read_le<unsigned long long>(field); field += 8; }
+                    if(csize == 0xffffffff) { csize = read_le<unsigned long long>(field); field += 8; }
+                    if(offset == 0xffffffff) { offset = read_le<unsigned long long>(field); field += 8; }
+                }
+                extra += 4 + size;
+            }
+
+            if(method != 0)
+                throw std::runtime_error("npz_load: compressed array " + name + " in " + fname + " is not supported");
+
+            //erase the lagging .npy
+            if(name.size() > 4 && name.substr(name.size()-4) == ".npy")
+                name.erase(name.size()-4);
+            locals.push_back({name,offset});
+
+            p += 46 + name_len + extra_len + comment_len;
         }
 
-        arrays[varname] = load_the_npy_file(fp);
+        //the npy headers are read upfront, so that shapes are known without loading arrays
+        for(auto& local : locals) {
+            char local_header[30];
+            read_at(local.second,local_header,30);
+            if(read_le<unsigned int>(local_header) != 0x04034b50)
+                throw std::runtime_error("npz_load: invalid local header of " + local.first + " in " + fname);
+            unsigned short name_len = read_le<unsigned short>(local_header+26);
+            unsigned short extra_len = read_le<unsigned short>(local_header+28);
+            fseeko(fp_,local.second + 30 + name_len + extra_len,SEEK_SET);
+
+            Entry entry;
+            unsigned int* shape;
+            unsigned int ndims;
+            parse_npy_header(fp_,entry.word_size,shape,ndims,entry.fortran_order);
+            entry.shape.assign(shape,shape+ndims);
+            delete[] shape;
+
+            entry.nbytes = entry.word_size;
+            for(auto dim : entry.shape)
+                entry.nbytes *= dim;
+            entry.data_offset = ftello(fp_);
+
+            entries_[local.first] = entry;
+        }
+    } catch(...) {
+        fclose(fp_);
+        throw;
     }
 
-    fclose(fp);
-    return arrays;
+    for(auto& it : entries_)
+        names_.push_back(it.first);
 }
 
-cnpy::NpyArrayPtr cnpy::npz_load(std::string fname, std::string varname) {
-    FILE* fp = fopen(fname.c_str(),"rb");
+cnpy::NpzReader::~NpzReader() {
+    fclose(fp_);
+}
 
-    if(!fp) {
-        printf("npz_load: Error! Unable to open file %s!\n",fname.c_str());
-        abort();
+const cnpy::NpzReader::Entry& cnpy::NpzReader::entry(const std::string& name) const {
+    auto it = entries_.find(name);
+    if(it == entries_.end()) {
+        std::stringstream ss;
+        ss << "npz_load: Error! Variable name "
+           << name
+           << " not found in "
+           << fname_
+           <<  "!"
+           << std::endl;
+        throw std::runtime_error(ss.str());
     }
+    return it->second;
+}
 
-    while(1) {
-        std::vector<char> local_header(30);
-        size_t header_res = fread(&local_header[0],sizeof(char),30,fp);
-        if(header_res != 30)
-            throw std::runtime_error("npz_load: failed fread");
-
-        //if we've reached the global header, stop reading
-        if(local_header[2] != 0x03 || local_header[3] != 0x04) break;
-
-        //read in the variable name
-        unsigned short name_len = *(unsigned short*) &local_header[26];
-        std::string vname(name_len,' ');
-        size_t vname_res = fread(&vname[0],sizeof(char),name_len,fp);
-        if(vname_res != name_len)
-            throw std::runtime_error("npz_load: failed fread");
-        vname.erase(vname.end()-4,vname.end()); //erase the lagging .npy
-
-        //read in the extra field
-        unsigned short extra_field_len = *(unsigned short*) &local_header[28];
-        fseek(fp,extra_field_len,SEEK_CUR); //skip past the extra field
-
-        if(vname == varname) {
-            auto array = load_the_npy_file(fp);
-            fclose(fp);
-            return array;
-        }
-        else {
-            //skip past the data
-            unsigned int size = *(unsigned int*) &local_header[22];
-            fseek(fp,size,SEEK_CUR);
-        }
-    }
+void cnpy::NpzReader::read_at(unsigned long long offset, char* data, unsigned long long size) {
+    if(fseeko(fp_,offset,SEEK_SET) != 0 || fread(data,sizeof(char),size,fp_) != size)
+        throw std::runtime_error("npz_load: failed fread from " + fname_);
+}
 
-    fclose(fp);
+cnpy::NpyArrayPtr cnpy::NpzReader::load(const std::string& name) {
+    const Entry& e = entry(name);
+
+    auto arr = cnpy::NpyArrayPtr(new cnpy::NpyArray());
+    arr->word_size = e.word_size;
+    arr->shape = e.shape;
+    arr->fortran_order = e.fortran_order;
+    arr->resize(e.nbytes);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    read_at(e.data_offset,arr->data(),e.nbytes);
+    return arr;
+}
 
-    std::stringstream ss;
-    ss << "npz_load: Error! Variable name "
-       << varname
-       << " not found in "
-       << fname
-       <<  "!"
-       << std::endl;
+void cnpy::NpzReader::read(const std::string& name, char* data) {
+    const Entry& e = entry(name);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    read_at(e.data_offset,data,e.nbytes);
+}
 
-    throw std::runtime_error(ss.str());
+cnpy::npz_t cnpy::npz_load(std::string fname) {
+    NpzReader reader(fname);
+
+    cnpy::npz_t arrays;
+    for(auto& name : reader.names())
+        arrays[name] = reader.load(name);
+    return arrays;
+}
+
+cnpy::NpyArrayPtr cnpy::npz_load(std::string fname, std::string varname) {
+    return NpzReader(fname).load(varname);
 }
 
 cnpy::NpyArrayPtr cnpy::npy_load(std::string fname) {
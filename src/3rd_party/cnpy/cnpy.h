@@ -16,6 +16,7 @@
 #include<zlib.h>
 #include<map>
 #include <memory>
+#include <mutex>
 
 namespace cnpy {
 
@@ -43,15 +44,74 @@ namespace cnpy {
     typedef std::shared_ptr<NpyArray> NpyArrayPtr;
     typedef std::map<std::string, NpyArrayPtr> npz_t;
 
+    //array to be written with npz_save(zipname, items), the data is not owned
+    struct NpzItem {
+        std::string name;
+        std::vector<unsigned int> shape;
+        char type; //as returned by map_type
+        unsigned int word_size;
+        const char* data;
+    };
+
+    //reads the directory of an npz file, including zip64 archives, and the
+    //arrays on request. loads from several threads are serialized.
+    class NpzReader {
+    public:
+        NpzReader(const std::string& fname);
+        ~NpzReader();
+
+        //names of all arrays, sorted
+        const std::vector<std::string>& names() const { return names_; }
+        bool contains(const std::string& name) const { return entries_.count(name) > 0; }
+
+        const std::vector<unsigned int>& shape(const std::string& name) const { return entry(name).shape; }
+        unsigned int word_size(const std::string& name) const { return entry(name).word_size; }
+
+        //number of bytes of the array data, without the npy header
+        unsigned long long nbytes(const std::string& name) const { return entry(name).nbytes; }
+
+        NpyArrayPtr load(const std::string& name);
+
+        //reads the data of the array into a buffer of nbytes(name) bytes
+        void read(const std::string& name, char* data);
+
+    private:
+        struct Entry {
+            std::vector<unsigned int> shape;
+            unsigned int word_size;
+            bool fortran_order;
+            unsigned long long data_offset;
+            unsigned long long nbytes;
+        };
+
+        const Entry& entry(const std::string& name) const;
+        void read_at(unsigned long long offset, char* data, unsigned long long size);
+
+        std::string fname_;
+        FILE* fp_;
+        std::mutex mutex_;
+        std::map<std::string, Entry> entries_;
+        std::vector<std::string> names_;
+    };
+
+    typedef std::shared_ptr<NpzReader> NpzReaderPtr;
+
     char BigEndianTest();
     char map_type(const std::type_info& t);
     template<typename T> std::vector<char> create_npy_header(const T* data, const unsigned int* shape, const unsigned int ndims);
+    std::vector<char> create_npy_header(char type, unsigned int word_size, const unsigned int* shape, const unsigned int ndims);
     void parse_npy_header(FILE* fp,unsigned int& word_size, unsigned int*& shape, unsigned int& ndims, bool& fortran_order);
     void parse_zip_footer(FILE* fp, unsigned short& nrecs, unsigned int& global_header_size, unsigned int& global_header_offset);
+    //crc32 of buffers beyond the 4GB zlib takes at once
+    unsigned int crc32_chunked(unsigned int crc, const char* data, unsigned long long size);
     npz_t npz_load(std::string fname);
     NpyArrayPtr npz_load(std::string fname, std::string varname);
     NpyArrayPtr npy_load(std::string fname);
 
+    //writes all items to a new zip in a single pass, with zip64 records for
+    //arrays and archives beyond 4GB
+    void npz_save(std::string zipname, const std::vector<NpzItem>& items);
+
     template<typename T> std::vector<char>& operator+=(std::vector<char>& lhs, const T rhs) {
         //write in little endian
         for(char byte = 0; byte < sizeof(T); byte++) {
@@ -155,13 +215,19 @@ namespace cnpy {
 
         std::vector<char> npy_header = create_npy_header(data,shape,ndims);
 
-        unsigned long nels = 1;
+        unsigned long long nels = 1;
         for (int m=0; m<ndims; m++ ) nels *= shape[m];
-        int nbytes = nels*sizeof(T) + npy_header.size();
+        unsigned long long nbytes = nels*sizeof(T) + npy_header.size();
+
+        //appending keeps the 32-bit headers, larger archives are written by npz_save(zipname, items)
+        if(global_header_offset + nbytes + 30 + fname.size() >= 0xffffffffull) {
+            fclose(fp);
+            throw std::runtime_error("npz_save: appending to " + zipname + " exceeds 4GB");
+        }
 
         //get the CRC of the data to be added
         unsigned int crc = crc32(0L,(unsigned char*)&npy_header[0],npy_header.size());
-        crc = crc32(crc,(unsigned char*)data,nels*sizeof(T));
+        crc = crc32_chunked(crc,(const char*)data,nels*sizeof(T));
 
         //build the local header
         std::vector<char> local_header;
@@ -213,34 +279,7 @@ namespace cnpy {
     }
 
     template<typename T> std::vector<char> create_npy_header(const T* data, const unsigned int* shape, const unsigned int ndims) {
-
-        std::vector<char> dict;
-        dict += "{'descr': '";
-        dict += BigEndianTest();
-        dict += map_type(typeid(T));
-        dict += tostring(sizeof(T));
-        dict += "', 'fortran_order': False, 'shape': (";
-        dict += tostring(shape[0]);
-        for(int i = 1;i < ndims;i++) {
-            dict += ", ";
-            dict += tostring(shape[i]);
-        }
-        if(ndims == 1) dict += ",";
-        dict += "), }";
-        //pad with spaces so that preamble+dict is modulo 16 bytes. preamble is 10 bytes. dict needs to end with \n
-        int remainder = 16 - (10 + dict.size()) % 16;
-        dict.insert(dict.end(),remainder,' ');
-        dict.back() = '\n';
-
-        std::vector<char> header;
-        header += (char) 0x93;
-        header += "NUMPY";
-        header += (char) 0x01; //major version of numpy format
-        header += (char) 0x00; //minor version of numpy format
-        header += (unsigned short) dict.size();
-        header.insert(header.end(),dict.begin(),dict.end());
-
-        return header;
+        return create_npy_header(map_type(typeid(T)), sizeof(T), shape, ndims);
     }
 
 
@@ -2,6 +2,7 @@
 
 #include "training/graph_group_async.h"
 #include "training/graph_group_multinode.h"
+#include "training/graph_group_multinode_sync.h"
 #include "training/graph_group_singleton.h"
 #include "training/graph_group_sync.h"
 #include "training/training.h"
@@ -12,6 +13,7 @@
 
 
 bool configureMPI(int, char**);
+void finalizeMPI();
 
 int main(int argc, char** argv) {
   using namespace marian;
@@ -22,8 +24,15 @@ int main(int argc, char** argv) {
   if(options->get<bool>("multi-node")) {
     ABORT_IF(!configureMPI(argc, argv), "MPI not found.");
 
-    LOG(warn, "[experimental] Running multi-node training");
-    New<Train<MultiNodeGraphGroup>>(options)->run();
+    if(options->get<bool>("sync-sgd")) {
+      LOG(warn, "[experimental] Running synchronous multi-node training");
+      New<Train<MultiNodeSyncGraphGroup>>(options)->run();
+    } else {
+      LOG(warn, "[experimental] Running multi-node training");
+      New<Train<MultiNodeGraphGroup>>(options)->run();
+    }
+
+    finalizeMPI();
   } else {
     if(devices.size() == 1) {
       New<Train<SingletonGraph>>(options)->run();
@@ -54,7 +63,18 @@ bool configureMPI(int argc, char** argv) {
       provided_thread_mode < MPI_THREAD_MULTIPLE,
       "Your version of MPI does not support multi-threaded communication.");
 
+  // all nodes shuffle the corpus and initialize parameters alike
+  unsigned long seed = marian::Config::seed;
+  MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+  marian::Config::seed = seed;
+
   enable = true;
 #endif
   return enable;
 }
+
+void finalizeMPI() {
+#if MPI_FOUND
+  MPI_Finalize();
+#endif
+}
@@ -0,0 +1,59 @@
+#include "marian.h"
+
+#include <boost/program_options.hpp>
+
+#include "common/logging.h"
+#include "data/corpus_binary.h"
+#include "data/vocab.h"
+
+int main(int argc, char** argv) {
+  using namespace marian;
+
+  createLoggers();
+
+  namespace po = boost::program_options;
+  po::options_description desc("Allowed options");
+  // clang-format off
+  desc.add_options()
+    ("vocab,v", po::value<std::string>(),
+     "Path to the vocabulary used for mapping words to indices")
+    ("output,o", po::value<std::string>(),
+     "Path to the binary corpus file, usually corpus.txt.bin")
+    ("max-size,m", po::value<int>()->default_value(0),
+     "Use only  arg  most common vocabulary items")
+    ("help,h", "Print this message and exit")
+    ;
+  // clang-format on
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl << std::endl;
+    std::cerr << "Usage: " << argv[0] << " [options]" << std::endl << std::endl;
+    std::cerr << desc << std::endl;
+    exit(1);
+  }
+
+  if(vm.count("help") || !vm.count("vocab") || !vm.count("output")) {
+    std::cerr << "Usage: " << argv[0] << " -v vocab.yml -o corpus.txt.bin "
+              << "< corpus.txt" << std::endl
+              << std::endl;
+    std::cerr << desc << std::endl;
+    exit(vm.count("help") ? 0 : 1);
+  }
+
+  auto vocab = New<Vocab>();
+  vocab->load(vm["vocab"].as<std::string>(), vm["max-size"].as<int>());
+
+  LOG(info, "Binarizing corpus...");
+
+  InputFileStream corpusStrm(std::cin);
+  size_t lines = data::BinaryCorpusFile::create(
+      vm["output"].as<std::string>(), corpusStrm, vocab);
+
+  LOG(info, "Finished, {} lines", lines);
+
+  return 0;
+}
@@ -1,12 +1,21 @@
 #include "marian.h"
 #include "translator/beam_search.h"
+#include "translator/greedy_search.h"
 #include "translator/translator.h"
 
 int main(int argc, char** argv) {
   using namespace marian;
 
   auto options = New<Config>(argc, argv, ConfigMode::translating);
-  auto task = New<TranslateMultiGPU<BeamSearch>>(options);
+
+  // n-best lists need the full beam search even for beam size 1, and the
+  // greedy search scans the decoder outputs on the host, i.e. on the CPU only
+  Ptr<ModelTask> task;
+  if(options->get<size_t>("beam-size") == 1 && !options->get<bool>("n-best")
+     && options->get<size_t>("cpu-threads") > 0)
+    task = New<TranslateMultiGPU<GreedySearch>>(options);
+  else
+    task = New<TranslateMultiGPU<BeamSearch>>(options);
 
   boost::timer::cpu_timer timer;
   task->run();
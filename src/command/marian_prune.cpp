@@ -0,0 +1,73 @@
+#include "marian.h"
+
+#include <boost/program_options.hpp>
+
+#include "common/logging.h"
+#include "models/pruning.h"
+
+int main(int argc, char** argv) {
+  using namespace marian;
+
+  createLoggers();
+
+  namespace po = boost::program_options;
+  po::options_description desc("Allowed options");
+  // clang-format off
+  desc.add_options()
+    ("model,m", po::value<std::string>(),
+     "Path to the model file to be pruned")
+    ("output,o", po::value<std::string>(),
+     "Path to the pruned model file")
+    ("ffn", po::value<float>()->default_value(0.f),
+     "Remove this fraction of hidden units from each transformer feed-forward layer")
+    ("heads", po::value<size_t>()->default_value(0),
+     "Remove this number of heads from each transformer attention layer")
+    ("deep-output", po::value<float>()->default_value(0.f),
+     "Remove this fraction of hidden units from the deep output layer of RNN models")
+    ("help,h", "Print this message and exit")
+    ;
+  // clang-format on
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch(std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl << std::endl;
+    std::cerr << "Usage: " << argv[0] << " [options]" << std::endl << std::endl;
+    std::cerr << desc << std::endl;
+    exit(1);
+  }
+
+  if(vm.count("help") || !vm.count("model") || !vm.count("output")) {
+    std::cerr << "Usage: " << argv[0] << " -m model.npz -o pruned.npz "
+              << "[--ffn 0.5] [--heads 2] [--deep-output 0.5]" << std::endl
+              << std::endl;
+    std::cerr << desc << std::endl;
+    exit(vm.count("help") ? 0 : 1);
+  }
+
+  float ffn = vm["ffn"].as<float>();
+  float deepOutput = vm["deep-output"].as<float>();
+  ABORT_IF(ffn < 0.f || ffn >= 1.f || deepOutput < 0.f || deepOutput >= 1.f,
+           "Fractions of pruned units have to be in [0, 1)");
+
+  ModelPruner pruner(vm["model"].as<std::string>());
+
+  if(ffn > 0.f)
+    LOG(info, "Removed {} feed-forward units", pruner.pruneFfn(ffn));
+  if(vm["heads"].as<size_t>() > 0)
+    LOG(info,
+        "Removed {} attention heads",
+        pruner.pruneHeads(vm["heads"].as<size_t>()));
+  if(deepOutput > 0.f)
+    LOG(info,
+        "Removed {} deep output units",
+        pruner.pruneDeepOutput(deepOutput));
+
+  pruner.save(vm["output"].as<std::string>());
+
+  LOG(info, "Finished");
+
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "marian.h"
 #include "translator/beam_search.h"
+#include "translator/greedy_search.h"
 #include "translator/translator.h"
 
 #include "3rd_party/simple-websocket-server/server_ws.hpp"
@@ -11,7 +12,12 @@ int main(int argc, char **argv) {
 
   // initialize translation model task
   auto options = New<Config>(argc, argv, ConfigMode::translating, true);
-  auto task = New<TranslateServiceMultiGPU<BeamSearch>>(options);
+  Ptr<ModelServiceTask> task;
+  if(options->get<size_t>("beam-size") == 1 && !options->get<bool>("n-best")
+     && options->get<size_t>("cpu-threads") > 0)
+    task = New<TranslateServiceMultiGPU<GreedySearch>>(options);
+  else
+    task = New<TranslateServiceMultiGPU<BeamSearch>>(options);
 
   // create web service server
   WsServer server;
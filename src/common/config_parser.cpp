@@ -173,6 +173,11 @@ void ConfigParser::validateOptions() const {
       "There should be as many files with embedding vectors as "
       "training sets");
 
+  UTIL_THROW_IF2(
+      has("binary-corpus") && get<bool>("binary-corpus")
+          && (!has("vocabs") || get<std::vector<std::string>>("vocabs").empty()),
+      "Vocabularies have to be given when training from a binary corpus");
+
   boost::filesystem::path modelPath(get<std::string>("model"));
 
   if(mode_ == ConfigMode::rescoring) {
@@ -227,7 +232,8 @@ void ConfigParser::validateDevices() const {
 
   boost::regex pattern;
   std::string help;
-  if(mode_ == ConfigMode::training && get<bool>("multi-node")) {
+  if(mode_ == ConfigMode::training && get<bool>("multi-node")
+     && get<size_t>("cpu-threads") == 0) {
     // valid strings: '0: 1 2', '0:1 2 1:2 3'
     pattern = "( *[0-9]+ *: *[0-9]+( *[0-9]+)*)+";
     help = "Supported format for multi-node setting: '0:0 1 2 3 1:0 1 2 3'";
@@ -354,6 +360,9 @@ void ConfigParser::addOptionsModel(po::options_description& desc) {
      "Operation after transformer embedding layer: d = dropout, a = add, n = normalize")
     ("transformer-postprocess", po::value<std::string>()->default_value("dan"),
      "Operation after each transformer layer: d = dropout, a = add, n = normalize")
+    ("transformer-decoder-autoreg", po::value<std::string>()->default_value("self-attention"),
+     "Type of the autoregressive layer in the transformer decoder: self-attention, "
+     "or an RNN cell such as ssru, which keeps a constant-size state per layer")
 #ifdef CUDNN
     ("char-stride", po::value<int>()->default_value(5),
      "Width of max-pooling layer after convolution layer in char-s2s model")
@@ -385,6 +394,9 @@ void ConfigParser::addOptionsModel(po::options_description& desc) {
        "Gradient Dropping momentum decay rate (0.0 to 1.0)")
       ("grad-dropping-warmup", po::value<size_t>()->default_value(100),
        "Do not apply gradient dropping for the first arg steps")
+      ("grad-quantize", po::value<bool>()->zero_tokens()->default_value(false),
+       "Send gradients between nodes of multi-node training as 8-bit "
+       "integers, keeping rounding errors for the next update")
       ("transformer-dropout", po::value<float>()->default_value(0),
        "Dropout between transformer layers (0 = no dropout)")
       ("transformer-dropout-attention", po::value<float>()->default_value(0),
@@ -434,6 +446,13 @@ void ConfigParser::addOptionsTraining(po::options_description& desc) {
       "is temporary with path creates persistent storage")
     ("sqlite-drop", po::value<bool>()->zero_tokens()->default_value(false),
       "Drop existing tables in sqlite3 database")
+    ("shuffle-shard-size", po::value<size_t>()->default_value(0),
+      "Shuffle training data block-wise: split it into shards of  arg  lines, "
+      "shuffle the order of shards and lines within one shard at a time. "
+      "Limits memory usage for corpora larger than RAM, 0 shuffles all at once")
+    ("binary-corpus", po::value<bool>()->zero_tokens()->default_value(false),
+      "Read training corpora from memory-mapped binary files train-set.bin "
+      "created by marian-binarize, binarize them first if they do not exist")
     ("restore-corpus,r", po::value<bool>()->zero_tokens()->default_value(false),
       "Restore the corpus state for seamless training continuation")
     ("devices,d", po::value<std::vector<std::string>>()
@@ -458,10 +477,15 @@ void ConfigParser::addOptionsTraining(po::options_description& desc) {
       "fit reserved memory")
     ("mini-batch-fit-step", po::value<size_t>()->default_value(10),
       "Step size for mini-batch-fit statistics")
+    ("gradient-checkpointing", po::value<bool>()->zero_tokens()->default_value(false),
+      "Keep only the outputs of transformer layers during the forward pass and "
+      "recompute the layers during the backward pass to save memory")
     ("maxi-batch", po::value<int>()->default_value(100),
       "Number of batches to preload for length-based sorting")
     ("maxi-batch-sort", po::value<std::string>()->default_value("trg"),
       "Sorting strategy for maxi-batch: trg (default) src none")
+    ("data-threads", po::value<size_t>()->default_value(1),
+      "Number of threads for parsing training data and creating batches")
 
     ("optimizer,o", po::value<std::string>()->default_value("adam"),
      "Optimization algorithm (possible values: sgd, adagrad, adam")
@@ -560,6 +584,10 @@ void ConfigParser::addOptionsTraining(po::options_description& desc) {
     ("multi-node-overlap", po::value<bool>()
       ->default_value(true),
      "Overlap model computations with MPI communication")
+    ("multi-node-chunk-size", po::value<size_t>()
+      ->default_value(262144),
+     "Split messages of multi-node training into chunks of  arg  values, "
+     "which are processed as they arrive")
   ;
   // clang-format on
   desc.add(training);
@@ -634,6 +662,17 @@ void ConfigParser::addOptionsTranslate(po::options_description& desc) {
       "Maximum length of a sentence in a training sentence pair")
     ("max-length-crop", po::value<bool>()->zero_tokens()->default_value(false),
       "Crop a sentence to max-length instead of ommitting it if longer than max-length")
+    ("max-length-factor", po::value<float>()->default_value(3.f),
+      "Maximum length of a translation as a multiple of the source length")
+    ("max-length-offset", po::value<size_t>()->default_value(0),
+      "Number of words added to the maximum length of a translation")
+    ("beam-prune-abs", po::value<float>()->default_value(0.f),
+      "Prune hypotheses whose cost is more than  arg  below the best hypothesis of the step, 0 to disable")
+    ("beam-prune-rel", po::value<float>()->default_value(0.f),
+      "Prune hypotheses whose cost is worse than the one of the best hypothesis of the step by more than  arg  times its magnitude, 0 to disable")
+    ("beam-early-stop", po::value<bool>()->zero_tokens()->default_value(false),
+      "Stop extending hypotheses which cannot beat the best finished translation anymore, "
+      "assumes that costs do not increase with length")
     ("devices,d", po::value<std::vector<std::string>>()
       ->multitoken()
       ->default_value(std::vector<std::string>({"0"}), "0"),
@@ -660,6 +699,10 @@ void ConfigParser::addOptionsTranslate(po::options_description& desc) {
     ("weights", po::value<std::vector<float>>()
       ->multitoken(),
       "Scorer weights")
+    ("parallel-scorers", po::value<bool>()->zero_tokens()->default_value(false),
+      "Evaluate the models of an ensemble concurrently, each on its own graph and thread (CPU only)")
+    ("graph-threads", po::value<size_t>()->default_value(0),
+      "Run independent branches of each graph concurrently on this many threads (CPU only), 0 runs all operations in order")
     // TODO: the options should be available only in server
     ("port,p", po::value<size_t>()->default_value(8080),
       "Port number for web socket server")
@@ -826,6 +869,7 @@ void ConfigParser::parseOptions(int argc, char** argv, bool doValidate) {
   SET_OPTION("transformer-preprocess", std::string);
   SET_OPTION("transformer-postprocess", std::string);
   SET_OPTION("transformer-postprocess-emb", std::string);
+  SET_OPTION("transformer-decoder-autoreg", std::string);
   SET_OPTION("transformer-dim-ffn", int);
   SET_OPTION("transformer-dim-ffn", int);
 
@@ -849,6 +893,7 @@ void ConfigParser::parseOptions(int argc, char** argv, bool doValidate) {
     SET_OPTION("grad-dropping-rate", float);
     SET_OPTION("grad-dropping-momentum", float);
     SET_OPTION("grad-dropping-warmup", size_t);
+    SET_OPTION("grad-quantize", bool);
 
     SET_OPTION("transformer-dropout", float);
     SET_OPTION("transformer-dropout-attention", float);
@@ -866,6 +911,8 @@ void ConfigParser::parseOptions(int argc, char** argv, bool doValidate) {
     SET_OPTION("tempdir", std::string);
     SET_OPTION("sqlite", std::string);
     SET_OPTION("sqlite-drop", bool);
+    SET_OPTION("shuffle-shard-size", size_t);
+    SET_OPTION("binary-corpus", bool);
     SET_OPTION("restore-corpus", bool);
 
     SET_OPTION("optimizer", std::string);
@@ -877,6 +924,8 @@ void ConfigParser::parseOptions(int argc, char** argv, bool doValidate) {
     SET_OPTION("mini-batch-words", int);
     SET_OPTION("mini-batch-fit", bool);
     SET_OPTION("mini-batch-fit-step", size_t);
+    SET_OPTION("gradient-checkpointing", bool);
+    SET_OPTION("data-threads", size_t);
 
     SET_OPTION("lr-decay", double);
     SET_OPTION("lr-decay-strategy", std::string);
@@ -914,6 +963,7 @@ void ConfigParser::parseOptions(int argc, char** argv, bool doValidate) {
 
     SET_OPTION("multi-node", bool);
     SET_OPTION("multi-node-overlap", bool);
+    SET_OPTION("multi-node-chunk-size", size_t);
   }
 
   if(mode_ == ConfigMode::rescoring) {
@@ -931,7 +981,14 @@ void ConfigParser::parseOptions(int argc, char** argv, bool doValidate) {
     SET_OPTION("normalize", float);
     SET_OPTION("allow-unk", bool);
     SET_OPTION("n-best", bool);
+    SET_OPTION("max-length-factor", float);
+    SET_OPTION("max-length-offset", size_t);
+    SET_OPTION("beam-prune-abs", float);
+    SET_OPTION("beam-prune-rel", float);
+    SET_OPTION("beam-early-stop", bool);
     SET_OPTION_NONDEFAULT("weights", std::vector<float>);
+    SET_OPTION("parallel-scorers", bool);
+    SET_OPTION("graph-threads", size_t);
     SET_OPTION("port", size_t);
   }
 
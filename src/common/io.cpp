@@ -0,0 +1,123 @@
+#include "common/io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "3rd_party/cnpy/cnpy.h"
+#include "3rd_party/threadpool.h"
+#include "common/logging.h"
+
+namespace marian {
+namespace io {
+
+size_t Snapshot::append(const std::string& name,
+                        const std::vector<unsigned int>& shape,
+                        char type,
+                        unsigned int wordSize) {
+  size_t elements = 1;
+  for(auto dim : shape)
+    elements *= dim;
+
+  // arrays start at multiples of the float size, also after texts
+  size_t offset = buffer_.size();
+  offset += (sizeof(float) - offset % sizeof(float)) % sizeof(float);
+  buffer_.resize(offset + elements * wordSize);
+
+  items_.push_back({name, shape, type, wordSize, offset});
+  return offset;
+}
+
+float* Snapshot::add(const std::string& name,
+                     const std::vector<unsigned int>& shape) {
+  size_t offset = append(name, shape, 'f', sizeof(float));
+  return (float*)(buffer_.data() + offset);
+}
+
+void Snapshot::addText(const std::string& name, const std::string& text) {
+  unsigned int size = text.size() + 1;
+  size_t offset = append(name, {size}, 'i', sizeof(char));
+  std::copy(text.c_str(), text.c_str() + size, buffer_.data() + offset);
+}
+
+void Snapshot::save(const std::string& fileName) const {
+  std::vector<cnpy::NpzItem> items;
+  for(auto& item : items_)
+    items.push_back({item.name,
+                     item.shape,
+                     item.type,
+                     item.wordSize,
+                     buffer_.data() + item.offset});
+
+  std::string tempName = fileName + ".tmp";
+  try {
+    cnpy::npz_save(tempName, items);
+  } catch(std::exception& e) {
+    ABORT("Could not save {}: {}", fileName, e.what());
+  }
+
+  ABORT_IF(std::rename(tempName.c_str(), fileName.c_str()) != 0,
+           "Could not rename {} to {}",
+           tempName,
+           fileName);
+}
+
+namespace {
+// A single thread, so that files are written in the order of the calls
+ThreadPool& writer() {
+  static ThreadPool pool(1);
+  return pool;
+}
+
+std::mutex pendingMutex;
+std::vector<std::future<void>> pending;
+
+void enqueue(std::function<void()> write) {
+  auto task = writer().enqueue(write);
+
+  std::lock_guard<std::mutex> lock(pendingMutex);
+  pending.erase(std::remove_if(pending.begin(),
+                               pending.end(),
+                               [](std::future<void>& f) {
+                                 return f.wait_for(std::chrono::seconds(0))
+                                        == std::future_status::ready;
+                               }),
+                pending.end());
+  pending.push_back(std::move(task));
+}
+}
+
+void saveAsync(const std::string& fileName, Ptr<Snapshot> snapshot) {
+  enqueue([fileName, snapshot]() { snapshot->save(fileName); });
+}
+
+void saveAsync(
+    const std::vector<std::pair<std::string, Ptr<Snapshot>>>& files) {
+  enqueue([files]() {
+    std::vector<std::thread> threads;
+    for(auto& file : files)
+      threads.emplace_back([&file]() { file.second->save(file.first); });
+    for(auto& thread : threads)
+      thread.join();
+  });
+}
+
+void writeAsync(std::function<void()> write) {
+  enqueue(write);
+}
+
+void waitForSaves() {
+  std::vector<std::future<void>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    tasks.swap(pending);
+  }
+  for(auto& task : tasks)
+    task.wait();
+}
+}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "common/definitions.h"
+
+namespace marian {
+namespace io {
+
+/**
+ * @brief Host copy of the arrays of an npz file.
+ *
+ * All arrays are stored back to back in a single buffer, so a snapshot of
+ * the model parameters or the optimizer state costs one copy of the data.
+ * Once taken, the snapshot is independent of the device memory and can be
+ * written while training continues.
+ */
+class Snapshot {
+private:
+  struct Item {
+    std::string name;
+    std::vector<unsigned int> shape;
+    char type;
+    unsigned int wordSize;
+    size_t offset;
+  };
+
+  std::vector<Item> items_;
+  std::vector<char> buffer_;
+
+  size_t append(const std::string& name,
+                const std::vector<unsigned int>& shape,
+                char type,
+                unsigned int wordSize);
+
+public:
+  /**
+   * @brief Reserves the buffer for the given number of bytes, which avoids
+   * moving the data already added when the buffer grows.
+   */
+  void reserve(size_t bytes) { buffer_.reserve(bytes); }
+
+  /**
+   * @brief Adds an array of floats and returns the memory its values have to
+   * be copied to. The pointer is valid until the next array is added.
+   */
+  float* add(const std::string& name, const std::vector<unsigned int>& shape);
+
+  /**
+   * @brief Adds a text such as a YAML configuration as a null-terminated
+   * array of chars.
+   */
+  void addText(const std::string& name, const std::string& text);
+
+  size_t size() const { return buffer_.size(); }
+
+  /**
+   * @brief Writes all arrays to an npz file in a single sequential pass. The
+   * file is written as fileName + ".tmp" and renamed on completion, so an
+   * existing file is only ever replaced by a complete one.
+   */
+  void save(const std::string& fileName) const;
+};
+
+/**
+ * @brief Saves the snapshot on a background thread and returns immediately.
+ * Files are written one after another in the order of the calls.
+ */
+void saveAsync(const std::string& fileName, Ptr<Snapshot> snapshot);
+
+/**
+ * @brief Saves several snapshots concurrently, one thread per file, on the
+ * background writer. Files of later calls are written once all of these are
+ * complete.
+ */
+void saveAsync(
+    const std::vector<std::pair<std::string, Ptr<Snapshot>>>& files);
+
+/**
+ * @brief Runs a write on the background writer once all files passed to
+ * saveAsync before have been written, for files which refer to them.
+ */
+void writeAsync(std::function<void()> write);
+
+/**
+ * @brief Blocks until all files passed to saveAsync have been written.
+ */
+void waitForSaves();
+}
+}
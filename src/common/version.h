@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+ * File version.h is generated using CMake. Do NOT modify it manually! Edit
+ * version.h.in file instead.
+ */
+
+// e.g. v1.2.3-beta+1.abc123d
+#define PROJECT_VERSION_FULL  "v1.3.1+44102fa"
+// e.g. v1.2.3-beta
+#define PROJECT_VERSION       "v1.3.1"
+#define PROJECT_VERSION_MAJOR 1
+#define PROJECT_VERSION_MINOR 3
+#define PROJECT_VERSION_PATCH 1
@@ -7,6 +7,7 @@
 #include <condition_variable>
 #include <boost/timer/timer.hpp>
 
+#include "3rd_party/threadpool.h"
 #include "common/config.h"
 #include "data/batch_stats.h"
 #include "data/rng_engine.h"
@@ -45,6 +46,52 @@ private:
   mutable std::condition_variable loadCondition_;
   bool loadReady_{true};
 
+  // Start of a maxi-batch: the corpus position and the state of the random
+  // number generator before it was read, and the number of batches in the
+  // epoch before it. Kept until the training state has counted its batches.
+  struct MaxiBatchStart {
+    size_t position;
+    size_t batches;
+    std::string seed;
+  };
+  std::deque<MaxiBatchStart> maxiBatchStarts_;
+  size_t position_{0};
+  size_t batchesEpoch_{0};
+
+  void resetMaxiBatchStarts(size_t position, size_t batchesEpoch) {
+    std::unique_lock<std::mutex> lock(loadMutex_);
+    maxiBatchStarts_.clear();
+    position_ = position;
+    batchesEpoch_ = batchesEpoch;
+  }
+
+  // creates batches from sorted samples in parallel if "data-threads" > 1
+  UPtr<ThreadPool> batchPool_;
+
+  std::vector<BatchPtr> toBatches(std::vector<samples>& batchVectors) {
+    std::vector<BatchPtr> batches;
+    batches.reserve(batchVectors.size());
+
+    if(!batchPool_) {
+      for(auto& batchVector : batchVectors)
+        batches.push_back(data_->toBatch(batchVector));
+      return batches;
+    }
+
+    // futures are collected in order, so the result does not depend on
+    // the scheduling of threads
+    std::vector<std::future<BatchPtr>> futures;
+    futures.reserve(batchVectors.size());
+    for(auto& batchVector : batchVectors) {
+      const samples* bv = &batchVector;
+      futures.emplace_back(
+          batchPool_->enqueue([this, bv]() { return data_->toBatch(*bv); }));
+    }
+    for(auto& future : futures)
+      batches.push_back(future.get());
+    return batches;
+  }
+
   void fillBatches(bool shuffle = true) {
     typedef typename sample::value_type Item;
     auto itemCmp = [](const Item& sa, const Item& sb) {
@@ -80,12 +127,16 @@ private:
     int maxBatchSize = options_->get<int>("mini-batch");
     int maxSize = maxBatchSize * options_->get<int>("maxi-batch");
 
+    MaxiBatchStart start{position_, batchesEpoch_, getRNGState()};
+
     // consume data from corpus into maxi-batch (single sentences)
     // sorted into specified order (due to queue)
     size_t sets = 0;
     while(current_ != data_->end() && maxiBatch->size() < maxSize) {
       maxiBatch->push(*current_);
       sets = current_->size();
+      // position of the pushed sample, the iterator reads ahead
+      position_ = data_->getPosition();
       current_++;
     }
 
@@ -93,7 +144,7 @@ private:
     int currentWords = 0;
     std::vector<size_t> lengths(sets, 0);
 
-    std::vector<BatchPtr> tempBatches;
+    std::vector<samples> batchVectors;
 
     // while there are sentences in the queue
     while(!maxiBatch->empty()) {
@@ -133,7 +184,7 @@ private:
 
       // if batch has desired size create a real batch
       if(makeBatch) {
-        tempBatches.push_back(data_->toBatch(batchVector));
+        batchVectors.emplace_back(std::move(batchVector));
 
         // prepare for next batch
         batchVector.clear();
@@ -145,7 +196,9 @@ private:
 
     // turn rest into batch
     if(!batchVector.empty())
-      tempBatches.push_back(data_->toBatch(batchVector));
+      batchVectors.emplace_back(std::move(batchVector));
+
+    std::vector<BatchPtr> tempBatches = toBatches(batchVectors);
 
     if(shuffle) {
       // shuffle the batches
@@ -157,13 +210,22 @@ private:
     std::unique_lock<std::mutex> lock(loadMutex_);
     for(const auto& batch : tempBatches)
       bufferedBatches_.push_back(batch);
+
+    if(!tempBatches.empty()) {
+      maxiBatchStarts_.push_back(start);
+      batchesEpoch_ += tempBatches.size();
+    }
   }
 
 public:
   BatchGenerator(Ptr<DataSet> data,
                  Ptr<Config> options,
                  Ptr<BatchStats> stats = nullptr)
-      : data_(data), options_(options), stats_(stats) {}
+      : data_(data), options_(options), stats_(stats) {
+    if(options_->has("data-threads")
+       && options_->get<size_t>("data-threads") > 1)
+      batchPool_.reset(new ThreadPool(options_->get<size_t>("data-threads")));
+  }
 
   operator bool() const {
     // wait if empty but loading
@@ -212,10 +274,30 @@ public:
       data_->shuffle();
     else
       data_->reset();
+    resetMaxiBatchStarts(0, 0);
     current_ = data_->begin();
     fillBatches(shuffle);
   }
 
+  /**
+   * @brief Stores the start of the maxi-batch that contains the next batch
+   * to be counted by the training state, so that restore() can seek to it.
+   */
+  void updateState(TrainingState& state) {
+    std::unique_lock<std::mutex> lock(loadMutex_);
+    while(maxiBatchStarts_.size() > 1
+          && maxiBatchStarts_[1].batches <= state.batchesEpoch)
+      maxiBatchStarts_.pop_front();
+
+    if(maxiBatchStarts_.empty())
+      return;
+
+    const auto& start = maxiBatchStarts_.front();
+    state.corpusPosition = start.position;
+    state.batchesMaxiBatch = start.batches;
+    state.seedMaxiBatch = start.seed;
+  }
+
   bool restore(Ptr<TrainingState> state, bool shuffle) {
     if(state->epochs == 1 && state->batchesEpoch == 0)
       return false;
@@ -230,8 +312,27 @@ public:
       setRNGState(state->seedBatch);
     }
 
-    prepare(shuffle);
-    for(int i = 0; i < state->batchesEpoch; ++i)
+    // progress files from older versions, replay the whole epoch
+    if(state->seedMaxiBatch.empty()) {
+      prepare(shuffle);
+      for(int i = 0; i < state->batchesEpoch; ++i)
+        next();
+      return true;
+    }
+
+    // recreate the order of this epoch, seek to the maxi-batch with the next
+    // batch and skip the batches from it that have already been used
+    if(shuffle)
+      data_->shuffle();
+    else
+      data_->reset();
+    data_->setPosition(state->corpusPosition);
+    setRNGState(state->seedMaxiBatch);
+    resetMaxiBatchStarts(state->corpusPosition, state->batchesMaxiBatch);
+
+    current_ = data_->begin();
+    fillBatches(shuffle);
+    for(size_t i = state->batchesMaxiBatch; i < state->batchesEpoch; ++i)
       next();
 
     return true;
@@ -249,7 +350,14 @@ public:
   void actAfterEpoch(TrainingState& state) {
     state.seedBatch = getRNGState();
     state.seedCorpus = data_->getRNGState();
+
+    // the next epoch starts with the first maxi-batch
+    state.corpusPosition = 0;
+    state.batchesMaxiBatch = 0;
+    state.seedMaxiBatch = state.seedBatch;
   }
+
+  void actAfterBatches(TrainingState& state) { updateState(state); }
 };
 }
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
+#include <mutex>
 #include <queue>
 
+#include <boost/filesystem.hpp>
 #include <boost/timer/timer.hpp>
 #include "data/corpus.h"
 #include "data/vocab.h"
@@ -11,10 +14,166 @@ namespace marian {
 
 namespace data {
 
+/**
+ * @brief Model of the workspace memory needed to train on a batch of a given
+ * number of sentences of a given length.
+ *
+ * The memory consists of a part that does not depend on the batch size but
+ * grows with the length, e.g. because of nodes unrolled over time steps, and
+ * a part per sentence that grows linearly with the length (activations per
+ * token in all layers) and quadratically (attention):
+ *
+ * bytes = constant + perLength * length
+ *         + batchSize * (perToken * length + perTokenLength * length^2)
+ *
+ * The coefficients are fitted to the peak memory of a few probe batches.
+ */
+class BatchMemoryModel {
+private:
+  float constant_{0};
+  float perLength_{0};
+  float perToken_{0};
+  float perTokenLength_{0};
+
+  size_t parameters_{0};
+  size_t workspace_{0};
+  bool checkpointing_{false};
+
+public:
+  /** @brief Peak memory measured for a batch. */
+  struct Probe {
+    size_t length;
+    size_t batchSize;
+    size_t bytes;
+  };
+
+  /**
+   * @param parameters Number of parameters of the model
+   * @param workspace Bytes of the workspace the model is fitted for
+   * @param checkpointing Whether the graph uses gradient checkpointing
+   */
+  BatchMemoryModel(size_t parameters, size_t workspace, bool checkpointing)
+      : parameters_(parameters),
+        workspace_(workspace),
+        checkpointing_(checkpointing) {}
+
+  /**
+   * @brief Fits the coefficients to probes of two lengths with two batch
+   * sizes each, in the order (length1, batch1), (length1, batch2),
+   * (length2, batch1), (length2, batch2).
+   */
+  void fit(const std::vector<Probe>& probes) {
+    ABORT_IF(probes.size() != 4, "Memory model needs four probes");
+
+    float lengths[2], perSentence[2], fixed[2];
+    for(size_t i = 0; i < 2; ++i) {
+      const Probe& small = probes[2 * i];
+      const Probe& large = probes[2 * i + 1];
+      lengths[i] = small.length;
+      perSentence[i] = std::max(
+          0.f,
+          ((float)large.bytes - (float)small.bytes)
+              / (large.batchSize - small.batchSize));
+      fixed[i] = small.bytes - small.batchSize * perSentence[i];
+    }
+
+    // memory per sentence through (0, 0) and both lengths
+    float perToken1 = perSentence[0] / lengths[0];
+    float perToken2 = perSentence[1] / lengths[1];
+    perTokenLength_ = (perToken2 - perToken1) / (lengths[1] - lengths[0]);
+    perToken_ = perToken1 - perTokenLength_ * lengths[0];
+    if(perTokenLength_ < 0 || perToken_ < 0) {
+      perTokenLength_ = 0;
+      perToken_ = std::max(perToken1, perToken2);
+    }
+
+    // memory independent of the batch size, linear in the length
+    perLength_ = (fixed[1] - fixed[0]) / (lengths[1] - lengths[0]);
+    constant_ = fixed[0] - perLength_ * lengths[0];
+    if(perLength_ < 0) {
+      perLength_ = 0;
+      constant_ = std::max(fixed[0], fixed[1]);
+    }
+
+    ABORT_IF(perToken_ <= 0 && perTokenLength_ <= 0,
+             "Memory of probe batches does not grow with the batch size");
+  }
+
+  /** @brief Predicted bytes for batchSize sentences of the given length. */
+  float bytes(size_t length, size_t batchSize) const {
+    return constant_ + perLength_ * length
+           + batchSize * (perToken_ * length + perTokenLength_ * length * length);
+  }
+
+  /** @brief Bytes of the workspace the model is fitted for. */
+  size_t workspace() const { return workspace_; }
+
+  /**
+   * @brief Largest number of sentences of the given length that are predicted
+   * to fit into the given fraction of the workspace.
+   */
+  size_t maxBatchSize(size_t length, float fill) const {
+    float available = fill * workspace_ - constant_ - perLength_ * length;
+    float perSentence = perToken_ * length + perTokenLength_ * length * length;
+    if(available < perSentence)
+      return 1;
+    return available / perSentence;
+  }
+
+  /**
+   * @brief Loads a model saved for the same number of parameters, workspace
+   * size and gradient checkpointing; returns false if there is none.
+   */
+  bool load(const std::string& name) {
+    if(!boost::filesystem::exists(name))
+      return false;
+
+    YAML::Node config = YAML::LoadFile(name);
+    if(config["parameters"].as<size_t>() != parameters_
+       || config["workspace"].as<size_t>() != workspace_
+       || config["gradient-checkpointing"].as<bool>(false) != checkpointing_)
+      return false;
+
+    constant_ = config["constant"].as<float>();
+    perLength_ = config["per-length"].as<float>();
+    perToken_ = config["per-token"].as<float>();
+    perTokenLength_ = config["per-token-length"].as<float>();
+    return true;
+  }
+
+  void save(const std::string& name) const {
+    std::ofstream fout(name);
+    YAML::Node config;
+
+    config["parameters"] = parameters_;
+    config["workspace"] = workspace_;
+    config["gradient-checkpointing"] = checkpointing_;
+    config["constant"] = constant_;
+    config["per-length"] = perLength_;
+    config["per-token"] = perToken_;
+    config["per-token-length"] = perTokenLength_;
+
+    fout << config;
+  }
+};
+
 class BatchStats {
 private:
   std::map<std::vector<size_t>, size_t> map_;
 
+  // Memory model the batch sizes have been predicted with, if any, and the
+  // factor the batch sizes are scaled with because of the memory measured
+  // during training
+  Ptr<BatchMemoryModel> memory_;
+  std::atomic<float> scale_{1.f};
+
+  std::mutex mutexReports_;
+  size_t reports_{0};
+  float maxRatio_{0};
+
+  // Number of reported batches after which batch sizes are adjusted
+  const size_t ADJUST_AFTER = 100;
+
 public:
   size_t getBatchSize(const std::vector<size_t>& lengths) {
     auto it = map_.lower_bound(lengths);
@@ -23,18 +182,60 @@ public:
         it++;
 
     ABORT_IF(it == map_.end(), "Missing batch statistics");
-    return it->second;
+    return std::max((size_t)1, (size_t)(it->second * scale_));
   }
 
   void add(Ptr<data::CorpusBatch> batch, size_t multiplier = 1) {
     std::vector<size_t> lengths;
     for(int i = 0; i < batch->sets(); ++i)
       lengths.push_back((*batch)[i]->batchWidth());
-    size_t batchSize = batch->size() * multiplier;
+    add(lengths, batch->size() * multiplier);
+  }
 
+  void add(const std::vector<size_t>& lengths, size_t batchSize) {
     if(map_[lengths] < batchSize)
       map_[lengths] = batchSize;
   }
+
+  /**
+   * @brief Sets the memory model the batch sizes have been predicted with,
+   * which enables their adjustment during training.
+   */
+  void setMemoryModel(Ptr<BatchMemoryModel> memory) { memory_ = memory; }
+
+  /**
+   * @brief Reports the peak workspace memory of a training batch.
+   *
+   * Batch sizes are scaled by the ratio between predicted and measured memory
+   * over the last batches, immediately if the workspace had to grow.
+   */
+  void reportPeak(Ptr<data::CorpusBatch> batch, size_t bytes) {
+    if(!memory_ || batch->size() == 0)
+      return;
+
+    size_t length = 0;
+    for(size_t i = 0; i < batch->sets(); ++i)
+      length = std::max(length, (*batch)[i]->batchWidth());
+    float ratio = bytes / memory_->bytes(length, batch->size());
+
+    std::lock_guard<std::mutex> lock(mutexReports_);
+    maxRatio_ = std::max(maxRatio_, ratio);
+    if(++reports_ < ADJUST_AFTER && bytes <= memory_->workspace())
+      return;
+
+    float scale = std::min(8.f, std::max(0.125f, 1.f / maxRatio_));
+    if(std::abs(scale - scale_) > 0.05f * scale_) {
+      LOG(info,
+          "[batching] Batches need {:.2f} times the predicted memory, scaling "
+          "batch sizes by {:.2f}",
+          maxRatio_,
+          scale);
+      scale_ = scale;
+    }
+
+    reports_ = 0;
+    maxRatio_ = 0;
+  }
 };
 }
 }
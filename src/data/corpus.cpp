@@ -13,54 +13,40 @@ Corpus::Corpus(std::vector<std::string> paths,
                Ptr<Config> options)
     : CorpusBase(paths, vocabs, options) {}
 
-SentenceTuple Corpus::next() {
-  bool cont = true;
-  while(cont) {
-    // get index of the current sentence
-    size_t curId = pos_;
-    // if corpus has been shuffled, ids_ contains sentence indexes
-    if(pos_ < ids_.size())
-      curId = ids_[pos_];
-    pos_++;
-
-    // fill up the sentence tuple with sentences from all input files
-    SentenceTuple tup(curId);
-    for(size_t i = 0; i < files_.size(); ++i) {
-      std::string line;
-
-      if(std::getline((std::istream&)*files_[i], line)) {
-        if(i > 0 && i == alignFileIdx_) {
-          addAlignmentToSentenceTuple(line, tup);
-        } else if(i > 0 && i == weightFileIdx_) {
-          addWeightsToSentenceTuple(line, tup);
-        } else {
-          addWordsToSentenceTuple(line, i, tup);
-        }
-      }
-    }
-
-    // continue only if each input file provides an example
-    size_t expectedSize = files_.size();
-    if(weightFileIdx_ > 0)
-      expectedSize -= 1;
-    if(alignFileIdx_ > 0)
-      expectedSize -= 1;
-    cont = tup.size() == expectedSize;
-
-    // continue if all sentences are no longer than maximum allowed length
-    if(cont && std::all_of(tup.begin(), tup.end(), [=](const Words& words) {
-         return words.size() > 0 && words.size() <= maxLength_;
-       }))
-      return tup;
-  }
-  return SentenceTuple(0);
+bool Corpus::readLines(size_t& id, std::vector<std::string>& lines) {
+  if(readingShards())
+    return readShardLines(id, lines);
+
+  // get index of the current sentence
+  id = pos_;
+  // if corpus has been shuffled, ids_ contains sentence indexes
+  if(pos_ < ids_.size())
+    id = ids_[pos_];
+  pos_++;
+
+  // continue only if each input file provides a line
+  lines.resize(files_.size());
+  for(size_t i = 0; i < files_.size(); ++i)
+    if(!std::getline((std::istream&)*files_[i], lines[i]))
+      return false;
+  return true;
 }
 
 void Corpus::shuffle() {
-  shuffleFiles(paths_);
+  resetParsing();
+  if(shardSize_ > 0) {
+    if(shardOffsets_.empty())
+      createShards(paths_);
+    LOG(info, "[data] Shuffling {} shards", shardOffsets_.front().size());
+    shuffleShards(shardOffsets_.front().size());
+  } else {
+    shuffleFiles(paths_);
+  }
 }
 
 void Corpus::reset() {
+  resetParsing();
+  resetShards();
   files_.clear();
   ids_.clear();
   pos_ = 0;
@@ -125,5 +111,69 @@ void Corpus::shuffleFiles(const std::vector<std::string>& paths) {
 
   LOG(info, "[data] Done");
 }
+void Corpus::createShards(const std::vector<std::string>& paths) {
+  LOG(info, "[data] Splitting corpus into shards of {} lines", shardSize_);
+
+  for(auto& path : paths) {
+    ABORT_IF(path == "stdin", "Block-wise shuffling cannot read from stdin");
+
+    std::string seekablePath = path;
+    if(boost::filesystem::path(path).extension() == ".gz") {
+      // decompress once into a seekable temporary file
+      shardTempFiles_.emplace_back(new TemporaryFile(
+          options_->get<std::string>("tempdir"), /*earlyUnlink=*/false));
+      {
+        InputFileStream in(path);
+        OutputFileStream out(*shardTempFiles_.back());
+        (std::ostream&)out << ((std::istream&)in).rdbuf();
+      }
+      seekablePath = shardTempFiles_.back()->getFileName();
+    }
+    shardFiles_.emplace_back(new std::ifstream(seekablePath));
+  }
+
+  // a single pass over all files recording the offset of every shard
+  shardOffsets_.resize(shardFiles_.size());
+  std::vector<std::string> lines(shardFiles_.size());
+  size_t numLines = 0;
+  bool cont = true;
+  while(cont) {
+    std::vector<std::streampos> offsets;
+    for(auto& file : shardFiles_)
+      offsets.push_back(file->tellg());
+
+    for(size_t i = 0; i < shardFiles_.size(); ++i)
+      cont = cont && std::getline(*shardFiles_[i], lines[i]);
+
+    if(cont) {
+      if(numLines % shardSize_ == 0)
+        for(size_t i = 0; i < shardFiles_.size(); ++i)
+          shardOffsets_[i].push_back(offsets[i]);
+      numLines++;
+    }
+  }
+
+  LOG(info,
+      "[data] Done, {} lines in {} shards",
+      numLines,
+      shardOffsets_.front().size());
+}
+
+void Corpus::loadShard(size_t shard, LineBuffer& buffer) {
+  for(size_t i = 0; i < shardFiles_.size(); ++i) {
+    shardFiles_[i]->clear();
+    shardFiles_[i]->seekg(shardOffsets_[i][shard]);
+  }
+
+  std::vector<std::string> lines(shardFiles_.size());
+  for(size_t l = 0; l < shardSize_; ++l) {
+    bool cont = true;
+    for(size_t i = 0; i < shardFiles_.size(); ++i)
+      cont = cont && std::getline(*shardFiles_[i], lines[i]);
+    if(!cont)
+      break;
+    buffer.emplace_back(shard * shardSize_ + l, lines);
+  }
+}
 }
 }
@@ -26,6 +26,18 @@ private:
 
   void shuffleFiles(const std::vector<std::string>& paths);
 
+  // block-wise shuffling: seekable streams and byte offsets of each shard
+  std::vector<UPtr<TemporaryFile>> shardTempFiles_;
+  std::vector<UPtr<std::ifstream>> shardFiles_;
+  std::vector<std::vector<std::streampos>> shardOffsets_;
+
+  void createShards(const std::vector<std::string>& paths);
+
+protected:
+  bool readLines(size_t& id, std::vector<std::string>& lines);
+
+  void loadShard(size_t shard, LineBuffer& buffer);
+
 public:
   Corpus(Ptr<Config> options, bool translate = false);
 
@@ -33,17 +45,6 @@ public:
          std::vector<Ptr<Vocab>> vocabs,
          Ptr<Config> options);
 
-  /**
-   * @brief Iterates sentence tuples in the corpus.
-   *
-   * A sentence tuple is skipped with no warning if any sentence in the tuple
-   * (e.g. a source or target) is longer than the maximum allowed sentence
-   * length in words unless the option "max-length-crop" is provided.
-   *
-   * @return A tuple representing parallel sentences.
-   */
-  sample next();
-
   void shuffle();
 
   void reset();
@@ -55,52 +56,6 @@ public:
   iterator end() { return iterator(); }
 
   std::vector<Ptr<Vocab>>& getVocabs() { return vocabs_; }
-
-  batch_ptr toBatch(const std::vector<sample>& batchVector) {
-    int batchSize = batchVector.size();
-
-    std::vector<size_t> sentenceIds;
-
-    std::vector<int> maxDims;
-    for(auto& ex : batchVector) {
-      if(maxDims.size() < ex.size())
-        maxDims.resize(ex.size(), 0);
-      for(size_t i = 0; i < ex.size(); ++i) {
-        if(ex[i].size() > (size_t)maxDims[i])
-          maxDims[i] = ex[i].size();
-      }
-      sentenceIds.push_back(ex.getId());
-    }
-
-    std::vector<Ptr<SubBatch>> subBatches;
-    for(auto m : maxDims) {
-      subBatches.emplace_back(New<SubBatch>(batchSize, m));
-    }
-
-    std::vector<size_t> words(maxDims.size(), 0);
-    for(int i = 0; i < batchSize; ++i) {
-      for(int j = 0; j < maxDims.size(); ++j) {
-        for(int k = 0; k < batchVector[i][j].size(); ++k) {
-          subBatches[j]->data()[k * batchSize + i] = batchVector[i][j][k];
-          subBatches[j]->mask()[k * batchSize + i] = 1.f;
-          words[j]++;
-        }
-      }
-    }
-
-    for(size_t j = 0; j < maxDims.size(); ++j)
-      subBatches[j]->setWords(words[j]);
-
-    auto batch = batch_ptr(new batch_type(subBatches));
-    batch->setSentenceIds(sentenceIds);
-
-    if(options_->has("guided-alignment") && alignFileIdx_)
-      addAlignmentsToBatch(batch, batchVector);
-    if(options_->has("data-weighting") && weightFileIdx_)
-      addWeightsToBatch(batch, batchVector);
-
-    return batch;
-  }
 };
 }
 }
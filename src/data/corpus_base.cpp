@@ -1,3 +1,4 @@
+#include <numeric>
 #include <random>
 
 #include "data/corpus.h"
@@ -43,6 +44,8 @@ CorpusBase::CorpusBase(std::vector<std::string> paths,
   for(auto path : paths_) {
     files_.emplace_back(new InputFileStream(path));
   }
+
+  initParsing();
 }
 
 CorpusBase::CorpusBase(Ptr<Config> options, bool translate)
@@ -164,6 +167,160 @@ CorpusBase::CorpusBase(Ptr<Config> options, bool translate)
     paths_.emplace_back(path);
     files_.emplace_back(new InputFileStream(path));
   }
+
+  initParsing();
+}
+
+void CorpusBase::initParsing() {
+  if(options_->has("shuffle-shard-size"))
+    shardSize_ = options_->get<size_t>("shuffle-shard-size");
+
+  if(options_->has("data-threads"))
+    parseThreads_ = std::max(options_->get<size_t>("data-threads"), (size_t)1);
+
+  if(parseThreads_ > 1) {
+    LOG(info, "[data] Parsing corpus with {} threads", parseThreads_);
+    parsePool_.reset(new ThreadPool(parseThreads_));
+  }
+}
+
+SentenceTuple CorpusBase::next() {
+  size_t id;
+  std::vector<std::string> lines;
+
+  if(!parsePool_) {
+    while(readLines(id, lines)) {
+      position_ = ++linesRead_;
+      auto tup = parseLines(id, lines);
+      if(!tup.empty())
+        return tup;
+    }
+    return SentenceTuple(0);
+  }
+
+  while(chunkPos_ >= currentChunk_.size()) {
+    enqueueChunks();
+    if(parsedChunks_.empty())
+      return SentenceTuple(0);
+
+    currentChunk_ = parsedChunks_.front().get();
+    parsedChunks_.pop_front();
+    chunkPos_ = 0;
+  }
+
+  auto& posTup = currentChunk_[chunkPos_++];
+  position_ = posTup.first;
+  return std::move(posTup.second);
+}
+
+void CorpusBase::setPosition(size_t position) {
+  resetParsing();
+
+  size_t id;
+  std::vector<std::string> lines;
+  while(linesRead_ < position && readLines(id, lines))
+    linesRead_++;
+  position_ = linesRead_;
+}
+
+void CorpusBase::enqueueChunks() {
+  // keep a bounded number of chunks in flight, reading overlaps with parsing
+  while(!linesExhausted_ && parsedChunks_.size() < 2 * parseThreads_) {
+    auto chunk = New<LineChunk>();
+    chunk->reserve(parseChunkSize_);
+
+    IndexedLines indexed;
+    while(chunk->size() < parseChunkSize_) {
+      if(!readLines(indexed.id, indexed.lines)) {
+        linesExhausted_ = true;
+        break;
+      }
+      indexed.position = ++linesRead_;
+      chunk->push_back(indexed);
+    }
+
+    if(chunk->empty())
+      break;
+
+    parsedChunks_.emplace_back(parsePool_->enqueue([this, chunk]() {
+      TupleChunk tuples;
+      tuples.reserve(chunk->size());
+      for(auto& indexed : *chunk) {
+        auto tup = parseLines(indexed.id, indexed.lines);
+        if(!tup.empty())
+          tuples.emplace_back(indexed.position, std::move(tup));
+      }
+      return tuples;
+    }));
+  }
+}
+
+void CorpusBase::resetParsing() {
+  for(auto& chunk : parsedChunks_)
+    chunk.wait();
+  parsedChunks_.clear();
+  currentChunk_.clear();
+  chunkPos_ = 0;
+  linesExhausted_ = false;
+  linesRead_ = 0;
+  position_ = 0;
+}
+
+void CorpusBase::shuffleShards(size_t numShards) {
+  shardOrder_.resize(numShards);
+  std::iota(shardOrder_.begin(), shardOrder_.end(), 0);
+  std::shuffle(shardOrder_.begin(), shardOrder_.end(), eng_);
+  shardPos_ = 0;
+  shardBuffer_.clear();
+  shardBufferPos_ = 0;
+}
+
+void CorpusBase::resetShards() {
+  shardOrder_.clear();
+  shardPos_ = 0;
+  shardBuffer_.clear();
+  shardBufferPos_ = 0;
+}
+
+bool CorpusBase::readShardLines(size_t& id, std::vector<std::string>& lines) {
+  while(shardBufferPos_ >= shardBuffer_.size()) {
+    if(shardPos_ >= shardOrder_.size())
+      return false;
+
+    shardBuffer_.clear();
+    shardBufferPos_ = 0;
+    loadShard(shardOrder_[shardPos_++], shardBuffer_);
+    std::shuffle(shardBuffer_.begin(), shardBuffer_.end(), eng_);
+  }
+
+  auto& idLines = shardBuffer_[shardBufferPos_++];
+  id = idLines.first;
+  lines.swap(idLines.second);
+  return true;
+}
+
+SentenceTuple CorpusBase::parseLines(
+    size_t id,
+    const std::vector<std::string>& lines) const {
+  // fill up the sentence tuple with sentences from all input files
+  SentenceTuple tup(id);
+  for(size_t i = 0; i < lines.size(); ++i) {
+    if(i > 0 && i == alignFileIdx_) {
+      addAlignmentToSentenceTuple(lines[i], tup);
+    } else if(i > 0 && i == weightFileIdx_) {
+      addWeightsToSentenceTuple(lines[i], tup);
+    } else {
+      addWordsToSentenceTuple(lines[i], i, tup);
+    }
+  }
+
+  // skip if any sentence is longer than the maximum allowed length
+  if(!std::all_of(tup.begin(), tup.end(), [=](const WordRange& words) {
+       return words.size() > 0 && words.size() <= maxLength_;
+     }))
+    return SentenceTuple(id);
+
+  return tup;
 }
 
 void CorpusBase::addWordsToSentenceTuple(const std::string& line,
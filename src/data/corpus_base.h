@@ -1,12 +1,15 @@
 #pragma once
 
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <random>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/iterator/iterator_facade.hpp>
 
+#include "3rd_party/threadpool.h"
 #include "common/config.h"
 #include "common/definitions.h"
 #include "common/file_stream.h"
@@ -20,6 +23,31 @@
 namespace marian {
 namespace data {
 
+/**
+ * @brief Read-only view of the word indices of a single sentence stored in a
+ * marian::data::SentenceTuple.
+ */
+class WordRange {
+private:
+  const WordIndex* begin_;
+  const WordIndex* end_;
+
+public:
+  typedef WordIndex value_type;
+
+  WordRange(const WordIndex* begin, const WordIndex* end)
+      : begin_(begin), end_(end) {}
+
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+
+  WordIndex operator[](size_t i) const { return begin_[i]; }
+  WordIndex back() const { return *(end_ - 1); }
+
+  const WordIndex* begin() const { return begin_; }
+  const WordIndex* end() const { return end_; }
+};
+
 /**
  * @brief A sentence tuple that stores all sources and target sentences for a
  * specific "line" from a parallel corpus.
@@ -27,24 +55,55 @@ namespace data {
  * Sentence tuples are used to store sentences read from external files and to
  * be a basis for construction of marian::data::CorpusBatch objects. They are
  * not a part of marian::data::CorpusBatch.
+ *
+ * The word indices of all sentences are stored in a single contiguous buffer
+ * of marian::WordIndex, sentences are accessed as marian::data::WordRange.
  */
 class SentenceTuple {
 private:
   size_t id_;
-  std::vector<Words> tuple_;
+  std::vector<WordIndex> words_;
+  // end of the i-th sentence in words_
+  std::vector<uint32_t> ends_;
   std::vector<float> weights_;
   WordAlignment alignment_;
 
 public:
-  typedef Words value_type;
+  typedef WordRange value_type;
+
+  /**
+   * @brief Random access iterator over the sentences of a tuple.
+   */
+  class const_iterator
+      : public boost::iterator_facade<const_iterator,
+                                      WordRange,
+                                      boost::random_access_traversal_tag,
+                                      WordRange> {
+  public:
+    const_iterator(const SentenceTuple* tup, size_t i) : tup_(tup), i_(i) {}
+
+  private:
+    friend class boost::iterator_core_access;
+
+    WordRange dereference() const { return (*tup_)[i_]; }
+    bool equal(const const_iterator& other) const { return i_ == other.i_; }
+    void increment() { ++i_; }
+    void decrement() { --i_; }
+    void advance(std::ptrdiff_t n) { i_ += n; }
+    std::ptrdiff_t distance_to(const const_iterator& other) const {
+      return (std::ptrdiff_t)other.i_ - (std::ptrdiff_t)i_;
+    }
+
+    const SentenceTuple* tup_;
+    size_t i_;
+  };
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
   /**
    * @brief Creates an empty tuple with the given Id.
    */
   SentenceTuple(size_t id) : id_(id) {}
 
-  ~SentenceTuple() { tuple_.clear(); }
-
   /**
    * @brief Returns the sentence's ID.
    */
@@ -55,38 +114,54 @@ public:
    *
    * @param words A vector of word indexes.
    */
-  void push_back(const Words& words) { tuple_.push_back(words); }
+  void push_back(const Words& words) {
+    words_.insert(words_.end(), words.begin(), words.end());
+    ends_.push_back(words_.size());
+  }
+
+  /**
+   * @brief Adds a new sentence given as a range of word indexes.
+   */
+  void push_back(const WordIndex* first, const WordIndex* last) {
+    words_.insert(words_.end(), first, last);
+    ends_.push_back(words_.size());
+  }
 
   /**
    * @brief The size of the tuple, e.g. two for parallel data with a source and
    * target sentences.
    */
-  size_t size() const { return tuple_.size(); }
+  size_t size() const { return ends_.size(); }
 
   /**
    * @brief The i-th tuple sentence.
    *
    * @param i Tuple's index.
    */
-  Words& operator[](size_t i) { return tuple_[i]; }
-  const Words& operator[](size_t i) const { return tuple_[i]; }
+  WordRange operator[](size_t i) const {
+    const WordIndex* data = words_.data();
+    return WordRange(data + (i > 0 ? ends_[i - 1] : 0), data + ends_[i]);
+  }
 
   /**
    * @brief The last tuple sentence, i.e. the target sentence.
    */
-  Words& back() { return tuple_.back(); }
-  const Words& back() const { return tuple_.back(); }
+  WordRange back() const { return (*this)[size() - 1]; }
 
   /**
    * @brief Checks whether the tuple is empty.
    */
-  bool empty() const { return tuple_.empty(); }
+  bool empty() const { return ends_.empty(); }
 
-  auto begin() const -> decltype(tuple_.begin()) { return tuple_.begin(); }
-  auto end() const -> decltype(tuple_.end()) { return tuple_.end(); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
 
-  auto rbegin() const -> decltype(tuple_.rbegin()) { return tuple_.rbegin(); }
-  auto rend() const -> decltype(tuple_.rend()) { return tuple_.rend(); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
 
   /**
    * @brief  Get sentence weights.
@@ -102,11 +177,14 @@ public:
 
 /**
  * @brief Batch of sentences represented as word indices with masking.
+ *
+ * Word indices are stored as marian::WordIndex and the mask is not stored but
+ * derived from sentence lengths when needed.
  */
 class SubBatch {
 private:
-  std::vector<Word> indices_;
-  std::vector<float> mask_;
+  std::vector<WordIndex> indices_;
+  std::vector<size_t> lengths_;
 
   size_t size_;
   size_t width_;
@@ -121,7 +199,7 @@ public:
    */
   SubBatch(int size, int width)
       : indices_(size * width, 0),
-        mask_(size * width, 0),
+        lengths_(size, 0),
         size_(size),
         width_(width),
         words_(0) {}
@@ -132,14 +210,40 @@ public:
    * The order of indices is \f$idx_{0,0}, idx_{0,1},\dots,idx_{0,s}, \dots,
    * idx_{w,0},idx_{w,1},\dots,idx_{w,s}\f$, where \f$w\f$ is the number of
    * words (width) and \f$s\f$ is the number of sentences (size).
+   *
+   * Returns a copy widened to marian::Word, e.g. for creating graph nodes; use
+   * indices() for element access.
    */
-  std::vector<Word>& data() { return indices_; }
+  Words data() const { return Words(indices_.begin(), indices_.end()); }
+
+  /**
+   * @brief Flat vector of word indices as stored.
+   *
+   * @see data()
+   */
+  std::vector<WordIndex>& indices() { return indices_; }
+  const std::vector<WordIndex>& indices() const { return indices_; }
+
   /**
    * @brief Flat masking vector; 0 is used for masked words.
    *
+   * Computed from the sentence lengths.
+   *
    * @see data()
    */
-  std::vector<float>& mask() { return mask_; }
+  std::vector<float> mask() const {
+    std::vector<float> mask(size_ * width_, 0.f);
+    for(size_t i = 0; i < size_; ++i)
+      for(size_t j = 0; j < lengths_[i]; ++j)
+        mask[j * size_ + i] = 1.f;
+    return mask;
+  }
+
+  /**
+   * @brief Number of unmasked words of each sentence.
+   */
+  const std::vector<size_t>& lengths() const { return lengths_; }
+  void setLength(size_t i, size_t length) { lengths_[i] = length; }
 
   /**
    * @brief The number of sentences in the batch.
@@ -155,41 +259,39 @@ public:
   size_t batchWords() { return words_; }
 
   /**
-   * @brief Splits the subbatch into subbatches of equal size.
+   * @brief Splits the subbatch into subbatches of consecutive sentences.
    *
-   * @param n Number of splits
+   * The width of each subbatch is reduced to its longest sentence.
+   *
+   * @param sizes Number of sentences of each split
    *
    * @return Vector of pointers to new subbatches.
    *
    * @see marian::data::Batch::split(size_t n)
    */
-  std::vector<Ptr<SubBatch>> split(size_t n) {
+  std::vector<Ptr<SubBatch>> split(const std::vector<size_t>& sizes) {
     std::vector<Ptr<SubBatch>> splits;
 
-    size_t subSize = std::ceil(size_ / (float)n);
-    size_t totSize = size_;
-
-    int pos = 0;
-    for(int k = 0; k < n; ++k) {
-      size_t __size__ = std::min(subSize, totSize);
+    size_t pos = 0;
+    for(auto __size__ : sizes) {
+      size_t __width__ = 0;
+      for(size_t i = 0; i < __size__; ++i)
+        __width__ = std::max(__width__, lengths_[pos + i]);
 
-      auto sb = New<SubBatch>(__size__, width_);
+      auto sb = New<SubBatch>(__size__, __width__);
 
       size_t __words__ = 0;
-      for(int j = 0; j < width_; ++j) {
-        for(int i = 0; i < __size__; ++i) {
-          sb->data()[j * __size__ + i] = indices_[j * size_ + pos + i];
-          sb->mask()[j * __size__ + i] = mask_[j * size_ + pos + i];
-
-          if(mask_[j * size_ + pos + i] != 0)
-            __words__++;
-        }
+      for(size_t i = 0; i < __size__; ++i) {
+        sb->setLength(i, lengths_[pos + i]);
+        __words__ += lengths_[pos + i];
       }
+      for(size_t j = 0; j < __width__; ++j)
+        for(size_t i = 0; i < __size__; ++i)
+          sb->indices()[j * __size__ + i] = indices_[j * size_ + pos + i];
 
       sb->setWords(__words__);
       splits.push_back(sb);
 
-      totSize -= __size__;
       pos += __size__;
     }
     return splits;
@@ -268,6 +370,56 @@ public:
    */
   size_t sets() const { return batches_.size(); }
 
+  /**
+   * @brief Creates a batch from sentence tuples, word indices are copied and
+   * sentence lengths set.
+   *
+   * @param batchVector Sentence tuples, one per sentence in the batch.
+   *
+   * @return A batch without guided alignments and data weights.
+   */
+  static Ptr<CorpusBatch> fromTuples(
+      const std::vector<SentenceTuple>& batchVector) {
+    size_t batchSize = batchVector.size();
+
+    std::vector<size_t> sentenceIds;
+
+    std::vector<size_t> maxDims;
+    for(auto& ex : batchVector) {
+      if(maxDims.size() < ex.size())
+        maxDims.resize(ex.size(), 0);
+      for(size_t i = 0; i < ex.size(); ++i) {
+        if(ex[i].size() > maxDims[i])
+          maxDims[i] = ex[i].size();
+      }
+      sentenceIds.push_back(ex.getId());
+    }
+
+    std::vector<Ptr<SubBatch>> subBatches;
+    for(auto m : maxDims) {
+      subBatches.emplace_back(New<SubBatch>(batchSize, m));
+    }
+
+    std::vector<size_t> words(maxDims.size(), 0);
+    for(size_t i = 0; i < batchSize; ++i) {
+      for(size_t j = 0; j < maxDims.size(); ++j) {
+        auto sentence = batchVector[i][j];
+        auto& indices = subBatches[j]->indices();
+        for(size_t k = 0; k < sentence.size(); ++k)
+          indices[k * batchSize + i] = sentence[k];
+        subBatches[j]->setLength(i, sentence.size());
+        words[j] += sentence.size();
+      }
+    }
+
+    for(size_t j = 0; j < maxDims.size(); ++j)
+      subBatches[j]->setWords(words[j]);
+
+    auto batch = New<CorpusBatch>(subBatches);
+    batch->setSentenceIds(sentenceIds);
+    return batch;
+  }
+
   /**
    * @brief Creates a batch filled with fake data. Used to determine the size of
    * the batch object.
@@ -285,7 +437,8 @@ public:
 
     for(auto len : lengths) {
       auto sb = New<SubBatch>(batchSize, len);
-      std::fill(sb->mask().begin(), sb->mask().end(), 1);
+      for(size_t i = 0; i < batchSize; ++i)
+        sb->setLength(i, len);
 
       batches.push_back(sb);
     }
@@ -310,20 +463,87 @@ public:
   }
 
   /**
-   * @brief Splits the batch into batches of equal size.
+   * @brief Sizes of n splits of consecutive sentences with balanced work.
+   *
+   * The work of a split is the number of its words including padding, summed
+   * over all subbatches. The largest work of a split is minimized with a
+   * binary search over budgets of words, filling splits greedily. Splits are
+   * then halved until there are n of them, as long as there are sentences.
+   */
+  std::vector<size_t> splitSizes(size_t n) const {
+    size_t size = this->size();
+
+    // greedy splits of at most budget padded words; a single sentence may
+    // exceed the budget
+    auto fill = [&](size_t budget) {
+      std::vector<size_t> sizes;
+      std::vector<size_t> widths(batches_.size(), 0);
+      size_t count = 0;
+      for(size_t i = 0; i < size; ++i) {
+        size_t words = 0;
+        for(size_t k = 0; k < batches_.size(); ++k)
+          words += (count + 1)
+                   * std::max(widths[k], batches_[k]->lengths()[i]);
+
+        if(count > 0 && words > budget) {
+          sizes.push_back(count);
+          count = 0;
+          std::fill(widths.begin(), widths.end(), 0);
+        }
+
+        for(size_t k = 0; k < batches_.size(); ++k)
+          widths[k] = std::max(widths[k], batches_[k]->lengths()[i]);
+        count++;
+      }
+      if(count > 0)
+        sizes.push_back(count);
+      return sizes;
+    };
+
+    size_t low = 0;
+    size_t high = 0;
+    for(auto subBatch : batches_)
+      high += size * subBatch->batchWidth();
+    while(low < high) {
+      size_t budget = (low + high) / 2;
+      if(fill(budget).size() <= n)
+        high = budget;
+      else
+        low = budget + 1;
+    }
+
+    auto sizes = fill(high);
+    while(sizes.size() < n) {
+      auto largest = std::max_element(sizes.begin(), sizes.end());
+      if(largest == sizes.end() || *largest < 2) {
+        sizes.push_back(0);
+        continue;
+      }
+      size_t half = *largest / 2;
+      *largest -= half;
+      sizes.insert(largest + 1, half);
+    }
+    return sizes;
+  }
+
+  /**
+   * @brief Splits the batch into batches with balanced work.
    *
    * @param n number of splits
    *
    * @return Vector of pointers to new batches.
    *
-   * @see marian::data::SubBatch::split(size_t n)
+   * @see splitSizes(size_t n)
+   * @see marian::data::SubBatch::split(const std::vector<size_t>& sizes)
    */
   std::vector<Ptr<Batch>> split(size_t n) {
+    auto sizes = splitSizes(n);
+
     // split each subbatch separately
     std::vector<std::vector<Ptr<SubBatch>>> subs(n);
     for(auto subBatch : batches_) {
       size_t i = 0;
-      for(auto splitSubBatch : subBatch->split(n))
+      for(auto splitSubBatch : subBatch->split(sizes))
         subs[i++].push_back(splitSubBatch);
     }
 
@@ -358,12 +578,14 @@ public:
         width = batches_.back()->batchWidth();
 
       for(auto split : splits) {
-        std::vector<float> ws(width * split->size(), 1.0f);
+        // split batches are narrower
+        size_t splitWidth = width == 1 ? 1 : split->widthTrg();
+        std::vector<float> ws(splitWidth * split->size(), 1.0f);
 
         // this needs to be split along the batch dimension
         // which is here the innermost dimension.
         // Should work for sentence-based weights, too.
-        for(int j = 0; j < width; ++j) {
+        for(int j = 0; j < splitWidth; ++j) {
           for(int i = 0; i < split->size(); ++i) {
             ws[j * split->size() + i] = dataWeights_[j * oldSize + i + pos];
           }
@@ -406,7 +628,7 @@ public:
         std::cerr << "\t w: ";
         for(size_t j = 0; j < sb->batchSize(); j++) {
           size_t idx = i * sb->batchSize() + j;
-          Word w = sb->data()[idx];
+          Word w = sb->indices()[idx];
           std::cerr << w << " ";
         }
         std::cerr << std::endl;
@@ -439,6 +661,44 @@ public:
 
   virtual std::vector<Ptr<Vocab>>& getVocabs() = 0;
 
+  /**
+   * @brief Iterates sentence tuples in the corpus.
+   *
+   * A sentence tuple is skipped with no warning if any sentence in the tuple
+   * (e.g. a source or target) is longer than the maximum allowed sentence
+   * length in words unless the option "max-length-crop" is provided.
+   *
+   * Lines are read sequentially with readLines(). If the option
+   * "data-threads" is larger than one, chunks of lines are converted into
+   * sentence tuples by a thread pool while the next chunks are being read.
+   * Tuples are returned in the same order as with a single thread.
+   *
+   * @return A tuple representing parallel sentences.
+   */
+  virtual sample next();
+
+  /**
+   * @brief Number of lines read in the current epoch up to and including the
+   * last sentence tuple returned by next(), skipped lines included.
+   */
+  virtual size_t getPosition() { return position_; }
+
+  /**
+   * @brief Reads and discards the given number of lines without parsing them.
+   */
+  virtual void setPosition(size_t position);
+
+  batch_ptr toBatch(const std::vector<sample>& batchVector) {
+    auto batch = CorpusBatch::fromTuples(batchVector);
+
+    if(options_->has("guided-alignment") && alignFileIdx_)
+      addAlignmentsToBatch(batch, batchVector);
+    if(options_->has("data-weighting") && weightFileIdx_)
+      addWeightsToBatch(batch, batchVector);
+
+    return batch;
+  }
+
 protected:
   std::vector<UPtr<InputFileStream>> files_;
   std::vector<Ptr<Vocab>> vocabs_;
@@ -488,6 +748,110 @@ protected:
 
   void addWeightsToBatch(Ptr<CorpusBatch> batch,
                          const std::vector<sample>& batchVector);
+
+  /**
+   * @brief Reads the next line from each input file, including alignment and
+   * weight files.
+   *
+   * @param id Set to the index of the sentence tuple in the corpus
+   * @param lines Filled with one line per input file
+   *
+   * @return False if any of the input files is exhausted.
+   */
+  virtual bool readLines(size_t& id, std::vector<std::string>& lines) {
+    ABORT("Reading raw lines is not implemented for this corpus");
+  }
+
+  /**
+   * @brief Converts lines returned by readLines() into a sentence tuple.
+   *
+   * Returns an empty tuple if the tuple should be skipped. The method does not
+   * modify the corpus and can be called concurrently.
+   */
+  SentenceTuple parseLines(size_t id,
+                           const std::vector<std::string>& lines) const;
+
+  /**
+   * @brief Waits for and discards all chunks of lines that are being parsed;
+   * needs to be called whenever the input files are re-opened or reordered.
+   */
+  void resetParsing();
+
+  typedef std::vector<std::pair<size_t, std::vector<std::string>>> LineBuffer;
+
+  /**
+   * @brief Number of lines per shard for block-wise shuffling, zero if the
+   * whole corpus is shuffled at once.
+   *
+   * With block-wise shuffling the corpus is split into shards of consecutive
+   * lines. Each epoch the order of shards is shuffled and the lines of one
+   * shard at a time are loaded into memory and shuffled there.
+   */
+  size_t shardSize_{0};
+
+  /**
+   * @brief Shuffles the order of shards and starts reading from the first
+   * shard in that order.
+   */
+  void shuffleShards(size_t numShards);
+
+  /**
+   * @brief Stops block-wise reading, e.g. when the corpus is not shuffled.
+   */
+  void resetShards();
+
+  /**
+   * @brief Reads the next line tuple from the current shuffled shard, loading
+   * the next shard with loadShard() if needed; a replacement for readLines()
+   * if shards are used.
+   *
+   * @return False if all shards have been read.
+   */
+  bool readShardLines(size_t& id, std::vector<std::string>& lines);
+
+  /**
+   * @brief Returns true if the corpus is currently read shard by shard.
+   */
+  bool readingShards() const { return !shardOrder_.empty(); }
+
+  /**
+   * @brief Loads the lines of all input files for the given shard together
+   * with their sentence indexes.
+   */
+  virtual void loadShard(size_t shard, LineBuffer& buffer) {
+    ABORT("Block-wise shuffling is not implemented for this corpus");
+  }
+
+private:
+  struct IndexedLines {
+    size_t id;
+    size_t position;
+    std::vector<std::string> lines;
+  };
+  typedef std::vector<IndexedLines> LineChunk;
+
+  size_t parseThreads_{1};
+  size_t parseChunkSize_{1000};
+  UPtr<ThreadPool> parsePool_;
+
+  // parsed sentence tuples with the positions of their lines
+  typedef std::vector<std::pair<size_t, SentenceTuple>> TupleChunk;
+
+  std::deque<std::future<TupleChunk>> parsedChunks_;
+  TupleChunk currentChunk_;
+  size_t chunkPos_{0};
+  bool linesExhausted_{false};
+
+  size_t linesRead_{0};
+  size_t position_{0};
+
+  std::vector<size_t> shardOrder_;
+  size_t shardPos_{0};
+  LineBuffer shardBuffer_;
+  size_t shardBufferPos_{0};
+
+  void initParsing();
+  void enqueueChunks();
 };
 
 class CorpusIterator
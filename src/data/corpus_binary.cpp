@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+#include "data/corpus_binary.h"
+
+namespace marian {
+namespace data {
+
+const char* BinaryCorpusFile::MAGIC = "MRNBIN01";
+
+BinaryCorpusFile::BinaryCorpusFile(const std::string& path) {
+  ABORT_IF(!boost::filesystem::exists(path),
+           "Binary corpus file '{}' does not exist",
+           path);
+
+  file_.open(path);
+  ABORT_IF(!file_.is_open(), "Could not memory-map file '{}'", path);
+  ABORT_IF(file_.size() < sizeof(Header),
+           "File '{}' is not a binary corpus",
+           path);
+
+  header_ = reinterpret_cast<const Header*>(file_.data());
+  ABORT_IF(std::strncmp(header_->magic, MAGIC, sizeof(header_->magic)) != 0,
+           "File '{}' is not a binary corpus",
+           path);
+  ABORT_IF(header_->version != VERSION,
+           "Binary corpus '{}' has version {}, expected {}",
+           path,
+           header_->version,
+           VERSION);
+
+  // word indices are padded to a multiple of 8 bytes before the offsets
+  size_t wordBytes = ((header_->words * sizeof(uint32_t) + 7) / 8) * 8;
+  size_t expected = sizeof(Header) + wordBytes
+                    + (header_->sentences + 1) * sizeof(uint64_t);
+  ABORT_IF(file_.size() != expected,
+           "Binary corpus '{}' is truncated or corrupted",
+           path);
+
+  words_ = reinterpret_cast<const uint32_t*>(file_.data() + sizeof(Header));
+  offsets_ = reinterpret_cast<const uint64_t*>(file_.data() + sizeof(Header)
+                                               + wordBytes);
+}
+
+size_t BinaryCorpusFile::create(const std::string& binPath,
+                                InputFileStream& textStrm,
+                                Ptr<Vocab> vocab) {
+  // Offsets are collected in a temporary file next to the output so that
+  // the index of very large corpora does not need to be kept in memory.
+  std::string offsetsPath = binPath + ".offsets";
+  std::ofstream out(binPath, std::ios::binary | std::ios::trunc);
+  std::ofstream offsetsOut(offsetsPath, std::ios::binary | std::ios::trunc);
+  ABORT_IF(!out || !offsetsOut, "Could not open '{}' for writing", binPath);
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.vocabSize = vocab->size();
+  header.sentences = 0;
+  header.words = 0;
+  out.write((const char*)&header, sizeof(Header));
+
+  std::vector<uint32_t> buffer;
+  std::string line;
+  while(std::getline((std::istream&)textStrm, line)) {
+    offsetsOut.write((const char*)&header.words, sizeof(uint64_t));
+
+    Words words = (*vocab)(line);
+    buffer.assign(words.begin(), words.end());
+    out.write((const char*)buffer.data(), buffer.size() * sizeof(uint32_t));
+
+    header.words += buffer.size();
+    header.sentences++;
+  }
+  offsetsOut.write((const char*)&header.words, sizeof(uint64_t));
+  offsetsOut.close();
+
+  if(header.words % 2 != 0) {
+    uint32_t pad = 0;
+    out.write((const char*)&pad, sizeof(uint32_t));
+  }
+
+  std::ifstream offsetsIn(offsetsPath, std::ios::binary);
+  out << offsetsIn.rdbuf();
+  offsetsIn.close();
+  std::remove(offsetsPath.c_str());
+
+  out.seekp(0);
+  out.write((const char*)&header, sizeof(Header));
+  ABORT_IF(!out, "Error while writing binary corpus '{}'", binPath);
+
+  return header.sentences;
+}
+
+CorpusBinary::CorpusBinary(Ptr<Config> options, bool translate /*= false*/)
+    : CorpusBase(options, translate) {
+  loadBinaries();
+}
+
+CorpusBinary::CorpusBinary(std::vector<std::string> paths,
+                           std::vector<Ptr<Vocab>> vocabs,
+                           Ptr<Config> options)
+    : CorpusBase(paths, vocabs, options) {
+  loadBinaries();
+}
+
+void CorpusBinary::loadBinaries() {
+  ABORT_IF(alignFileIdx_ || weightFileIdx_,
+           "Guided alignment and data weighting are not supported with a "
+           "binary corpus");
+
+  // the text streams opened by CorpusBase are only needed for binarization
+  for(size_t i = 0; i < paths_.size(); ++i) {
+    auto binPath = paths_[i] + ".bin";
+    if(!boost::filesystem::exists(binPath)) {
+      LOG(info, "[data] Binarizing {} into {}", paths_[i], binPath);
+      size_t lines = BinaryCorpusFile::create(binPath, *files_[i], vocabs_[i]);
+      LOG(info, "[data] Done, {} lines", lines);
+    }
+
+    LOG(info, "[data] Memory-mapping binary corpus {}", binPath);
+    binaries_.emplace_back(new BinaryCorpusFile(binPath));
+
+    ABORT_IF(binaries_.back()->vocabSize() != vocabs_[i]->size(),
+             "Binary corpus '{}' was created with a vocabulary of size {}, "
+             "but the current vocabulary has {} items",
+             binPath,
+             binaries_.back()->vocabSize(),
+             vocabs_[i]->size());
+    ABORT_IF(binaries_.back()->size() != binaries_.front()->size(),
+             "Binary corpora '{}' and '{}' differ in the number of sentences",
+             paths_.front() + ".bin",
+             binPath);
+  }
+  files_.clear();
+}
+
+SentenceTuple CorpusBinary::next() {
+  size_t total = binaries_.front()->size();
+  while(pos_ < total) {
+    // if corpus has been shuffled, ids_ contains sentence indexes
+    size_t curId = pos_ < ids_.size() ? ids_[pos_] : pos_;
+    pos_++;
+
+    SentenceTuple tup(curId);
+    bool valid = true;
+    for(auto& binary : binaries_) {
+      size_t length = binary->length(curId);
+      if(length == 0 || (length > maxLength_ && !maxLengthCrop_)) {
+        valid = false;
+        break;
+      }
+
+      const WordIndex* sent = binary->sentence(curId);
+      if(length <= maxLength_ && !rightLeft_) {
+        tup.push_back(sent, sent + length);
+        continue;
+      }
+
+      std::vector<WordIndex> words(sent, sent + std::min(length, maxLength_));
+      words.back() = EOS_ID;
+
+      if(rightLeft_)
+        std::reverse(words.begin(), words.end() - 1);
+
+      tup.push_back(words.data(), words.data() + words.size());
+    }
+
+    if(valid)
+      return tup;
+  }
+  return SentenceTuple(0);
+}
+
+void CorpusBinary::shuffle() {
+  LOG(info, "[data] Shuffling binary corpus index");
+  pos_ = 0;
+  ids_.resize(binaries_.front()->size());
+  std::iota(ids_.begin(), ids_.end(), 0);
+  std::shuffle(ids_.begin(), ids_.end(), eng_);
+}
+
+void CorpusBinary::reset() {
+  ids_.clear();
+  pos_ = 0;
+}
+
+void CorpusBinary::restore(Ptr<TrainingState> ts) {
+  setRNGState(ts->seedCorpus);
+}
+}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "common/config.h"
+#include "common/definitions.h"
+#include "common/file_stream.h"
+#include "data/batch.h"
+#include "data/corpus_base.h"
+#include "data/dataset.h"
+#include "data/vocab.h"
+
+namespace marian {
+namespace data {
+
+/**
+ * @brief Read-only, memory-mapped file of word indices for one side of a
+ * training corpus.
+ *
+ * The file consists of a fixed-size header, the flat array of uint32 word
+ * indices of all sentences (each sentence terminated by EOS), and an index of
+ * uint64 offsets into that array with one extra entry at the end, i.e. the
+ * length of sentence i is offsets[i + 1] - offsets[i].
+ */
+class BinaryCorpusFile {
+public:
+  struct Header {
+    char magic[8];
+    uint64_t version;
+    uint64_t vocabSize;
+    uint64_t sentences;
+    uint64_t words;
+  };
+
+  static const char* MAGIC;
+  static const uint64_t VERSION = 1;
+
+  BinaryCorpusFile(const std::string& path);
+
+  /**
+   * @brief Number of sentences in the file.
+   */
+  size_t size() const { return header_->sentences; }
+
+  /**
+   * @brief Vocabulary size the file has been created with.
+   */
+  size_t vocabSize() const { return header_->vocabSize; }
+
+  /**
+   * @brief Number of words, including EOS, in the i-th sentence.
+   */
+  size_t length(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+
+  /**
+   * @brief Pointer to the first word index of the i-th sentence.
+   */
+  const uint32_t* sentence(size_t i) const { return words_ + offsets_[i]; }
+
+  /**
+   * @brief Maps each line of a text stream to word indices with the given
+   * vocabulary and writes them into a binary file at the given path.
+   *
+   * @return Number of sentences written.
+   */
+  static size_t create(const std::string& binPath,
+                       InputFileStream& textStrm,
+                       Ptr<Vocab> vocab);
+
+private:
+  boost::iostreams::mapped_file_source file_;
+
+  const Header* header_;
+  const uint32_t* words_;
+  const uint64_t* offsets_;
+};
+
+/**
+ * @brief Training corpus read from pre-binarized, memory-mapped files.
+ *
+ * For each training set `file` the word indices are read from `file.bin`,
+ * which is created with `marian-binarize` or on the first use. Shuffling
+ * permutes the sentence index only, and sentence tuples are filled directly
+ * from the mapped files without any text processing.
+ */
+class CorpusBinary : public CorpusBase {
+private:
+  std::vector<UPtr<BinaryCorpusFile>> binaries_;
+  std::vector<size_t> ids_;
+
+  void loadBinaries();
+
+public:
+  CorpusBinary(Ptr<Config> options, bool translate = false);
+
+  CorpusBinary(std::vector<std::string> paths,
+               std::vector<Ptr<Vocab>> vocabs,
+               Ptr<Config> options);
+
+  /**
+   * @brief Iterates sentence tuples in the corpus.
+   *
+   * Sentence tuples are skipped or cropped exactly as in
+   * marian::data::CorpusBase::next().
+   */
+  sample next();
+
+  void shuffle();
+
+  void reset();
+
+  void restore(Ptr<TrainingState>);
+
+  size_t getPosition() { return pos_; }
+
+  void setPosition(size_t position) { pos_ = position; }
+
+  iterator begin() { return iterator(this); }
+
+  iterator end() { return iterator(); }
+
+  std::vector<Ptr<Vocab>>& getVocabs() { return vocabs_; }
+};
+}
+}
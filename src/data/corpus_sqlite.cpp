@@ -107,33 +107,32 @@ void CorpusSQLite::fillSQLite() {
   createRandomFunction();
 }
 
-SentenceTuple CorpusSQLite::next() {
-  while(select_->executeStep()) {
-    // fill up the sentence tuple with sentences from all input files
-    size_t curId = select_->getColumn(0).getInt();
-    SentenceTuple tup(curId);
-
-    for(size_t i = 0; i < files_.size(); ++i) {
-      auto line = select_->getColumn(i + 1);
-
-      if(i > 0 && i == alignFileIdx_) {
-        addAlignmentToSentenceTuple(line, tup);
-      } else if(i > 0 && i == weightFileIdx_) {
-        addWeightsToSentenceTuple(line, tup);
-      } else {
-        addWordsToSentenceTuple(line, i, tup);
-      }
-    }
-
-    if(std::all_of(tup.begin(), tup.end(), [=](const Words& words) {
-         return words.size() > 0 && words.size() <= maxLength_;
-       }))
-      return tup;
-  }
-  return SentenceTuple(0);
+bool CorpusSQLite::readLines(size_t& id, std::vector<std::string>& lines) {
+  if(readingShards())
+    return readShardLines(id, lines);
+
+  if(!select_->executeStep())
+    return false;
+
+  id = select_->getColumn(0).getInt();
+  lines.resize(files_.size());
+  for(size_t i = 0; i < files_.size(); ++i)
+    lines[i] = select_->getColumn(i + 1).getString();
+  return true;
 }
 
 void CorpusSQLite::shuffle() {
+  resetParsing();
+  if(shardSize_ > 0) {
+    // shards are ranges of _id, read with the primary index and shuffled in
+    // memory, which avoids sorting the whole table
+    size_t lines = db_->execAndGet("select count(*) from lines;").getInt64();
+    size_t numShards = (lines + shardSize_ - 1) / shardSize_;
+    LOG(info, "[sqlite] Shuffling {} shards", numShards);
+    shuffleShards(numShards);
+    return;
+  }
+
   LOG(info, "[sqlite] Selecting shuffled data");
   select_.reset(new SQLite::Statement(
       *db_,
@@ -142,18 +141,28 @@ void CorpusSQLite::shuffle() {
 }
 
 void CorpusSQLite::reset() {
+  resetParsing();
+  resetShards();
   select_.reset(
       new SQLite::Statement(*db_, "select * from lines order by _id;"));
 }
 
-void CorpusSQLite::restore(Ptr<TrainingState> ts) {
-  for(size_t i = 0; i < ts->epochs - 1; ++i) {
-    shuffle();
-    // Required to execute the select statement from shuffle()
-    select_->executeStep();
-    reset();
+void CorpusSQLite::loadShard(size_t shard, LineBuffer& buffer) {
+  SQLite::Statement select(
+      *db_, "select * from lines where _id >= ? and _id < ? order by _id;");
+  select.bind(1, (long long)(shard * shardSize_));
+  select.bind(2, (long long)((shard + 1) * shardSize_));
+
+  while(select.executeStep()) {
+    std::vector<std::string> lines(files_.size());
+    for(size_t i = 0; i < files_.size(); ++i)
+      lines[i] = select.getColumn(i + 1).getString();
+    buffer.emplace_back(select.getColumn(0).getInt(), std::move(lines));
   }
 }
 
+void CorpusSQLite::restore(Ptr<TrainingState> ts) {
+  setRNGState(ts->seedCorpus);
+}
 }
 }
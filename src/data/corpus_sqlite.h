@@ -20,14 +20,15 @@
 #include <SQLiteCpp/sqlite3/sqlite3.h>
 
 
+// Draws from the random engine of the corpus passed as user data, so the
+// shuffled order can be restored from the saved engine state.
 static void SQLiteRandomSeed(sqlite3_context* context,
                              int argc,
                              sqlite3_value** argv) {
   if(argc == 1 && sqlite3_value_type(argv[0]) == SQLITE_INTEGER) {
-    const int seed = sqlite3_value_int(argv[0]);
-    static std::default_random_engine eng(seed);
+    auto eng = static_cast<std::mt19937*>(sqlite3_user_data(context));
     std::uniform_int_distribution<> unif;
-    const int result = unif(eng);
+    const int result = unif(*eng);
     sqlite3_result_int(context, result);
   } else {
     sqlite3_result_error(context, "Invalid", 0);
@@ -46,6 +47,11 @@ private:
 
   size_t seed_;
 
+protected:
+  bool readLines(size_t& id, std::vector<std::string>& lines);
+
+  void loadShard(size_t shard, LineBuffer& buffer);
+
 public:
   CorpusSQLite(Ptr<Config> options, bool translate = false);
 
@@ -53,8 +59,6 @@ public:
                std::vector<Ptr<Vocab>> vocabs,
                Ptr<Config> options);
 
-  sample next();
-
   void shuffle();
 
   void reset();
@@ -67,59 +71,13 @@ public:
 
   std::vector<Ptr<Vocab>>& getVocabs() { return vocabs_; }
 
-  batch_ptr toBatch(const std::vector<sample>& batchVector) {
-    int batchSize = batchVector.size();
-
-    std::vector<size_t> sentenceIds;
-
-    std::vector<int> maxDims;
-    for(auto& ex : batchVector) {
-      if(maxDims.size() < ex.size())
-        maxDims.resize(ex.size(), 0);
-      for(size_t i = 0; i < ex.size(); ++i) {
-        if(ex[i].size() > (size_t)maxDims[i])
-          maxDims[i] = ex[i].size();
-      }
-      sentenceIds.push_back(ex.getId());
-    }
-
-    std::vector<Ptr<SubBatch>> subBatches;
-    for(auto m : maxDims) {
-      subBatches.emplace_back(New<SubBatch>(batchSize, m));
-    }
-
-    std::vector<size_t> words(maxDims.size(), 0);
-    for(int i = 0; i < batchSize; ++i) {
-      for(int j = 0; j < maxDims.size(); ++j) {
-        for(int k = 0; k < batchVector[i][j].size(); ++k) {
-          subBatches[j]->data()[k * batchSize + i] = batchVector[i][j][k];
-          subBatches[j]->mask()[k * batchSize + i] = 1.f;
-          words[j]++;
-        }
-      }
-    }
-
-    for(size_t j = 0; j < maxDims.size(); ++j)
-      subBatches[j]->setWords(words[j]);
-
-    auto batch = batch_ptr(new batch_type(subBatches));
-    batch->setSentenceIds(sentenceIds);
-
-    if(options_->has("guided-alignment") && alignFileIdx_)
-      addAlignmentsToBatch(batch, batchVector);
-    if(options_->has("data-weighting") && weightFileIdx_)
-      addWeightsToBatch(batch, batchVector);
-
-    return batch;
-  }
-
 private:
   void createRandomFunction() {
     sqlite3_create_function(db_->getHandle(),
                             "random_seed",
                             1,
                             SQLITE_UTF8,
-                            NULL,
+                            &eng_,
                             &SQLiteRandomSeed,
                             NULL,
                             NULL);
@@ -33,6 +33,21 @@ public:
   virtual void reset() {}
   virtual void prepare() {}
   virtual void restore(Ptr<TrainingState>) {}
+
+  /**
+   * @brief Position of the last sample returned by next() within the current
+   * epoch, e.g. the number of lines read from the input files.
+   */
+  virtual size_t getPosition() { return 0; }
+
+  /**
+   * @brief Moves to the given position in the current epoch, so that next()
+   * continues with the sample following it. Must be called after shuffle()
+   * or reset().
+   */
+  virtual void setPosition(size_t) {
+    ABORT("Setting the position is not implemented for this dataset");
+  }
 };
 
 typedef std::vector<float> Data;
@@ -55,44 +55,7 @@ public:
   iterator end() { return iterator(); }
 
   batch_ptr toBatch(const std::vector<sample>& batchVector) {
-    int batchSize = batchVector.size();
-
-    std::vector<size_t> sentenceIds;
-
-    std::vector<int> maxDims;
-    for(auto& ex : batchVector) {
-      if(maxDims.size() < ex.size())
-        maxDims.resize(ex.size(), 0);
-      for(size_t i = 0; i < ex.size(); ++i) {
-        if(ex[i].size() > (size_t)maxDims[i])
-          maxDims[i] = ex[i].size();
-      }
-      sentenceIds.push_back(ex.getId());
-    }
-
-    std::vector<Ptr<SubBatch>> subBatches;
-    for(auto m : maxDims) {
-      subBatches.emplace_back(New<SubBatch>(batchSize, m));
-    }
-
-    std::vector<size_t> words(maxDims.size(), 0);
-    for(int i = 0; i < batchSize; ++i) {
-      for(int j = 0; j < maxDims.size(); ++j) {
-        for(int k = 0; k < batchVector[i][j].size(); ++k) {
-          subBatches[j]->data()[k * batchSize + i] = batchVector[i][j][k];
-          subBatches[j]->mask()[k * batchSize + i] = 1.f;
-          words[j]++;
-        }
-      }
-    }
-
-    for(size_t j = 0; j < maxDims.size(); ++j)
-      subBatches[j]->setWords(words[j]);
-
-    auto batch = batch_ptr(new batch_type(subBatches));
-    batch->setSentenceIds(sentenceIds);
-
-    return batch;
+    return CorpusBatch::fromTuples(batchVector);
   }
 
   void prepare() {}
@@ -11,6 +11,9 @@ namespace marian {
 typedef size_t Word;
 typedef std::vector<Word> Words;
 
+// Compact type for storing word indices of training and input data
+typedef uint32_t WordIndex;
+
 const Word EOS_ID = 0;
 const Word UNK_ID = 1;
 const std::string EOS_STR = "</s>";
@@ -66,6 +66,8 @@ struct Chainable {
   virtual void set_zero_adjoint() {}
   virtual bool trainable() = 0;
   virtual void setTrainable(bool) = 0;
+  // true for nodes whose value is a view of the memory of their children
+  virtual bool isView() { return false; }
 
   virtual void setId(size_t) = 0;
   virtual size_t getId() = 0;
@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
 #include <sstream>
 #include "graph/expression_graph.h"
 
 #include "tensors/tensor_operators.h"
 
+#include "3rd_party/threadpool.h"
+
 namespace marian {
 
 ExpressionGraph::ExpressionGraph(bool inference)
@@ -17,6 +24,241 @@ void ExpressionGraph::setDevice(DeviceId deviceId) {
   }
 }
 
+void ExpressionGraph::setForwardThreads(size_t threads) {
+  if(threads > 1)
+    pool_ = New<ThreadPool>(threads);
+  else
+    pool_ = nullptr;
+}
+
+void ExpressionGraph::forwardConcurrent() {
+  // Nodes on the tape, the number of their children which are still to be
+  // computed and the nodes waiting for each of them. Children which are not
+  // on the tape have been computed by an earlier forward pass.
+  std::vector<Expr> nodes(nodesForward_.begin(), nodesForward_.end());
+  std::unordered_map<Chainable<Tensor>*, size_t> index;
+  for(size_t i = 0; i < nodes.size(); ++i)
+    index[nodes[i].get()] = i;
+
+  std::vector<size_t> waiting(nodes.size(), 0);
+  std::vector<std::vector<size_t>> dependents(nodes.size());
+  std::deque<size_t> ready;
+  for(size_t i = 0; i < nodes.size(); ++i) {
+    for(auto& child : nodes[i]->children()) {
+      auto it = index.find(child.get());
+      if(it != index.end()) {
+        waiting[i]++;
+        dependents[it->second].push_back(i);
+      }
+    }
+    if(!waiting[i])
+      ready.push_back(i);
+  }
+
+  std::mutex mutex;
+  std::condition_variable computed;
+  std::vector<size_t> done;
+  std::vector<std::pair<size_t, std::exception_ptr>> failed;
+  size_t running = 0;
+  size_t remaining = nodes.size();
+
+  // Allocation, initialization and everything that touches the graph happen
+  // on the calling thread, the pool only runs the forward operations.
+  auto complete = [&](size_t i) {
+    auto v = nodes[i];
+    checkNan(v->val());
+
+    if(v->marked_for_debug()) {
+      std::cerr << "Debug: " << v->debug_message() << std::endl;
+      std::cerr << v->val()->debug() << std::endl;
+    }
+
+    for(auto j : dependents[i])
+      if(--waiting[j] == 0)
+        ready.push_back(j);
+
+    // all nodes reading a released node have completed
+    if(checkpointing())
+      releaseSegment(v);
+
+    if(inferenceOnly_)
+      v->children().clear();
+    nodes[i] = nullptr;
+    remaining--;
+  };
+
+  // Completes nodes computed by the pool after at least the given number of
+  // them has finished. Exceptions thrown by the forward operations in the
+  // pool are rethrown here, on the calling thread, for the first failed node
+  // on the tape.
+  auto collect = [&](size_t least) {
+    std::vector<size_t> finished;
+    std::vector<std::pair<size_t, std::exception_ptr>> errors;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      computed.wait(lock,
+                    [&] { return done.size() + failed.size() >= least; });
+      finished.swap(done);
+      errors.swap(failed);
+    }
+    running -= finished.size() + errors.size();
+    if(!errors.empty())
+      std::rethrow_exception(
+          std::min_element(errors.begin(),
+                           errors.end(),
+                           [](const std::pair<size_t, std::exception_ptr>& a,
+                              const std::pair<size_t, std::exception_ptr>& b) {
+                             return a.first < b.first;
+                           })
+              ->second);
+    for(auto i : finished)
+      complete(i);
+  };
+
+  // The pool tasks refer to this frame, so they have to finish before an
+  // exception leaves it.
+  auto drain = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    computed.wait(lock, [&] { return done.size() + failed.size() >= running; });
+  };
+
+  nodesForward_.clear();
+  try {
+    while(remaining > 0) {
+      if(ready.empty()) {
+        collect(1);
+        continue;
+      }
+      collect(0);
+
+      size_t i = ready.front();
+      ready.pop_front();
+      auto v = nodes[i];
+
+      // Memory must not move while other nodes are running, so if the
+      // allocator has to grow, the running nodes are finished first.
+      bool throwRealloc = tensors_->throwsAtReallocation();
+      try {
+        tensors_->throwAtReallocation(true);
+        v->allocate();
+        tensors_->throwAtReallocation(throwRealloc);
+      } catch(AllocationException& e) {
+        tensors_->throwAtReallocation(throwRealloc);
+        collect(running);
+        if(throwRealloc)
+          throw;
+        v->allocate();
+      }
+      v->init();
+
+      // views are rebuilt when their memory has moved, which is not safe while
+      // other nodes read them
+      for(auto& child : v->children())
+        child->val();
+
+      if(ready.empty()) {
+        // nothing else can run, so the node is computed right here
+        v->forward();
+        complete(i);
+      } else {
+        running++;
+        auto node = v.get();
+        pool_->enqueue([&, node, i] {
+          std::exception_ptr error;
+          try {
+            node->forward();
+          } catch(...) {
+            error = std::current_exception();
+          }
+          std::lock_guard<std::mutex> lock(mutex);
+          if(error)
+            failed.emplace_back(i, error);
+          else
+            done.push_back(i);
+          computed.notify_one();
+        });
+      }
+    }
+  } catch(...) {
+    drain();
+    throw;
+  }
+}
+
+Expr ExpressionGraph::checkpoint(Expr node) {
+  if(!checkpointing() || !node->trainable() || checkpointOf_.count(node.get()))
+    return node;
+
+  auto it = std::find(segment_.begin(), segment_.end(), node);
+  if(it != segment_.end())
+    segment_.erase(it);
+
+  checkpointOf_[node.get()] = node.get();
+  for(auto& v : segment_)
+    checkpointOf_[v.get()] = node.get();
+  segments_[node.get()].swap(segment_);
+  segment_.clear();
+
+  return node;
+}
+
+void ExpressionGraph::prepareSegments() {
+  auto checkpointOf = [this](Expr v) -> Chainable<Tensor>* {
+    auto it = checkpointOf_.find(v.get());
+    return it != checkpointOf_.end() ? it->second : nullptr;
+  };
+
+  pending_.clear();
+  kept_.clear();
+  for(auto& v : nodesForward_) {
+    auto owner = checkpointOf(v);
+    if(owner)
+      pending_[owner]++;
+
+    // checkpoints are always kept
+    for(auto& child : v->children()) {
+      auto childOwner = checkpointOf(child);
+      if(childOwner && childOwner != owner && childOwner != child.get())
+        kept_.insert(child.get());
+    }
+  }
+
+  // views are kept together with the memory of their children
+  for(auto it = nodesForward_.rbegin(); it != nodesForward_.rend(); ++it)
+    if((*it)->isView() && kept_.count(it->get()))
+      for(auto& child : (*it)->children())
+        if(checkpointOf(child))
+          kept_.insert(child.get());
+}
+
+void ExpressionGraph::releaseSegment(Expr node) {
+  auto owner = checkpointOf_.find(node.get());
+  if(owner == checkpointOf_.end() || --pending_[owner->second] > 0)
+    return;
+
+  std::vector<Expr> freed;
+  for(auto& v : segments_[owner->second]) {
+    if(!kept_.count(v.get())) {
+      v->free();
+      freed.push_back(v);
+    }
+  }
+  segments_[owner->second].swap(freed);
+}
+
+void ExpressionGraph::recomputeSegment(Expr node) {
+  auto it = segments_.find(node.get());
+  if(it == segments_.end())
+    return;
+
+  for(auto& v : it->second) {
+    v->allocate();
+    v->init();
+    v->forward();
+  }
+  segments_.erase(it);
+}
+
 Expr ExpressionGraph::dropout(float prob, const Shape& shape) {
   return Expression<ConstantNode>(shared_from_this(),
                                   shape,
@@ -6,6 +6,7 @@
 
 #include "common/config.h"
 #include "common/definitions.h"
+#include "common/io.h"
 
 #include "tensors/tensor_allocator.h"
 #include "tensors/backend.h"
@@ -22,6 +23,8 @@ namespace marian {
 template <class T, typename... Args>
 Expr Expression(Args&&... args);
 
+class ThreadPool;
+
 class ExpressionGraph : public std::enable_shared_from_this<ExpressionGraph> {
 private:
   size_t count_{0};
@@ -43,6 +46,40 @@ private:
 
   bool throwNaN_{false};
 
+  Ptr<ThreadPool> pool_;
+
+  // Gradient checkpointing: trainable nodes added since the last checkpoint,
+  // the nodes of the segment ending in each checkpoint, which are reduced to
+  // the freed nodes after the forward pass, the checkpoint of each node in a
+  // segment, the nodes of each segment that are still to be computed and the
+  // nodes that are used outside of their segment
+  bool checkpointing_{false};
+  std::vector<Expr> segment_;
+  std::unordered_map<Chainable<Tensor>*, std::vector<Expr>> segments_;
+  std::unordered_map<Chainable<Tensor>*, Chainable<Tensor>*> checkpointOf_;
+  std::unordered_map<Chainable<Tensor>*, size_t> pending_;
+  std::unordered_set<Chainable<Tensor>*> kept_;
+
+  void forwardConcurrent();
+
+  /**
+   * @brief Counts the nodes of each segment on the tape and finds the nodes
+   * that have to be kept because they are used outside of their segment.
+   */
+  void prepareSegments();
+
+  /**
+   * @brief Frees the nodes of the segment of the computed node once all nodes
+   * of the segment have been computed, apart from nodes that are kept.
+   */
+  void releaseSegment(Expr node);
+
+  /**
+   * @brief Recomputes the freed nodes of the segment ending in the given node
+   * if it is a checkpoint.
+   */
+  void recomputeSegment(Expr node);
+
 protected:
   // Delete, copy and move constructors
   ExpressionGraph(const ExpressionGraph&) = delete;
@@ -57,6 +94,32 @@ public:
 
   void setInference(bool inference) { inferenceOnly_ = inference; }
 
+  /**
+   * @brief Enables gradient checkpointing: during training only the nodes
+   * marked with checkpoint() and the nodes used across them are kept after
+   * the forward pass, the other nodes are recomputed during the backward
+   * pass.
+   */
+  void setCheckpointing(bool checkpointing) { checkpointing_ = checkpointing; }
+
+  bool checkpointing() { return checkpointing_ && !inferenceOnly_; }
+
+  /**
+   * @brief Marks the node as a checkpoint that ends the segment of the
+   * trainable nodes added since the previous checkpoint. Without gradient
+   * checkpointing the node is returned unchanged.
+   */
+  Expr checkpoint(Expr node);
+
+  /**
+   * @brief Runs independent branches of the graph concurrently on a pool of
+   * the given number of threads during the forward pass.
+   *
+   * Only graphs on the CPU are affected. With less than two threads all
+   * nodes are executed in the order they were created.
+   */
+  void setForwardThreads(size_t threads);
+
   ~ExpressionGraph() {
     clear();
     params_->clear();
@@ -121,6 +184,14 @@ public:
     // @TODO: check if allocation works properly
     hashMap_.clear();
 
+    if(checkpointing())
+      prepareSegments();
+
+    if(pool_ && backend_->getDevice().type == DeviceType::cpu) {
+      forwardConcurrent();
+      return;
+    }
+
     while(!nodesForward_.empty()) {
       auto v = nodesForward_.front();
       v->allocate();
@@ -134,6 +205,9 @@ public:
         std::cerr << v->val()->debug() << std::endl;
       }
 
+      if(checkpointing())
+        releaseSegment(v);
+
       if(inferenceOnly_)
         v->children().clear();
       nodesForward_.pop_front();
@@ -158,6 +232,9 @@ public:
       auto v = nodesBackward_.back();
       nodesBackward_.pop_back();
 
+      if(checkpointing())
+        recomputeSegment(v);
+
       for(auto&& child : v->children()) {
         if(child->trainable())
           child->set_zero_adjoint();
@@ -286,6 +363,8 @@ public:
     if(!inferenceOnly_ && node->trainable()) {
       nodesBackward_.push_back(node);
       topNodes_.insert(node);
+      if(checkpointing_ && node->type() != "param")
+        segment_.push_back(node);
     }
 
     return node;
@@ -313,6 +392,13 @@ public:
 
     topNodes_.clear();
     hashMap_.clear();
+
+    segment_.clear();
+    segments_.clear();
+    checkpointOf_.clear();
+    pending_.clear();
+    kept_.clear();
+
     tensors_->clear();
   }
 
@@ -328,36 +414,43 @@ public:
     LOG(info, "Loading model from {}", name);
     setReloaded(false);
 
-    auto numpy = cnpy::npz_load(name);
+    // arrays are read one by one when the parameters are allocated
+    auto npz = New<cnpy::NpzReader>(name);
 
-    for(auto it : numpy) {
-      auto name = it.first;
+    for(auto& name : npz->names()) {
       // skip over special parameters starting with _
       if(name.substr(0, 8) == "special:")
         continue;
 
+      auto& npShape = npz->shape(name);
       Shape shape;
-      if(it.second->shape.size() == 1) {
+      if(npShape.size() == 1) {
         shape.resize(2);
         shape.set(0, 1);
-        shape.set(1, it.second->shape[0]);
+        shape.set(1, npShape[0]);
       } else {
-        shape.resize(it.second->shape.size());
-        for(int i = 0; i < it.second->shape.size(); ++i)
-          shape.set(i, it.second->shape[i]);
+        shape.resize(npShape.size());
+        for(int i = 0; i < npShape.size(); ++i)
+          shape.set(i, npShape[i]);
       }
 
-      param(name, shape, inits::from_numpy(it.second));
+      param(name, shape, inits::from_npz(npz, name));
     }
 
     if(markReloaded)
       setReloaded(true);
   }
 
-  void save(const std::string& name) {
-    LOG(info, "Saving model to {}", name);
-
-    std::string mode = "w";
+  /**
+   * @brief Adds copies of all parameters to the snapshot, named without the
+   * namespace of the graph.
+   */
+  void save(io::Snapshot& snapshot) {
+    // room for the alignment of the first array after a text
+    size_t bytes = snapshot.size() + sizeof(float);
+    for(auto p : params()->getMap())
+      bytes += p.second->shape().elements() * sizeof(float);
+    snapshot.reserve(bytes);
 
     for(auto p : params()->getMap()) {
       std::string pName = p.first;
@@ -367,20 +460,21 @@ public:
           pName = pName.substr(namespace_.size() + 2);
       }
 
-      std::vector<float> v;
-      p.second->val()->get(v);
       auto& pShape = p.second->shape();
+      std::vector<unsigned int> shape;
+      for(int i = 0; i < pShape.size(); ++i)
+        shape.push_back(pShape[i]);
 
-      unsigned dim = pShape.size();
-      unsigned* shape = new unsigned[dim];
-      for(int i = 0; i < dim; ++i)
-        shape[i] = pShape[i];
+      p.second->val()->copyTo(snapshot.add(pName, shape));
+    }
+  }
 
-      cnpy::npz_save(name, pName, v.data(), shape, dim, mode);
+  void save(const std::string& name) {
+    LOG(info, "Saving model to {}", name);
 
-      delete[] shape;
-      mode = "a";
-    }
+    io::Snapshot snapshot;
+    save(snapshot);
+    snapshot.save(name);
   }
 };
 
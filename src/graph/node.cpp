@@ -20,6 +20,9 @@ void Node::free() {
     if(adj_)
       graph()->free(adj_);
   }
+  // freed nodes are allocated again when they are recomputed
+  val_ = nullptr;
+  adj_ = nullptr;
 }
 
 void Node::init_dependent() {
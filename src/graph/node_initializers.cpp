@@ -136,6 +136,24 @@ NodeInitializer from_numpy(const cnpy::NpyArrayPtr& np) {
   };
 }
 
+NodeInitializer from_npz(const cnpy::NpzReaderPtr& npz,
+                         const std::string& name) {
+  return [npz, name](Tensor t) {
+    ABORT_IF(npz->word_size(name) != sizeof(float)
+                 || npz->nbytes(name) != t->size() * sizeof(float),
+             "Array '{}' does not match the parameter of shape {}",
+             name,
+             t->shape());
+
+    if(t->getBackend()->getDevice().type == DeviceType::cpu) {
+      npz->read(name, (char*)t->data());
+    } else {
+      auto np = npz->load(name);
+      t->set((float*)np->data(), (float*)np->data() + t->size());
+    }
+  };
+}
+
 // move this somewhere else
 NodeInitializer from_word2vec(const std::string& file,
                                           int dimVoc,
@@ -69,6 +69,14 @@ NodeInitializer from_sparse_vector(
 
 NodeInitializer from_numpy(const cnpy::NpyArrayPtr& np);
 
+/**
+ * @brief Reads the array from the npz file when the parameter is allocated,
+ * directly into the tensor on the CPU, so that only one array at a time is
+ * held in host memory while a model is loaded.
+ */
+NodeInitializer from_npz(const cnpy::NpzReaderPtr& npz,
+                         const std::string& name);
+
 NodeInitializer from_word2vec(const std::string& file,
                                           int dimVoc,
                                           int dimEmb,
@@ -337,8 +337,15 @@ struct SoftmaxNodeOp : public UnaryNodeOp {
   SoftmaxNodeOp(Expr a)
       : UnaryNodeOp(a), mask_(nullptr) {}
 
+  // The mask is also a child, so that the graph knows it has to be computed
+  // before the softmax.
   SoftmaxNodeOp(Expr a, Expr mask)
-      : UnaryNodeOp(a), mask_(mask) {}
+      : UnaryNodeOp(a), mask_(mask) {
+    if(mask_) {
+      children_.push_back(mask_);
+      graph()->remove_top_node(mask_);
+    }
+  }
 
   Expr mask_;
 
@@ -770,17 +777,23 @@ struct SelectNodeOp : public UnaryNodeOp {
 
 struct TransposeNodeOp : public UnaryNodeOp {
   std::vector<int> axes_;
+  std::vector<int> axesBw_;
 
   TransposeNodeOp(Expr a, const std::vector<int>& axes)
       : UnaryNodeOp(a, newShape(a, axes)),
-        axes_{axes} {}
+        axes_{axes},
+        axesBw_(axes.size()) {
+    // the gradient is transposed back with the inverse permutation
+    for(int i = 0; i < axes_.size(); ++i)
+      axesBw_[axes_[i]] = i;
+  }
 
   NodeOps forwardOps() {
     return {NodeOp(TransposeND(val_, child(0)->val(), axes_))};
   }
 
   NodeOps backwardOps() {
-    return {NodeOp(TransposeND(child(0)->grad(), adj_, axes_))};
+    return {NodeOp(TransposeNDGrad(child(0)->grad(), adj_, axesBw_))};
   }
 
   template <class... Args>
@@ -839,6 +852,8 @@ public:
   size_t allocate() { return 0; }
   void free() {}
 
+  bool isView() { return true; }
+
   void forward() {}
   void backward() {}
 
@@ -846,17 +861,21 @@ public:
 
   void set_zero_adjoint() { reshapee_->set_zero_adjoint(); }
 
+  // Views are only rebuilt if they do not share the memory of the child, so
+  // that nodes running concurrently can read an up-to-date view.
   Tensor& val() {
     auto childVal = reshapee_->val();
-    val_.reset(
-        new TensorBase(childVal->memory(), shape(), childVal->getBackend()));
+    if(!val_ || val_->memory() != childVal->memory())
+      val_.reset(
+          new TensorBase(childVal->memory(), shape(), childVal->getBackend()));
     return val_;
   };
 
   Tensor& grad() {
     auto childGrad = reshapee_->grad();
-    adj_.reset(
-        new TensorBase(childGrad->memory(), shape(), childGrad->getBackend()));
+    if(!adj_ || adj_->memory() != childGrad->memory())
+      adj_.reset(new TensorBase(
+          childGrad->memory(), shape(), childGrad->getBackend()));
     return adj_;
   };
 
@@ -913,6 +932,8 @@ public:
   size_t allocate() { return 0; }
   void free() {}
 
+  bool isView() { return true; }
+
   void forward() {}
   void backward() {}
 
@@ -920,21 +941,27 @@ public:
 
   void set_zero_adjoint() { stepNode_->set_zero_adjoint(); }
 
+  // Views are only rebuilt if the memory of the child has moved, so that
+  // nodes running concurrently can read an up-to-date view.
   Tensor& val() {
     auto childVal = stepNode_->val();
     size_t offset = step_ * shape().elements() * sizeof(float);
-    auto mem = New<MemoryPiece>(childVal->memory()->data() + offset,
-                                childVal->memory()->size());
-    val_.reset(new TensorBase(mem, shape(), childVal->getBackend()));
+    uint8_t* data = childVal->memory()->data() + offset;
+    if(!val_ || val_->memory()->data() != data) {
+      auto mem = New<MemoryPiece>(data, childVal->memory()->size());
+      val_.reset(new TensorBase(mem, shape(), childVal->getBackend()));
+    }
     return val_;
   };
 
   Tensor& grad() {
     auto childGrad = stepNode_->grad();
     size_t offset = step_ * shape().elements() * sizeof(float);
-    auto mem = New<MemoryPiece>(childGrad->memory()->data() + offset,
-                                childGrad->memory()->size());
-    adj_.reset(new TensorBase(mem, shape(), childGrad->getBackend()));
+    uint8_t* data = childGrad->memory()->data() + offset;
+    if(!adj_ || adj_->memory()->data() != data) {
+      auto mem = New<MemoryPiece>(data, childGrad->memory()->size());
+      adj_.reset(new TensorBase(mem, shape(), childGrad->getBackend()));
+    }
     return adj_;
   };
 
@@ -1086,6 +1113,9 @@ class PoolingWithMaskingOp : public UnaryNodeOp {
         width_(width),
         isEven_(isEven)
     {
+      children_.push_back(mask);
+      graph()->remove_top_node(mask);
+
       auto xShape = x->shape();
       int dimBatch = xShape[0];
       int dimWord = xShape[1];
@@ -60,10 +60,11 @@ protected:
 
     int dimBatch = subBatch->batchSize();
 
+    std::vector<float> mask = subBatch->mask();
     std::vector<float> strided;
-    for (size_t wordIdx = 0; wordIdx < subBatch->mask().size(); wordIdx += stride * dimBatch) {
+    for (size_t wordIdx = 0; wordIdx < mask.size(); wordIdx += stride * dimBatch) {
       for (size_t j = wordIdx; j < wordIdx + dimBatch; ++j) {
-        strided.push_back(subBatch->mask()[j]);
+        strided.push_back(mask[j]);
       }
     }
     int dimWords = strided.size() / dimBatch;
@@ -181,7 +181,8 @@ public:
                                  Ptr<DecoderState>,
                                  const std::vector<size_t>&,
                                  const std::vector<size_t>&,
-                                 int dimBatch, int beamSize)
+                                 int dimBatch, int beamSize,
+                                 bool normalize = true)
       = 0;
 
   virtual Ptr<DecoderState> step(Ptr<ExpressionGraph>, Ptr<DecoderState>) = 0;
@@ -202,7 +203,7 @@ protected:
 
   std::vector<std::string> modelFeatures_;
 
-  void saveModelParameters(const std::string& name) {
+  void saveModelParameters(io::Snapshot& snapshot) {
     Config::YamlNode modelParams;
     for(auto& key : modelFeatures_)
       modelParams[key] = options_->getOptions()[key];
@@ -212,7 +213,9 @@ protected:
 
     modelParams["version"] = PROJECT_VERSION_FULL;
 
-    Config::AddYamlToNpz(modelParams, "special:model.yml", name);
+    YAML::Emitter out;
+    OutputYaml(modelParams, out);
+    snapshot.addText("special:model.yml", out.c_str());
   }
 
   virtual void createDecoderConfig(const std::string& name) {
@@ -266,6 +269,7 @@ public:
     modelFeatures_.push_back("transformer-preprocess");
     modelFeatures_.push_back("transformer-postprocess");
     modelFeatures_.push_back("transformer-postprocess-emb");
+    modelFeatures_.push_back("transformer-decoder-autoreg");
   }
 
   std::vector<Ptr<EncoderBase>>& getEncoders() { return encoders_; }
@@ -285,9 +289,14 @@ public:
   virtual void save(Ptr<ExpressionGraph> graph,
                     const std::string& name,
                     bool saveTranslatorConfig = false) {
-    // ignore config for now
-    graph->save(name);
-    saveModelParameters(name);
+    LOG(info, "Saving model to {}", name);
+
+    // the parameters are copied right away, the file is written in the
+    // background
+    auto snapshot = New<io::Snapshot>();
+    saveModelParameters(*snapshot);
+    graph->save(*snapshot);
+    io::saveAsync(name, snapshot);
 
     if(saveTranslatorConfig)
       createDecoderConfig(name);
@@ -319,12 +328,16 @@ public:
                                  Ptr<DecoderState> state,
                                  const std::vector<size_t>& hypIndices,
                                  const std::vector<size_t>& embIndices,
-                                 int dimBatch, int beamSize) {
+                                 int dimBatch, int beamSize,
+                                 bool normalize = true) {
     auto selectedState = hypIndices.empty() ? state : state->select(hypIndices, beamSize);
     selectEmbeddings(graph, selectedState, embIndices, dimBatch, beamSize);
     selectedState->setSingleStep(true);
     auto nextState = step(graph, selectedState);
-    nextState->setProbs(logsoftmax(nextState->getProbs()));
+    // without normalization the raw logits are returned, e.g. for the fused
+    // n-best selection on the CPU
+    if(normalize)
+      nextState->setProbs(logsoftmax(nextState->getProbs()));
     return nextState;
   }
 
@@ -395,55 +408,78 @@ public:
     return build(graph, corpusBatch, clearGraph);
   }
 
+  /**
+   * Predicts the largest batch sizes that fit into the workspace for every
+   * length step from a memory model. The model is fitted to the peak memory of
+   * four small probe batches and saved next to the model, so that training
+   * continued with the same model and workspace does not need the probes.
+   */
   Ptr<data::BatchStats> collectStats(Ptr<ExpressionGraph> graph,
                                      size_t multiplier = 1) {
     auto stats = New<data::BatchStats>();
 
     size_t numFiles = opt<std::vector<std::string>>("train-sets").size();
-
-    size_t first = opt<size_t>("mini-batch-fit-step");
     size_t step = opt<size_t>("mini-batch-fit-step");
 
     size_t maxLength = opt<size_t>("max-length");
     maxLength = std::ceil(maxLength / (float)step) * step;
 
-    size_t maxBatch = 512;
-    bool fits = true;
-    while(fits) {
-      std::vector<size_t> lengths(numFiles, first);
-      auto batch = data::CorpusBatch::fakeBatch(lengths, maxBatch, options_);
-      build(graph, batch);
-      fits = graph->fits();
-      if(fits)
-        maxBatch *= 2;
+    // build a first batch to create the parameters
+    std::vector<size_t> lengths(numFiles, step);
+    build(graph, data::CorpusBatch::fakeBatch(lengths, 1, options_));
+    size_t parameters = 0;
+    for(auto p : *graph->params())
+      parameters += p->shape().elements();
+    size_t workspace = graph->allocator()->size();
+
+    auto memory = New<data::BatchMemoryModel>(
+        parameters, workspace, graph->checkpointing());
+    std::string name = opt<std::string>("model") + ".batch.yml";
+    if(memory->load(name)) {
+      LOG(info, "[batching] Loaded memory model from {}", name);
+    } else {
+      // probe lengths in the middle of the range, halving the batch sizes
+      // until the probes fit
+      size_t length2 = std::max((size_t)2, maxLength / 2);
+      size_t length1 = length2 / 2;
+      size_t batchSize = 16;
+
+      std::vector<data::BatchMemoryModel::Probe> probes;
+      while(probes.size() < 4) {
+        size_t length = probes.size() < 2 ? length1 : length2;
+        size_t size = probes.size() % 2 == 0 ? batchSize : 2 * batchSize;
+
+        std::vector<size_t> lengths(numFiles, length);
+        build(graph, data::CorpusBatch::fakeBatch(lengths, size, options_));
+        if(graph->fits()) {
+          probes.push_back({length, size, graph->allocator()->peak()});
+        } else {
+          ABORT_IF(batchSize == 1,
+                   "Batches of two sentences of length {} do not fit into "
+                   "the workspace",
+                   length);
+          batchSize /= 2;
+          probes.clear();
+        }
+      }
+
+      memory->fit(probes);
+      memory->save(name);
+      LOG(info,
+          "[batching] Fitted memory model to probes of length {} and {}, "
+          "saved to {}",
+          length1,
+          length2,
+          name);
     }
 
+    // leave some room for fragmentation and errors of the model
     for(size_t i = step; i <= maxLength; i += step) {
-      size_t start = 1;
-      size_t end = maxBatch;
-
       std::vector<size_t> lengths(numFiles, i);
-      bool fits = true;
-
-      do {
-        size_t current = (start + end) / 2;
-        //std::cerr << i << " " << current << std::endl;
-        auto batch = data::CorpusBatch::fakeBatch(lengths, current, options_);
-        build(graph, batch);
-        fits = graph->fits();
-
-        if(fits) {
-          stats->add(batch, multiplier);
-          start = current + 1;
-        }
-        else {
-          end = current - 1;
-        }
-      } while(end - start > step);
-      //} while(start <= end);
-
-      maxBatch = start;
+      stats->add(lengths, memory->maxBatchSize(i, 0.9f) * multiplier);
     }
+    stats->setMemoryModel(memory);
+
     return stats;
   }
 
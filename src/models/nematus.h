@@ -29,34 +29,33 @@ public:
     using namespace keywords;
 
     LOG(info, "Loading model from {}", name);
-    auto numpy = cnpy::npz_load(name);
+    auto npz = New<cnpy::NpzReader>(name);
 
     graph->setReloaded(false);
 
-    for(auto it : numpy) {
-      auto name = it.first;
-
+    for(auto& name : npz->names()) {
       if(name == "decoder_c_tt")
         continue;
       if(name.substr(0, 8) == "special:")
         continue;
 
+      auto& npShape = npz->shape(name);
       Shape shape;
-      if(numpy[name]->shape.size() == 2) {
+      if(npShape.size() == 2) {
         shape.resize(2);
-        shape.set(0, numpy[name]->shape[0]);
-        shape.set(1, numpy[name]->shape[1]);
-      } else if(numpy[name]->shape.size() == 1) {
+        shape.set(0, npShape[0]);
+        shape.set(1, npShape[1]);
+      } else if(npShape.size() == 1) {
         shape.resize(2);
         shape.set(0, 1);
-        shape.set(1, numpy[name]->shape[0]);
+        shape.set(1, npShape[0]);
       }
 
       std::string pName = name;
       if(nameMap_.count(name))
         pName = nameMap_[name];
 
-      graph->param(pName, shape, inits::from_numpy(numpy[name]));
+      graph->param(pName, shape, inits::from_npz(npz, name));
     }
 
     graph->setReloaded(true);
@@ -67,40 +66,38 @@ public:
             bool saveTranslatorConfig = false) {
     LOG(info, "Saving model to {}", name);
 
-    unsigned shape[2];
-    std::string mode = "w";
+    auto snapshot = New<io::Snapshot>();
+
+    float* ctt = snapshot->add("decoder_c_tt", {1});
+    *ctt = 0;
+
+    saveModelParameters(*snapshot);
+
+    size_t bytes = snapshot->size() + sizeof(float);
+    for(auto p : graph->params()->getMap())
+      bytes += p.second->shape().elements() * sizeof(float);
+    snapshot->reserve(bytes);
 
     if(nameMapRev_.empty())
       for(auto& kv : nameMap_)
         nameMapRev_.insert({kv.second, kv.first});
 
     for(auto p : graph->params()->getMap()) {
-      std::vector<float> v;
-      p.second->val()->get(v);
-
-      unsigned dim;
-      if(p.second->shape()[0] == 1) {
-        shape[0] = p.second->shape()[1];
-        dim = 1;
-      } else {
-        shape[0] = p.second->shape()[0];
-        shape[1] = p.second->shape()[1];
-        dim = 2;
-      }
+      std::vector<unsigned int> shape;
+      if(p.second->shape()[0] == 1)
+        shape = {(unsigned int)p.second->shape()[1]};
+      else
+        shape = {(unsigned int)p.second->shape()[0],
+                 (unsigned int)p.second->shape()[1]};
 
       std::string pName = p.first;
       if(nameMapRev_.count(pName))
         pName = nameMapRev_[pName];
 
-      cnpy::npz_save(name, pName, v.data(), shape, dim, mode);
-      mode = "a";
+      p.second->val()->copyTo(snapshot->add(pName, shape));
     }
 
-    float ctt = 0;
-    shape[0] = 1;
-    cnpy::npz_save(name, "decoder_c_tt", &ctt, shape, 1, mode);
-
-    saveModelParameters(name);
+    io::saveAsync(name, snapshot);
 
     if(saveTranslatorConfig) {
       createAmunConfig(name);
@@ -0,0 +1,272 @@
+#include "models/pruning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "common/config.h"
+#include "common/logging.h"
+
+namespace marian {
+
+namespace {
+
+typedef cnpy::NpyArrayPtr Array;
+
+bool endsWith(const std::string& name, const std::string& suffix) {
+  return name.size() >= suffix.size()
+         && name.compare(name.size() - suffix.size(), suffix.size(), suffix)
+                == 0;
+}
+
+// Vectors such as biases are stored either as [n] or as [1, n]
+size_t rows(Array a) {
+  return a->shape.size() > 1 ? a->shape[a->shape.size() - 2] : 1;
+}
+
+size_t cols(Array a) {
+  return a->shape.back();
+}
+
+const float* floats(Array a) {
+  ABORT_IF(a->word_size != sizeof(float) || a->shape.size() > 2,
+           "Only matrices of floats can be pruned");
+  return (const float*)a->data();
+}
+
+// Squared L2 norms of all columns
+std::vector<float> columnNorms(Array a) {
+  const float* data = floats(a);
+  std::vector<float> norms(cols(a), 0.f);
+  for(size_t i = 0; i < rows(a); ++i)
+    for(size_t j = 0; j < cols(a); ++j)
+      norms[j] += data[i * cols(a) + j] * data[i * cols(a) + j];
+  return norms;
+}
+
+// Squared L2 norms of all rows
+std::vector<float> rowNorms(Array a) {
+  const float* data = floats(a);
+  std::vector<float> norms(rows(a), 0.f);
+  for(size_t i = 0; i < rows(a); ++i)
+    for(size_t j = 0; j < cols(a); ++j)
+      norms[i] += data[i * cols(a) + j] * data[i * cols(a) + j];
+  return norms;
+}
+
+// Indices of all but the remove least important structures, in order
+std::vector<size_t> keepLargest(const std::vector<float>& importance,
+                                size_t remove) {
+  std::vector<size_t> order(importance.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return importance[a] < importance[b];
+  });
+  std::vector<size_t> keep(order.begin() + remove, order.end());
+  std::sort(keep.begin(), keep.end());
+  return keep;
+}
+
+Array keepColumns(Array a, const std::vector<size_t>& keep) {
+  const float* data = floats(a);
+  auto pruned = std::make_shared<cnpy::NpyArray>(*a);
+  pruned->shape.back() = keep.size();
+  pruned->resize(rows(a) * keep.size() * sizeof(float));
+
+  float* out = (float*)pruned->data();
+  for(size_t i = 0; i < rows(a); ++i)
+    for(size_t j = 0; j < keep.size(); ++j)
+      out[i * keep.size() + j] = data[i * cols(a) + keep[j]];
+  return pruned;
+}
+
+Array keepRows(Array a, const std::vector<size_t>& keep) {
+  const float* data = floats(a);
+  auto pruned = std::make_shared<cnpy::NpyArray>(*a);
+  pruned->shape[pruned->shape.size() - 2] = keep.size();
+  pruned->resize(keep.size() * cols(a) * sizeof(float));
+
+  float* out = (float*)pruned->data();
+  for(size_t i = 0; i < keep.size(); ++i)
+    std::copy(data + keep[i] * cols(a),
+              data + (keep[i] + 1) * cols(a),
+              out + i * cols(a));
+  return pruned;
+}
+}
+
+ModelPruner::ModelPruner(const std::string& modelPath) {
+  LOG(info, "Loading model from {}", modelPath);
+  params_ = cnpy::npz_load(modelPath);
+
+  if(has("special:model.yml")) {
+    auto config = YAML::Load(params_["special:model.yml"]->data());
+    if(config["transformer-heads"])
+      heads_ = config["transformer-heads"].as<int>();
+  }
+}
+
+size_t ModelPruner::pruneFfn(float fraction) {
+  size_t removed = 0;
+  for(auto& it : params_) {
+    if(!endsWith(it.first, "_ffn_W1"))
+      continue;
+
+    std::string prefix = it.first.substr(0, it.first.size() - 3);
+    if(!has(prefix + "_b1") || !has(prefix + "_W2"))
+      continue;
+
+    auto& W1 = params_[prefix + "_W1"];
+    auto& b1 = params_[prefix + "_b1"];
+    auto& W2 = params_[prefix + "_W2"];
+
+    auto in = columnNorms(W1);
+    auto out = rowNorms(W2);
+    std::vector<float> importance(in.size());
+    for(size_t j = 0; j < in.size(); ++j)
+      importance[j] = std::sqrt(in[j] * out[j]);
+
+    size_t units = in.size();
+    size_t remove = std::min((size_t)(fraction * units), units - 1);
+    auto keep = keepLargest(importance, remove);
+
+    W1 = keepColumns(W1, keep);
+    b1 = keepColumns(b1, keep);
+    W2 = keepRows(W2, keep);
+
+    LOG(info, "Removed {} of {} hidden units from {}", remove, units, prefix);
+    removed += remove;
+  }
+  return removed;
+}
+
+size_t ModelPruner::pruneHeads(size_t heads) {
+  size_t removed = 0;
+  for(auto& it : params_) {
+    if(!endsWith(it.first, "_Wq"))
+      continue;
+
+    std::string prefix = it.first.substr(0, it.first.size() - 3);
+    if(!has(prefix + "_Wo"))
+      continue;
+
+    ABORT_IF(!heads_,
+             "The number of attention heads is missing in the model "
+             "configuration");
+
+    auto& Wq = params_[prefix + "_Wq"];
+    auto& Wo = params_[prefix + "_Wo"];
+
+    size_t dimHead = rows(Wq) / heads_;
+    size_t layerHeads = cols(Wq) / dimHead;
+
+    // Projections of keys and values per encoder. The rows of Wo consist of
+    // one block per encoder.
+    std::vector<std::string> projections = {prefix};
+    for(int i = 2; has(prefix + "_enc" + std::to_string(i) + "_Wk"); ++i)
+      projections.push_back(prefix + "_enc" + std::to_string(i));
+
+    auto outNorms = rowNorms(Wo);
+    std::vector<float> importance(layerHeads, 0.f);
+    for(size_t e = 0; e < projections.size(); ++e) {
+      auto valueNorms = columnNorms(params_[projections[e] + "_Wv"]);
+      for(size_t h = 0; h < layerHeads; ++h) {
+        float in = 0.f, out = 0.f;
+        for(size_t d = h * dimHead; d < (h + 1) * dimHead; ++d) {
+          in += valueNorms[d];
+          out += outNorms[e * layerHeads * dimHead + d];
+        }
+        importance[h] += std::sqrt(in * out);
+      }
+    }
+
+    size_t remove = std::min(heads, layerHeads - 1);
+    auto keep = keepLargest(importance, remove);
+
+    std::vector<size_t> keepCols, keepRowsWo;
+    for(auto h : keep)
+      for(size_t d = h * dimHead; d < (h + 1) * dimHead; ++d)
+        keepCols.push_back(d);
+    for(size_t e = 0; e < projections.size(); ++e)
+      for(auto d : keepCols)
+        keepRowsWo.push_back(e * layerHeads * dimHead + d);
+
+    Wq = keepColumns(Wq, keepCols);
+    params_[prefix + "_bq"] = keepColumns(params_[prefix + "_bq"], keepCols);
+    for(auto& proj : projections)
+      for(auto suffix : {"_Wk", "_bk", "_Wv", "_bv"})
+        params_[proj + suffix] = keepColumns(params_[proj + suffix], keepCols);
+    Wo = keepRows(Wo, keepRowsWo);
+
+    LOG(info, "Removed {} of {} heads from {}", remove, layerHeads, prefix);
+    removed += remove;
+  }
+  return removed;
+}
+
+size_t ModelPruner::pruneDeepOutput(float fraction) {
+  size_t removed = 0;
+  for(auto& it : params_) {
+    if(!endsWith(it.first, "_ff_logit_l1_b0"))
+      continue;
+
+    std::string prefix = it.first.substr(0, it.first.size() - 3);
+    std::string nameOut = prefix.substr(0, prefix.size() - 3) + "_l2_W";
+    if(!has(nameOut)) {
+      LOG(warn, "Skipping {}, the output layer is tied to the embeddings", prefix);
+      continue;
+    }
+    if(has(prefix + "_ln_s0") || has(prefix + "_gamma0")) {
+      LOG(warn, "Skipping {}, the layer is normalized", prefix);
+      continue;
+    }
+
+    auto& out = params_[nameOut];
+    auto outNorms = rowNorms(out);
+    std::vector<float> inNorms(outNorms.size(), 0.f);
+    for(int i = 0; has(prefix + "_W" + std::to_string(i)); ++i) {
+      auto norms = columnNorms(params_[prefix + "_W" + std::to_string(i)]);
+      for(size_t j = 0; j < norms.size(); ++j)
+        inNorms[j] += norms[j];
+    }
+
+    std::vector<float> importance(outNorms.size());
+    for(size_t j = 0; j < importance.size(); ++j)
+      importance[j] = std::sqrt(inNorms[j] * outNorms[j]);
+
+    size_t units = importance.size();
+    size_t remove = std::min((size_t)(fraction * units), units - 1);
+    auto keep = keepLargest(importance, remove);
+
+    for(int i = 0; has(prefix + "_W" + std::to_string(i)); ++i) {
+      auto nameW = prefix + "_W" + std::to_string(i);
+      auto nameB = prefix + "_b" + std::to_string(i);
+      params_[nameW] = keepColumns(params_[nameW], keep);
+      params_[nameB] = keepColumns(params_[nameB], keep);
+    }
+    out = keepRows(out, keep);
+
+    LOG(info, "Removed {} of {} hidden units from {}", remove, units, prefix);
+    removed += remove;
+  }
+  return removed;
+}
+
+void ModelPruner::save(const std::string& modelPath) {
+  LOG(info, "Saving model to {}", modelPath);
+
+  std::vector<cnpy::NpzItem> items;
+  for(auto& it : params_) {
+    auto& a = it.second;
+    if(a->word_size == sizeof(float))
+      items.push_back({it.first, a->shape, 'f', sizeof(float), a->data()});
+    else if(a->word_size == sizeof(char))
+      items.push_back({it.first, a->shape, 'i', sizeof(char), a->data()});
+    else
+      ABORT("Parameter '{}' has an unsupported word size {}",
+            it.first,
+            a->word_size);
+  }
+  cnpy::npz_save(modelPath, items);
+}
+}
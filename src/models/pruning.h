@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "3rd_party/cnpy/cnpy.h"
+
+namespace marian {
+
+/**
+ * @brief Structured magnitude pruning of the parameters in a model file.
+ *
+ * Whole structures are removed from the weight matrices, which shrinks the
+ * parameter shapes. The models read their layer sizes from the shapes of
+ * loaded parameters, so a pruned model can be used for translation and
+ * fine-tuned like any other model. A structure is ranked by the product of
+ * the L2 norms of its input and output weights, and the lowest-ranked
+ * structures are removed:
+ *
+ * - hidden units of the transformer feed-forward layers (columns of W1 and
+ *   b1, rows of W2),
+ * - attention heads of the transformer (columns of Wq, Wk, Wv and their
+ *   biases, rows of Wo),
+ * - hidden units of the deep output layer of RNN models (columns of the
+ *   ff_logit_l1 weights and biases, rows of ff_logit_l2_W). This needs
+ *   untied output embeddings and no layer normalization in that layer.
+ */
+class ModelPruner {
+private:
+  cnpy::npz_t params_;
+  int heads_{0};
+
+  bool has(const std::string& name) const { return params_.count(name) > 0; }
+
+public:
+  ModelPruner(const std::string& modelPath);
+
+  /**
+   * @brief Removes the given fraction of hidden units from each feed-forward
+   * layer and returns the number of removed units.
+   */
+  size_t pruneFfn(float fraction);
+
+  /**
+   * @brief Removes up to the given number of heads from each attention layer,
+   * keeping at least one, and returns the number of removed heads.
+   */
+  size_t pruneHeads(size_t heads);
+
+  /**
+   * @brief Removes the given fraction of hidden units from the deep output
+   * layer and returns the number of removed units.
+   */
+  size_t pruneDeepOutput(float fraction);
+
+  void save(const std::string& modelPath);
+};
+}
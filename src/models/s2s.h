@@ -323,10 +323,15 @@ public:
     else if(alignedContexts.size() == 1)
       alignedContext = alignedContexts[0];
 
+    // hidden units of a pruned model may have been removed, see marian-prune
+    int dimLogit = opt<int>("dim-emb");
+    if(auto b = graph->get(prefix_ + "_ff_logit_l1_b0"))
+      dimLogit = b->shape()[-1];
+
     // construct deep output multi-layer network layer-wise
     auto layer1 = mlp::dense(graph)                                //
         ("prefix", prefix_ + "_ff_logit_l1")                       //
-        ("dim", opt<int>("dim-emb"))                               //
+        ("dim", dimLogit)                                          //
         ("activation", (int)mlp::act::tanh)                        //
         ("layer-normalization", opt<bool>("layer-normalization"))  //
         ("nematus-normalization",
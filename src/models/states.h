@@ -21,7 +21,7 @@ public:
   virtual Expr getAttended() { return context_; }
   virtual Expr getMask() { return mask_; }
 
-  virtual const std::vector<size_t>& getSourceWords() {
+  virtual Words getSourceWords() {
     return batch_->front()->data();
   }
 };
@@ -70,7 +70,7 @@ public:
     singleStep_ = singleStep;
   }
 
-  virtual const std::vector<size_t>& getSourceWords() {
+  virtual Words getSourceWords() {
     return getEncoderStates()[0]->getSourceWords();
   }
 
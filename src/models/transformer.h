@@ -6,6 +6,7 @@
 #include "model_base.h"
 #include "model_factory.h"
 #include "encdec.h"
+#include "rnn/constructors.h"
 
 namespace marian {
 
@@ -210,9 +211,15 @@ public:
 
     int dimModel = q->shape()[-1];
 
+    // heads of a pruned model may have been removed, see marian-prune
+    int dimHead = dimModel / dimHeads;
+    if(auto Wq = graph->get(prefix + "_Wq"))
+      dimHeads = Wq->shape()[-1] / dimHead;
+    int dimAttModel = dimHeads * dimHead;
+
     auto Wq = graph->param(
-        prefix + "_Wq", {dimModel, dimModel}, inits::glorot_uniform);
-    auto bq = graph->param(prefix + "_bq", {1, dimModel}, inits::zeros);
+        prefix + "_Wq", {dimModel, dimAttModel}, inits::glorot_uniform);
+    auto bq = graph->param(prefix + "_bq", {1, dimAttModel}, inits::zeros);
     auto qh = affine(q, Wq, bq);
     qh = SplitHeads(qh, dimHeads);
 
@@ -223,16 +230,16 @@ public:
         prefixProj += "_enc" + std::to_string(i + 1);
 
       auto Wk = graph->param(prefixProj + "_Wk",
-                             {dimModel, dimModel},
+                             {dimModel, dimAttModel},
                              inits::glorot_uniform);
       auto bk = graph->param(
-          prefixProj + "_bk", {1, dimModel}, inits::zeros);
+          prefixProj + "_bk", {1, dimAttModel}, inits::zeros);
 
       auto Wv = graph->param(prefixProj + "_Wv",
-                             {dimModel, dimModel},
+                             {dimModel, dimAttModel},
                              inits::glorot_uniform);
       auto bv = graph->param(
-          prefixProj + "_bv", {1, dimModel}, inits::zeros);
+          prefixProj + "_bv", {1, dimAttModel}, inits::zeros);
 
       auto kh = affine(keys[i], Wk, bk);
       auto vh = affine(values[i], Wv, bv);
@@ -317,7 +324,8 @@ public:
     output
         = PostProcess(graph, prefix + "_Wo", opsPost, output, input, dropProb);
 
-    return output;
+    // with gradient checkpointing the block is recomputed from its input
+    return graph->checkpoint(output);
   }
 
   Expr LayerFFN(Ptr<ExpressionGraph> graph,
@@ -333,7 +341,10 @@ public:
     auto opsPre = options->get<std::string>("transformer-preprocess");
     auto output = PreProcess(graph, prefix + "_ffn", opsPre, input, dropProb);
 
+    // hidden units of a pruned model may have been removed, see marian-prune
     int dimFfn = options->get<int>("transformer-dim-ffn");
+    if(auto W1 = graph->get(prefix + "_W1"))
+      dimFfn = W1->shape()[-1];
 
     auto W1 = graph->param(
         prefix + "_W1", {dimModel, dimFfn}, inits::glorot_uniform);
@@ -351,7 +362,8 @@ public:
     output
         = PostProcess(graph, prefix + "_ffn", opsPost, output, input, dropProb);
 
-    return output;
+    // with gradient checkpointing the block is recomputed from its input
+    return graph->checkpoint(output);
   }
 };
 
@@ -457,35 +469,109 @@ public:
 };
 
 class TransformerState : public DecoderState {
+private:
+  // number of target positions decoded so far
+  int position_;
+
 public:
   TransformerState(const rnn::States &states,
                    Expr probs,
-                   std::vector<Ptr<EncoderState>> &encStates)
-      : DecoderState(states, probs, encStates) {}
+                   std::vector<Ptr<EncoderState>> &encStates,
+                   int position = 0)
+      : DecoderState(states, probs, encStates), position_(position) {}
+
+  int getPosition() { return position_; }
 
   virtual Ptr<DecoderState> select(const std::vector<size_t> &selIdx, int beamSize) {
     rnn::States selectedStates;
 
-    int dimDepth = states_[0].output->shape()[-1];
-    int dimTime  = states_[0].output->shape()[-2];
-    int dimBatch = selIdx.size() / beamSize;
+    for(auto state : states_) {
+      // recurrent layers keep a single state per hypothesis
+      if(state.cell) {
+        selectedStates.push_back(state.select(selIdx, beamSize));
+        continue;
+      }
 
-    std::vector<size_t> selIdx2;
-    for(auto i : selIdx)
-      for(int j = 0; j < dimTime; ++j)
-        selIdx2.push_back(i * dimTime + j);
+      // self-attention layers keep the inputs of all previous positions
+      int dimDepth = state.output->shape()[-1];
+      int dimTime  = state.output->shape()[-2];
+      int dimBatch = selIdx.size() / beamSize;
+
+      std::vector<size_t> selIdx2;
+      for(auto i : selIdx)
+        for(int j = 0; j < dimTime; ++j)
+          selIdx2.push_back(i * dimTime + j);
 
-    for(auto state : states_) {
       auto sel = rows(flatten_2d(state.output), selIdx2);
       sel = reshape(sel, {beamSize, dimBatch, dimTime, dimDepth});
       selectedStates.push_back({sel, nullptr});
     }
 
-    return New<TransformerState>(selectedStates, probs_, encStates_);
+    return New<TransformerState>(
+        selectedStates, probs_, encStates_, position_);
   }
 };
 
 class DecoderTransformer : public DecoderBase, public Transformer {
+private:
+  /**
+   * @brief Recurrent replacement of the decoder self-attention, selected with
+   * --transformer-decoder-autoreg. The layer keeps a single state per
+   * hypothesis instead of the inputs of all previous positions, so a decoding
+   * step costs the same at every position.
+   */
+  Expr LayerRNN(Ptr<ExpressionGraph> graph,
+                Ptr<Options> options,
+                std::string prefix,
+                Expr input,
+                rnn::State &state,
+                bool inference = false) {
+    int dimModel = input->shape()[-1];
+
+    float dropProb = inference ? 0 : options->get<float>("transformer-dropout");
+    auto opsPre = options->get<std::string>("transformer-preprocess");
+    auto output = PreProcess(graph, prefix, opsPre, input, dropProb);
+
+    auto rnn = rnn::rnn(graph)                                           //
+        ("type", options->get<std::string>("transformer-decoder-autoreg"))  //
+        ("prefix", prefix)                                               //
+        ("dimInput", dimModel)                                           //
+        ("dimState", dimModel);
+    rnn.push_back(rnn::cell(graph));
+    auto seq = rnn.construct();
+
+    // the RNN runs over time-major input, the hypotheses of a beam are
+    // treated as separate sentences of the batch
+    int dimBeam = input->shape()[-4];
+    int dimBatch = input->shape()[-3];
+    int dimTime = input->shape()[-2];
+    Shape flatShape = {1, dimBeam * dimBatch, dimModel};
+    Shape stateShape = {dimBeam, 1, dimBatch, dimModel};
+
+    output = reshape(transpose(output, {2, 0, 1, 3}),
+                     {dimTime, dimBeam * dimBatch, dimModel});
+    if(state.output)
+      output = seq->transduce(output,
+                              rnn::State{reshape(state.output, flatShape),
+                                         reshape(state.cell, flatShape)});
+    else
+      output = seq->transduce(output);
+    output = transpose(reshape(output, {dimTime, dimBeam, dimBatch, dimModel}),
+                       {1, 2, 0, 3});
+
+    // the last state is only needed to continue decoding step by step
+    if(inference) {
+      auto last = seq->lastCellStates().back();
+      state = {reshape(last.output, stateShape),
+               reshape(last.cell, stateShape)};
+    }
+
+    auto opsPost = options->get<std::string>("transformer-postprocess");
+    output = PostProcess(graph, prefix, opsPost, output, input, dropProb);
+
+    return output;
+  }
+
 public:
   DecoderTransformer(Ptr<Options> options) : DecoderBase(options) {}
 
@@ -522,10 +608,9 @@ public:
     // according to paper embeddings are scaled by \sqrt(d_m)
     auto scaledEmbeddings = std::sqrt(dimEmb) * embeddings;
 
-    int startPos = 0;
+    int startPos = std::dynamic_pointer_cast<TransformerState>(state)
+                       ->getPosition();
     auto prevDecoderStates = state->getStates();
-    if(prevDecoderStates.size() > 0)
-      startPos = prevDecoderStates[0].output->shape()[-2];
 
     scaledEmbeddings
         = AddPositionalEmbeddings(graph, scaledEmbeddings, startPos);
@@ -543,17 +628,23 @@ public:
     rnn::States decoderStates;
     int dimTrgWords = query->shape()[-2];
     int dimBatch = query->shape()[-3];
-    auto selfMask = TriangleMask(graph, dimTrgWords);
-    if(decoderMask) {
-      decoderMask = atleast_nd(decoderMask, 4);
-      decoderMask = reshape(TransposeTimeBatch(decoderMask),
-                            {1, dimBatch, 1, dimTrgWords});
-      selfMask = selfMask * decoderMask;
-      //if(dimBeam > 1)
-      //  selfMask = repeat(selfMask, dimBeam, axis = -4);
-    }
 
-    selfMask = InverseMask(selfMask);
+    // recurrent layers only look at previous positions, no mask is needed
+    auto autoreg = opt<std::string>("transformer-decoder-autoreg");
+    Expr selfMask;
+    if(autoreg == "self-attention") {
+      selfMask = TriangleMask(graph, dimTrgWords);
+      if(decoderMask) {
+        decoderMask = atleast_nd(decoderMask, 4);
+        decoderMask = reshape(TransposeTimeBatch(decoderMask),
+                              {1, dimBatch, 1, dimTrgWords});
+        selfMask = selfMask * decoderMask;
+        //if(dimBeam > 1)
+        //  selfMask = repeat(selfMask, dimBeam, axis = -4);
+      }
+
+      selfMask = InverseMask(selfMask);
+    }
 
     std::vector<Expr> encoderContexts;
     std::vector<Expr> encoderMasks;
@@ -580,21 +671,37 @@ public:
 
     // apply layers
     for(int i = 1; i <= opt<int>("dec-depth"); ++i) {
-      auto values = query;
-      if(prevDecoderStates.size() > 0)
-        values = concatenate({prevDecoderStates[i - 1].output, query}, axis = -2);
+      if(autoreg == "self-attention") {
+        auto values = query;
+        if(prevDecoderStates.size() > 0)
+          values = concatenate({prevDecoderStates[i - 1].output, query},
+                               axis = -2);
 
-      decoderStates.push_back({values, nullptr});
+        decoderStates.push_back({values, nullptr});
 
-      // TODO: do not recompute matrix multiplies
-      query = LayerAttention(graph,
-                             options_,
-                             prefix_ + "_l" + std::to_string(i) + "_self",
-                             query,
-                             values,
-                             values,
-                             selfMask,
-                             inference_);
+        // TODO: do not recompute matrix multiplies
+        query = LayerAttention(graph,
+                               options_,
+                               prefix_ + "_l" + std::to_string(i) + "_self",
+                               query,
+                               values,
+                               values,
+                               selfMask,
+                               inference_);
+      } else {
+        rnn::State layerState;
+        if(prevDecoderStates.size() > 0)
+          layerState = prevDecoderStates[i - 1];
+
+        query = LayerRNN(graph,
+                         options_,
+                         prefix_ + "_l" + std::to_string(i) + "_rnn",
+                         query,
+                         layerState,
+                         inference_);
+
+        decoderStates.push_back(layerState);
+      }
 
       if(encoderContexts.size() > 0) {
         // auto comb = opt<std::string>("transformer-multi-encoder");
@@ -662,8 +769,10 @@ public:
     Expr logits = output->apply(decoderContext);
 
     // return unormalized(!) probabilities
-    return New<TransformerState>(
-        decoderStates, logits, state->getEncoderStates());
+    return New<TransformerState>(decoderStates,
+                                 logits,
+                                 state->getEncoderStates(),
+                                 startPos + dimTrgWords);
   }
 
   // helper function for guided alignment
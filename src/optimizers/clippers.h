@@ -16,6 +16,17 @@ namespace marian {
 class ClipperBase {
 public:
   virtual void clip(Tensor) = 0;
+
+  /**
+   * @brief Returns the factor the gradient has to be scaled with to be
+   * clipped, so that the scaling can be fused into the optimizer step.
+   * Clippers that cannot be expressed as a factor clip the tensor in place
+   * and return 1.
+   */
+  virtual float clipFactor(Tensor t) {
+    clip(t);
+    return 1.f;
+  }
 };
 
 typedef std::shared_ptr<ClipperBase> ClipperPtr;
@@ -35,6 +46,7 @@ public:
   Norm(float c = 1.0) : c_(c) {}
 
   void clip(Tensor t);
+  float clipFactor(Tensor t);
 
 private:
   float c_;
@@ -1,252 +1,387 @@
 #include "optimizers.h"
 
+#include <boost/regex.hpp>
+#include <set>
+#include <thread>
+
+#include "common/config_parser.h"
+#include "common/io.h"
 #include "tensors/tensor_operators.h"
 
 namespace marian {
 
-void Sgd::updateImpl(Tensor params, Tensor grads) {
-  using namespace functional;
-  Element(_1 -= (multiplyFactor_ * eta_) * _2, params, grads);
-
-  params->getBackend()->synchronize();
+namespace {
+bool onCpu(Tensor t) {
+  return t->getBackend()->getDevice().type == DeviceType::cpu;
 }
 
-// Aagrad
-
-void Adagrad::updateImpl(Tensor params, Tensor grads) {
-  if(!alloc_)
-    alloc_ = New<TensorAllocator>(params->getBackend());
-
-  if(!gt_) {
-    int elements = params->size();
-    alloc_->reserveExact(params->memory()->size());
-    alloc_->allocate(gt_, {1, elements});
-    gt_->set(0);
-  }
-
+void smooth(Tensor paramsAvg, Tensor params, float decay) {
   using namespace functional;
+  Element(_1 = ((1.f - decay) * _1) + (decay * _2), paramsAvg, params);
+}
 
-  Element(_1 += (_2 * _2), gt_, grads);
+// File with the state of shard i of n, next to the file with the layout
+std::string shardFileName(const std::string& name, size_t i, size_t n) {
+  std::string base = name;
+  if(base.size() > 4 && base.substr(base.size() - 4) == ".npz")
+    base = base.substr(0, base.size() - 4);
+  return base + ".shard" + std::to_string(i + 1) + "-of-" + std::to_string(n)
+         + ".npz";
+}
 
-  Element(_1 -= ((multiplyFactor_ * eta_) / (sqrt(_2) + eps_)) * _3,
-          params,
-          gt_,
-          grads);
+// Range of the parameters held by a shard of a checkpoint
+struct ShardRange {
+  std::string file;
+  size_t offset;
+  size_t size;
+};
+
+// Removes the shard files of earlier checkpoints of name which the layout of
+// the current shards does not refer to, e.g. after a change of the number of
+// devices
+void removeStaleShards(const std::string& name,
+                       const std::vector<ShardRange>& shards) {
+  // shard files are named <prefix>I-of-N.npz
+  std::string prefix
+      = boost::filesystem::path(shardFileName(name, 0, 1)).filename().string();
+  prefix.erase(prefix.size() - std::string("1-of-1.npz").size());
+  boost::regex range("[0-9]+-of-[0-9]+");
+  auto isShard = [&](const std::string& file) {
+    return file.size() > prefix.size() + 4
+           && file.compare(0, prefix.size(), prefix) == 0
+           && file.compare(file.size() - 4, 4, ".npz") == 0
+           && boost::regex_match(
+                  file.substr(prefix.size(), file.size() - prefix.size() - 4),
+                  range);
+  };
+
+  std::set<std::string> current;
+  for(auto& shard : shards)
+    current.insert(boost::filesystem::path(shard.file).filename().string());
+
+  auto dir = boost::filesystem::path(name).parent_path();
+  if(dir.empty())
+    dir = ".";
+
+  boost::system::error_code ec;
+  std::vector<boost::filesystem::path> stale;
+  for(boost::filesystem::directory_iterator it(dir, ec), end; !ec && it != end;
+      it.increment(ec)) {
+    std::string file = it->path().filename().string();
+    if(isShard(file) && !current.count(file))
+      stale.push_back(it->path());
+  }
 
-  params->getBackend()->synchronize();
+  for(auto& path : stale) {
+    LOG(info, "Removing optimizer parameters {}", path.string());
+    boost::filesystem::remove(path, ec);
+  }
+}
 }
 
-void Adagrad::load(const std::string& name,
-                   std::vector<Ptr<OptimizerBase>> opts,
-                   std::vector<Ptr<Backend>> backends) {
+void OptimizerBase::load(const std::string& name,
+                         std::vector<Ptr<OptimizerBase>> opts,
+                         std::vector<Ptr<Backend>> backends,
+                         size_t firstShard,
+                         size_t totalShards) {
   if(!boost::filesystem::exists(name))
     return;
 
-  LOG(info, "Loading Adagrad parameters from {}", name);
+  if(totalShards == 0)
+    totalShards = opts.size();
 
-  std::vector<float> vGt;
-  size_t totalSize = 0;
+  LOG(info, "Loading optimizer parameters from {}", name);
 
-  auto numpy = cnpy::npz_load(name);
-  for(auto it : numpy) {
-    auto name = it.first;
-    auto np = it.second;
+  std::vector<ShardRange> sources;
+  size_t totalSize = 0;
 
-    // get the size of gt_
-    totalSize = np->shape[1];
+  auto npz = New<cnpy::NpzReader>(name);
+  if(npz->contains("special:optimizer.yml")) {
+    auto layout = YAML::Load(npz->load("special:optimizer.yml")->data());
+    totalSize = layout["size"].as<size_t>();
 
-    // extract data into vectors
-    if(name == "adagrad_gt") {
-      vGt.resize(totalSize);
-      std::copy((float*)np->data(), (float*)np->data() + totalSize, vGt.begin());
+    auto dir = boost::filesystem::path(name).parent_path();
+    for(auto shard : layout["shards"])
+      sources.push_back({(dir / shard["file"].as<std::string>()).string(),
+                         shard["offset"].as<size_t>(),
+                         shard["size"].as<size_t>()});
+  } else {
+    // earlier checkpoints hold the state of all shards in a single file
+    if(npz->names().empty()) {
+      LOG(warn, "[warn] Optimizer parameters not found in {}", name);
+      return;
     }
+    totalSize = npz->shape(npz->names()[0]).back();
+    sources.push_back({name, 0, totalSize});
   }
 
-  if(vGt.empty()) {
-    LOG(warn, "[warn] Adagrad parameters not found in .npz file");
-    return;
+  // the parameters are sharded as in the graph groups
+  size_t shardSize = ceil(totalSize / (float)totalShards);
+  for(size_t i = 0; i < opts.size(); ++i) {
+    size_t begin = std::min((firstShard + i) * shardSize, totalSize);
+    size_t end = std::min(begin + shardSize, totalSize);
+    opts[i]->allocateState(backends[i], end - begin);
   }
 
-  // get the size of params which should go
-  size_t shardSize = ceil(totalSize / (float)backends.size());
-
-  size_t id = 0;
-  for(auto optBase : opts) {
-    auto opt = std::dynamic_pointer_cast<Adagrad>(optBase);
+  // each file is read once and copied to all shards it overlaps with
+  for(auto& source : sources) {
+    auto reader = source.file == name ? npz : New<cnpy::NpzReader>(source.file);
+    std::map<std::string, cnpy::NpyArrayPtr> arrays;
+
+    for(size_t i = 0; i < opts.size(); ++i) {
+      size_t shardBegin = std::min((firstShard + i) * shardSize, totalSize);
+      size_t shardEnd = std::min(shardBegin + shardSize, totalSize);
+
+      size_t begin = std::max(shardBegin, source.offset);
+      size_t end = std::min(shardEnd, source.offset + source.size);
+      if(begin >= end)
+        continue;
+
+      for(auto& state : opts[i]->getState()) {
+        if(!reader->contains(state.first)) {
+          LOG(warn,
+              "[warn] Optimizer parameters {} not found in {}",
+              state.first,
+              source.file);
+          continue;
+        }
+
+        auto& array = arrays[state.first];
+        if(!array) {
+          array = reader->load(state.first);
+          ABORT_IF(array->bytes.size() != source.size * sizeof(float),
+                   "Optimizer parameters {} in {} do not have {} values",
+                   state.first,
+                   source.file,
+                   source.size);
+        }
+
+        const float* data = (const float*)array->data() + (begin - source.offset);
+        state.second->subtensor(begin - shardBegin, end - begin)
+            ->set(data, data + (end - begin));
+      }
+    }
+  }
+}
 
-    int size = std::min(shardSize, totalSize);
-    totalSize -= size;
+void OptimizerBase::save(const std::string& name,
+                         std::vector<Ptr<OptimizerBase>> opts,
+                         size_t totalSize,
+                         size_t firstShard,
+                         size_t totalShards) {
+  // optimizers without state such as SGD write no checkpoint
+  if(opts[0]->getState().empty())
+    return;
 
-    if(!opt->alloc_)
-      opt->alloc_ = New<TensorAllocator>(backends[id]);
+  if(totalShards == 0)
+    totalShards = opts.size();
 
-    if(!opt->gt_) {
-      opt->alloc_->reserveExact(sizeof(float) * size);
-      opt->alloc_->allocate(opt->gt_, {1, size});
-    }
+  LOG(info, "Saving optimizer parameters to {}", name);
 
-    size_t shift = id * shardSize;
-    std::vector<float> tmp(vGt.begin() + shift, vGt.begin() + shift + size);
-    opt->gt_->set(tmp);
+  // the layout of all shards follows from the sharding in the graph groups
+  size_t shardSize = ceil(totalSize / (float)totalShards);
+  std::vector<ShardRange> shards;
+  for(size_t i = 0; i < totalShards; ++i) {
+    size_t begin = std::min(i * shardSize, totalSize);
+    size_t end = std::min(begin + shardSize, totalSize);
+    shards.push_back({shardFileName(name, i, totalShards), begin, end - begin});
+  }
 
-    id++;
+  std::vector<std::pair<std::string, Ptr<io::Snapshot>>> files;
+  std::vector<std::thread> threads;
+
+  // every shard copies its state to the host concurrently
+  for(size_t i = 0; i < opts.size(); ++i) {
+    auto state = opts[i]->getState();
+    unsigned int size = state[0].second->size();
+
+    auto& shard = shards[firstShard + i];
+    ABORT_IF(size != shard.size,
+             "Optimizer shard {} holds {} values instead of {}",
+             firstShard + i,
+             size,
+             shard.size);
+
+    auto snapshot = New<io::Snapshot>();
+    files.push_back({shard.file, snapshot});
+
+    threads.emplace_back([state, snapshot, size]() {
+      snapshot->reserve(state.size() * sizeof(float) * size);
+      for(auto& s : state)
+        s.second->copyTo(snapshot->add(s.first, {1, size}));
+    });
   }
-}
+  for(auto& thread : threads)
+    thread.join();
 
-void Adagrad::save(const std::string& name,
-                   std::vector<Ptr<OptimizerBase>> opts,
-                   size_t totalSize) {
-  LOG(info, "Saving Adagrad parameters to {}", name);
+  // the shards are written in parallel, the layout once they are complete
+  io::saveAsync(files);
 
-  std::vector<float> vGt;
+  if(firstShard != 0)
+    return;
 
-  for(auto optBase : opts) {
-    auto opt = std::dynamic_pointer_cast<Adagrad>(optBase);
-    std::vector<float> tmp;
-    opt->gt_->get(tmp);
-    vGt.insert(vGt.end(), tmp.begin(), tmp.end());
+  YAML::Node layout;
+  layout["size"] = totalSize;
+  for(auto& shard : shards) {
+    YAML::Node node;
+    node["file"] = boost::filesystem::path(shard.file).filename().string();
+    node["offset"] = shard.offset;
+    node["size"] = shard.size;
+    layout["shards"].push_back(node);
   }
 
-  unsigned* shape = new unsigned[2];
-  shape[0] = 1;
-  shape[1] = vGt.size();
-
-  cnpy::npz_save(name, "adagrad_gt", vGt.data(), shape, 2, "w");
+  YAML::Emitter out;
+  OutputYaml(layout, out);
+  auto snapshot = New<io::Snapshot>();
+  snapshot->addText("special:optimizer.yml", out.c_str());
+  io::saveAsync(name, snapshot);
 
-  delete[] shape;
+  // shards of earlier layouts are only removed once no layout refers to them
+  io::writeAsync([name, shards]() { removeStaleShards(name, shards); });
 }
 
-void Adagrad::resetStats() {
-  if(gt_)
-    gt_->set(0);
-}
+void Sgd::updateImpl(Tensor params,
+                     Tensor grads,
+                     float clipFactor,
+                     Tensor paramsAvg,
+                     float decay) {
+  float eta = multiplyFactor_ * eta_ * clipFactor;
 
-// Adam
+  if(onCpu(params)) {
+    cpu::SgdUpdate(params, grads, paramsAvg, eta, decay);
+  } else {
+    using namespace functional;
+    Element(_1 -= eta * _2, params, grads);
+    if(paramsAvg)
+      smooth(paramsAvg, params, decay);
+  }
 
-void Adam::updateImpl(Tensor params, Tensor grads) {
-  if(!alloc_)
-    alloc_ = New<TensorAllocator>(params->getBackend());
+  params->getBackend()->synchronize();
+}
 
-  if(!mt_) {
-    int elements = params->size();
-    alloc_->reserveExact(2 * params->memory()->size());
-    alloc_->allocate(mt_, {1, elements});
-    mt_->set(0);
+// Aagrad
 
-    alloc_->allocate(vt_, {1, elements});
-    vt_->set(0);
-  }
+void Adagrad::updateImpl(Tensor params,
+                         Tensor grads,
+                         float clipFactor,
+                         Tensor paramsAvg,
+                         float decay) {
+  allocateState(params->getBackend(), params->size());
 
-  t_++;
-  float denom1 = 1 - std::pow(beta1_, t_);
-  float denom2 = 1 - std::pow(beta2_, t_);
+  float eta = multiplyFactor_ * eta_;
 
-  using namespace functional;
+  if(onCpu(params)) {
+    cpu::AdagradUpdate(
+        params, grads, gt_, paramsAvg, clipFactor, eta, eps_, decay);
+  } else {
+    using namespace functional;
+
+    Element(_1 += (clipFactor * _2) * (clipFactor * _2), gt_, grads);
 
-  Element(_1 = (beta1_ * _1) + ((1 - beta1_) * _2), mt_, grads);
-  Element(_1 = (beta2_ * _1) + ((1 - beta2_) * (_2 * _2)), vt_, grads);
+    Element(_1 -= (eta / (sqrt(_2) + eps_)) * (clipFactor * _3),
+            params,
+            gt_,
+            grads);
 
-  Element(_1 -= (multiplyFactor_ * eta_) * (_2 / denom1)
-                / (sqrt(_3 / denom2) + eps_),
-          params,
-          mt_,
-          vt_);
+    if(paramsAvg)
+      smooth(paramsAvg, params, decay);
+  }
 
   params->getBackend()->synchronize();
 }
 
-void Adam::load(const std::string& name,
-                std::vector<Ptr<OptimizerBase>> opts,
-                std::vector<Ptr<Backend>> backends) {
-  if(!boost::filesystem::exists(name))
-    return;
-
-  LOG(info, "Loading Adam parameters from {}", name);
-
-  std::vector<float> vMt;
-  std::vector<float> vVt;
-  size_t totalSize = 0;
+std::vector<std::pair<std::string, Tensor>> Adagrad::getState() {
+  if(!gt_)
+    return {};
+  return {{"adagrad_gt", gt_}};
+}
 
-  auto numpy = cnpy::npz_load(name);
-  for(auto it : numpy) {
-    auto name = it.first;
-    auto np = it.second;
+void Adagrad::allocateState(Ptr<Backend> backend, int size) {
+  if(gt_)
+    return;
 
-    // get the size of mt_ and vt_, they are the same
-    totalSize = np->shape[1];
+  if(!alloc_)
+    alloc_ = New<TensorAllocator>(backend);
 
-    // extract data into vectors
-    if(name == "adam_mt") {
-      vMt.resize(totalSize);
-      std::copy((float*)np->data(), (float*)np->data() + totalSize, vMt.begin());
-    }
-    if(name == "adam_vt") {
-      vVt.resize(totalSize);
-      std::copy((float*)np->data(), (float*)np->data() + totalSize, vVt.begin());
-    }
-  }
+  alloc_->reserveExact(alloc_->capacity({1, size}));
+  alloc_->allocate(gt_, {1, size});
+  gt_->set(0);
+}
 
-  if(vMt.empty() || vVt.empty()) {
-    LOG(warn, "[warn] Adam parameters not found in .npz file");
-    return;
-  }
+void Adagrad::resetStats() {
+  if(gt_)
+    gt_->set(0);
+}
 
-  // get the size of params which should go
-  size_t shardSize = ceil(totalSize / (float)backends.size());
+// Adam
 
-  size_t id = 0;
-  for(auto optBase : opts) {
-    auto opt = std::dynamic_pointer_cast<Adam>(optBase);
+void Adam::updateImpl(Tensor params,
+                      Tensor grads,
+                      float clipFactor,
+                      Tensor paramsAvg,
+                      float decay) {
+  allocateState(params->getBackend(), params->size());
 
-    int size = std::min(shardSize, totalSize);
-    totalSize -= size;
+  t_++;
+  float denom1 = 1 - std::pow(beta1_, t_);
+  float denom2 = 1 - std::pow(beta2_, t_);
 
-    if(!opt->alloc_)
-      opt->alloc_ = New<TensorAllocator>(backends[id]);
+  float eta = multiplyFactor_ * eta_;
+
+  if(onCpu(params)) {
+    cpu::AdamUpdate(params,
+                    grads,
+                    mt_,
+                    vt_,
+                    paramsAvg,
+                    clipFactor,
+                    eta,
+                    beta1_,
+                    beta2_,
+                    denom1,
+                    denom2,
+                    eps_,
+                    decay);
+  } else {
+    using namespace functional;
 
-    if(!opt->mt_ || !opt->vt_) {
-      opt->alloc_->reserveExact(2 * sizeof(float) * size);
-      opt->alloc_->allocate(opt->mt_, {1, size});
-      opt->alloc_->allocate(opt->vt_, {1, size});
-    }
+    Element(_1 = (beta1_ * _1) + ((1 - beta1_) * clipFactor * _2), mt_, grads);
+    Element(_1 = (beta2_ * _1)
+                 + ((1 - beta2_) * (clipFactor * _2) * (clipFactor * _2)),
+            vt_,
+            grads);
 
-    size_t shift = id * shardSize;
-    std::vector<float> tmpMt(vMt.begin() + shift, vMt.begin() + shift + size);
-    opt->mt_->set(tmpMt);
-    std::vector<float> tmpVt(vVt.begin() + shift, vVt.begin() + shift + size);
-    opt->vt_->set(tmpVt);
+    Element(_1 -= eta * (_2 / denom1) / (sqrt(_3 / denom2) + eps_),
+            params,
+            mt_,
+            vt_);
 
-    id++;
+    if(paramsAvg)
+      smooth(paramsAvg, params, decay);
   }
-}
 
-void Adam::save(const std::string& name,
-                std::vector<Ptr<OptimizerBase>> opts,
-                size_t totalSize) {
-  LOG(info, "Saving Adam parameters to {}", name);
-
-  std::vector<float> vMt;
-  std::vector<float> vVt;
+  params->getBackend()->synchronize();
+}
 
-  for(auto optBase : opts) {
-    auto opt = std::dynamic_pointer_cast<Adam>(optBase);
+std::vector<std::pair<std::string, Tensor>> Adam::getState() {
+  if(!mt_ || !vt_)
+    return {};
+  return {{"adam_mt", mt_}, {"adam_vt", vt_}};
+}
 
-    std::vector<float> tmp;
-    opt->mt_->get(tmp);
-    vMt.insert(vMt.end(), tmp.begin(), tmp.end());
-    opt->vt_->get(tmp);
-    vVt.insert(vVt.end(), tmp.begin(), tmp.end());
-  }
+void Adam::allocateState(Ptr<Backend> backend, int size) {
+  if(mt_ && vt_)
+    return;
 
-  // the shape is the same for mt_ and vt_
-  unsigned* shape = new unsigned[2];
-  shape[0] = 1;
-  shape[1] = vMt.size();
+  if(!alloc_)
+    alloc_ = New<TensorAllocator>(backend);
 
-  cnpy::npz_save(name, "adam_mt", vMt.data(), shape, 2, "w");
-  cnpy::npz_save(name, "adam_vt", vVt.data(), shape, 2, "a");
+  alloc_->reserveExact(2 * alloc_->capacity({1, size}));
+  alloc_->allocate(mt_, {1, size});
+  mt_->set(0);
 
-  delete[] shape;
+  alloc_->allocate(vt_, {1, size});
+  vt_->set(0);
 }
 
 void Adam::resetStats() {
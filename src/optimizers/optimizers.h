@@ -28,13 +28,22 @@ public:
     update(p, g, multiplyFactor);
   }
 
-  void update(Tensor params, Tensor grads, float multiplyFactor = 1.0f) {
-    if(clipper_)
-      clipper_->clip(grads);
+  /**
+   * @brief Updates params with grads. If paramsAvg is given, the updated
+   * parameters are also blended into it as (1 - decay) * paramsAvg + decay *
+   * params. Gradient clipping, the update and the smoothing are done in a
+   * single pass over the memory on the CPU.
+   */
+  void update(Tensor params,
+              Tensor grads,
+              float multiplyFactor = 1.0f,
+              Tensor paramsAvg = nullptr,
+              float decay = 0.f) {
+    float clipFactor = clipper_ ? clipper_->clipFactor(grads) : 1.f;
 
     // In case we want to add a multiply factor to our learning rate
     multiplyFactor_ = multiplyFactor;
-    updateImpl(params, grads);
+    updateImpl(params, grads, clipFactor, paramsAvg, decay);
   }
 
   virtual void actAfterLoaded(TrainingState& state) {
@@ -59,15 +68,56 @@ public:
 
   void setParams(const std::vector<float>& params) { parseParams(params); }
 
-  virtual void load(const std::string& name,
-                    std::vector<Ptr<OptimizerBase>> opts,
-                    std::vector<Ptr<Backend>> backends) {}
-  virtual void save(const std::string& name,
-                    std::vector<Ptr<OptimizerBase>> opts,
-                    size_t totalSize) {}
+  /**
+   * @brief Restores the state of all shard optimizers opts, which live on the
+   * given backends. The checkpoint may have been written with a different
+   * number of shards, its state is re-sharded to the current ones.
+   *
+   * If the parameters are split into more shards than opts, e.g. across the
+   * nodes of multi-node training, opts are the shards firstShard to
+   * firstShard + opts.size() - 1 of totalShards.
+   */
+  void load(const std::string& name,
+            std::vector<Ptr<OptimizerBase>> opts,
+            std::vector<Ptr<Backend>> backends,
+            size_t firstShard = 0,
+            size_t totalShards = 0);
+
+  /**
+   * @brief Saves the state of all shard optimizers opts. Every shard is
+   * written to its own file, concurrently and in the background, and name
+   * records the layout of the shards.
+   *
+   * With firstShard and totalShards as in load, only the files of opts are
+   * written; the layout of all shards is written along with the first one.
+   * Shard files of name which the new layout does not refer to, e.g. from a
+   * run on a different number of devices, are removed after it is written.
+   */
+  void save(const std::string& name,
+            std::vector<Ptr<OptimizerBase>> opts,
+            size_t totalSize,
+            size_t firstShard = 0,
+            size_t totalShards = 0);
 
 protected:
-  virtual void updateImpl(Tensor params, Tensor grads) = 0;
+  /**
+   * @brief State tensors of this shard with their names in checkpoints,
+   * empty if the optimizer has no state or has not been used yet.
+   */
+  virtual std::vector<std::pair<std::string, Tensor>> getState() { return {}; }
+
+  /**
+   * @brief Allocates the state of a shard of the given size on the backend,
+   * if it is not allocated yet.
+   */
+  virtual void allocateState(Ptr<Backend> backend, int size) {}
+
+  virtual void updateImpl(Tensor params,
+                          Tensor grads,
+                          float clipFactor,
+                          Tensor paramsAvg,
+                          float decay)
+      = 0;
   virtual void parseParams(const std::vector<float>& params) = 0;
   virtual void resetStats() = 0;
 
@@ -88,7 +138,11 @@ public:
       : OptimizerBase(eta, clipper) {}
 
 private:
-  void updateImpl(Tensor params, Tensor grads);
+  void updateImpl(Tensor params,
+                  Tensor grads,
+                  float clipFactor,
+                  Tensor paramsAvg,
+                  float decay);
 
   virtual void parseParams(const std::vector<float>& params) {}
   virtual void resetStats() {}
@@ -104,15 +158,16 @@ public:
   Adagrad(float eta, Ptr<ClipperBase> clipper = nullptr)
       : OptimizerBase(eta, clipper) {}
 
-  void load(const std::string& name,
-            std::vector<Ptr<OptimizerBase>> opts,
-            std::vector<Ptr<Backend>> backends);
-  void save(const std::string& name,
-            std::vector<Ptr<OptimizerBase>> opts,
-            size_t totalSize);
+protected:
+  std::vector<std::pair<std::string, Tensor>> getState();
+  void allocateState(Ptr<Backend> backend, int size);
 
 private:
-  void updateImpl(Tensor params, Tensor grads);
+  void updateImpl(Tensor params,
+                  Tensor grads,
+                  float clipFactor,
+                  Tensor paramsAvg,
+                  float decay);
   void resetStats();
 
   void parseParams(const std::vector<float>& params) {
@@ -135,15 +190,16 @@ public:
   Adam(float eta, Ptr<ClipperBase> clipper = nullptr)
       : OptimizerBase(eta, clipper), t_(0) {}
 
-  void load(const std::string& name,
-            std::vector<Ptr<OptimizerBase>> opts,
-            std::vector<Ptr<Backend>> backends);
-  void save(const std::string& name,
-            std::vector<Ptr<OptimizerBase>> opts,
-            size_t totalSize);
+protected:
+  std::vector<std::pair<std::string, Tensor>> getState();
+  void allocateState(Ptr<Backend> backend, int size);
 
 private:
-  void updateImpl(Tensor params, Tensor grads);
+  void updateImpl(Tensor params,
+                  Tensor grads,
+                  float clipFactor,
+                  Tensor paramsAvg,
+                  float decay);
   void resetStats();
 
   virtual void parseParams(const std::vector<float>& params) {
@@ -51,6 +51,95 @@ Expr gruOps(const std::vector<Expr>& nodes, bool final) {
 
 /******************************************************************************/
 
+bool isFusable(Expr xW, State state, Expr mask, int dimState) {
+  if(xW->graph()->getDevice().type != DeviceType::cpu)
+    return false;
+
+  const auto& shape = xW->shape();
+  int dimTime = shape[-3];
+  int dimBatch = shape[-2];
+  return shape.elements() == dimTime * dimBatch * shape[-1]
+         && state.output->shape().elements() == dimBatch * dimState
+         && (!mask || mask->shape().elements() == dimTime * dimBatch);
+}
+
+Shape sequenceShape(Expr state, Expr xW) {
+  const auto& stateShape = state->shape();
+  Shape shape;
+  shape.resize(std::max(stateShape.size(), (size_t)3));
+  for(int i = 1; i <= stateShape.size(); ++i)
+    shape.set(-i, stateShape[-i]);
+  shape.set(-3, xW->shape()[-3]);
+  return shape;
+}
+
+// Recurrence of a GRU over all time steps. The children are the initial
+// state, the projected inputs of all steps, U, b and optionally the mask.
+struct GRUSequenceNodeOp : public NaryNodeOp {
+  bool final_;
+  bool reverse_;
+
+  GRUSequenceNodeOp(const std::vector<Expr>& nodes, bool final, bool reverse)
+      : NaryNodeOp(nodes, sequenceShape(nodes[0], nodes[1])),
+        final_(final),
+        reverse_(reverse) {}
+
+  NodeOps forwardOps() {
+    std::vector<Tensor> inputs;
+    for(int i = 0; i < children_.size(); ++i)
+      inputs.push_back(child(i)->val());
+
+    return {NodeOp(GRUSequenceForward(val_, inputs, final_, reverse_))};
+  }
+
+  NodeOps backwardOps() {
+    std::vector<Tensor> inputs;
+    std::vector<Tensor> outputs;
+    for(auto child : children_) {
+      inputs.push_back(child->val());
+      if(child->trainable())
+        outputs.push_back(child->grad());
+      else
+        outputs.push_back(nullptr);
+    }
+
+    return {NodeOp(
+        GRUSequenceBackward(outputs, inputs, val_, adj_, final_, reverse_))};
+  }
+
+  // do not check if node is trainable
+  virtual void runBackward(const NodeOps& ops) {
+    for(auto&& op : ops)
+      op();
+  }
+
+  const std::string type() { return "GRU-sequence-ops"; }
+
+  const std::string color() { return "yellow"; }
+
+  virtual size_t hash() {
+    if(!hash_) {
+      hash_ = NaryNodeOp::hash();
+      boost::hash_combine(hash_, final_);
+      boost::hash_combine(hash_, reverse_);
+    }
+    return hash_;
+  }
+
+  virtual bool equal(Expr node) {
+    if(!NaryNodeOp::equal(node))
+      return false;
+    auto cnode = std::dynamic_pointer_cast<GRUSequenceNodeOp>(node);
+    return cnode && final_ == cnode->final_ && reverse_ == cnode->reverse_;
+  }
+};
+
+Expr gruSequenceOps(const std::vector<Expr>& nodes, bool final, bool reverse) {
+  return Expression<GRUSequenceNodeOp>(nodes, final, reverse);
+}
+
+/******************************************************************************/
+
 struct LSTMCellNodeOp : public NaryNodeOp {
   LSTMCellNodeOp(const std::vector<Expr>& nodes)
       : NaryNodeOp(nodes) {}
@@ -132,5 +221,72 @@ Expr lstmOpsC(const std::vector<Expr>& nodes) {
 Expr lstmOpsO(const std::vector<Expr>& nodes) {
   return Expression<LSTMOutputNodeOp>(nodes);
 }
+
+// Recurrence of an LSTM over all time steps. The children are the initial
+// output and cell state, the projected inputs of all steps, U, b and
+// optionally the mask. The outputs of all steps are followed by the cell
+// states of all steps.
+struct LSTMSequenceNodeOp : public NaryNodeOp {
+  bool reverse_;
+
+  LSTMSequenceNodeOp(const std::vector<Expr>& nodes, bool reverse)
+      : NaryNodeOp(nodes, newShape(nodes)), reverse_(reverse) {}
+
+  Shape newShape(const std::vector<Expr>& nodes) {
+    const auto& shape = nodes[2]->shape();
+    return {2, shape[-3], shape[-2], nodes[3]->shape()[-2]};
+  }
+
+  NodeOps forwardOps() {
+    std::vector<Tensor> inputs;
+    for(int i = 0; i < children_.size(); ++i)
+      inputs.push_back(child(i)->val());
+
+    return {NodeOp(LSTMSequenceForward(val_, inputs, reverse_))};
+  }
+
+  NodeOps backwardOps() {
+    std::vector<Tensor> inputs;
+    std::vector<Tensor> outputs;
+    for(auto child : children_) {
+      inputs.push_back(child->val());
+      if(child->trainable())
+        outputs.push_back(child->grad());
+      else
+        outputs.push_back(nullptr);
+    }
+
+    return {NodeOp(LSTMSequenceBackward(outputs, inputs, val_, adj_, reverse_))};
+  }
+
+  // do not check if node is trainable
+  virtual void runBackward(const NodeOps& ops) {
+    for(auto&& op : ops)
+      op();
+  }
+
+  const std::string type() { return "LSTM-sequence-ops"; }
+
+  const std::string color() { return "yellow"; }
+
+  virtual size_t hash() {
+    if(!hash_) {
+      hash_ = NaryNodeOp::hash();
+      boost::hash_combine(hash_, reverse_);
+    }
+    return hash_;
+  }
+
+  virtual bool equal(Expr node) {
+    if(!NaryNodeOp::equal(node))
+      return false;
+    auto cnode = std::dynamic_pointer_cast<LSTMSequenceNodeOp>(node);
+    return cnode && reverse_ == cnode->reverse_;
+  }
+};
+
+Expr lstmSequenceOps(const std::vector<Expr>& nodes, bool reverse) {
+  return Expression<LSTMSequenceNodeOp>(nodes, reverse);
+}
 }
 }
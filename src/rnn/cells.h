@@ -112,7 +112,95 @@ public:
 
 /******************************************************************************/
 
+/**
+ * @brief Simpler simple recurrent unit (SSRU) of Kim et al. (2019), "From
+ * Research to Production and Back: Ludicrously Fast Neural Machine
+ * Translation". The recurrence is element-wise and has no recurrent matrix
+ * multiplication:
+ *
+ *   f_t = sigmoid(W_f x_t + b_f)
+ *   c_t = f_t * c_{t-1} + (1 - f_t) * W x_t
+ *   h_t = relu(c_t)
+ */
+class SSRU : public Cell {
+private:
+  Expr W_, Wf_, bf_;
+
+  float dropout_;
+  Expr dropMaskX_;
+
+public:
+  SSRU(Ptr<ExpressionGraph> graph, Ptr<Options> options) : Cell(options) {
+    int dimInput = options_->get<int>("dimInput");
+    int dimState = options_->get<int>("dimState");
+    std::string prefix = options_->get<std::string>("prefix");
+
+    dropout_ = options_->get<float>("dropout", 0);
+
+    W_ = graph->param(prefix + "_W",
+                      {dimInput, dimState},
+                      inits::glorot_uniform);
+
+    Wf_ = graph->param(prefix + "_Wf",
+                       {dimInput, dimState},
+                       inits::glorot_uniform);
+    bf_ = graph->param(prefix + "_bf", {1, dimState}, inits::zeros);
+
+    if(dropout_ > 0.0f)
+      dropMaskX_ = graph->dropout(dropout_, {1, dimInput});
+  }
+
+  State apply(std::vector<Expr> inputs, State state, Expr mask = nullptr) {
+    return applyState(applyInput(inputs), state, mask);
+  }
+
+  std::vector<Expr> applyInput(std::vector<Expr> inputs) {
+    Expr input;
+    if(inputs.size() == 0)
+      return {};
+    else if(inputs.size() > 1)
+      input = concatenate(inputs, keywords::axis = -1);
+    else
+      input = inputs.front();
+
+    if(dropMaskX_)
+      input = dropout(input, keywords::mask = dropMaskX_);
+
+    auto xW = dot(input, W_);
+    auto xWf = affine(input, Wf_, bf_);
+
+    return {xW, xWf};
+  }
+
+  State applyState(std::vector<Expr> xWs, State state, Expr mask = nullptr) {
+    auto f = logit(xWs[1]);
+    auto cell = f * state.cell + (1.f - f) * xWs[0];
+    auto output = relu(cell);
+
+    if(mask)
+      return {output * mask, cell * mask};
+    else
+      return {output, cell};
+  }
+};
+
+/******************************************************************************/
+
 Expr gruOps(const std::vector<Expr>& nodes, bool final = false);
+Expr gruSequenceOps(const std::vector<Expr>& nodes, bool final, bool reverse);
+
+/**
+ * @brief Whether the recurrence over the mapped inputs xW can be computed by
+ * a fused sequence operation: on the CPU, for a single sequence of time steps
+ * with a matching initial state and mask.
+ */
+bool isFusable(Expr xW, State state, Expr mask, int dimState);
+
+/**
+ * @brief Shape of the outputs of all time steps for the given initial state,
+ * the same as for the concatenated outputs of the unrolled time loop.
+ */
+Shape sequenceShape(Expr state, Expr xW);
 
 class GRU : public Cell {
 protected:
@@ -242,6 +330,28 @@ public:
 
     return {output, state.cell};  // no cell state, hence copy
   }
+
+  virtual Expr applySequence(std::vector<Expr> xWs,
+                             State state,
+                             Expr mask,
+                             bool reverse,
+                             std::function<State()>& last) {
+    if(layerNorm_ || dropMaskS_ || xWs.size() != 1
+       || !isFusable(xWs.front(), state, mask, opt<int>("dimState")))
+      return nullptr;
+
+    auto xW = xWs.front();
+    auto outputs
+        = mask ? gruSequenceOps({state.output, xW, U_, b_, mask}, final_, reverse)
+               : gruSequenceOps({state.output, xW, U_, b_}, final_, reverse);
+
+    last = [=]() -> State {
+      int dimTime = outputs->shape()[-3];
+      return {reshape(step(outputs, dimTime - 1, -3), state.output->shape()),
+              state.cell};
+    };
+    return outputs;
+  }
 };
 
 /**
@@ -480,12 +590,36 @@ public:
 
     return {output, state.cell};  // no cell state, hence copy
   }
+
+  virtual Expr applySequence(std::vector<Expr> xWs,
+                             State state,
+                             Expr mask,
+                             bool reverse,
+                             std::function<State()>& last) {
+    if(layerNorm_ || transition_ || dropMaskS_ || xWs.size() != 1
+       || !isFusable(xWs.front(), state, mask, opt<int>("dimState")))
+      return nullptr;
+
+    auto xW = xWs.front();
+    auto outputs = mask ? gruSequenceOps(
+                              {state.output, xW, UUx_, bbx_, mask}, final_, reverse)
+                        : gruSequenceOps(
+                              {state.output, xW, UUx_, bbx_}, final_, reverse);
+
+    last = [=]() -> State {
+      int dimTime = outputs->shape()[-3];
+      return {reshape(step(outputs, dimTime - 1, -3), state.output->shape()),
+              state.cell};
+    };
+    return outputs;
+  }
 };
 
 /******************************************************************************/
 
 Expr lstmOpsC(const std::vector<Expr>& nodes);
 Expr lstmOpsO(const std::vector<Expr>& nodes);
+Expr lstmSequenceOps(const std::vector<Expr>& nodes, bool reverse);
 
 class FastLSTM : public Cell {
 protected:
@@ -601,6 +735,36 @@ public:
 
     return {nextRecState, nextCellState};
   }
+
+  virtual Expr applySequence(std::vector<Expr> xWs,
+                             State state,
+                             Expr mask,
+                             bool reverse,
+                             std::function<State()>& last) {
+    int dimState = opt<int>("dimState");
+    if(layerNorm_ || dropMaskS_ || xWs.size() != 1 || !state.cell
+       || state.cell->shape().elements() != state.output->shape().elements()
+       || !isFusable(xWs.front(), state, mask, dimState))
+      return nullptr;
+
+    auto xW = xWs.front();
+    // outputs and cell states of all time steps, stacked along axis -4
+    auto states = mask ? lstmSequenceOps(
+                             {state.output, state.cell, xW, U_, b_, mask}, reverse)
+                       : lstmSequenceOps(
+                             {state.output, state.cell, xW, U_, b_}, reverse);
+
+    auto shape = sequenceShape(state.output, xW);
+    auto outputs = reshape(step(states, 0, -4), shape);
+
+    last = [=]() -> State {
+      int dimTime = states->shape()[-3];
+      auto cells = reshape(step(states, 1, -4), shape);
+      return {reshape(step(outputs, dimTime - 1, -3), state.output->shape()),
+              reshape(step(cells, dimTime - 1, -3), state.cell->shape())};
+    };
+    return outputs;
+  }
 };
 
 using LSTM = FastLSTM;
@@ -52,11 +52,15 @@ private:
   Ptr<Cell> cell_;
   dir direction_;
   States last_;
+  // Extracts the last state of a fused layer. It is only called on request,
+  // since unused nodes would be additional roots of the graph.
+  std::function<State()> lastFused_;
 
-  States apply(const Expr input,
-               const States initialState,
-               const Expr mask = nullptr) {
+  Expr apply(const Expr input,
+             const States initialState,
+             const Expr mask = nullptr) {
     last_.clear();
+    lastFused_ = nullptr;
 
     State state = initialState.front();
 
@@ -64,6 +68,13 @@ private:
 
     auto xWs = cell_->applyInput({input});
 
+    // run the whole time loop as one operation if the cell supports it
+    auto fused = cell_->applySequence(
+        xWs, state, mask, direction_ == dir::backward, lastFused_);
+    if(fused)
+      return fused;
+    lastFused_ = nullptr;
+
     size_t timeSteps = input->shape()[-3];
 
     States outputs;
@@ -92,10 +103,11 @@ private:
 
     last_.push_back(outputs.back());
 
-    return outputs;
+    // @TODO: benchmark whether this concatenation is a good idea
+    return outputs.outputs();
   }
 
-  States apply(const Expr input, const Expr mask = nullptr) {
+  Expr apply(const Expr input, const Expr mask = nullptr) {
     auto graph = input->graph();
 
     int dimBatch = input->shape()[-2];
@@ -115,20 +127,25 @@ private:
 public:
   friend RNN;
 
-  // @TODO: benchmark whether this concatenation is a good idea
   virtual Expr transduce(Expr input, Expr mask = nullptr) {
-    return apply(input, mask).outputs();
+    return apply(input, mask);
   }
 
   virtual Expr transduce(Expr input, States states, Expr mask = nullptr) {
-    return apply(input, states, mask).outputs();
+    return apply(input, states, mask);
   }
 
   virtual Expr transduce(Expr input, State state, Expr mask = nullptr) {
-    return apply(input, States({state}), mask).outputs();
+    return apply(input, States({state}), mask);
   }
 
-  States lastCellStates() { return last_; }
+  States lastCellStates() {
+    if(lastFused_) {
+      last_.push_back(lastFused_());
+      lastFused_ = nullptr;
+    }
+    return last_;
+  }
 
   void push_back(Ptr<Cell> cell) { cell_ = cell; }
 
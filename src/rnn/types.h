@@ -158,6 +158,23 @@ public:
   virtual std::vector<Expr> applyInput(std::vector<Expr> inputs) = 0;
   virtual State applyState(std::vector<Expr>, State, Expr = nullptr) = 0;
 
+  /**
+   * @brief Runs the recurrence over all time steps of the mapped inputs from
+   * applyInput() as a single operation.
+   *
+   * Returns the outputs of all time steps along axis -3 and sets last to a
+   * function extracting the state at the last time step. Returns nullptr if
+   * the cell cannot fuse the time loop, which then has to be unrolled with
+   * applyState().
+   */
+  virtual Expr applySequence(std::vector<Expr> /*xWs*/,
+                             State /*state*/,
+                             Expr /*mask*/,
+                             bool /*reverse*/,
+                             std::function<State()>& /*last*/) {
+    return nullptr;
+  }
+
   virtual void clear() {}
 };
 
@@ -238,6 +255,18 @@ public:
     return hidden;
   };
 
+  virtual Expr applySequence(std::vector<Expr> mappedInputs,
+                             State state,
+                             Expr mask,
+                             bool reverse,
+                             std::function<State()>& last) {
+    // only a single cell without transitions or inputs can be fused
+    if(stackables_.size() != 1)
+      return nullptr;
+    return stackables_[0]->as<Cell>()->applySequence(
+        mappedInputs, state, mask, reverse, last);
+  }
+
   Ptr<Stackable> operator[](int i) { return stackables_[i]; }
 
   Ptr<Stackable> at(int i) { return stackables_[i]; }
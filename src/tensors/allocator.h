@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
 #include <memory>
@@ -73,6 +74,7 @@ private:
   size_t step_{128 * 1024 * 1024};
   size_t alignment_{256};
   bool throw_{false};
+  size_t peak_{0};
 
   std::set<Gap> gaps_;
   std::unordered_map<uint8_t*, Ptr<MemoryPiece>> allocated_;
@@ -151,6 +153,8 @@ public:
 
   void throwAtReallocation(bool throwRealloc) { throw_ = throwRealloc; }
 
+  bool throwsAtReallocation() const { return throw_; }
+
   void reserve(size_t bytes) {
     bytes = align(bytes);
     if(bytes > 0)
@@ -180,6 +184,7 @@ public:
     auto ptr = gap.data();
     auto mp = New<MemoryPiece>(ptr, bytes);
     allocated_[ptr] = mp;
+    peak_ = std::max(peak_, size() - available_);
     return mp;
   }
 
@@ -210,6 +215,7 @@ public:
 
   void clear() {
     available_ = 0;
+    peak_ = 0;
     gaps_.clear();
     allocated_.clear();
     insertGap({device_->data(), device_->size()}, false);
@@ -223,6 +229,9 @@ public:
 
   size_t available() { return available_; }
 
+  /** Largest number of bytes allocated at once since the last clear(). */
+  size_t peak() { return peak_; }
+
   DeviceId getDevice() { return device_->getDevice(); }
 };
 }
@@ -0,0 +1,175 @@
+#include "tensors/tensor_operators.h"
+#include "tensors/cpu/simd.h"
+
+namespace marian {
+namespace cpu {
+
+namespace {
+
+// Runs step.apply<V>(i) for all vectors of a tensor of the given size and
+// step.apply<float>(i) for the remaining elements, so every element is read
+// and written exactly once. The graph groups already update their shards on
+// separate threads, so a shard is processed by a single thread.
+template <class Step>
+void forEachElement(const Step& step, size_t size) {
+  size_t i = 0;
+  for(; i + simd::width <= size; i += simd::width)
+    step.template apply<simd::vfloat>(i);
+  for(; i < size; ++i)
+    step.template apply<float>(i);
+}
+
+// avg = (1 - decay) * avg + decay * params
+template <typename V>
+inline void smooth(float* avg, V params, float decay) {
+  using namespace simd;
+  store(avg,
+        fmadd(constant<V>(1.f - decay),
+              load<V>(avg),
+              mul(constant<V>(decay), params)));
+}
+
+struct SgdStep {
+  float* params;
+  const float* grads;
+  float* avg;
+  float eta;
+  float decay;
+
+  template <typename V>
+  inline void apply(size_t i) const {
+    using namespace simd;
+    V p = load<V>(params + i);
+    p = sub(p, mul(constant<V>(eta), load<V>(grads + i)));
+    store(params + i, p);
+    if(avg)
+      smooth(avg + i, p, decay);
+  }
+};
+
+struct AdagradStep {
+  float* params;
+  const float* grads;
+  float* gt;
+  float* avg;
+  float gradFactor;
+  float eta;
+  float eps;
+  float decay;
+
+  template <typename V>
+  inline void apply(size_t i) const {
+    using namespace simd;
+    V g = mul(constant<V>(gradFactor), load<V>(grads + i));
+    V s = fmadd(g, g, load<V>(gt + i));
+    store(gt + i, s);
+
+    V p = load<V>(params + i);
+    p = sub(p, div(mul(constant<V>(eta), g), add(sqrt(s), constant<V>(eps))));
+    store(params + i, p);
+    if(avg)
+      smooth(avg + i, p, decay);
+  }
+};
+
+struct AdamStep {
+  float* params;
+  const float* grads;
+  float* mt;
+  float* vt;
+  float* avg;
+  float gradFactor;
+  float eta;
+  float beta1;
+  float beta2;
+  float denom1;
+  float denom2;
+  float eps;
+  float decay;
+
+  template <typename V>
+  inline void apply(size_t i) const {
+    using namespace simd;
+    V g = mul(constant<V>(gradFactor), load<V>(grads + i));
+    V m = fmadd(constant<V>(beta1),
+                load<V>(mt + i),
+                mul(constant<V>(1.f - beta1), g));
+    V v = fmadd(constant<V>(beta2),
+                load<V>(vt + i),
+                mul(constant<V>(1.f - beta2), mul(g, g)));
+    store(mt + i, m);
+    store(vt + i, v);
+
+    V p = load<V>(params + i);
+    V update = div(mul(constant<V>(eta), div(m, constant<V>(denom1))),
+                   add(sqrt(div(v, constant<V>(denom2))), constant<V>(eps)));
+    p = sub(p, update);
+    store(params + i, p);
+    if(avg)
+      smooth(avg + i, p, decay);
+  }
+};
+
+float* dataOrNull(Tensor t) {
+  return t ? t->data() : nullptr;
+}
+}
+
+void SgdUpdate(Tensor params,
+               Tensor grads,
+               Tensor paramsAvg,
+               float eta,
+               float decay) {
+  SgdStep step{params->data(), grads->data(), dataOrNull(paramsAvg), eta, decay};
+  forEachElement(step, params->size());
+}
+
+void AdagradUpdate(Tensor params,
+                   Tensor grads,
+                   Tensor gt,
+                   Tensor paramsAvg,
+                   float gradFactor,
+                   float eta,
+                   float eps,
+                   float decay) {
+  AdagradStep step{params->data(),
+                   grads->data(),
+                   gt->data(),
+                   dataOrNull(paramsAvg),
+                   gradFactor,
+                   eta,
+                   eps,
+                   decay};
+  forEachElement(step, params->size());
+}
+
+void AdamUpdate(Tensor params,
+                Tensor grads,
+                Tensor mt,
+                Tensor vt,
+                Tensor paramsAvg,
+                float gradFactor,
+                float eta,
+                float beta1,
+                float beta2,
+                float denom1,
+                float denom2,
+                float eps,
+                float decay) {
+  AdamStep step{params->data(),
+                grads->data(),
+                mt->data(),
+                vt->data(),
+                dataOrNull(paramsAvg),
+                gradFactor,
+                eta,
+                beta1,
+                beta2,
+                denom1,
+                denom2,
+                eps,
+                decay};
+  forEachElement(step, params->size());
+}
+}
+}
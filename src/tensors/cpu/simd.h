@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace marian {
+namespace cpu {
+
+/**
+ * @brief Vector math for the CPU kernels.
+ *
+ * The widest vector type the compiler targets is selected at compile time:
+ * AVX-512 with 16 floats, AVX2 with 8 floats, or plain floats otherwise.
+ * Since Marian is compiled with -march=native, this is also the widest type
+ * of the machine it runs on. All primitives are overloaded for float as
+ * well, so the loop remainders of a kernel use the same approximations as
+ * the vectorized part.
+ *
+ * exp is evaluated with the polynomial approximation of the Cephes library,
+ * tanh with the rational approximation of Eigen. With vectors, exp has a
+ * relative error below 3e-7 and tanh an absolute error below 3e-7. The scalar versions are less accurate (about
+ * 5e-6 relative error for exp) since -Ofast may reorder the range reduction.
+ */
+namespace simd {
+
+#if defined(__AVX512F__)
+
+typedef __m512 vfloat;
+static const int width = 16;
+
+inline vfloat load(const float* p) { return _mm512_loadu_ps(p); }
+inline void store(float* p, vfloat x) { _mm512_storeu_ps(p, x); }
+inline vfloat set1(float x) { return _mm512_set1_ps(x); }
+
+inline vfloat add(vfloat x, vfloat y) { return _mm512_add_ps(x, y); }
+inline vfloat sub(vfloat x, vfloat y) { return _mm512_sub_ps(x, y); }
+inline vfloat mul(vfloat x, vfloat y) { return _mm512_mul_ps(x, y); }
+inline vfloat div(vfloat x, vfloat y) { return _mm512_div_ps(x, y); }
+inline vfloat fmadd(vfloat x, vfloat y, vfloat z) {
+  return _mm512_fmadd_ps(x, y, z);
+}
+inline vfloat max(vfloat x, vfloat y) { return _mm512_max_ps(x, y); }
+inline vfloat min(vfloat x, vfloat y) { return _mm512_min_ps(x, y); }
+inline vfloat sqrt(vfloat x) { return _mm512_sqrt_ps(x); }
+
+inline vfloat floor(vfloat x) {
+  return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+// 2^n for integral n in the range of normal exponents
+inline vfloat pow2n(vfloat n) {
+  __m512i e = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+}
+
+inline vfloat abs(vfloat x) {
+  return _mm512_castsi512_ps(_mm512_and_si512(
+      _mm512_castps_si512(x), _mm512_set1_epi32(0x7fffffff)));
+}
+
+// |x| with the sign of y
+inline vfloat copysign(vfloat x, vfloat y) {
+  __m512i sign = _mm512_and_si512(_mm512_castps_si512(y),
+                                  _mm512_set1_epi32(0x80000000));
+  return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(x), sign));
+}
+
+inline float sum(vfloat x) { return _mm512_reduce_add_ps(x); }
+inline float max(vfloat x) { return _mm512_reduce_max_ps(x); }
+
+#elif defined(__AVX2__)
+
+typedef __m256 vfloat;
+static const int width = 8;
+
+inline vfloat load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, vfloat x) { _mm256_storeu_ps(p, x); }
+inline vfloat set1(float x) { return _mm256_set1_ps(x); }
+
+inline vfloat add(vfloat x, vfloat y) { return _mm256_add_ps(x, y); }
+inline vfloat sub(vfloat x, vfloat y) { return _mm256_sub_ps(x, y); }
+inline vfloat mul(vfloat x, vfloat y) { return _mm256_mul_ps(x, y); }
+inline vfloat div(vfloat x, vfloat y) { return _mm256_div_ps(x, y); }
+inline vfloat fmadd(vfloat x, vfloat y, vfloat z) {
+#ifdef __FMA__
+  return _mm256_fmadd_ps(x, y, z);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(x, y), z);
+#endif
+}
+inline vfloat max(vfloat x, vfloat y) { return _mm256_max_ps(x, y); }
+inline vfloat min(vfloat x, vfloat y) { return _mm256_min_ps(x, y); }
+inline vfloat sqrt(vfloat x) { return _mm256_sqrt_ps(x); }
+
+inline vfloat floor(vfloat x) { return _mm256_floor_ps(x); }
+
+// 2^n for integral n in the range of normal exponents
+inline vfloat pow2n(vfloat n) {
+  __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+}
+
+inline vfloat abs(vfloat x) {
+  return _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+}
+
+// |x| with the sign of y
+inline vfloat copysign(vfloat x, vfloat y) {
+  vfloat sign = _mm256_and_ps(
+      y, _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000)));
+  return _mm256_or_ps(x, sign);
+}
+
+inline float sum(vfloat x) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_movehdup_ps(s));
+  return _mm_cvtss_f32(s);
+}
+
+inline float max(vfloat x) {
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_movehdup_ps(m));
+  return _mm_cvtss_f32(m);
+}
+
+#else
+
+typedef float vfloat;
+static const int width = 1;
+
+inline float load(const float* p) { return *p; }
+
+#endif
+
+// Scalar primitives, used for loop remainders and if there are no vectors
+
+inline void store(float* p, float x) { *p = x; }
+inline float add(float x, float y) { return x + y; }
+inline float sub(float x, float y) { return x - y; }
+inline float mul(float x, float y) { return x * y; }
+inline float div(float x, float y) { return x / y; }
+inline float fmadd(float x, float y, float z) { return x * y + z; }
+inline float max(float x, float y) { return x > y ? x : y; }
+inline float min(float x, float y) { return x < y ? x : y; }
+inline float sqrt(float x) { return std::sqrt(x); }
+
+inline float floor(float x) { return std::floor(x); }
+
+inline float pow2n(float n) {
+  int32_t e = ((int32_t)n + 127) << 23;
+  float y;
+  std::memcpy(&y, &e, sizeof(y));
+  return y;
+}
+
+inline float abs(float x) { return std::fabs(x); }
+inline float copysign(float x, float y) { return std::copysign(x, y); }
+
+inline float sum(float x) { return x; }
+inline float max(float x) { return x; }
+
+template <typename V>
+inline V constant(float x);
+
+template <>
+inline float constant<float>(float x) {
+  return x;
+}
+
+// Loads a vector or a single float, for kernels written once for both
+template <typename V>
+inline V load(const float* p);
+
+template <>
+inline float load<float>(const float* p) {
+  return *p;
+}
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+template <>
+inline vfloat constant<vfloat>(float x) {
+  return set1(x);
+}
+
+template <>
+inline vfloat load<vfloat>(const float* p) {
+  return load(p);
+}
+#endif
+
+/**
+ * @brief e^x, saturated above 88 and clamped below ln(FLT_MIN) = -87.34, so
+ * that it returns about FLT_MIN, the smallest normal float, instead of 0.
+ */
+template <typename V>
+inline V exp(V x) {
+  x = min(x, constant<V>(88.f));
+  x = max(x, constant<V>(-87.3365447504f));
+
+  // e^x = 2^n * e^r with r = x - n * log(2) in [-log(2)/2, log(2)/2]
+  V n = floor(fmadd(x, constant<V>(1.44269504088896341f), constant<V>(0.5f)));
+  x = sub(x, mul(n, constant<V>(0.693359375f)));
+  x = sub(x, mul(n, constant<V>(-2.12194440e-4f)));
+
+  V y = constant<V>(1.9875691500e-4f);
+  y = fmadd(y, x, constant<V>(1.3981999507e-3f));
+  y = fmadd(y, x, constant<V>(8.3334519073e-3f));
+  y = fmadd(y, x, constant<V>(4.1665795894e-2f));
+  y = fmadd(y, x, constant<V>(1.6666665459e-1f));
+  y = fmadd(y, x, constant<V>(5.0000001201e-1f));
+  y = fmadd(y, mul(x, x), add(x, constant<V>(1.f)));
+
+  return mul(y, pow2n(n));
+}
+
+/**
+ * @brief Largest element of an array of n > 0 floats.
+ */
+inline float maxOf(const float* x, int n) {
+  int i = 0;
+  float m = x[0];
+  if(n >= width) {
+    vfloat vm = load(x);
+    for(i = width; i + width <= n; i += width)
+      vm = max(vm, load(x + i));
+    m = max(vm);
+  }
+  for(; i < n; ++i)
+    m = max(m, x[i]);
+  return m;
+}
+
+/**
+ * @brief Sum of an array of n floats.
+ */
+inline float sumOf(const float* x, int n) {
+  int i = 0;
+  float s = 0.f;
+  if(n >= width) {
+    vfloat vs = load(x);
+    for(i = width; i + width <= n; i += width)
+      vs = add(vs, load(x + i));
+    s = sum(vs);
+  }
+  for(; i < n; ++i)
+    s += x[i];
+  return s;
+}
+
+/**
+ * @brief tanh(x) as a rational function of x on [-9, 9], saturated outside.
+ * The coefficients are the ones used by Eigen.
+ */
+template <typename V>
+inline V tanh(V x) {
+  x = min(x, constant<V>(9.f));
+  x = max(x, constant<V>(-9.f));
+  V x2 = mul(x, x);
+
+  V p = constant<V>(-2.76076847742355e-16f);
+  p = fmadd(p, x2, constant<V>(2.00018790482477e-13f));
+  p = fmadd(p, x2, constant<V>(-8.60467152213735e-11f));
+  p = fmadd(p, x2, constant<V>(5.12229709037114e-08f));
+  p = fmadd(p, x2, constant<V>(1.48572235717979e-05f));
+  p = fmadd(p, x2, constant<V>(6.37261928875436e-04f));
+  p = fmadd(p, x2, constant<V>(4.89352455891786e-03f));
+  p = mul(p, x);
+
+  V q = constant<V>(1.19825839466702e-06f);
+  q = fmadd(q, x2, constant<V>(1.18534705686654e-04f));
+  q = fmadd(q, x2, constant<V>(2.26843463243900e-03f));
+  q = fmadd(q, x2, constant<V>(4.89352518554385e-03f));
+
+  return div(p, q);
+}
+}
+}
+}
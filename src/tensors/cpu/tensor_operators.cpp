@@ -5,10 +5,19 @@
 
 #include "tensors/tensor_operators.h"
 #include "tensors/cpu/backend.h"
+#include "tensors/cpu/simd.h"
 
 #include "functional/functional.h"
 #include "functional/tensor.h"
 
+#if MKL_FOUND
+#include <mkl.h>
+#else
+#if BLAS_FOUND
+#include <cblas.h>
+#endif
+#endif
+
 namespace marian {
 
 namespace cpu {
@@ -125,7 +134,8 @@ void Deconcatenate(std::vector<Tensor>& outputs, const Tensor in, int ax) {
 }
 
 // @TODO: optimize this, currently it's quite horrible
-void TransposeND(Tensor out, Tensor in, const std::vector<int>& vAxis) {
+template <bool add>
+void TransposeNDImpl(Tensor out, Tensor in, const std::vector<int>& vAxis) {
   functional::Array<int, functional::Shape::size()> permute;
   int diff = functional::Shape::size() - vAxis.size();
   for(int i = 0; i < permute.size(); ++i)
@@ -146,10 +156,21 @@ void TransposeND(Tensor out, Tensor in, const std::vector<int>& vAxis) {
     gOut.shape().dims(index, oDims);
     for(int i = 0; i < N; ++i)
       pDims[permute[i]] = oDims[i];
-    gOut[index] = gIn[pDims];
+    if(add)
+      gOut[index] += gIn[pDims];
+    else
+      gOut[index] = gIn[pDims];
   }
 }
 
+void TransposeND(Tensor out, Tensor in, const std::vector<int>& vAxis) {
+  TransposeNDImpl<false>(out, in, vAxis);
+}
+
+void TransposeNDGrad(Tensor out, Tensor in, const std::vector<int>& vAxis) {
+  TransposeNDImpl<true>(out, in, vAxis);
+}
+
 void Softmax(Tensor out_, Tensor in_, Tensor mask_) {
   float* out = out_->data();
   const float* in = in_->data();
@@ -158,26 +179,45 @@ void Softmax(Tensor out_, Tensor in_, Tensor mask_) {
   int rows = out_->shape().elements() / out_->shape().back();
   int cols = out_->shape().back();
 
+  // the mask may be broadcast, e.g. over the beam during decoding, so the
+  // row of the mask and its stride along the columns are looked up per row
+  functional::Shape outShape = out_->shape();
+  functional::Shape maskShape = mask ? mask_->shape() : out_->shape();
+  functional::Array<int, functional::Shape::size()> dims;
+  int maskStride = maskShape.back() == 1 ? 0 : 1;
+
   for (int j = 0; j < rows; ++j) {
     float* so = out + j*cols;
     const float* sp = in + j*cols;
-    const float* mp = mask ? mask + j*cols : nullptr;
-
-    float max = sp[0];
-    for (int i = 1; i < cols; ++i) {
-      max = std::max(max, sp[i]);
+    const float* mp = nullptr;
+    if (mask) {
+      outShape.dims(j*cols, dims);
+      mp = mask + maskShape.bindex(dims);
     }
 
-    float sum = 0.f;
-    for (int i = 0; i < cols; ++i) {
-      float ex = !mask || mp[i] ? std::exp(sp[i] - max) : 0.f;
-      so[i] = ex;
-      sum += ex;
-    }
+    float max = simd::maxOf(sp, cols);
 
-    for (int i = 0; i < cols; ++i) {
-      so[i] /= sum;
+    int i = 0;
+    simd::vfloat vmax = simd::constant<simd::vfloat>(max);
+    for (; i + simd::width <= cols; i += simd::width)
+      simd::store(so + i, simd::exp(simd::sub(simd::load(sp + i), vmax)));
+    for (; i < cols; ++i)
+      so[i] = simd::exp(sp[i] - max);
+
+    if (mask) {
+      for (i = 0; i < cols; ++i)
+        if (!mp[i * maskStride])
+          so[i] = 0.f;
     }
+
+    float scale = 1.f / simd::sumOf(so, cols);
+
+    i = 0;
+    simd::vfloat vscale = simd::constant<simd::vfloat>(scale);
+    for (; i + simd::width <= cols; i += simd::width)
+      simd::store(so + i, simd::mul(simd::load(so + i), vscale));
+    for (; i < cols; ++i)
+      so[i] *= scale;
   }
 }
 
@@ -192,22 +232,30 @@ void LogSoftmax(Tensor out_, Tensor in_) {
     float* so = out + j * cols;
     const float* sp = in + j*cols;
 
-    float max = sp[0];
-    for (int i = 1; i < cols; ++i) {
-      max = std::max(max, sp[i]);
-    }
+    float max = simd::maxOf(sp, cols);
 
+    int i = 0;
     float sum = 0.f;
-    for (int i = 0; i < cols; ++i) {
-      float sm = sp[i] - max;
-      float ex = std::exp(sm);
-      so[i] = sm;
-      sum += ex;
-    }
-
-    for (int i = 0; i < cols; ++i) {
-      so[i] -= std::log(sum);
+    simd::vfloat vmax = simd::constant<simd::vfloat>(max);
+    if (cols >= simd::width) {
+      simd::vfloat vsum = simd::constant<simd::vfloat>(0.f);
+      for (; i + simd::width <= cols; i += simd::width)
+        vsum = simd::add(
+            vsum, simd::exp(simd::sub(simd::load(sp + i), vmax)));
+      sum = simd::sum(vsum);
     }
+    for (; i < cols; ++i)
+      sum += simd::exp(sp[i] - max);
+
+    float logSum = std::log(sum);
+
+    i = 0;
+    simd::vfloat vlogSum = simd::constant<simd::vfloat>(logSum);
+    for (; i + simd::width <= cols; i += simd::width)
+      simd::store(so + i,
+                  simd::sub(simd::sub(simd::load(sp + i), vmax), vlogSum));
+    for (; i < cols; ++i)
+      so[i] = (sp[i] - max) - logSum;
   }
 }
 
@@ -355,6 +403,37 @@ void Insert(Tensor out,
   ABORT("Not implemented!");
 }
 
+// One row of the GRU cell: the new state from the previous state, the
+// projected input and the projected previous state
+inline void gruForwardRow(float* rowOut,
+                          const float* rowState,
+                          const float* xWrow,
+                          const float* sUrow,
+                          const float* b,
+                          int cols,
+                          float m,
+                          bool final) {
+  #pragma omp simd
+  for (int i = 0; i < cols; ++i) {
+    // @TODO: stable logit
+    float r = stableLogit(xWrow[i] + sUrow[i] + b[i]);
+
+    int k = i + cols;
+
+    float z = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+
+    int l = i + 2 * cols;
+    float h;
+    if(final)
+      h = std::tanh(xWrow[l] + (sUrow[l] + b[l]) * r);
+    else
+      h = std::tanh(xWrow[l] + sUrow[l] * r + b[l]);
+
+    float out = (1.0f - z) * h + z * rowState[i];
+    rowOut[i] = m * out + (1 - m) * rowState[i];
+  }
+}
+
 void GRUFastForward(Tensor out_, std::vector<Tensor> inputs, bool final) {
   int rows = out_->shape().elements() / out_->shape().back();
   int cols = out_->shape().back();
@@ -370,31 +449,78 @@ void GRUFastForward(Tensor out_, std::vector<Tensor> inputs, bool final) {
   #pragma omp parallel for
   for (int j = 0; j < rows; ++j) {
     float m = !mask || mask[j];
-    float* rowOut = out + j * cols;
-    const float* rowState = state + j * cols;
+    gruForwardRow(out + j * cols,
+                  state + j * cols,
+                  xW + j * cols * 3,
+                  sU + j * cols * 3,
+                  b,
+                  cols,
+                  m,
+                  final);
+  }
+}
 
-    const float* xWrow = xW + j * cols * 3;
-    const float* sUrow = sU + j * cols * 3;
+// Gradients of one row of the GRU cell, accumulated into the non-null outputs.
+// The columns are shared among the threads of an enclosing parallel region, so
+// each thread always accumulates the same columns of the bias gradient.
+inline void gruBackwardRow(float* rowOutState,
+                           float* rowOutXW,
+                           float* rowOutSU,
+                           float* outB,
+                           const float* rowState,
+                           const float* rowXW,
+                           const float* rowSU,
+                           const float* b,
+                           const float* rowAdj,
+                           int cols,
+                           float m,
+                           bool final) {
+  #pragma omp for simd nowait
+  for (int i = 0; i < cols; ++i) {
+    int k = i + cols;
+    int l = i + 2 * cols;
+
+    float r = stableLogit(rowXW[i] + rowSU[i] + b[i]);
+    float z = stableLogit(rowXW[k] + rowSU[k] + b[k]);
+
+    float h;
+    if(final)
+      h = std::tanh(rowXW[l] + (rowSU[l] + b[l]) * r);
+    else
+      h = std::tanh(rowXW[l] + rowSU[l] * r + b[l]);
 
-    #pragma omp simd
-    for (int i = 0; i < cols; ++i) {
-      // @TODO: stable logit
-      float r = stableLogit(xWrow[i] + sUrow[i] + b[i]);
+    float adj = rowAdj[i];
 
-      int k = i + cols;
+    float t = (1-z)*(1-h*h);
 
-      float z = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+    // df/ds
+    if(rowOutState) rowOutState[i] += (m * z - m + 1) * adj;
 
-      int l = i + 2 * cols;
-      float h;
+    // df/d(xW_r) ...
+    float dfdxW_r = m * r * (1 - r) * t * adj;
+    if(final)
+      dfdxW_r *= rowSU[l] + b[l];
+    else
+      dfdxW_r *= rowSU[l];
+    if(rowOutXW) rowOutXW[i] += dfdxW_r;
+    if(rowOutSU) rowOutSU[i] += dfdxW_r;
+    if(outB)  outB[i] += dfdxW_r;
+
+    // df/d(xW_z) ...
+    float dfdxW_z = m * (1 - z) * z * (rowState[i] - h) * adj;
+    if(rowOutXW) rowOutXW[k] += dfdxW_z;
+    if(rowOutSU) rowOutSU[k] += dfdxW_z;
+    if(outB)  outB[k] += dfdxW_z;
+
+    // df/d(xW_x) ...
+    float dfdxW_x = m * t * adj;
+    if(rowOutXW) rowOutXW[l] += dfdxW_x;
+    if(rowOutSU) rowOutSU[l] += dfdxW_x * r;
+    if(outB)
       if(final)
-        h = std::tanh(xWrow[l] + (sUrow[l] + b[l]) * r);
+        outB[l] += dfdxW_x * r;
       else
-        h = std::tanh(xWrow[l] + sUrow[l] * r + b[l]);
-
-      float out = (1.0f - z) * h + z * rowState[i];
-      rowOut[i] = m * out + (1 - m) * rowState[i];
-    }
+        outB[l] += dfdxW_x;
   }
 }
 
@@ -420,63 +546,18 @@ void GRUFastBackward(std::vector<Tensor> outputs,
   #pragma omp parallel
   for (int j = 0; j < rows; ++j) {
     float m = !mask || mask[j];
-
-    float* rowOutState = outState + j * cols;
-    float* rowOutXW = outXW + j * cols * 3;
-    float* rowOutSU = outSU + j * cols * 3;
-
-    const float* rowState = state + j * cols;
-    const float* rowXW = xW + j * cols * 3;
-    const float* rowSU = sU + j * cols * 3;
-    const float* rowAdj = adj + j * cols;
-
-    #pragma omp for simd nowait
-    for (int i = 0; i < cols; ++i) {
-      int k = i + cols;
-      int l = i + 2 * cols;
-
-      float r = stableLogit(rowXW[i] + rowSU[i] + b[i]);
-      float z = stableLogit(rowXW[k] + rowSU[k] + b[k]);
-
-      float h;
-      if(final)
-        h = std::tanh(rowXW[l] + (rowSU[l] + b[l]) * r);
-      else
-        h = std::tanh(rowXW[l] + rowSU[l] * r + b[l]);
-
-      float adj = rowAdj[i];
-
-      float t = (1-z)*(1-h*h);
-
-      // df/ds
-      if(outState) rowOutState[i] += (m * z - m + 1) * adj;
-
-      // df/d(xW_r) ...
-      float dfdxW_r = m * r * (1 - r) * t * adj;
-      if(final)
-        dfdxW_r *= rowSU[l] + b[l];
-      else
-        dfdxW_r *= rowSU[l];
-      if(outXW) rowOutXW[i] += dfdxW_r;
-      if(outSU) rowOutSU[i] += dfdxW_r;
-      if(outB)  outB[i] += dfdxW_r;
-
-      // df/d(xW_z) ...
-      float dfdxW_z = m * (1 - z) * z * (rowState[i] - h) * adj;
-      if(outXW) rowOutXW[k] += dfdxW_z;
-      if(outSU) rowOutSU[k] += dfdxW_z;
-      if(outB)  outB[k] += dfdxW_z;
-
-      // df/d(xW_x) ...
-      float dfdxW_x = m * t * adj;
-      if(outXW) rowOutXW[l] += dfdxW_x;
-      if(outSU) rowOutSU[l] += dfdxW_x * r;
-      if(outB)
-        if(final)
-          outB[l] += dfdxW_x * r;
-        else
-          outB[l] += dfdxW_x;
-    }
+    gruBackwardRow(outState ? outState + j * cols : nullptr,
+                   outXW ? outXW + j * cols * 3 : nullptr,
+                   outSU ? outSU + j * cols * 3 : nullptr,
+                   outB,
+                   state + j * cols,
+                   xW + j * cols * 3,
+                   sU + j * cols * 3,
+                   b,
+                   adj + j * cols,
+                   cols,
+                   m,
+                   final);
   }
 }
 
@@ -576,11 +657,19 @@ void Att(Tensor out_, Tensor va_, Tensor context_, Tensor state_) {
     const float* ctxRow = ctx + (j % (b * t)) * cols;
     const float* stateRow = state + ((j / (b * t)) * b + j % b) * cols;
 
+    int i = 0;
     float sum = 0.f;
-    #pragma omp simd reduction(+:sum)
-    for (size_t i = 0; i < cols; ++i) {
+    if (cols >= simd::width) {
+      simd::vfloat vsum = simd::constant<simd::vfloat>(0.f);
+      for (; i + simd::width <= cols; i += simd::width) {
+        auto z = simd::add(simd::load(ctxRow + i), simd::load(stateRow + i));
+        vsum = simd::fmadd(simd::tanh(z), simd::load(vaRow + i), vsum);
+      }
+      sum = simd::sum(vsum);
+    }
+    for (; i < cols; ++i) {
       float z = ctxRow[i] + stateRow[i];
-      sum += std::tanh(z) * vaRow[i];
+      sum += simd::tanh(z) * vaRow[i];
     }
 
     out[j] = sum;
@@ -613,11 +702,26 @@ void AttBack(Tensor gVa_, Tensor gContext_, Tensor gState_,
 
     float adj_j = adj[j];
 
-    #pragma omp simd
-    for (size_t i = 0; i < k; ++i) {
+    size_t i = 0;
+    simd::vfloat vadj = simd::constant<simd::vfloat>(adj_j);
+    simd::vfloat one = simd::constant<simd::vfloat>(1.f);
+    for (; i + simd::width <= k; i += simd::width) {
+      auto z = simd::add(simd::load(cRow + i), simd::load(sRow + i));
+
+      auto t = simd::tanh(z);
+      auto r = simd::mul(simd::load(va + i),
+                         simd::sub(one, simd::mul(t, t)));
+
+      auto r_adj_j = simd::mul(r, vadj);
+      simd::store(gcRow + i, simd::add(simd::load(gcRow + i), r_adj_j));
+      simd::store(gsRow + i, simd::add(simd::load(gsRow + i), r_adj_j));
+
+      simd::store(gVa + i, simd::fmadd(t, vadj, simd::load(gVa + i)));
+    }
+    for (; i < k; ++i) {
       float z = cRow[i] + sRow[i];
 
-      float t = std::tanh(z);
+      float t = simd::tanh(z);
       float r = va[i] * (1.f - t * t);
 
       float r_adj_j = r * adj_j;
@@ -813,6 +917,44 @@ void SetSparse(float* out,
   }
 }
 
+// One row of the LSTM cell state from the previous cell state, the projected
+// input and the projected previous output
+inline void lstmCellForwardRow(float* rowOut,
+                               const float* rowCell,
+                               const float* xWrow,
+                               const float* sUrow,
+                               const float* b,
+                               int cols,
+                               float m) {
+  for (int i = 0; i < cols; ++i) {
+    float gf = stableLogit(xWrow[i] + sUrow[i] + b[i]);
+
+    int k = i + cols;
+    float gi = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+
+    int l = i + 2*cols;
+    float gc = std::tanh(xWrow[l] + sUrow[l] + b[l]);
+
+    float cout = gf*rowCell[i] + gi*gc;
+    rowOut[i] = m*cout + (1-m)*rowCell[i];
+  }
+}
+
+// One row of the LSTM output from the new cell state
+inline void lstmOutputForwardRow(float* rowOut,
+                                 const float* rowCell,
+                                 const float* xWrow,
+                                 const float* sUrow,
+                                 const float* b,
+                                 int cols) {
+  for (int i = 0; i < cols; ++i) {
+    int k = i + 3*cols;
+    float go = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+
+    rowOut[i] = go * std::tanh(rowCell[i]);
+  }
+}
+
 void LSTMCellForward(Tensor out_, std::vector<Tensor> inputs) {
   int rows = out_->shape().elements() / out_->shape()[-1];
   int cols = out_->shape()[-1];
@@ -826,25 +968,13 @@ void LSTMCellForward(Tensor out_, std::vector<Tensor> inputs) {
 
   for (int j = 0; j < rows; ++j) {
     float m = !mask || mask[j];
-
-    float* rowOut = out + j*cols;
-    const float* rowCell = cell + j*cols;
-
-    const float* xWrow = xW + j*cols*4;
-    const float* sUrow = sU + j*cols*4;
-
-    for (int i = 0; i < cols; ++i) {
-      float gf = stableLogit(xWrow[i] + sUrow[i] + b[i]);
-
-      int k = i + cols;
-      float gi = stableLogit(xWrow[k] + sUrow[k] + b[k]);
-
-      int l = i + 2*cols;
-      float gc = std::tanh(xWrow[l] + sUrow[l] + b[l]);
-
-      float cout = gf*rowCell[i] + gi*gc;
-      rowOut[i] = m*cout + (1-m)*rowCell[i];
-    }
+    lstmCellForwardRow(out + j*cols,
+                       cell + j*cols,
+                       xW + j*cols*4,
+                       sU + j*cols*4,
+                       b,
+                       cols,
+                       m);
   }
 }
 
@@ -859,18 +989,94 @@ void LSTMOutputForward(Tensor out_, std::vector<Tensor> inputs) {
   const float* b = inputs[3]->data();
 
   for (int j = 0; j <rows; ++j) {
-    float* rowOut = out + j*cols;
-    const float* rowCell = cell + j*cols;
+    lstmOutputForwardRow(out + j*cols,
+                         cell + j*cols,
+                         xW + j*cols*4,
+                         sU + j*cols*4,
+                         b,
+                         cols);
+  }
+}
 
-    const float* xWrow = xW + j*cols*4;
-    const float* sUrow = sU + j*cols*4;
+// Gradients of one row of the LSTM cell state, accumulated into the non-null
+// outputs
+inline void lstmCellBackwardRow(float* rowOutCell,
+                                float* rowOutXW,
+                                float* rowOutSU,
+                                float* outB,
+                                const float* rowCell,
+                                const float* xWrow,
+                                const float* sUrow,
+                                const float* b,
+                                const float* rowAdj,
+                                int cols,
+                                float m) {
+  for (int i = 0; i < cols; ++i) {
+    float gf = stableLogit(xWrow[i] + sUrow[i] + b[i]);
+
+    int k = i + cols;
+    float gi = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+
+    int l = i + 2*cols;
+    float gc = std::tanh(xWrow[l] + sUrow[l] + b[l]);
+
+    float adj = rowAdj[i];
+
+    // dc/dx_{t-1}
+    if (rowOutCell) {
+      rowOutCell[i] += (m*gf - m + 1)*adj;
+    }
 
-    for (int i = 0; i < cols; ++i) {
-      int k = i + 3*cols;
-      float go = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+    // dc/d(b_f) = dc/d(xW_f) ...
+    float dcdxf = m*rowCell[i] * gf*(1-gf) * adj;
+    if (rowOutXW) { rowOutXW[i] += dcdxf; }
+    if (rowOutSU) { rowOutSU[i] += dcdxf; }
+    if (outB) { outB[i] += dcdxf; }
+
+    // dc/d(b_i) ...
+    float dcdb_i = m * gc * gi*(1-gi) * adj;
+    if (rowOutXW) { rowOutXW[k] += dcdb_i; }
+    if (rowOutSU) { rowOutSU[k] += dcdb_i; }
+    if (outB) { outB[k] += dcdb_i; }
+
+    // dc/d(b_c) ...
+    float dcdxc = m * gi * (1 - gc*gc) * adj;
+    if (rowOutXW) { rowOutXW[l] += dcdxc; }
+    if (rowOutSU) { rowOutSU[l] += dcdxc; }
+    if (outB) { outB[l] += dcdxc; }
+  }
+}
 
-      rowOut[i] = go * std::tanh(rowCell[i]);
+// Gradients of one row of the LSTM output, accumulated into the non-null
+// outputs
+inline void lstmOutputBackwardRow(float* rowOutCell,
+                                  float* rowOutXW,
+                                  float* rowOutSU,
+                                  float* outB,
+                                  const float* rowCell,
+                                  const float* xWrow,
+                                  const float* sUrow,
+                                  const float* b,
+                                  const float* rowAdj,
+                                  int cols) {
+  for (int i = 0; i < cols; ++i) {
+    int k = i + 3*cols;
+    float go = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+
+    float t = std::tanh(rowCell[i]);
+
+    float adj = rowAdj[i];
+
+    // dc/dc_{t-1}
+    if (rowOutCell) {
+      rowOutCell[i] += go * (1 - t*t) * adj;
     }
+
+    // dc/d(b_o) = dc/d(xW_f) ...
+    float dcdxo = t * go*(1-go) * adj;
+    if (rowOutXW) { rowOutXW[k] += dcdxo; }
+    if (rowOutSU) { rowOutSU[k] += dcdxo; }
+    if (outB) { outB[k] += dcdxo; }
   }
 }
 
@@ -895,51 +1101,17 @@ void LSTMCellBackward(std::vector<Tensor> outputs,
 
   for (int j = 0; j <rows; ++j) {
     float m = !mask || mask[j];
-
-    float* rowOutCell = outCell + j*cols;
-    float* rowOutXW = outXW + j*cols*4;
-    float* rowOutSU = outSU + j*cols*4;
-
-    const float* rowCell = cell + j*cols;
-    const float* xWrow = xW + j*cols*4;
-    const float* sUrow = sU + j*cols*4;
-
-    const float* rowAdj = adj + j*cols;
-
-    for (int i = 0; i < cols; ++i) {
-      float gf = stableLogit(xWrow[i] + sUrow[i] + b[i]);
-
-      int k = i + cols;
-      float gi = stableLogit(xWrow[k] + sUrow[k] + b[k]);
-
-      int l = i + 2*cols;
-      float gc = std::tanh(xWrow[l] + sUrow[l] + b[l]);
-
-      float adj = rowAdj[i];
-
-      // dc/dx_{t-1}
-      if (outCell) {
-        rowOutCell[i] += (m*gf - m + 1)*adj;
-      }
-
-      // dc/d(b_f) = dc/d(xW_f) ...
-      float dcdxf = m*rowCell[i] * gf*(1-gf) * adj;
-      if (outXW) { rowOutXW[i] += dcdxf; }
-      if (outSU) { rowOutSU[i] += dcdxf; }
-      if (outB) { outB[i] += dcdxf; }
-
-      // dc/d(b_i) ...
-      float dcdb_i = m * gc * gi*(1-gi) * adj;
-      if (outXW) { rowOutXW[k] += dcdb_i; }
-      if (outSU) { rowOutSU[k] += dcdb_i; }
-      if (outB) { outB[k] += dcdb_i; }
-
-      // dc/d(b_c) ...
-      float dcdxc = m * gi * (1 - gc*gc) * adj;
-      if (outXW) { rowOutXW[l] += dcdxc; }
-      if (outSU) { rowOutSU[l] += dcdxc; }
-      if (outB) { outB[l] += dcdxc; }
-    }
+    lstmCellBackwardRow(outCell ? outCell + j*cols : nullptr,
+                        outXW ? outXW + j*cols*4 : nullptr,
+                        outSU ? outSU + j*cols*4 : nullptr,
+                        outB,
+                        cell + j*cols,
+                        xW + j*cols*4,
+                        sU + j*cols*4,
+                        b,
+                        adj + j*cols,
+                        cols,
+                        m);
   }
 }
 
@@ -962,35 +1134,312 @@ void LSTMOutputBackward(std::vector<Tensor> outputs,
   const float* adj = adj_->data();
 
   for (int j = 0; j < rows; ++j) {
-    float* rowOutCell = outCell + j*cols;
-    float* rowOutXW = outXW + j*cols*4;
-    float* rowOutSU = outSU + j*cols*4;
+    lstmOutputBackwardRow(outCell ? outCell + j*cols : nullptr,
+                          outXW ? outXW + j*cols*4 : nullptr,
+                          outSU ? outSU + j*cols*4 : nullptr,
+                          outB,
+                          cell + j*cols,
+                          xW + j*cols*4,
+                          sU + j*cols*4,
+                          b,
+                          adj + j*cols,
+                          cols);
+  }
+}
 
-    const float* rowCell = cell + j*cols;
-    const float* xWrow = xW + j*cols*4;
-    const float* sUrow = sU + j*cols*4;
+// C = op(A) * op(B) + beta * C for row-major matrices, where op(A) is m x k
+// and op(B) is k x n
+inline void sgemm(bool transA,
+                  bool transB,
+                  int m,
+                  int n,
+                  int k,
+                  const float* A,
+                  const float* B,
+                  float beta,
+                  float* C) {
+#if BLAS_FOUND
+  cblas_sgemm(CblasRowMajor,
+              transA ? CblasTrans : CblasNoTrans,
+              transB ? CblasTrans : CblasNoTrans,
+              m, n, k,
+              1.f,
+              A,
+              transA ? m : k,
+              B,
+              transB ? k : n,
+              beta,
+              C,
+              n);
+#else
+  ABORT("Not implemented!");
+#endif
+}
 
-    const float* rowAdj = adj + j*cols;
+/*
+ * The sequence kernels below run the recurrence of a layer over all time
+ * steps. The input projections xW of all steps are computed beforehand, so
+ * each step is a single matrix product of the previous states with the same
+ * recurrent matrix U, which stays in cache, followed by the element-wise cell.
+ * Time steps are stored along the outermost axis, processed from last to
+ * first if reverse is set, and the backward pass recomputes the recurrent
+ * projections instead of storing them.
+ */
 
-    for (int i = 0; i < cols; ++i) {
-      int k = i + 3*cols;
-      float go = stableLogit(xWrow[k] + sUrow[k] + b[k]);
+void GRUSequenceForward(Tensor out_,
+                        std::vector<Tensor> inputs,
+                        bool final,
+                        bool reverse) {
+  int cols = out_->shape()[-1];
+  int dimBatch = out_->shape()[-2];
+  int stepSize = dimBatch * cols;
+  int steps = out_->shape().elements() / stepSize;
 
-      float t = std::tanh(rowCell[i]);
+  float* out = out_->data();
 
-      float adj = rowAdj[i];
+  const float* state = inputs[0]->data();
+  const float* xW = inputs[1]->data();
+  const float* U = inputs[2]->data();
+  const float* b = inputs[3]->data();
+  const float* mask = inputs.size() > 4 ? inputs[4]->data() : nullptr;
 
-      // dc/dc_{t-1}
-      if (outCell) {
-        rowOutCell[i] += go * (1 - t*t) * adj;
-      }
+  std::vector<float> sU(dimBatch * cols * 3);
+
+  for (int i = 0; i < steps; ++i) {
+    int t = reverse ? steps - i - 1 : i;
+    const float* prev = i == 0 ? state : out + (reverse ? t + 1 : t - 1) * stepSize;
+
+    sgemm(false, false, dimBatch, 3 * cols, cols, prev, U, 0.f, sU.data());
+
+    #pragma omp parallel for
+    for (int j = 0; j < dimBatch; ++j) {
+      int row = t * dimBatch + j;
+      float m = !mask || mask[row];
+      gruForwardRow(out + row * cols,
+                    prev + j * cols,
+                    xW + row * cols * 3,
+                    sU.data() + j * cols * 3,
+                    b,
+                    cols,
+                    m,
+                    final);
+    }
+  }
+}
+
+void GRUSequenceBackward(std::vector<Tensor> outputs,
+                         std::vector<Tensor> inputs,
+                         Tensor val_,
+                         Tensor adj_,
+                         bool final,
+                         bool reverse) {
+  int cols = adj_->shape()[-1];
+  int dimBatch = adj_->shape()[-2];
+  int stepSize = dimBatch * cols;
+  int steps = adj_->shape().elements() / stepSize;
+
+  float* outState = outputs[0] ? outputs[0]->data() : nullptr;
+  float* outXW = outputs[1] ? outputs[1]->data() : nullptr;
+  float* outU = outputs[2] ? outputs[2]->data() : nullptr;
+  float* outB = outputs[3] ? outputs[3]->data() : nullptr;
+
+  const float* state = inputs[0]->data();
+  const float* xW = inputs[1]->data();
+  const float* U = inputs[2]->data();
+  const float* b = inputs[3]->data();
+  const float* mask = inputs.size() > 4 ? inputs[4]->data() : nullptr;
+  const float* val = val_->data();
+  const float* adj = adj_->data();
 
-      // dc/d(b_o) = dc/d(xW_f) ...
-      float dcdxo = t * go*(1-go) * adj;
-      if (outXW) { rowOutXW[k] += dcdxo; }
-      if (outSU) { rowOutSU[k] += dcdxo; }
-      if (outB) { outB[k] += dcdxo; }
+  std::vector<float> sU(dimBatch * cols * 3);
+  std::vector<float> adjSU(dimBatch * cols * 3);
+  std::vector<float> adjStep(stepSize);
+  std::vector<float> adjPrev(stepSize);
+  // gradient flowing into the states of the previous step
+  std::vector<float> carry(stepSize, 0.f);
+
+  for (int i = steps - 1; i >= 0; --i) {
+    int t = reverse ? steps - i - 1 : i;
+    const float* prev = i == 0 ? state : val + (reverse ? t + 1 : t - 1) * stepSize;
+
+    sgemm(false, false, dimBatch, 3 * cols, cols, prev, U, 0.f, sU.data());
+
+    for (int k = 0; k < stepSize; ++k)
+      adjStep[k] = adj[t * stepSize + k] + carry[k];
+    std::fill(adjSU.begin(), adjSU.end(), 0.f);
+    std::fill(adjPrev.begin(), adjPrev.end(), 0.f);
+
+    #pragma omp parallel
+    for (int j = 0; j < dimBatch; ++j) {
+      int row = t * dimBatch + j;
+      float m = !mask || mask[row];
+      gruBackwardRow(adjPrev.data() + j * cols,
+                     outXW ? outXW + row * cols * 3 : nullptr,
+                     adjSU.data() + j * cols * 3,
+                     outB,
+                     prev + j * cols,
+                     xW + row * cols * 3,
+                     sU.data() + j * cols * 3,
+                     b,
+                     adjStep.data() + j * cols,
+                     cols,
+                     m,
+                     final);
     }
+
+    if(outU)
+      sgemm(true, false, cols, 3 * cols, dimBatch, prev, adjSU.data(), 1.f, outU);
+    sgemm(false, true, dimBatch, cols, 3 * cols, adjSU.data(), U, 1.f, adjPrev.data());
+
+    carry.swap(adjPrev);
+  }
+
+  if(outState)
+    for (int k = 0; k < stepSize; ++k)
+      outState[k] += carry[k];
+}
+
+void LSTMSequenceForward(Tensor out_, std::vector<Tensor> inputs, bool reverse) {
+  int cols = out_->shape()[-1];
+  int dimBatch = out_->shape()[-2];
+  int stepSize = dimBatch * cols;
+  int steps = out_->shape()[-3];
+
+  // outputs of all steps followed by the cell states of all steps
+  float* outH = out_->data();
+  float* outC = outH + steps * stepSize;
+
+  const float* output = inputs[0]->data();
+  const float* cell = inputs[1]->data();
+  const float* xW = inputs[2]->data();
+  const float* U = inputs[3]->data();
+  const float* b = inputs[4]->data();
+  const float* mask = inputs.size() > 5 ? inputs[5]->data() : nullptr;
+
+  std::vector<float> sU(dimBatch * cols * 4);
+
+  for (int i = 0; i < steps; ++i) {
+    int t = reverse ? steps - i - 1 : i;
+    int p = reverse ? t + 1 : t - 1;
+    const float* prevH = i == 0 ? output : outH + p * stepSize;
+    const float* prevC = i == 0 ? cell : outC + p * stepSize;
+
+    sgemm(false, false, dimBatch, 4 * cols, cols, prevH, U, 0.f, sU.data());
+
+    #pragma omp parallel for
+    for (int j = 0; j < dimBatch; ++j) {
+      int row = t * dimBatch + j;
+      float m = !mask || mask[row];
+      lstmCellForwardRow(outC + row * cols,
+                         prevC + j * cols,
+                         xW + row * cols * 4,
+                         sU.data() + j * cols * 4,
+                         b,
+                         cols,
+                         m);
+      lstmOutputForwardRow(outH + row * cols,
+                           outC + row * cols,
+                           xW + row * cols * 4,
+                           sU.data() + j * cols * 4,
+                           b,
+                           cols);
+    }
+  }
+}
+
+void LSTMSequenceBackward(std::vector<Tensor> outputs,
+                          std::vector<Tensor> inputs,
+                          Tensor val_,
+                          Tensor adj_,
+                          bool reverse) {
+  int cols = adj_->shape()[-1];
+  int dimBatch = adj_->shape()[-2];
+  int stepSize = dimBatch * cols;
+  int steps = adj_->shape()[-3];
+
+  float* outOutput = outputs[0] ? outputs[0]->data() : nullptr;
+  float* outCell = outputs[1] ? outputs[1]->data() : nullptr;
+  float* outXW = outputs[2] ? outputs[2]->data() : nullptr;
+  float* outU = outputs[3] ? outputs[3]->data() : nullptr;
+  float* outB = outputs[4] ? outputs[4]->data() : nullptr;
+
+  const float* output = inputs[0]->data();
+  const float* cell = inputs[1]->data();
+  const float* xW = inputs[2]->data();
+  const float* U = inputs[3]->data();
+  const float* b = inputs[4]->data();
+  const float* mask = inputs.size() > 5 ? inputs[5]->data() : nullptr;
+
+  const float* valH = val_->data();
+  const float* valC = valH + steps * stepSize;
+  const float* adjH = adj_->data();
+  const float* adjC = adjH + steps * stepSize;
+
+  std::vector<float> sU(dimBatch * cols * 4);
+  std::vector<float> adjSU(dimBatch * cols * 4);
+  std::vector<float> adjStepH(stepSize);
+  std::vector<float> adjStepC(stepSize);
+  std::vector<float> adjPrevH(stepSize);
+  std::vector<float> adjPrevC(stepSize);
+  // gradients flowing into the outputs and cell states of the previous step
+  std::vector<float> carryH(stepSize, 0.f);
+  std::vector<float> carryC(stepSize, 0.f);
+
+  for (int i = steps - 1; i >= 0; --i) {
+    int t = reverse ? steps - i - 1 : i;
+    int p = reverse ? t + 1 : t - 1;
+    const float* prevH = i == 0 ? output : valH + p * stepSize;
+    const float* prevC = i == 0 ? cell : valC + p * stepSize;
+
+    sgemm(false, false, dimBatch, 4 * cols, cols, prevH, U, 0.f, sU.data());
+
+    for (int k = 0; k < stepSize; ++k) {
+      adjStepH[k] = adjH[t * stepSize + k] + carryH[k];
+      adjStepC[k] = adjC[t * stepSize + k] + carryC[k];
+    }
+    std::fill(adjSU.begin(), adjSU.end(), 0.f);
+    std::fill(adjPrevC.begin(), adjPrevC.end(), 0.f);
+
+    for (int j = 0; j < dimBatch; ++j) {
+      int row = t * dimBatch + j;
+      float m = !mask || mask[row];
+      // the output adds to the gradient of the new cell state first
+      lstmOutputBackwardRow(adjStepC.data() + j * cols,
+                            outXW ? outXW + row * cols * 4 : nullptr,
+                            adjSU.data() + j * cols * 4,
+                            outB,
+                            valC + row * cols,
+                            xW + row * cols * 4,
+                            sU.data() + j * cols * 4,
+                            b,
+                            adjStepH.data() + j * cols,
+                            cols);
+      lstmCellBackwardRow(adjPrevC.data() + j * cols,
+                          outXW ? outXW + row * cols * 4 : nullptr,
+                          adjSU.data() + j * cols * 4,
+                          outB,
+                          prevC + j * cols,
+                          xW + row * cols * 4,
+                          sU.data() + j * cols * 4,
+                          b,
+                          adjStepC.data() + j * cols,
+                          cols,
+                          m);
+    }
+
+    if(outU)
+      sgemm(true, false, cols, 4 * cols, dimBatch, prevH, adjSU.data(), 1.f, outU);
+    sgemm(false, true, dimBatch, cols, 4 * cols, adjSU.data(), U, 0.f, adjPrevH.data());
+
+    carryH.swap(adjPrevH);
+    carryC.swap(adjPrevC);
+  }
+
+  for (int k = 0; k < stepSize; ++k) {
+    if(outOutput)
+      outOutput[k] += carryH[k];
+    if(outCell)
+      outCell[k] += carryC[k];
   }
 }
 
@@ -166,6 +166,7 @@ void Deconcatenate(std::vector<Tensor>& outputs, const Tensor in, int ax) {
     SplitCont(outputs, in, ax);
 }
 
+template <bool add>
 __global__ void gTransposeND(functional::Tensor<float> out,
                              const functional::Tensor<float> in,
                              const functional::Array<int, functional::Shape::size()> permute) {
@@ -181,12 +182,16 @@ __global__ void gTransposeND(functional::Tensor<float> out,
       out.shape().dims(index, oDims);
       for(int i = 0; i < N; ++i)
         pDims[permute[i]] = oDims[i];
-      out[index] = in[pDims];
+      if(add)
+        out[index] += in[pDims];
+      else
+        out[index] = in[pDims];
     }
   }
 }
 
-void TransposeND(Tensor out, Tensor in, const std::vector<int>& vAxis) {
+template <bool add>
+void TransposeNDImpl(Tensor out, Tensor in, const std::vector<int>& vAxis) {
   cudaSetDevice(out->getDevice().no);
 
   functional::Array<int, functional::Shape::size()> axes;
@@ -201,7 +206,15 @@ void TransposeND(Tensor out, Tensor in, const std::vector<int>& vAxis) {
   int threads = std::min(MAX_THREADS, length);
   int blocks = std::min(MAX_BLOCKS, length / threads + (length % threads != 0));
 
-  gTransposeND<<<blocks, threads>>>(out, in, axes);
+  gTransposeND<add><<<blocks, threads>>>(out, in, axes);
+}
+
+void TransposeND(Tensor out, Tensor in, const std::vector<int>& vAxis) {
+  TransposeNDImpl<false>(out, in, vAxis);
+}
+
+void TransposeNDGrad(Tensor out, Tensor in, const std::vector<int>& vAxis) {
+  TransposeNDImpl<true>(out, in, vAxis);
 }
 
 __global__ void gSoftmax(float* out,
@@ -80,12 +80,17 @@ public:
 
   void get(std::vector<float> &v) {
     v.resize(size());
+    copyTo(v.data());
+  }
+
+  // copies all values to host memory with room for size() floats
+  void copyTo(float* v) {
     if(backend_->getDevice().type == DeviceType::cpu) {
-      std::copy(data(), data() + size(), v.data());
+      std::copy(data(), data() + size(), v);
     }
 #ifdef CUDA_FOUND
     else {
-      gpu::copy(backend_, data(), data() + size(), v.data());
+      gpu::copy(backend_, data(), data() + size(), v);
     }
 #endif
   }
@@ -30,6 +30,10 @@ public:
     allocator_->throwAtReallocation(throwRealloc);
   }
 
+  bool throwsAtReallocation() const {
+    return allocator_->throwsAtReallocation();
+  }
+
   void reserve(size_t bytes = 0) {
     float mult = bytes / GROW + 1;
     LOG(info,
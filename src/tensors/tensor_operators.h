@@ -83,6 +83,7 @@ namespace marian {
   DISPATCH4(CrossEntropyPickBackward, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor)
 
   DISPATCH3(TransposeND, marian::Tensor, marian::Tensor, const std::vector<int>&)
+  DISPATCH3(TransposeNDGrad, marian::Tensor, marian::Tensor, const std::vector<int>&)
   DISPATCH4(Shift, marian::Tensor, marian::Tensor, marian::Shape, bool)
 
   DISPATCH3(Concatenate, marian::Tensor, const std::vector<marian::Tensor>&, int)
@@ -204,9 +205,112 @@ namespace marian {
       cpu::GRUFastBackward(outputs, inputs, adj, final);
   }
 
+  // Recurrences over whole sequences, see rnn::Cell::applySequence. These are
+  // only implemented on the CPU.
+  namespace cpu {
+    void GRUSequenceForward(marian::Tensor out,
+                            std::vector<marian::Tensor> inputs,
+                            bool final,
+                            bool reverse);
+
+    void GRUSequenceBackward(std::vector<marian::Tensor> outputs,
+                             std::vector<marian::Tensor> inputs,
+                             marian::Tensor val,
+                             marian::Tensor adj,
+                             bool final,
+                             bool reverse);
+
+    void LSTMSequenceForward(marian::Tensor out,
+                             std::vector<marian::Tensor> inputs,
+                             bool reverse);
+
+    void LSTMSequenceBackward(std::vector<marian::Tensor> outputs,
+                              std::vector<marian::Tensor> inputs,
+                              marian::Tensor val,
+                              marian::Tensor adj,
+                              bool reverse);
+  }
+
+  static inline void GRUSequenceForward(marian::Tensor out,
+                                        std::vector<marian::Tensor> inputs,
+                                        bool final,
+                                        bool reverse) {
+    ABORT_IF(out->getBackend()->getDevice().type != DeviceType::cpu,
+             "Fused recurrences are only implemented on the CPU");
+    cpu::GRUSequenceForward(out, inputs, final, reverse);
+  }
+
+  static inline void GRUSequenceBackward(std::vector<marian::Tensor> outputs,
+                                         std::vector<marian::Tensor> inputs,
+                                         marian::Tensor val,
+                                         marian::Tensor adj,
+                                         bool final,
+                                         bool reverse) {
+    ABORT_IF(adj->getBackend()->getDevice().type != DeviceType::cpu,
+             "Fused recurrences are only implemented on the CPU");
+    cpu::GRUSequenceBackward(outputs, inputs, val, adj, final, reverse);
+  }
+
+  static inline void LSTMSequenceForward(marian::Tensor out,
+                                         std::vector<marian::Tensor> inputs,
+                                         bool reverse) {
+    ABORT_IF(out->getBackend()->getDevice().type != DeviceType::cpu,
+             "Fused recurrences are only implemented on the CPU");
+    cpu::LSTMSequenceForward(out, inputs, reverse);
+  }
+
+  static inline void LSTMSequenceBackward(std::vector<marian::Tensor> outputs,
+                                          std::vector<marian::Tensor> inputs,
+                                          marian::Tensor val,
+                                          marian::Tensor adj,
+                                          bool reverse) {
+    ABORT_IF(adj->getBackend()->getDevice().type != DeviceType::cpu,
+             "Fused recurrences are only implemented on the CPU");
+    cpu::LSTMSequenceBackward(outputs, inputs, val, adj, reverse);
+  }
+
   DISPATCH4(Att, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor)
   DISPATCH7(AttBack, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor)
 
+  /**
+   * @brief Fused optimizer steps on the CPU.
+   *
+   * Each step reads the gradient and the optimizer state once, scales the
+   * gradient by gradFactor (e.g. a clipping factor), updates the state and
+   * the parameters, and blends the new parameters into paramsAvg with the
+   * given decay unless paramsAvg is null. eta is the effective learning rate.
+   */
+  namespace cpu {
+    void SgdUpdate(marian::Tensor params,
+                   marian::Tensor grads,
+                   marian::Tensor paramsAvg,
+                   float eta,
+                   float decay);
+
+    void AdagradUpdate(marian::Tensor params,
+                       marian::Tensor grads,
+                       marian::Tensor gt,
+                       marian::Tensor paramsAvg,
+                       float gradFactor,
+                       float eta,
+                       float eps,
+                       float decay);
+
+    void AdamUpdate(marian::Tensor params,
+                    marian::Tensor grads,
+                    marian::Tensor mt,
+                    marian::Tensor vt,
+                    marian::Tensor paramsAvg,
+                    float gradFactor,
+                    float eta,
+                    float beta1,
+                    float beta2,
+                    float denom1,
+                    float denom2,
+                    float eps,
+                    float decay);
+  }
+
 #ifdef CUDA_FOUND
   namespace gpu {
     float L2Norm(marian::Tensor in);
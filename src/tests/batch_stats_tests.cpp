@@ -0,0 +1,92 @@
+#include "catch.hpp"
+#include "data/batch_stats.h"
+
+#include <cstdio>
+#include <map>
+
+using namespace marian;
+using data::BatchMemoryModel;
+
+namespace {
+// Memory of a model with known coefficients, see BatchMemoryModel
+struct Coefficients {
+  double constant, perLength, perToken, perTokenLength;
+
+  double bytes(size_t length, size_t batchSize) const {
+    return constant + perLength * length
+           + batchSize * (perToken * length + perTokenLength * length * length);
+  }
+};
+
+// The probes as measured by EncoderDecoder::collectStats
+std::vector<BatchMemoryModel::Probe> probes(const Coefficients& c) {
+  std::vector<BatchMemoryModel::Probe> probes;
+  for(size_t length : {25, 50})
+    for(size_t batchSize : {16, 32})
+      probes.push_back({length, batchSize, (size_t)c.bytes(length, batchSize)});
+  return probes;
+}
+}
+
+TEST_CASE("Batch memory model is fitted to probe batches", "[data]") {
+  size_t workspace = 512 * 1024 * 1024;
+
+  // with attention memory grows quadratically with the length, without it
+  // linearly
+  std::map<std::string, Coefficients> models
+      = {{"quadratic", {1e6, 2000, 500, 3}}, {"linear", {4e6, 0, 1200, 0}}};
+
+  for(auto& it : models) {
+    auto& c = it.second;
+    BatchMemoryModel memory(1000, workspace, false);
+    memory.fit(probes(c));
+
+    SECTION(it.first + " memory, the coefficients are recovered") {
+      for(size_t length : {1, 10, 25, 100, 200})
+        for(size_t batchSize : {1, 7, 64, 1000}) {
+          INFO("length " << length << ", batch size " << batchSize);
+          CHECK(memory.bytes(length, batchSize)
+                == Approx(c.bytes(length, batchSize)).epsilon(1e-4));
+        }
+    }
+
+    SECTION(it.first + " memory, the largest batch fills the workspace") {
+      float fill = 0.9f;
+      for(size_t length : {1, 10, 50, 100, 200}) {
+        INFO("length " << length);
+        size_t batchSize = memory.maxBatchSize(length, fill);
+        CHECK(batchSize > 1);
+        CHECK(c.bytes(length, batchSize) <= fill * workspace * (1 + 1e-4));
+        CHECK(c.bytes(length, batchSize + 1) > fill * workspace * (1 - 1e-4));
+      }
+
+      // at least one sentence is returned even if it does not fit
+      CHECK(memory.maxBatchSize(1000000, fill) == 1);
+    }
+  }
+}
+
+TEST_CASE("Batch memory model is only loaded for the same setup", "[data]") {
+  std::string fname = "batch_stats_test.yml";
+  std::remove(fname.c_str());
+
+  size_t parameters = 1000, workspace = 64 * 1024 * 1024;
+  Coefficients c = {1e6, 2000, 500, 3};
+
+  BatchMemoryModel saved(parameters, workspace, true);
+  CHECK_FALSE(saved.load(fname));
+  saved.fit(probes(c));
+  saved.save(fname);
+
+  BatchMemoryModel loaded(parameters, workspace, true);
+  REQUIRE(loaded.load(fname));
+  for(size_t length : {1, 30, 100})
+    CHECK(loaded.bytes(length, 10) == Approx(saved.bytes(length, 10)));
+  CHECK(loaded.maxBatchSize(30, 0.9f) == saved.maxBatchSize(30, 0.9f));
+
+  CHECK_FALSE(BatchMemoryModel(parameters + 1, workspace, true).load(fname));
+  CHECK_FALSE(BatchMemoryModel(parameters, workspace / 2, true).load(fname));
+  CHECK_FALSE(BatchMemoryModel(parameters, workspace, false).load(fname));
+
+  std::remove(fname.c_str());
+}
@@ -0,0 +1,207 @@
+#include "catch.hpp"
+#include "3rd_party/cnpy/cnpy.h"
+#include "graph/expression_graph.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace marian;
+
+namespace {
+std::vector<char> readFile(const std::string& fname) {
+  std::ifstream in(fname, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>());
+}
+
+template <typename T>
+T readLE(const std::vector<char>& bytes, size_t pos) {
+  T x;
+  std::memcpy(&x, bytes.data() + pos, sizeof(T));
+  return x;
+}
+
+template <typename T>
+void writeLE(std::vector<char>& bytes, size_t pos, T x) {
+  std::memcpy(bytes.data() + pos, &x, sizeof(T));
+}
+}
+
+TEST_CASE("npz archives with more than 65535 arrays round-trip", "[cnpy]") {
+  std::string fname = "cnpy_test_many.npz";
+
+  // one more array than the 16-bit record count of a plain zip footer holds
+  size_t num = 0xffff + 100;
+  std::vector<float> values(2 * num);
+  std::vector<cnpy::NpzItem> items;
+  std::vector<std::string> names(num);
+  for(size_t i = 0; i < num; ++i) {
+    values[2 * i] = i;
+    values[2 * i + 1] = -(float)i;
+    names[i] = "a" + std::to_string(i);
+    items.push_back({names[i], {2}, cnpy::map_type(typeid(float)),
+                     sizeof(float), (const char*)&values[2 * i]});
+  }
+  cnpy::npz_save(fname, items);
+
+  // the plain footer is saturated and the counts are in the zip64 footer
+  auto bytes = readFile(fname);
+  REQUIRE(bytes.size() > 22 + 20 + 56);
+  size_t footer = bytes.size() - 22;
+  CHECK(readLE<unsigned int>(bytes, footer) == 0x06054b50);
+  CHECK(readLE<unsigned short>(bytes, footer + 10) == 0xffff);
+  CHECK(readLE<unsigned int>(bytes, footer - 20) == 0x07064b50);
+  CHECK(readLE<unsigned long long>(bytes, footer - 20 - 56 + 32) == num);
+
+  auto npz = New<cnpy::NpzReader>(fname);
+  REQUIRE(npz->names().size() == num);
+
+  for(size_t i : {(size_t)0, (size_t)1, (size_t)0xfffe, (size_t)0xffff, num - 1}) {
+    INFO("array: " << names[i]);
+    REQUIRE(npz->contains(names[i]));
+    CHECK(npz->shape(names[i]) == std::vector<unsigned int>({2}));
+    CHECK(npz->word_size(names[i]) == sizeof(float));
+    CHECK(npz->nbytes(names[i]) == 2 * sizeof(float));
+
+    float read[2];
+    npz->read(names[i], (char*)read);
+    CHECK(read[0] == values[2 * i]);
+    CHECK(read[1] == values[2 * i + 1]);
+
+    auto np = cnpy::npz_load(fname, names[i]);
+    CHECK(((float*)np->data())[1] == values[2 * i + 1]);
+  }
+
+  CHECK(cnpy::npz_load(fname).size() == num);
+  std::remove(fname.c_str());
+}
+
+TEST_CASE("npz reader follows zip64 offsets beyond 4GiB", "[cnpy]") {
+  std::string plain = "cnpy_test_plain.npz";
+  std::string fname = "cnpy_test_offset.npz";
+
+  std::vector<float> values = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f};
+  cnpy::npz_save(plain,
+                 {{"w", {2, 3}, cnpy::map_type(typeid(float)), sizeof(float),
+                   (const char*)values.data()}});
+  auto bytes = readFile(plain);
+  std::remove(plain.c_str());
+
+  // split the archive into the local entry and its central directory record
+  size_t footer = bytes.size() - 22;
+  REQUIRE(readLE<unsigned int>(bytes, footer) == 0x06054b50);
+  size_t dirOffset = readLE<unsigned int>(bytes, footer + 16);
+  size_t dirSize = readLE<unsigned int>(bytes, footer + 12);
+  std::vector<char> local(bytes.begin(), bytes.begin() + dirOffset);
+  std::vector<char> dir(bytes.begin() + dirOffset,
+                        bytes.begin() + dirOffset + dirSize);
+
+  // move the entry past 4GiB, the gap is a hole in a sparse file
+  unsigned long long offset = (5ull << 30) + 3;
+  unsigned long long newDirOffset = offset + local.size();
+
+  // the central directory record points to the entry through a zip64 field
+  writeLE<unsigned short>(dir, 4, 45);
+  writeLE<unsigned short>(dir, 6, 45);
+  writeLE<unsigned short>(dir, 30, 12);
+  writeLE<unsigned int>(dir, 42, 0xffffffff);
+  std::vector<char> extra(12);
+  writeLE<unsigned short>(extra, 0, 0x0001);
+  writeLE<unsigned short>(extra, 2, 8);
+  writeLE<unsigned long long>(extra, 4, offset);
+  dir.insert(dir.end(), extra.begin(), extra.end());
+
+  std::vector<char> tail(56 + 20 + 22, 0);
+  writeLE<unsigned int>(tail, 0, 0x06064b50);
+  writeLE<unsigned long long>(tail, 4, 44);
+  writeLE<unsigned long long>(tail, 24, 1);
+  writeLE<unsigned long long>(tail, 32, 1);
+  writeLE<unsigned long long>(tail, 40, dir.size());
+  writeLE<unsigned long long>(tail, 48, newDirOffset);
+  writeLE<unsigned int>(tail, 56, 0x07064b50);
+  writeLE<unsigned long long>(tail, 64, newDirOffset + dir.size());
+  writeLE<unsigned int>(tail, 72, 1);
+  writeLE<unsigned int>(tail, 76, 0x06054b50);
+  writeLE<unsigned short>(tail, 84, 1);
+  writeLE<unsigned short>(tail, 86, 1);
+  writeLE<unsigned int>(tail, 88, dir.size());
+  writeLE<unsigned int>(tail, 92, 0xffffffff);
+
+  FILE* fp = fopen(fname.c_str(), "wb");
+  REQUIRE(fp != nullptr);
+  REQUIRE(fseeko(fp, offset, SEEK_SET) == 0);
+  fwrite(local.data(), 1, local.size(), fp);
+  fwrite(dir.data(), 1, dir.size(), fp);
+  fwrite(tail.data(), 1, tail.size(), fp);
+  REQUIRE(fclose(fp) == 0);
+
+  cnpy::NpzReader npz(fname);
+  REQUIRE(npz.names() == std::vector<std::string>({"w"}));
+  CHECK(npz.shape("w") == std::vector<unsigned int>({2, 3}));
+
+  auto np = npz.load("w");
+  CHECK(std::vector<float>((float*)np->data(), (float*)np->data() + 6)
+        == values);
+  std::remove(fname.c_str());
+}
+
+#ifdef BLAS_FOUND
+TEST_CASE("Models are loaded lazily from npz files (cpu)", "[cnpy]") {
+  std::string fname = "cnpy_test_model.npz";
+
+  std::vector<float> vW(3 * 4), vB(4);
+  for(size_t i = 0; i < vW.size(); ++i)
+    vW[i] = 0.5f * i - 1.f;
+  for(size_t i = 0; i < vB.size(); ++i)
+    vB[i] = -2.f * i;
+
+  {
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(4);
+    graph->param("W", {3, 4}, inits::from_vector(vW));
+    graph->param("b", {1, 4}, inits::from_vector(vB));
+    graph->forward();
+    graph->save(fname);
+  }
+
+  auto npz = New<cnpy::NpzReader>(fname);
+  CHECK(npz->names() == std::vector<std::string>({"W", "b"}));
+
+  SECTION("through the graph") {
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(4);
+    graph->load(fname, true);
+    graph->forward();
+
+    std::vector<float> values;
+    graph->get("W")->val()->get(values);
+    CHECK(values == vW);
+    graph->get("b")->val()->get(values);
+    CHECK(values == vB);
+  }
+
+  SECTION("through the initializer, several times from the same reader") {
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(4);
+    auto w1 = graph->param("W1", {3, 4}, inits::from_npz(npz, "W"));
+    auto w2 = graph->param("W2", {3, 4}, inits::from_npz(npz, "W"));
+    auto b = graph->param("b", {1, 4}, inits::from_npz(npz, "b"));
+    graph->forward();
+
+    std::vector<float> values;
+    w1->val()->get(values);
+    CHECK(values == vW);
+    w2->val()->get(values);
+    CHECK(values == vW);
+    b->val()->get(values);
+    CHECK(values == vB);
+  }
+
+  std::remove(fname.c_str());
+}
+#endif
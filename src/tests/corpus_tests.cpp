@@ -0,0 +1,103 @@
+#include "catch.hpp"
+#include "data/corpus_base.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+using namespace marian;
+using namespace data;
+
+namespace {
+typedef std::vector<std::vector<size_t>> Lengths;
+
+// A batch with one subbatch per vector of sentence lengths
+Ptr<CorpusBatch> makeBatch(const Lengths& lengths) {
+  std::vector<Ptr<SubBatch>> subBatches;
+  for(auto& l : lengths) {
+    auto sb = New<SubBatch>(l.size(), *std::max_element(l.begin(), l.end()));
+    for(size_t i = 0; i < l.size(); ++i)
+      sb->setLength(i, l[i]);
+    subBatches.push_back(sb);
+  }
+  auto batch = New<CorpusBatch>(subBatches);
+
+  std::vector<size_t> ids(lengths[0].size());
+  std::iota(ids.begin(), ids.end(), 100);
+  batch->setSentenceIds(ids);
+  return batch;
+}
+
+// Padded words of the sentences [begin, begin + size) in all subbatches
+size_t work(const Lengths& lengths, size_t begin, size_t size) {
+  size_t words = 0;
+  for(auto& l : lengths) {
+    size_t width = 0;
+    for(size_t i = begin; i < begin + size; ++i)
+      width = std::max(width, l[i]);
+    words += size * width;
+  }
+  return words;
+}
+
+// Smallest possible work of the largest of n splits of consecutive sentences
+size_t optimalWork(const Lengths& lengths, size_t n) {
+  size_t size = lengths[0].size();
+  size_t none = std::numeric_limits<size_t>::max();
+
+  // best[i]: splits of the first i sentences, one more split per round
+  std::vector<size_t> best(size + 1, none);
+  best[0] = 0;
+  for(size_t k = 0; k < n; ++k) {
+    std::vector<size_t> next = best;
+    for(size_t i = 1; i <= size; ++i)
+      for(size_t j = 0; j < i; ++j)
+        if(best[j] != none)
+          next[i] = std::min(next[i],
+                             std::max(best[j], work(lengths, j, i - j)));
+    best = next;
+  }
+  return best[size];
+}
+}
+
+TEST_CASE("Batches are split into parts with balanced work", "[data]") {
+  Lengths lengths = {{3, 12, 4, 4, 9, 2, 7},
+                     {5, 10, 3, 6, 11, 1, 8}};
+  auto batch = makeBatch(lengths);
+  size_t size = batch->size();
+
+  for(size_t n = 1; n <= 2 * size + 1; ++n) {
+    INFO("splits: " << n);
+    auto sizes = batch->splitSizes(n);
+    REQUIRE(sizes.size() == n);
+    CHECK(std::accumulate(sizes.begin(), sizes.end(), (size_t)0) == size);
+
+    size_t maxWork = 0, pos = 0;
+    for(auto s : sizes) {
+      maxWork = std::max(maxWork, work(lengths, pos, s));
+      pos += s;
+    }
+    CHECK(maxWork == optimalWork(lengths, n));
+
+    // with more splits than sentences each sentence is on its own and the
+    // remaining splits are empty
+    if(n >= size) {
+      CHECK(std::count(sizes.begin(), sizes.end(), 1) == size);
+      CHECK(std::count(sizes.begin(), sizes.end(), 0) == n - size);
+    }
+
+    auto splits = batch->split(n);
+    REQUIRE(splits.size() == n);
+    std::vector<size_t> ids;
+    for(size_t i = 0; i < n; ++i) {
+      auto split = std::static_pointer_cast<CorpusBatch>(splits[i]);
+      CHECK(split->size() == sizes[i]);
+      CHECK(split->sets() == lengths.size());
+      ids.insert(ids.end(),
+                 split->getSentenceIds().begin(),
+                 split->getSentenceIds().end());
+    }
+    CHECK(ids == batch->getSentenceIds());
+  }
+}
@@ -0,0 +1,136 @@
+#include "catch.hpp"
+#include "training/gradient_compressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace marian;
+
+namespace {
+// Sends grads through a compressor and returns what the receiver adds up
+std::vector<float> roundTrip(GradientCompressor& compressor,
+                             const std::vector<float>& grads,
+                             size_t offset = 0,
+                             bool drop = true) {
+  std::vector<char> message;
+  compressor.compress(grads.data(), offset, grads.size(), message, drop);
+  CHECK(message.size() <= compressor.maxBytes(grads.size()));
+
+  std::vector<float> received(grads.size(), 0.f);
+  GradientCompressor::decompressAdd(
+      message.data(), received.data(), received.size());
+  return received;
+}
+
+// The residual, sent in full by compressing zeros without dropping
+std::vector<float> residual(GradientCompressor& compressor,
+                            size_t size,
+                            size_t offset = 0) {
+  return roundTrip(compressor, std::vector<float>(size, 0.f), offset, false);
+}
+}
+
+TEST_CASE("Gradient compression round trips", "[training]") {
+  std::vector<float> grads = {0.5f,  -3.f, 0.25f, 1.f,   -0.125f, 2.f,
+                              -0.5f, 0.f,  4.f,   -1.5f, 0.75f,   -6.f};
+  size_t size = grads.size();
+
+  SECTION("dense values are sent exactly") {
+    GradientCompressor compressor(size, 0.f, 0.f, false);
+    CHECK(roundTrip(compressor, grads) == grads);
+    CHECK(residual(compressor, size) == std::vector<float>(size, 0.f));
+  }
+
+  SECTION("dropping sends the largest values and keeps the rest") {
+    // 3 of 12 values are sent, two of them at the end of the range
+    GradientCompressor compressor(size, 0.75f, 0.f, false);
+    auto sent = roundTrip(compressor, grads);
+
+    std::vector<float> expected(size, 0.f);
+    for(size_t i : {1, 8, 11})
+      expected[i] = grads[i];
+    CHECK(sent == expected);
+
+    auto rest = residual(compressor, size);
+    for(size_t i = 0; i < size; ++i)
+      CHECK(sent[i] + rest[i] == grads[i]);
+    CHECK(residual(compressor, size) == std::vector<float>(size, 0.f));
+  }
+
+  SECTION("dropping selects exactly k values among ties") {
+    std::vector<float> equal(10, 1.f);
+    GradientCompressor compressor(equal.size(), 0.7f, 0.f, false);
+    auto sent = roundTrip(compressor, equal);
+    CHECK(std::count(sent.begin(), sent.end(), 1.f) == 3);
+
+    auto rest = residual(compressor, equal.size());
+    for(size_t i = 0; i < equal.size(); ++i)
+      CHECK(sent[i] + rest[i] == 1.f);
+  }
+
+  SECTION("residuals are added at the same positions the next time") {
+    GradientCompressor compressor(size, 0.75f, 0.f, false);
+    auto first = roundTrip(compressor, grads);
+
+    // the kept value at position 5 now outweighs the new one at position 1
+    auto second = roundTrip(compressor, grads);
+    CHECK(second[5] == 2 * grads[5]);
+    CHECK(second[1] == 0.f);
+
+    // all that has been sent and kept adds up to both gradients
+    auto rest = residual(compressor, size);
+    for(size_t i = 0; i < size; ++i)
+      CHECK(first[i] + second[i] + rest[i] == 2 * grads[i]);
+  }
+
+  SECTION("quantization keeps the rounding errors") {
+    // the residual is read back quantized as well, with a much smaller scale
+    GradientCompressor compressor(size, 0.f, 0.f, true);
+    std::vector<float> small(size);
+    for(size_t i = 0; i < size; ++i)
+      small[i] = grads[i] + 0.001f * i;
+
+    auto sent = roundTrip(compressor, small);
+    auto rest = residual(compressor, size);
+    for(size_t i = 0; i < size; ++i) {
+      CHECK(std::abs(sent[i] - small[i]) <= 6.012f / 127);
+      CHECK(sent[i] + rest[i] == Approx(small[i]).margin(1e-3));
+    }
+  }
+
+  SECTION("ranges of a larger residual are compressed separately") {
+    GradientCompressor compressor(2 * size, 0.75f, 0.f, false);
+    auto sent = roundTrip(compressor, grads, size);
+    CHECK(residual(compressor, size, 0) == std::vector<float>(size, 0.f));
+
+    auto rest = residual(compressor, size, size);
+    for(size_t i = 0; i < size; ++i)
+      CHECK(sent[i] + rest[i] == grads[i]);
+  }
+
+  SECTION("momentum accumulates the local gradients until they are sent") {
+    float momentum = 0.5f;
+    GradientCompressor compressor(size, 0.75f, momentum, false);
+
+    std::vector<float> local = grads;
+    compressor.addMomentum(local.data(), 0, size);
+    CHECK(local == grads);
+    auto sent = roundTrip(compressor, local);
+
+    // velocity is masked where values were sent and decays elsewhere
+    local = grads;
+    compressor.addMomentum(local.data(), 0, size);
+    for(size_t i = 0; i < size; ++i) {
+      if(sent[i] != 0)
+        CHECK(local[i] == grads[i]);
+      else
+        CHECK(local[i] == (1 + momentum) * grads[i]);
+    }
+
+    // and it is cleared for gradients applied without compression
+    compressor.resetMomentum(0, size);
+    local = grads;
+    compressor.addMomentum(local.data(), 0, size);
+    CHECK(local == grads);
+  }
+}
@@ -2,6 +2,8 @@
 #include "graph/expression_graph.h"
 #include "graph/expression_operators.h"
 
+#include <cmath>
+
 using namespace marian;
 
 #ifdef CUDA_FOUND
@@ -105,3 +107,125 @@ TEST_CASE("Expression graph can be initialized with constant values (cpu)",
     REQUIRE(values == v);
   }
 }
+
+TEST_CASE("Gradient checkpointing recomputes freed nodes (cpu)", "[graph]") {
+  auto graph = New<ExpressionGraph>();
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(4);
+
+  std::vector<float> v({0.1, -0.2, 0.3, -0.4, 0.5, -0.6});
+
+  auto build = [&](bool checkpointing, Expr& hidden) {
+    graph->clear();
+    graph->setCheckpointing(checkpointing);
+
+    auto x = graph->param("x", {2, 3}, inits::from_vector(v));
+    auto layer = x;
+    for(int i = 0; i < 3; ++i) {
+      hidden = tanh(layer * 2.f);
+      layer = graph->checkpoint(hidden + layer);
+    }
+    return sum(sum(layer * layer, keywords::axis = 0), keywords::axis = 1);
+  };
+
+  Expr hidden;
+  std::vector<float> expected, grads;
+
+  build(false, hidden);
+  graph->backprop();
+  graph->params()->grads()->get(expected);
+
+  build(true, hidden);
+  graph->forward();
+  REQUIRE(!hidden->val());
+  graph->backward();
+  graph->params()->grads()->get(grads);
+
+  REQUIRE(grads == expected);
+}
+
+struct ThrowingNodeOp : public NaryNodeOp {
+  ThrowingNodeOp(Expr a) : NaryNodeOp({a}, a->shape()) {}
+
+  NodeOps forwardOps() {
+    return {NodeOp(throw std::runtime_error("forward failed"))};
+  }
+
+  const std::string type() { return "throwing"; }
+};
+
+TEST_CASE("Concurrent forward rethrows on the calling thread (cpu)",
+          "[graph]") {
+  auto graph = New<ExpressionGraph>();
+  graph->setDevice({0, DeviceType::cpu});
+  graph->setForwardThreads(2);
+  graph->reserveWorkspaceMB(4);
+
+  std::vector<float> v({0.1, -0.2, 0.3, -0.4, 0.5, -0.6});
+
+  // the failing node runs in the pool next to the other branches
+  auto x = graph->param("x", {2, 3}, inits::from_vector(v));
+  auto a = tanh(x);
+  auto b = Expression<ThrowingNodeOp>(x);
+  auto c = tanh(x * 2.f);
+  auto y = a + b + c;
+
+  REQUIRE_THROWS_AS(graph->forward(), std::runtime_error);
+}
+
+TEST_CASE("Concurrent forward matches the serial forward (cpu)", "[graph]") {
+  std::vector<float> vX(2 * 3 * 4), vW(4 * 4), vMask(2 * 3 * 4);
+  for(size_t i = 0; i < vX.size(); ++i) {
+    vX[i] = std::sin(0.9f * i);
+    vMask[i] = (i % 4 == 3 || i % 7 == 0) ? 0.f : 1.f;
+  }
+  for(size_t i = 0; i < vW.size(); ++i)
+    vW[i] = std::cos(1.3f * i);
+
+  // values of all branches and the gradients of both parameters
+  auto run = [&](size_t threads) {
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->setForwardThreads(threads);
+    graph->reserveWorkspaceMB(4);
+
+    auto x = graph->param("x", {2, 3, 4}, inits::from_vector(vX));
+    auto w = graph->param("w", {4, 4}, inits::from_vector(vW));
+    auto mask = graph->constant({2, 3, 4}, inits::from_vector(vMask));
+
+    // independent branches, two of them views of the parameter which are not
+    // computed but share the memory of their child
+    std::vector<Expr> branches = {
+        dot(reshape(tanh(x), {6, 4}), w),
+        logit(step(x, 1, -2) * 2.f) + x,
+        softmax(x * 3.f, mask),
+        sum(exp(x - 1.f), keywords::axis = -1) * sum(w, keywords::axis = 0),
+        relu(transpose(x, {0, 2, 1}))};
+
+    Expr loss;
+    for(auto& branch : branches) {
+      int dim = branch->shape().elements();
+      auto part = sum(reshape(branch * branch, {1, dim}), keywords::axis = 1);
+      loss = loss ? loss + part : part;
+    }
+
+    graph->backprop();
+
+    std::vector<std::vector<float>> results;
+    for(auto& e : branches) {
+      results.emplace_back();
+      e->val()->get(results.back());
+    }
+    for(auto& e : {x, w}) {
+      results.emplace_back();
+      e->grad()->get(results.back());
+    }
+    results.emplace_back();
+    loss->val()->get(results.back());
+    return results;
+  };
+
+  auto expected = run(1);
+  for(int i = 0; i < 5; ++i)
+    CHECK(run(2) == expected);
+}
@@ -0,0 +1,117 @@
+#include "catch.hpp"
+#include "data/types.h"
+#include "graph/expression_graph.h"
+#include "translator/nth_element.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace marian;
+
+#ifdef BLAS_FOUND
+TEST_CASE("Fused n-best selection matches a full sort (cpu)", "[translator]") {
+  auto graph = New<ExpressionGraph>();
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(4);
+
+  float lowest = std::numeric_limits<float>::lowest();
+
+  SECTION("weighted terms with log-softmax and a broadcast term") {
+    int dimBatch = 2, dimBeam = 3, dimVocab = 37;
+    int rows = dimBatch * dimBeam;
+    std::vector<size_t> beamSizes(dimBatch, dimBeam);
+
+    // decoder outputs, normalized on the fly, and a term shared by all
+    // hypotheses such as a word penalty
+    std::vector<float> vDecoder(rows * dimVocab), vShared(dimVocab),
+        prevCosts(rows);
+    for(size_t k = 0; k < vDecoder.size(); ++k)
+      vDecoder[k] = 4.f * std::sin(0.37f * k);
+    for(int k = 0; k < dimVocab; ++k)
+      vShared[k] = -std::abs(std::cos(0.91f * k));
+    for(int h = 0; h < rows; ++h)
+      prevCosts[h] = -0.5f * h;
+    // blacklisted words of some hypotheses
+    vDecoder[EOS_ID] = lowest;
+    vDecoder[4 * dimVocab + EOS_ID] = lowest;
+
+    float wDecoder = 0.7f, wShared = 0.3f;
+
+    auto decoder = graph->constant({dimBeam, dimBatch, dimVocab},
+                                   inits::from_vector(vDecoder));
+    auto shared = graph->constant({1, dimVocab}, inits::from_vector(vShared));
+    graph->forward();
+
+    std::vector<ScoreTerm> terms = {{decoder->val(), wDecoder, true},
+                                    {shared->val(), wShared, false}};
+
+    for(bool skipUnk : {false, true}) {
+      INFO("skipUnk: " << skipUnk);
+
+      NthElementCPU nth(dimBeam, dimBatch);
+      std::vector<float> outCosts;
+      std::vector<unsigned> outKeys;
+      nth.getNBestListFromScores(
+          beamSizes, prevCosts, terms, outCosts, outKeys, false, skipUnk);
+      REQUIRE(outKeys.size() == dimBatch * dimBeam);
+
+      for(int batchIdx = 0; batchIdx < dimBatch; ++batchIdx) {
+        // all candidates of the sentence, keys in batch-major layout
+        std::vector<std::pair<double, unsigned>> candidates;
+        for(int beamIdx = 0; beamIdx < dimBeam; ++beamIdx) {
+          int row = beamIdx * dimBatch + batchIdx;
+          const float* scores = vDecoder.data() + row * dimVocab;
+
+          double max = *std::max_element(scores, scores + dimVocab);
+          double sum = 0;
+          for(int i = 0; i < dimVocab; ++i)
+            sum += std::exp(scores[i] - max);
+          double logSum = max + std::log(sum);
+
+          for(int i = 0; i < dimVocab; ++i) {
+            if((skipUnk && i == UNK_ID) || scores[i] == lowest)
+              continue;
+            double cost = prevCosts[row] + wDecoder * (scores[i] - logSum)
+                          + wShared * vShared[i];
+            unsigned key = (batchIdx * dimBeam + beamIdx) * dimVocab + i;
+            candidates.emplace_back(cost, key);
+          }
+        }
+        std::sort(candidates.rbegin(), candidates.rend());
+
+        for(int k = 0; k < dimBeam; ++k) {
+          size_t pos = batchIdx * dimBeam + k;
+          CHECK(outKeys[pos] == candidates[k].second);
+          CHECK(outCosts[pos] == Approx(candidates[k].first).epsilon(1e-4));
+        }
+      }
+    }
+  }
+
+  SECTION("blacklisted candidates have a finite cost") {
+    // fewer words than the beam size are allowed, and the weight would make
+    // the blacklisted scores overflow to -inf
+    int dimVocab = 5, dimBeam = 4;
+    std::vector<float> vScores = {lowest, 0.5f, -1.f, lowest, -0.2f};
+
+    auto scores = graph->constant({1, 1, dimVocab},
+                                  inits::from_vector(vScores));
+    graph->forward();
+
+    NthElementCPU nth(dimBeam, 1);
+    std::vector<float> outCosts;
+    std::vector<unsigned> outKeys;
+    nth.getNBestListFromScores(
+        {(size_t)dimBeam}, {-3.f}, {{scores->val(), 2.f, false}},
+        outCosts, outKeys, true);
+
+    REQUIRE(outKeys.size() == dimBeam);
+    CHECK(outKeys[0] == 1);
+    CHECK(outKeys[1] == 4);
+    CHECK(outKeys[2] == 2);
+    CHECK(outCosts[0] == Approx(-2.f));
+    // std::isfinite is folded away with -ffinite-math-only
+    CHECK(outCosts[3] == lowest);
+  }
+}
+#endif
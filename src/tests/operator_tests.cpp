@@ -1,6 +1,9 @@
 #include "catch.hpp"
 #include "graph/expression_graph.h"
 #include "graph/expression_operators.h"
+#include "rnn/attention.h"
+
+#include <cmath>
 
 using namespace marian;
 
@@ -115,6 +118,47 @@ void tests(DeviceType device) {
     CHECK( values == vT5 );
   }
 
+  SECTION("transpose gradients") {
+    graph->clear();
+    values.clear();
+
+    std::vector<float> vX(24), vW(24), vV(24);
+    for(int k = 0; k < 24; ++k) {
+      vX[k] = k;
+      vW[k] = k + 1;
+      vV[k] = 0.5f * k - 3;
+    }
+
+    // {1, 2, 0} is not its own inverse, and x has a second consumer, so the
+    // gradient of the transpose has to be added to the one of the product
+    auto x = graph->param("x", {2, 3, 4}, inits::from_vector(vX));
+    auto t = transpose(x, {1, 2, 0});
+    auto w = graph->constant({3, 4, 2}, inits::from_vector(vW));
+    auto v = graph->constant({2, 3, 4}, inits::from_vector(vV));
+    auto loss = sum(reshape(t * w, {1, 24}), keywords::axis = 1)
+                + sum(reshape(x * v, {1, 24}), keywords::axis = 1);
+    graph->backprop();
+
+    CHECK(t->shape() == Shape({3, 4, 2}));
+
+    // t[j][k][i] = x[i][j][k]
+    std::vector<float> tOut(24), gX(24);
+    for(int i = 0; i < 2; ++i)
+      for(int j = 0; j < 3; ++j)
+        for(int k = 0; k < 4; ++k) {
+          int in = (i * 3 + j) * 4 + k;
+          int out = (j * 4 + k) * 2 + i;
+          tOut[out] = vX[in];
+          gX[in] = vW[out] + vV[in];
+        }
+
+    t->val()->get(values);
+    CHECK( values == tOut );
+
+    x->grad()->get(values);
+    CHECK( values == gX );
+  }
+
   SECTION("softmax and logsoftmax") {
     graph->clear();
     values.clear();
@@ -303,3 +347,154 @@ TEST_CASE("Expression graph supports basic math operations (cpu)", "[operator]")
   tests(DeviceType::cpu);
 }
 #endif
+
+#ifdef BLAS_FOUND
+// Row-wise softmax computed in double precision, masked entries are set to 0
+std::vector<float> refSoftmax(const std::vector<float>& in,
+                              int cols,
+                              const std::vector<float>& mask = {}) {
+  std::vector<float> out(in.size());
+  for(size_t j = 0; j < in.size(); j += cols) {
+    double max = *std::max_element(in.begin() + j, in.begin() + j + cols);
+    double sum = 0;
+    for(int i = 0; i < cols; ++i) {
+      double e = std::exp(in[j + i] - max);
+      if(!mask.empty() && !mask[(j + i) % mask.size()])
+        e = 0;
+      out[j + i] = e;
+      sum += e;
+    }
+    for(int i = 0; i < cols; ++i)
+      out[j + i] /= sum;
+  }
+  return out;
+}
+
+std::vector<float> refLogSoftmax(const std::vector<float>& in, int cols) {
+  std::vector<float> out(in.size());
+  for(size_t j = 0; j < in.size(); j += cols) {
+    double max = *std::max_element(in.begin() + j, in.begin() + j + cols);
+    double sum = 0;
+    for(int i = 0; i < cols; ++i)
+      sum += std::exp(in[j + i] - max);
+    for(int i = 0; i < cols; ++i)
+      out[j + i] = in[j + i] - max - std::log(sum);
+  }
+  return out;
+}
+
+TEST_CASE("Vectorized CPU operators match scalar references (cpu)",
+          "[operator]") {
+  auto near = [](float x, float y) {
+    return x == Approx(y).epsilon(1e-4).margin(1e-5);
+  };
+
+  auto newGraph = []() {
+    auto graph = New<ExpressionGraph>();
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(4);
+    return graph;
+  };
+
+  // lengths below, at and between multiples of the vector width leave
+  // tails of all sizes for the scalar loops
+  std::vector<int> lengths = {1, 3, 8, 13, 16, 21, 37};
+  std::vector<float> values;
+
+  SECTION("softmax and logsoftmax") {
+    for(int cols : lengths) {
+      INFO("columns: " << cols);
+      auto graph = newGraph();
+
+      int dimBeam = 2, dimRows = 3;
+      std::vector<float> in(dimBeam * dimRows * cols);
+      for(size_t k = 0; k < in.size(); ++k)
+        in[k] = 3.f * std::sin(1.3f * k);
+      // far below the maximum of its row, where exp is clamped
+      in[cols / 2] = -200.f;
+
+      // broadcast over the beam, every row keeps at least one entry
+      std::vector<float> mask(dimRows * cols);
+      for(size_t k = 0; k < mask.size(); ++k)
+        mask[k] = k % cols == 0 || k % 3 != 1;
+
+      auto input = graph->constant({dimBeam, dimRows, cols},
+                                   inits::from_vector(in));
+      auto sm = softmax(input);
+      auto lsm = logsoftmax(input);
+      auto msm = softmax(input,
+                         graph->constant({1, dimRows, cols},
+                                         inits::from_vector(mask)));
+      graph->forward();
+
+      sm->val()->get(values);
+      auto smOut = refSoftmax(in, cols);
+      CHECK(std::equal(values.begin(), values.end(), smOut.begin(), near));
+
+      lsm->val()->get(values);
+      auto lsmOut = refLogSoftmax(in, cols);
+      CHECK(std::equal(values.begin(), values.end(), lsmOut.begin(), near));
+
+      msm->val()->get(values);
+      auto msmOut = refSoftmax(in, cols, mask);
+      CHECK(std::equal(values.begin(), values.end(), msmOut.begin(), near));
+    }
+  }
+
+  SECTION("attention and its gradients") {
+    for(int cols : lengths) {
+      INFO("columns: " << cols);
+      auto graph = newGraph();
+
+      int dimWords = 2, dimBatch = 2;
+      std::vector<float> vVa(cols), vContext(dimWords * dimBatch * cols),
+          vState(dimBatch * cols), vAdj(dimWords * dimBatch);
+      for(int k = 0; k < cols; ++k)
+        vVa[k] = std::cos(0.7f * k);
+      for(size_t k = 0; k < vContext.size(); ++k)
+        vContext[k] = std::sin(0.9f * k);
+      for(size_t k = 0; k < vState.size(); ++k)
+        vState[k] = 0.5f * std::cos(1.1f * k);
+      for(size_t k = 0; k < vAdj.size(); ++k)
+        vAdj[k] = k + 1.f;
+
+      auto va = graph->param("va", {cols, 1}, inits::from_vector(vVa));
+      auto context = graph->param(
+          "context", {dimWords, dimBatch, cols}, inits::from_vector(vContext));
+      auto state = graph->param(
+          "state", {dimBatch, cols}, inits::from_vector(vState));
+
+      auto att = rnn::attOps(va, context, state);
+      auto adj = graph->constant(att->shape(), inits::from_vector(vAdj));
+      auto loss = sum(reshape(att * adj, {1, dimWords * dimBatch}),
+                      keywords::axis = 1);
+      graph->backprop();
+
+      std::vector<float> attOut(vAdj.size(), 0.f);
+      std::vector<float> gVa(cols, 0.f), gContext(vContext.size(), 0.f),
+          gState(vState.size(), 0.f);
+      for(size_t j = 0; j < attOut.size(); ++j) {
+        const float* c = vContext.data() + j * cols;
+        const float* s = vState.data() + (j % dimBatch) * cols;
+        for(int i = 0; i < cols; ++i) {
+          float t = std::tanh(c[i] + s[i]);
+          attOut[j] += t * vVa[i];
+          gVa[i] += t * vAdj[j];
+          gContext[j * cols + i] += vVa[i] * (1 - t * t) * vAdj[j];
+          gState[(j % dimBatch) * cols + i] += vVa[i] * (1 - t * t) * vAdj[j];
+        }
+      }
+
+      att->val()->get(values);
+      CHECK(std::equal(values.begin(), values.end(), attOut.begin(), near));
+
+      va->grad()->get(values);
+      CHECK(std::equal(values.begin(), values.end(), gVa.begin(), near));
+      context->grad()->get(values);
+      CHECK(std::equal(values.begin(), values.end(), gContext.begin(), near));
+      state->grad()->get(values);
+      CHECK(std::equal(values.begin(), values.end(), gState.begin(), near));
+    }
+  }
+}
+#endif
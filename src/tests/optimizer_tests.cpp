@@ -0,0 +1,152 @@
+#include "catch.hpp"
+#include "common/io.h"
+#include "optimizers/optimizers.h"
+#include "tensors/tensor_allocator.h"
+
+#include <boost/filesystem.hpp>
+#include <cmath>
+
+using namespace marian;
+
+#ifdef BLAS_FOUND
+namespace {
+// Parameters split into shards as in the graph groups, with one optimizer
+// per shard
+class ShardedParams {
+public:
+  ShardedParams(size_t shards, const std::vector<float>& values)
+      : backend_(BackendByDevice({0, DeviceType::cpu}, 1111)),
+        alloc_(New<TensorAllocator>(backend_)),
+        size_(values.size()),
+        shardSize_(ceil(size_ / (float)shards)) {
+    alloc_->reserveExact(2 * size_ * sizeof(float));
+    alloc_->allocate(params_, {1, (int)size_});
+    alloc_->allocate(grads_, {1, (int)size_});
+    params_->set(values);
+
+    for(size_t i = 0; i < shards; ++i)
+      opts_.push_back(Optimizer<Adagrad>(0.1f));
+  }
+
+  void update(const std::vector<float>& grads) {
+    grads_->set(grads);
+    for(size_t i = 0; i < opts_.size(); ++i) {
+      size_t begin = std::min(i * shardSize_, size_);
+      size_t end = std::min(begin + shardSize_, size_);
+      opts_[i]->update(params_->subtensor(begin, end - begin),
+                       grads_->subtensor(begin, end - begin));
+    }
+  }
+
+  std::vector<float> values() {
+    std::vector<float> v;
+    params_->get(v);
+    return v;
+  }
+
+  void save(const std::string& name) {
+    opts_[0]->save(name, opts_, size_);
+    marian::io::waitForSaves();
+  }
+
+  void load(const std::string& name) {
+    std::vector<Ptr<Backend>> backends(opts_.size(), backend_);
+    opts_[0]->load(name, opts_, backends);
+  }
+
+private:
+  Ptr<Backend> backend_;
+  Ptr<TensorAllocator> alloc_;
+  Tensor params_;
+  Tensor grads_;
+  std::vector<Ptr<OptimizerBase>> opts_;
+  size_t size_;
+  size_t shardSize_;
+};
+
+std::vector<float> gradients(size_t size, size_t step) {
+  std::vector<float> g(size);
+  for(size_t i = 0; i < size; ++i)
+    g[i] = std::sin(0.7f * i + step);
+  return g;
+}
+}
+
+TEST_CASE("Optimizer checkpoints are re-sharded on load (cpu)",
+          "[optimizer]") {
+  namespace fs = boost::filesystem;
+
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directories(dir);
+  std::string name = (dir / "model.npz.optimizer.npz").string();
+  auto shardFile = [&](size_t i, size_t n) {
+    return dir / ("model.npz.optimizer.shard" + std::to_string(i) + "-of-"
+                  + std::to_string(n) + ".npz");
+  };
+
+  // 11 values leave the last shard smaller than the others
+  size_t size = 11;
+  std::vector<float> init(size);
+  for(size_t i = 0; i < size; ++i)
+    init[i] = 0.1f * i - 0.5f;
+
+  ShardedParams trained(3, init);
+  for(size_t step = 0; step < 3; ++step)
+    trained.update(gradients(size, step));
+  trained.save(name);
+
+  CHECK(fs::exists(shardFile(1, 3)));
+  CHECK(fs::exists(shardFile(3, 3)));
+
+  // the next update of a resumed run matches the one of the trained run
+  auto values = trained.values();
+  trained.update(gradients(size, 3));
+  auto expected = trained.values();
+
+  for(size_t shards : {1, 2, 3, 4, 11}) {
+    INFO("shards: " << shards);
+    ShardedParams resumed(shards, values);
+    resumed.load(name);
+    resumed.update(gradients(size, 3));
+
+    auto actual = resumed.values();
+    for(size_t i = 0; i < size; ++i)
+      CHECK(actual[i] == Approx(expected[i]));
+  }
+
+  SECTION("without the state the update differs") {
+    ShardedParams fresh(2, values);
+    fresh.update(gradients(size, 3));
+    CHECK(fresh.values() != expected);
+  }
+
+  SECTION("re-sharded checkpoints replace the earlier shards") {
+    ShardedParams resumed(2, values);
+    resumed.load(name);
+
+    // files which only look alike are kept
+    std::vector<fs::path> others = {dir / "model.npz.optimizer.shard-1.npz",
+                                    dir / "other.optimizer.shard1-of-3.npz"};
+    for(auto& other : others)
+      fs::ofstream(other) << "x";
+
+    resumed.save(name);
+    CHECK(fs::exists(shardFile(1, 2)));
+    CHECK(fs::exists(shardFile(2, 2)));
+    for(size_t i = 1; i <= 3; ++i)
+      CHECK_FALSE(fs::exists(shardFile(i, 3)));
+    for(auto& other : others)
+      CHECK(fs::exists(other));
+
+    // the new checkpoint resumes as well
+    ShardedParams reloaded(3, values);
+    reloaded.load(name);
+    reloaded.update(gradients(size, 3));
+    auto actual = reloaded.values();
+    for(size_t i = 0; i < size; ++i)
+      CHECK(actual[i] == Approx(expected[i]));
+  }
+
+  fs::remove_all(dir);
+}
+#endif
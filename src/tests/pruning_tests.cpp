@@ -0,0 +1,152 @@
+#include "catch.hpp"
+#include "common/io.h"
+#include "data/corpus_base.h"
+#include "models/model_factory.h"
+#include "models/pruning.h"
+
+#include <cstdio>
+
+using namespace marian;
+
+#ifdef BLAS_FOUND
+namespace {
+Ptr<Options> modelOptions(const std::string& type) {
+  auto options = New<Options>();
+  options->set("type", type);
+  options->set("inference", true);
+  options->set("cost-type", std::string("ce-sum"));
+  options->set("ignore-model-config", false);
+  options->set("dim-vocabs", std::vector<int>({10, 10}));
+  options->set("dim-emb", 8);
+  options->set("enc-depth", 1);
+  options->set("dec-depth", 1);
+  options->set("dropout-src", 0.f);
+  options->set("dropout-trg", 0.f);
+  options->set("tied-embeddings", false);
+  options->set("tied-embeddings-src", false);
+  options->set("tied-embeddings-all", false);
+  options->set("embedding-normalization", false);
+  options->set("layer-normalization", false);
+  options->set("skip", false);
+
+  options->set("transformer-heads", 4);
+  options->set("transformer-dim-ffn", 16);
+  options->set("transformer-preprocess", std::string(""));
+  options->set("transformer-postprocess", std::string("dan"));
+  options->set("transformer-postprocess-emb", std::string("d"));
+  options->set("transformer-decoder-autoreg", std::string("self-attention"));
+  options->set("transformer-multi-encoder", std::string("stack"));
+  options->set("transformer-dropout", 0.f);
+  options->set("transformer-dropout-attention", 0.f);
+
+  options->set("dim-rnn", 8);
+  options->set("enc-type", std::string("bidirectional"));
+  options->set("enc-cell", std::string("gru"));
+  options->set("enc-cell-depth", 1);
+  options->set("dec-cell", std::string("gru"));
+  options->set("dec-cell-base-depth", 2);
+  options->set("dec-cell-high-depth", 1);
+  options->set("dropout-rnn", 0.f);
+  return options;
+}
+
+// Builds the model on a small batch, with the parameters of the file if given,
+// and returns the cost of the batch
+float forward(Ptr<ExpressionGraph> graph,
+              Ptr<Options> options,
+              const std::string& name = "") {
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(16);
+
+  auto model = models::from_options(options);
+  if(!name.empty())
+    model->load(graph, name);
+
+  std::vector<size_t> lengths = {3, 4};
+  auto cost = model->build(
+      graph, data::CorpusBatch::fakeBatch(lengths, 2, options));
+  graph->forward();
+
+  std::vector<float> values;
+  cost->val()->get(values);
+  return values[0];
+}
+
+Shape shapeOf(Ptr<ExpressionGraph> graph, const std::string& name) {
+  auto param = graph->get(name);
+  REQUIRE(param);
+  return param->shape();
+}
+}
+
+TEST_CASE("Pruned models are loaded with smaller layers (cpu)", "[pruning]") {
+  std::string fname = "pruning_test_model.npz";
+  std::string pruned = "pruning_test_pruned.npz";
+
+  SECTION("transformer feed-forward units and attention heads") {
+    auto options = modelOptions("transformer");
+    {
+      auto graph = New<ExpressionGraph>(true);
+      forward(graph, options);
+      CHECK(shapeOf(graph, "encoder_l1_ffn_W1") == Shape({8, 16}));
+      models::from_options(options)->save(graph, fname);
+      marian::io::waitForSaves();
+    }
+
+    // one feed-forward layer in the encoder and one in the decoder, three
+    // attention layers with four heads of two dimensions
+    ModelPruner pruner(fname);
+    CHECK(pruner.pruneFfn(0.75f) == 2 * 12);
+    CHECK(pruner.pruneHeads(1) == 3 * 1);
+    pruner.save(pruned);
+
+    auto graph = New<ExpressionGraph>(true);
+    float cost = forward(graph, options, pruned);
+    CHECK(cost > 0.f);
+
+    for(std::string prefix : {"encoder_l1_ffn", "decoder_l1_ffn"}) {
+      CHECK(shapeOf(graph, prefix + "_W1") == Shape({8, 4}));
+      CHECK(shapeOf(graph, prefix + "_b1") == Shape({1, 4}));
+      CHECK(shapeOf(graph, prefix + "_W2") == Shape({4, 8}));
+    }
+    for(std::string prefix :
+        {"encoder_l1_self", "decoder_l1_self", "decoder_l1_context"}) {
+      for(std::string name : {"_Wq", "_Wk", "_Wv"})
+        CHECK(shapeOf(graph, prefix + name) == Shape({8, 6}));
+      for(std::string name : {"_bq", "_bk", "_bv"})
+        CHECK(shapeOf(graph, prefix + name) == Shape({1, 6}));
+      CHECK(shapeOf(graph, prefix + "_Wo") == Shape({6, 8}));
+    }
+  }
+
+  SECTION("deep output units of RNN models") {
+    auto options = modelOptions("s2s");
+    {
+      auto graph = New<ExpressionGraph>(true);
+      forward(graph, options);
+      CHECK(shapeOf(graph, "decoder_ff_logit_l1_W0") == Shape({8, 8}));
+      models::from_options(options)->save(graph, fname);
+      marian::io::waitForSaves();
+    }
+
+    ModelPruner pruner(fname);
+    CHECK(pruner.pruneDeepOutput(0.5f) == 4);
+    pruner.save(pruned);
+
+    auto graph = New<ExpressionGraph>(true);
+    float cost = forward(graph, options, pruned);
+    CHECK(cost > 0.f);
+
+    // the inputs are the embeddings, the decoder state and the context of
+    // the bidirectional encoder
+    CHECK(shapeOf(graph, "decoder_ff_logit_l1_W0") == Shape({8, 4}));
+    CHECK(shapeOf(graph, "decoder_ff_logit_l1_W1") == Shape({8, 4}));
+    CHECK(shapeOf(graph, "decoder_ff_logit_l1_W2") == Shape({16, 4}));
+    CHECK(shapeOf(graph, "decoder_ff_logit_l1_b0") == Shape({1, 4}));
+    CHECK(shapeOf(graph, "decoder_ff_logit_l2_W") == Shape({4, 10}));
+  }
+
+  std::remove(fname.c_str());
+  std::remove(pruned.c_str());
+}
+#endif
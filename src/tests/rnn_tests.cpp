@@ -3,6 +3,7 @@
 
 #include "rnn/rnn.h"
 #include "rnn/constructors.h"
+#include "models/transformer.h"
 
 using namespace marian;
 
@@ -290,3 +291,197 @@ TEST_CASE("Model components, RNN etc. (cpu)", "[model]") {
   tests(DeviceType::cpu);
 }
 #endif
+
+#ifdef BLAS_FOUND
+typedef std::function<Expr(Ptr<ExpressionGraph>, const std::vector<Expr>&)>
+    SequenceOp;
+
+// Weighted sum of the outputs of a sequence op applied to parameters with the
+// given values, optionally with the gradients of the parameters
+float sequenceLoss(const SequenceOp& op,
+                   const std::vector<Shape>& shapes,
+                   const std::vector<std::vector<float>>& values,
+                   std::vector<std::vector<float>>* grads = nullptr) {
+  auto graph = New<ExpressionGraph>();
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(4);
+
+  std::vector<Expr> inputs;
+  for(size_t i = 0; i < shapes.size(); ++i)
+    inputs.push_back(graph->param("input" + std::to_string(i),
+                                  shapes[i],
+                                  inits::from_vector(values[i])));
+
+  auto output = op(graph, inputs);
+  int dim = output->shape().elements();
+  std::vector<float> weights(dim);
+  for(int k = 0; k < dim; ++k)
+    weights[k] = std::sin(k + 1.f);
+  auto loss = sum(reshape(output * graph->constant(output->shape(),
+                                                   inits::from_vector(weights)),
+                          {1, dim}),
+                  keywords::axis = 1);
+
+  if(grads) {
+    graph->backprop();
+    grads->resize(inputs.size());
+    for(size_t i = 0; i < inputs.size(); ++i)
+      inputs[i]->grad()->get((*grads)[i]);
+  } else {
+    graph->forward();
+  }
+
+  std::vector<float> value;
+  loss->val()->get(value);
+  return value[0];
+}
+
+// Compares the gradients of all inputs of a sequence op with central
+// differences of its loss
+void checkSequenceGradients(const SequenceOp& op,
+                            const std::vector<Shape>& shapes) {
+  std::vector<std::vector<float>> values(shapes.size());
+  for(size_t i = 0; i < shapes.size(); ++i)
+    for(int k = 0; k < shapes[i].elements(); ++k)
+      values[i].push_back(0.5f * std::sin(1.7f * k + i));
+
+  std::vector<std::vector<float>> grads;
+  sequenceLoss(op, shapes, values, &grads);
+
+  float eps = 1e-2f;
+  for(size_t i = 0; i < values.size(); ++i) {
+    for(size_t k = 0; k < values[i].size(); ++k) {
+      auto plus = values;
+      plus[i][k] += eps;
+      auto minus = values;
+      minus[i][k] -= eps;
+      float numeric = (sequenceLoss(op, shapes, plus)
+                       - sequenceLoss(op, shapes, minus))
+                      / (2 * eps);
+      INFO("input " << i << ", element " << k);
+      CHECK(grads[i][k] == Approx(numeric).epsilon(0.02).margin(2e-3));
+    }
+  }
+}
+
+TEST_CASE("Fused RNN sequence gradients (cpu)", "[model]") {
+  // three columns do not fill a vector register, the last step of the second
+  // sentence is masked
+  int dimTime = 3, dimBatch = 2, dimState = 3;
+  std::vector<float> vMask = {1, 1, 1, 1, 1, 0};
+
+  auto mask = [&](Ptr<ExpressionGraph> graph) {
+    return graph->constant({dimTime, dimBatch, 1}, inits::from_vector(vMask));
+  };
+
+  for(bool reverse : {false, true}) {
+    for(bool final : {false, true}) {
+      SECTION(std::string("GRU") + (final ? ", final" : "")
+              + (reverse ? ", reverse" : "")) {
+        checkSequenceGradients(
+            [&](Ptr<ExpressionGraph> graph, const std::vector<Expr>& in) {
+              return rnn::gruSequenceOps(
+                  {in[0], in[1], in[2], in[3], mask(graph)}, final, reverse);
+            },
+            {{dimBatch, dimState},
+             {dimTime, dimBatch, 3 * dimState},
+             {dimState, 3 * dimState},
+             {1, 3 * dimState}});
+      }
+    }
+
+    SECTION(std::string("LSTM") + (reverse ? ", reverse" : "")) {
+      checkSequenceGradients(
+          [&](Ptr<ExpressionGraph> graph, const std::vector<Expr>& in) {
+            return rnn::lstmSequenceOps(
+                {in[0], in[1], in[2], in[3], in[4], mask(graph)}, reverse);
+          },
+          {{dimBatch, dimState},
+           {dimBatch, dimState},
+           {dimTime, dimBatch, 4 * dimState},
+           {dimState, 4 * dimState},
+           {1, 4 * dimState}});
+    }
+  }
+}
+#endif
+
+#ifdef BLAS_FOUND
+TEST_CASE("SSRU decoding step by step matches the full sequence (cpu)",
+          "[model]") {
+  Config::seed = 1234;
+
+  auto options = New<Options>();
+  options->set("inference", true);
+  options->set("dim-vocabs", std::vector<int>({10, 10}));
+  options->set("dim-emb", 8);
+  options->set("dec-depth", 2);
+  options->set("transformer-decoder-autoreg", std::string("ssru"));
+  options->set("transformer-dim-ffn", 16);
+  options->set("transformer-preprocess", std::string(""));
+  options->set("transformer-postprocess", std::string("dan"));
+  options->set("transformer-postprocess-emb", std::string("d"));
+  options->set("transformer-dropout", 0.f);
+  options->set("dropout-trg", 0.f);
+  options->set("tied-embeddings", false);
+  options->set("tied-embeddings-src", false);
+  options->set("tied-embeddings-all", false);
+
+  auto graph = New<ExpressionGraph>(true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(16);
+
+  // a language model without encoder, the first word of the second sentence
+  // is the last one of the first sentence
+  int dimTime = 4, dimBatch = 2;
+  std::vector<size_t> words = {3, 7, 1, 5, 9, 2, 4, 3};
+
+  std::vector<Ptr<data::SubBatch>> subBatches;
+  for(int i = 0; i < 2; ++i) {
+    auto sb = New<data::SubBatch>(dimBatch, dimTime);
+    std::copy(words.begin(), words.end(), sb->indices().begin());
+    for(int j = 0; j < dimBatch; ++j)
+      sb->setLength(j, dimTime);
+    subBatches.push_back(sb);
+  }
+  auto batch = New<data::CorpusBatch>(subBatches);
+
+  auto decoder = New<DecoderTransformer>(options);
+  std::vector<Ptr<EncoderState>> encStates;
+
+  auto fullState = decoder->startState(graph, batch, encStates);
+  decoder->groundTruth(fullState, graph, batch);
+  auto full = decoder->step(graph, fullState)->getProbs();
+
+  // the words of the previous position are embedded at every step, the state
+  // carries the recurrent layers and the position
+  std::vector<Expr> steps;
+  auto state = decoder->startState(graph, batch, encStates);
+  for(int t = 0; t < dimTime; ++t) {
+    std::vector<size_t> prev;
+    if(t > 0)
+      prev.assign(words.begin() + (t - 1) * dimBatch,
+                  words.begin() + t * dimBatch);
+    decoder->selectEmbeddings(graph, state, prev, dimBatch, 1);
+    state->setSingleStep(true);
+    state = decoder->step(graph, state);
+    steps.push_back(state->getProbs());
+  }
+
+  graph->forward();
+
+  CHECK(full->shape() == Shape({1, dimTime, dimBatch, 10}));
+  std::vector<float> vFull;
+  full->val()->get(vFull);
+
+  for(int t = 0; t < dimTime; ++t) {
+    CHECK(steps[t]->shape() == Shape({1, 1, dimBatch, 10}));
+    std::vector<float> vStep;
+    steps[t]->val()->get(vStep);
+    for(size_t k = 0; k < vStep.size(); ++k) {
+      INFO("position " << t << ", element " << k);
+      CHECK(vStep[k] == Approx(vFull[t * vStep.size() + k]).epsilon(1e-4));
+    }
+  }
+}
+#endif
@@ -0,0 +1,224 @@
+#include "training/gradient_compressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "common/logging.h"
+
+namespace marian {
+
+namespace {
+// Layout of a message: the header, the indices of the values if gradients
+// were dropped, then either the values as floats or the scales of the blocks
+// followed by the values as 8-bit integers
+struct Header {
+  uint32_t size;   // number of gradients
+  uint32_t count;  // number of values sent
+  uint32_t flags;
+};
+
+const uint32_t SPARSE = 1;
+const uint32_t QUANTIZED = 2;
+
+// Values sharing a scale when quantized
+const size_t QUANTIZATION_BLOCK = 256;
+
+size_t blocks(size_t count) {
+  return (count + QUANTIZATION_BLOCK - 1) / QUANTIZATION_BLOCK;
+}
+
+size_t messageBytes(size_t count, bool sparse, bool quantized) {
+  size_t bytes = sizeof(Header);
+  if(sparse)
+    bytes += count * sizeof(uint32_t);
+  if(quantized)
+    bytes += blocks(count) * sizeof(float) + count * sizeof(int8_t);
+  else
+    bytes += count * sizeof(float);
+  return bytes;
+}
+}
+
+GradientCompressor::GradientCompressor(size_t size,
+                                       float dropRate,
+                                       float momentum,
+                                       bool quantize)
+    : residual_(size, 0.f),
+      dropRate_(dropRate),
+      momentum_(momentum),
+      quantize_(quantize) {
+  if(dropRate_ > 0 && momentum_ > 0)
+    velocity_.resize(size, 0.f);
+}
+
+size_t GradientCompressor::sparseCapacity(size_t size) const {
+  return std::min(size, (size_t)std::ceil(size * (1.f - dropRate_)));
+}
+
+void GradientCompressor::selectLargest(const float* values,
+                                       size_t size,
+                                       std::vector<uint32_t>& indices) {
+  size_t k = sparseCapacity(size);
+  indices.clear();
+  indices.reserve(k);
+  if(k == 0)
+    return;
+
+  // the k-th largest absolute value, and how many values equal to it are
+  // needed after all larger ones
+  magnitudes_.resize(size);
+  for(size_t i = 0; i < size; ++i)
+    magnitudes_[i] = std::abs(values[i]);
+  std::nth_element(magnitudes_.begin(),
+                   magnitudes_.begin() + (size - k),
+                   magnitudes_.end());
+  float cut = magnitudes_[size - k];
+  size_t ties = k;
+  for(size_t i = size - k; i < size; ++i)
+    if(magnitudes_[i] > cut)
+      ties--;
+
+  for(size_t i = 0; i < size; ++i) {
+    float magnitude = std::abs(values[i]);
+    if(magnitude > cut) {
+      indices.push_back(i);
+    } else if(magnitude == cut && ties > 0) {
+      indices.push_back(i);
+      ties--;
+    }
+  }
+}
+
+void GradientCompressor::addMomentum(float* grads, size_t offset, size_t size) {
+  if(velocity_.empty())
+    return;
+
+  float* velocity = velocity_.data() + offset;
+  for(size_t i = 0; i < size; ++i) {
+    velocity[i] = momentum_ * velocity[i] + grads[i];
+    grads[i] = velocity[i];
+  }
+}
+
+void GradientCompressor::resetMomentum(size_t offset, size_t size) {
+  if(!velocity_.empty())
+    std::fill(velocity_.begin() + offset, velocity_.begin() + offset + size, 0.f);
+}
+
+void GradientCompressor::compress(const float* grads,
+                                  size_t offset,
+                                  size_t size,
+                                  std::vector<char>& message,
+                                  bool drop) {
+  float* residual = residual_.data() + offset;
+  float* velocity = velocity_.empty() ? nullptr : velocity_.data() + offset;
+
+  // the residual becomes the gradients to send
+  for(size_t i = 0; i < size; ++i)
+    residual[i] += grads[i];
+
+  bool sparse = drop && dropRate_ > 0;
+  std::vector<uint32_t> indices;
+  if(sparse)
+    selectLargest(residual, size, indices);
+
+  size_t count = sparse ? indices.size() : size;
+  auto value = [&](size_t j) -> float& {
+    return residual[sparse ? indices[j] : j];
+  };
+
+  message.resize(messageBytes(count, sparse, quantize_));
+  Header* header = (Header*)message.data();
+  header->size = size;
+  header->count = count;
+  header->flags = (sparse ? SPARSE : 0) | (quantize_ ? QUANTIZED : 0);
+
+  char* pos = message.data() + sizeof(Header);
+  if(sparse) {
+    std::copy(indices.begin(), indices.end(), (uint32_t*)pos);
+    pos += count * sizeof(uint32_t);
+  }
+
+  // sent values are subtracted from the residual, rounding errors remain
+  if(quantize_) {
+    float* scales = (float*)pos;
+    int8_t* quantized = (int8_t*)(pos + blocks(count) * sizeof(float));
+    for(size_t b = 0; b < blocks(count); ++b) {
+      size_t begin = b * QUANTIZATION_BLOCK;
+      size_t end = std::min(begin + QUANTIZATION_BLOCK, count);
+
+      float maxAbs = 0;
+      for(size_t j = begin; j < end; ++j)
+        maxAbs = std::max(maxAbs, std::abs(value(j)));
+      float scale = maxAbs / 127.f;
+      scales[b] = scale;
+
+      for(size_t j = begin; j < end; ++j) {
+        long q = scale > 0 ? std::lround(value(j) / scale) : 0;
+        q = std::max(-127l, std::min(127l, q));
+        quantized[j] = q;
+        value(j) -= q * scale;
+      }
+    }
+  } else {
+    float* values = (float*)pos;
+    for(size_t j = 0; j < count; ++j) {
+      values[j] = value(j);
+      value(j) = 0;
+    }
+  }
+
+  // momentum factor masking for the values that have been sent
+  if(velocity) {
+    if(sparse)
+      for(auto i : indices)
+        velocity[i] = 0;
+    else
+      std::fill(velocity, velocity + size, 0.f);
+  }
+}
+
+size_t GradientCompressor::maxBytes(size_t size) const {
+  size_t bytes = messageBytes(size, false, quantize_);
+  if(dropRate_ > 0)
+    bytes = std::max(bytes,
+                     messageBytes(sparseCapacity(size), true, quantize_));
+  return bytes;
+}
+
+void GradientCompressor::decompressAdd(const char* message,
+                                       float* grads,
+                                       size_t size) {
+  const Header* header = (const Header*)message;
+  ABORT_IF(header->size != size,
+           "Compressed gradients hold {} values instead of {}",
+           header->size,
+           size);
+
+  size_t count = header->count;
+  const char* pos = message + sizeof(Header);
+
+  const uint32_t* indices = nullptr;
+  if(header->flags & SPARSE) {
+    indices = (const uint32_t*)pos;
+    pos += count * sizeof(uint32_t);
+  }
+
+  auto index = [indices](size_t j) -> size_t {
+    return indices ? indices[j] : j;
+  };
+
+  if(header->flags & QUANTIZED) {
+    const float* scales = (const float*)pos;
+    const int8_t* quantized
+        = (const int8_t*)(pos + blocks(count) * sizeof(float));
+    for(size_t j = 0; j < count; ++j)
+      grads[index(j)] += quantized[j] * scales[j / QUANTIZATION_BLOCK];
+  } else {
+    const float* values = (const float*)pos;
+    for(size_t j = 0; j < count; ++j)
+      grads[index(j)] += values[j];
+  }
+}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "common/definitions.h"
+
+namespace marian {
+
+/**
+ * @brief Compresses gradients in host memory for sending them between nodes.
+ *
+ * With a dropping rate, only the gradients with the largest absolute values
+ * are sent, as pairs of index and value; exactly the top (1 - rate) of each
+ * compressed range are selected. With quantization, values are sent
+ * as 8-bit integers with a scale per block of values. Everything that is not
+ * sent, dropped gradients as well as rounding errors, is kept in a residual
+ * and added to the gradients at the same positions the next time they are
+ * compressed, so updates are delayed rather than lost.
+ *
+ * The residual covers size values, and every call compresses a range of it,
+ * so a single compressor can serve the chunks of a larger vector.
+ *
+ * With a momentum, the gradients of a node are accumulated in a velocity
+ * before they are compressed (momentum correction), and the velocity is
+ * cleared where values have been sent (momentum factor masking). The
+ * momentum is added separately from compress, since compressed values may
+ * also be sums of gradients of several nodes.
+ */
+class GradientCompressor {
+private:
+  std::vector<float> residual_;
+  std::vector<float> velocity_;
+  std::vector<float> magnitudes_;
+
+  float dropRate_;
+  float momentum_;
+  bool quantize_;
+
+  /** Number of values sent out of size with dropping. */
+  size_t sparseCapacity(size_t size) const;
+
+  /**
+   * Indices of the sparseCapacity(size) values with the largest absolute
+   * values, in increasing order.
+   */
+  void selectLargest(const float* values,
+                     size_t size,
+                     std::vector<uint32_t>& indices);
+
+public:
+  /**
+   * @param size Number of gradients the residual is kept for
+   * @param dropRate Fraction of gradients to drop, 0 to send all
+   * @param momentum Momentum of the momentum correction for dropped gradients
+   * @param quantize Send values as 8-bit integers
+   */
+  GradientCompressor(size_t size, float dropRate, float momentum, bool quantize);
+
+  /**
+   * @brief Replaces the local gradients at [offset, offset + size) with
+   * their velocity, if a momentum is used. Call this once per update before
+   * the gradients are compressed or summed with those of other nodes.
+   */
+  void addMomentum(float* grads, size_t offset, size_t size);
+
+  /**
+   * @brief Clears the velocity at [offset, offset + size), for gradients
+   * which have been applied without compression.
+   */
+  void resetMomentum(size_t offset, size_t size);
+
+  /**
+   * @brief Adds the residual at [offset, offset + size) to grads and writes
+   * the result to message; whatever is not sent remains as residual.
+   *
+   * @param drop Whether to drop gradients, false e.g. during warm-up
+   */
+  void compress(const float* grads,
+                size_t offset,
+                size_t size,
+                std::vector<char>& message,
+                bool drop = true);
+
+  /** @brief Upper bound of the bytes of a message with size gradients. */
+  size_t maxBytes(size_t size) const;
+
+  /** @brief Adds the gradients in message to the size values of grads. */
+  static void decompressAdd(const char* message, float* grads, size_t size);
+};
+}
@@ -13,6 +13,7 @@ protected:
   Ptr<Config> options_;
   Ptr<OptimizerBase> opt_;
   Ptr<Scheduler> scheduler_;
+  Ptr<data::BatchStats> stats_;
 
   bool scaleLearningRate_;
   float avgBatchWords_;
@@ -37,5 +38,40 @@ public:
   virtual void setScheduler(Ptr<Scheduler> scheduler) = 0;
 
   virtual Ptr<data::BatchStats> collectStats() = 0;
+
+  /**
+   * Set the batch statistics used to create the training batches, which are
+   * adjusted to the peak memory of the graphs.
+   */
+  void setBatchStats(Ptr<data::BatchStats> stats) { stats_ = stats; }
+
+  /**
+   * Weights of the costs and gradients of the parts of a split batch, so that
+   * their weighted sum is the cost and gradient of the whole batch: the share
+   * of target words of each part if the cost is averaged over words, the
+   * share of sentences if it is averaged over sentences, 1 for summed costs.
+   */
+  std::vector<float> splitWeights(const std::vector<Ptr<data::Batch>>& parts) {
+    auto costType = options_->get<std::string>("cost-type");
+    bool perWord = costType == "ce-mean-words" || costType == "perplexity";
+
+    std::vector<float> weights;
+    float total = 0;
+    for(auto part : parts) {
+      weights.push_back(perWord ? part->wordsTrg() : part->size());
+      total += weights.back();
+    }
+
+    for(auto& weight : weights)
+      weight = costType == "ce-sum" ? 1.f : weight / total;
+    return weights;
+  }
+
+  /** Report the peak memory of the graph for the given batch. */
+  void reportMemory(Ptr<ExpressionGraph> graph, Ptr<data::Batch> batch) {
+    if(stats_)
+      stats_->reportPeak(std::static_pointer_cast<data::CorpusBatch>(batch),
+                         graph->allocator()->peak());
+  }
 };
 }
@@ -63,18 +63,20 @@ void AsyncGraphGroup::pushGradients(Tensor newGrads,
 
           Tensor updater = (gradientBufferSize_ > 1)?bufferGrads_[idx]:grads_[idx];
 
-          if(scaleLearningRate_) {
+          float factor = scaleLearningRate_ ? batch_words / avgBatchWords_ : 1.f;
+
+          if(movingAvg_) {
             shardOpt_[idx]->update(
-                params_[idx], updater, batch_words / avgBatchWords_);
+                params_[idx],
+                updater,
+                factor,
+                paramsAvg_[idx],
+                movingAverageDecay(scheduler_->numberOfBatches()));
           } else {
-            shardOpt_[idx]->update(params_[idx], updater);
+            shardOpt_[idx]->update(params_[idx], updater, factor);
           }
 
           if (gradientBufferSize_ > 1) bufferGrads_[idx]->set(0);
-
-          if(movingAvg_)
-            updateMovingAverage(
-                paramsAvg_[idx], params_[idx], scheduler_->numberOfBatches());
         },
         idx,
         pos));
@@ -85,13 +87,9 @@ void AsyncGraphGroup::pushGradients(Tensor newGrads,
     t.join();
 }
 
-void AsyncGraphGroup::updateMovingAverage(Tensor paramsAvg,
-                                          Tensor params,
-                                          size_t batches) {
-  using namespace functional;
-  float decay
-      = std::max(mvDecay_, 1.f - (float)(batches + 1) / (float)(batches + 10));
-  Element(_1 = ((1.f - decay) * _1) + (decay * _2), paramsAvg, params);
+float AsyncGraphGroup::movingAverageDecay(size_t batches) {
+  return std::max(mvDecay_,
+                  1.f - (float)(batches + 1) / (float)(batches + 10));
 }
 
 void AsyncGraphGroup::init(Ptr<data::Batch> batch) {
@@ -195,8 +193,7 @@ void AsyncGraphGroup::execute(Ptr<data::Batch> batch) {
     thread_local size_t num_seen_words = 0;
     thread_local int t_id = 0;
     thread_local float cost = 0;
-    thread_local int sentences = 0;
-    thread_local int words = 0;
+    thread_local std::vector<Ptr<data::Batch>> seenBatches;
 
     thread_local Tensor accGradients;
     thread_local Ptr<TensorAllocator> accAlloc;
@@ -217,12 +214,11 @@ void AsyncGraphGroup::execute(Ptr<data::Batch> batch) {
     graph->forward();
     cost += costNode->scalar();
     graph->backward();
+    reportMemory(graph, batch);
 
     // Get batch stats
     size_t batch_words = batch->wordsTrg();
-    
-    words += batch->words();
-    sentences += batch->size();
+    seenBatches.push_back(batch);
 
     Tensor gradients;
     if(tau_ > 1) {
@@ -264,11 +260,8 @@ void AsyncGraphGroup::execute(Ptr<data::Batch> batch) {
       cost /= (tau_ * gradientBufferSize_);
 
 
-      //@TOOD AHAM
-      //scheduler_->update(cost, batch);
-      scheduler_->update(cost, sentences, words);
-      sentences = 0;
-      words = 0;
+      scheduler_->update(cost, seenBatches);
+      seenBatches.clear();
       cost = 0;
 
       if(scheduler_->saving() || scheduler_->validating()) {
@@ -60,7 +60,7 @@ protected:
                              size_t batch_words,
                              int device_id);
 
-  void updateMovingAverage(Tensor paramsAvg, Tensor params, size_t batches);
+  float movingAverageDecay(size_t batches);
 
   void execute(Ptr<data::Batch> batch);
 
@@ -80,6 +80,7 @@ public:
       auto graph = New<ExpressionGraph>();
       graph->setDevice(device);
       graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+      graph->setCheckpointing(options_->get<bool>("gradient-checkpointing"));
       graphs_.push_back(graph);
       shardOpt_.push_back(Optimizer(options_));
       builders_.push_back(models::from_config(options_));
@@ -138,8 +139,6 @@ public:
 
     if(options_->get<bool>("overwrite")) {
       builders_[idx]->save(graphs_[idx], name, true);
-      if(scheduler_)
-        scheduler_->save(name);
     } else {
       if(!final) {
         std::string numberOfBatches
@@ -152,12 +151,14 @@ public:
       }
 
       builders_[idx]->save(graphs_[idx], name, true);
-      if(scheduler_)
-        scheduler_->save(name);
     }
 
     size_t totalSize = graphs_[idx]->params()->vals()->size();
     shardOpt_[idx]->save(name + ".optimizer.npz", shardOpt_, totalSize);
+
+    // the progress is queued after the model and optimizer files
+    if(scheduler_)
+      scheduler_->save(name);
   }
 
   Ptr<data::BatchStats> collectStats() {
@@ -110,17 +110,19 @@ void AsyncGraphGroupDrop::pushGradients(Tensor newGrads,
           // convert back to dense, store it in grads_[idx]
           pushShardedSparseGradient_[idx]->toDense(grads_[idx], -pos);
 
-          if(scaleLearningRate_) {
+          float factor = scaleLearningRate_ ? batch_words / avgBatchWords_ : 1.f;
+
+          if(movingAvg_) {
             shardOpt_[idx]->update(
-                params_[idx], grads_[idx], batch_words / avgBatchWords_);
+                params_[idx],
+                grads_[idx],
+                factor,
+                paramsAvg_[idx],
+                movingAverageDecay(scheduler_->numberOfBatches()));
           } else {
-            shardOpt_[idx]->update(params_[idx], grads_[idx]);
+            shardOpt_[idx]->update(params_[idx], grads_[idx], factor);
           }
 
-          if(movingAvg_)
-            updateMovingAverage(
-                paramsAvg_[idx], params_[idx], scheduler_->numberOfBatches());
-
         },
         idx,
         pos));
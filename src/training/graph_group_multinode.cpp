@@ -2,8 +2,46 @@
 #include "tensors/tensor_operators.h"
 #include "functional/functional.h"
 
+#include <algorithm>
+#include <atomic>
+
 namespace marian {
 
+#if MPI_FOUND
+namespace {
+/**
+ * Gradients pushed by a client to the server shards of a node. They are
+ * received chunk by chunk and replaced by the updated parameters shard by
+ * shard, which are sent back to the client.
+ */
+struct ServerPush {
+  int node;
+  int client;
+  size_t batchWords;
+
+  /** Gradients and then parameters of the node. */
+  std::vector<float> buffer;
+
+  /** Receive buffers for compressed chunks. */
+  std::vector<std::vector<char>> messages;
+
+  /** Receive requests of the chunks and number of chunks still expected. */
+  std::vector<MPI_Request> recvs;
+  size_t pendingRecvs{0};
+
+  /** Chunks still expected for each shard. */
+  std::vector<size_t> pendingChunks;
+
+  /** Shards that have not been updated yet. */
+  std::atomic<size_t> pendingShards{0};
+
+  /** Send requests of the updated parameters. */
+  std::mutex mutexSends;
+  std::vector<MPI_Request> sends;
+};
+}
+#endif
+
 /**
  * Set given scheduler to register training observers on the shard optimizers.
  */
@@ -71,7 +109,9 @@ void MultiNodeGraphGroup::setupMPI() {
 void MultiNodeGraphGroup::setupClients(Ptr<data::Batch> batch) {
   runBatchThroughClientGraphs(batch);
   calculateNodeSizes();
+  calculateChunks();
   initClientCpuBuffers();
+  initClientCompressors();
   if(clientCommOverlap) {
     initClientCommOverlapVars();
     initClientCommOverlapGpuTensors();
@@ -100,12 +140,49 @@ void MultiNodeGraphGroup::calculateNodeSizes() {
   size_t modelSize = clientGraphs_[0]->params()->vals()->size();
   size_t nodeSize = ceilf(((float)modelSize) / mpi_comm_world_size_);
   for(int node = 0; node < mpi_comm_world_size_; node++) {
-    size_t remainingModelSize = modelSize - (nodeSize * node);
+    size_t remainingModelSize
+        = modelSize - std::min(modelSize, nodeSize * node);
     // Takes care of edge case where last node is smaller than the others
     nodeSizes_.push_back(std::min(nodeSize, remainingModelSize));
   }
 }
 
+/**
+ * Split the parameters of each node into chunks of at most chunkSize_ values
+ * that do not cross the boundaries of its shards.
+ */
+void MultiNodeGraphGroup::calculateChunks() {
+  ABORT_IF(chunkSize_ == 0, "Chunks of multi-node messages cannot be empty");
+  for(int node = 0; node < mpi_comm_world_size_; node++) {
+    std::vector<Chunk> chunks;
+    size_t offset = 0;
+    auto shardSizes = shardSizesOfNode(node);
+    for(size_t shard = 0; shard < shardSizes.size(); shard++) {
+      for(size_t pos = 0; pos < shardSizes[shard]; pos += chunkSize_)
+        chunks.push_back(
+            {shard, offset + pos, std::min(chunkSize_, shardSizes[shard] - pos)});
+      offset += shardSizes[shard];
+    }
+    nodeChunks_.push_back(chunks);
+  }
+}
+
+/**
+ * Sizes of the shards of the given node, the last of which may be smaller than
+ * the others.
+ */
+std::vector<size_t> MultiNodeGraphGroup::shardSizesOfNode(int node) {
+  size_t nodeSize = nodeSizes_[node];
+  size_t shards = numberClientsOfNodes_[node];
+  size_t shardSize = ceilf(((float)nodeSize) / shards);
+  std::vector<size_t> sizes;
+  for(size_t shard = 0; shard < shards; shard++) {
+    size_t remainingNodeSize = nodeSize - std::min(nodeSize, shardSize * shard);
+    sizes.push_back(std::min(shardSize, remainingNodeSize));
+  }
+  return sizes;
+}
+
 /**
  * Initialize a CPU buffer for each client on this node for storing gradients or
  * parameters.
@@ -114,13 +191,42 @@ void MultiNodeGraphGroup::calculateNodeSizes() {
  */
 void MultiNodeGraphGroup::initClientCpuBuffers() {
   // Initialize CPU buffers used to send GPU data through MPI (can't send
-  // directly from GPUs)
+  // directly from GPUs). Gradients are copied in one go, then sent to all
+  // nodes while parameters are received in parallel.
+  size_t modelSize = clientGraphs_[0]->params()->vals()->size();
+  for(int i = 0; i < devices_.size(); i++) {
+    clientCommBuffersCPU_.push_back(std::vector<float>(modelSize));
+    clientParamBuffersCPU_.push_back(std::vector<float>(modelSize));
+  }
+}
+
+/**
+ * Initialize a compressor for the gradients of each client and node if
+ * gradients are dropped or quantized.
+ */
+void MultiNodeGraphGroup::initClientCompressors() {
+  if(!compressGradients_)
+    return;
+
   for(int i = 0; i < devices_.size(); i++) {
-    // @TODO Optimization: Use full size to copy in one go, then send gradients
-    // and receive parameters in parallel
-    size_t size = nodeSizes_[mpi_my_rank_];
-    clientCommBuffersCPU_.push_back(std::vector<float>(size));
+    std::vector<Ptr<GradientCompressor>> compressors;
+    for(int node = 0; node < mpi_comm_world_size_; node++)
+      compressors.push_back(
+          New<GradientCompressor>(nodeSizes_[node],
+                                  options_->get<float>("grad-dropping-rate"),
+                                  options_->get<float>("grad-dropping-momentum"),
+                                  options_->get<bool>("grad-quantize")));
+    clientCompressors_.push_back(compressors);
   }
+  clientPushSteps_ = std::vector<size_t>(devices_.size(), 0);
+
+  // Every chunk is compressed into its own message
+  size_t chunks = 0;
+  for(auto& nodeChunks : nodeChunks_)
+    chunks += nodeChunks.size();
+  clientMessageBuffersCPU_ = std::vector<std::vector<std::vector<char>>>(
+      devices_.size(), std::vector<std::vector<char>>(chunks));
+  messageCapacity_ = clientCompressors_[0][0]->maxBytes(chunkSize_);
 }
 
 /**
@@ -174,8 +280,6 @@ void MultiNodeGraphGroup::initClientCommOverlapGpuTensors() {
 void MultiNodeGraphGroup::setupServerShards() {
   calculateShardSizes();
   initShardGpuTensors();
-  // CPU buffer for receiving/sending grads/params
-  serverShardBufferCPU_ = std::vector<float>(nodeSizes_[mpi_my_rank_]);
   // Shard optimizers
   for(int shard = 0; shard < devices_.size(); shard++) {
     shardOptimizers_.push_back(Optimizer(options_));
@@ -190,13 +294,7 @@ void MultiNodeGraphGroup::setupServerShards() {
  * the node size is not perfectly divisibly by the number of shards.
  */
 void MultiNodeGraphGroup::calculateShardSizes() {
-  size_t nodeSize = nodeSizes_[mpi_my_rank_];
-  size_t shardSize = ceilf(((float)nodeSize) / devices_.size());
-  for(int shard = 0; shard < devices_.size(); shard++) {
-    size_t remainingNodeSize = nodeSize - (shardSize * shard);
-    // Takes care of edge case where last shard is smaller than the others
-    shardSizes_.push_back(std::min(shardSize, remainingNodeSize));
-  }
+  shardSizes_ = shardSizesOfNode(mpi_my_rank_);
 }
 
 /**
@@ -204,103 +302,230 @@ void MultiNodeGraphGroup::calculateShardSizes() {
  * server shard.
  */
 void MultiNodeGraphGroup::initShardGpuTensors() {
+  // shards start with the parameters of this node
   size_t offset = 0;
+  for(int node = 0; node < mpi_my_rank_; node++)
+    offset += nodeSizes_[node];
   for(int shard = 0; shard < devices_.size(); shard++) {
     Tensor gpuParams = newTensor(shardSizes_[shard], clientGraphs_[shard]->getBackend());
     gpuParams->copyFrom(clientGraphs_[0]->params()->vals()->subtensor(
         offset, shardSizes_[shard]));
     shardParams_.push_back(gpuParams);
     shardGrads_.push_back(newTensor(shardSizes_[shard], clientGraphs_[shard]->getBackend()));
+    offset += shardSizes_[shard];
   }
 }
 
+/**
+ * Tag of the parameter chunks of the given shard sent to the given client.
+ */
+int MultiNodeGraphGroup::paramTag(int client, size_t shard) {
+  int shards = *std::max_element(numberClientsOfNodes_.begin(),
+                                 numberClientsOfNodes_.end());
+  return MPI_TAG_PARAM_PUSH_ + client * shards + shard;
+}
+
 /**
  * Launch independent thread which continually receives gradients assigned to
- * this shard from any client, runs the shard optimizer and sends back the
- * updated parameters.
+ * the shards on this node from any client, runs the shard optimizers and sends
+ * back the updated parameters.
  */
 void MultiNodeGraphGroup::launchServerThread() {
 #if MPI_FOUND
   serverShardThread_ = new std::thread([this] {
-    // keep track of number of nodes still communicating with this shard
-    int nCommunicatingNodes = mpi_comm_world_size_;
-    MPI_Status status;
-    do {
-      // Receive grads from any client
+    const auto& chunks = nodeChunks_[mpi_my_rank_];
+    size_t nodeSize = nodeSizes_[mpi_my_rank_];
+
+    std::vector<size_t> shardOffsets;
+    size_t offset = 0;
+    for(auto size : shardSizes_) {
+      shardOffsets.push_back(offset);
+      offset += size;
+    }
+
+    // Pushes being received or sent back, reused once they are done
+    std::vector<Ptr<ServerPush>> pushes;
+    auto freePush = [&]() {
+      for(auto push : pushes) {
+        if(push->pendingRecvs > 0 || push->pendingShards > 0)
+          continue;
+        int sent;
+        MPI_Testall(push->sends.size(),
+                    push->sends.data(),
+                    &sent,
+                    MPI_STATUSES_IGNORE);
+        if(sent)
+          return push;
+      }
+      auto push = New<ServerPush>();
+      push->buffer.resize(nodeSize);
+      if(compressGradients_)
+        push->messages.resize(chunks.size(),
+                              std::vector<char>(messageCapacity_));
+      pushes.push_back(push);
+      return push;
+    };
+
+    // Update a shard with the received gradients and send its parameters back
+    auto updateShard = [&](Ptr<ServerPush> push, size_t shard) {
+      float* data = push->buffer.data() + shardOffsets[shard];
+      {
+        std::lock_guard<std::mutex> guard(shardMutex_[shard]);
+
+        // Copy grads to appropriate GPU
+        shardGrads_[shard]->set(data, data + shardSizes_[shard]);
+
+        // Run optimizer on GPU
+        if(scaleLearningRate_ && push->batchWords > 0) {
+          shardOptimizers_[shard]->update(shardParams_[shard],
+                                          shardGrads_[shard],
+                                          push->batchWords / avgBatchWords_);
+        } else {
+          shardOptimizers_[shard]->update(shardParams_[shard],
+                                          shardGrads_[shard]);
+        }
+        // Copy params from GPU
+        shardParams_[shard]->copyTo(data);
+      }
+
+      std::vector<MPI_Request> sends;
+      for(auto& chunk : chunks) {
+        if(chunk.shard != shard)
+          continue;
+        MPI_Request request;
+        MPI_Isend(push->buffer.data() + chunk.offset,
+                  chunk.size,
+                  MPI_FLOAT,
+                  push->node,
+                  paramTag(push->client, shard),
+                  MPI_COMM_WORLD,
+                  &request);
+        sends.push_back(request);
+      }
+      {
+        std::lock_guard<std::mutex> guard(push->mutexSends);
+        push->sends.insert(push->sends.end(), sends.begin(), sends.end());
+      }
+      push->pendingShards--;
+    };
+
+    {
+      // Shards are updated while the chunks of other shards and pushes are
+      // still being received
+      ThreadPool shardPool(devices_.size());
+
+      // keep track of number of nodes still communicating with this shard
+      int nCommunicatingNodes = mpi_comm_world_size_;
       unsigned long messageInfo[4];
-      MPI_Recv(&messageInfo,
-               4,
-               MPI_UNSIGNED_LONG,
-               MPI_ANY_SOURCE,
-               MPI_TAG_GRAD_PUSH_,
-               MPI_COMM_WORLD,
-               &status);
-      if(messageInfo[MSG_INFO_STATUS_] == STATUS_NODE_FINISHED_) {
-        nCommunicatingNodes--;
-        continue;
-      }  // register finished node and skip to next loop iteration
-      MPI_Recv(serverShardBufferCPU_.data(),
-               nodeSizes_[mpi_my_rank_],
-               MPI_FLOAT,
-               status.MPI_SOURCE,
-               MPI_TAG_GRAD_PUSH_,
-               MPI_COMM_WORLD,
-               MPI_STATUS_IGNORE);
-
-      // Update shard params asynchronously over GPUs
-      std::vector<std::thread> threads;
-      size_t offset = 0;
-      for(int gpu = 0; gpu < devices_.size(); gpu++) {
-        size_t size = shardSizes_[gpu];
-
-        threads.emplace_back(std::thread(
-            [=](int gpu, size_t offset, size_t size, size_t batchWords) {
-              std::lock_guard<std::mutex> guard(shardMutex_[gpu]);
-
-              // Copy grads to appropriate GPU
-              cudaMemcpy(shardGrads_[gpu]->data(),
-                         &serverShardBufferCPU_.at(offset),
-                         size * sizeof(float),
-                         cudaMemcpyHostToDevice);
-              cudaStreamSynchronize(0);
-
-              // Run optimizer on GPU
-              if(scaleLearningRate_ && batchWords > 0) {
-                shardOptimizers_[gpu]->update(shardParams_[gpu],
-                                              shardGrads_[gpu],
-                                              batchWords / avgBatchWords_);
+      MPI_Request infoRequest;
+      MPI_Irecv(&messageInfo,
+                4,
+                MPI_UNSIGNED_LONG,
+                MPI_ANY_SOURCE,
+                MPI_TAG_GRAD_PUSH_,
+                MPI_COMM_WORLD,
+                &infoRequest);
+
+      std::vector<MPI_Request> requests;
+      std::vector<std::pair<Ptr<ServerPush>, size_t>> owners;
+      while(nCommunicatingNodes != 0) {
+        // Wait for the next message info or chunk of any push
+        requests = {infoRequest};
+        owners = {{nullptr, 0}};
+        for(auto push : pushes) {
+          if(push->pendingRecvs == 0)
+            continue;
+          for(size_t c = 0; c < chunks.size(); ++c) {
+            if(push->recvs[c] != MPI_REQUEST_NULL) {
+              requests.push_back(push->recvs[c]);
+              owners.push_back({push, c});
+            }
+          }
+        }
+
+        int index;
+        MPI_Status status;
+        MPI_Waitany(requests.size(), requests.data(), &index, &status);
+
+        if(index == 0) {
+          if(messageInfo[MSG_INFO_STATUS_] == STATUS_NODE_FINISHED_) {
+            // register finished node
+            nCommunicatingNodes--;
+          } else {
+            ABORT_IF(messageInfo[MSG_INFO_SIZE_] != nodeSize,
+                     "Node {} pushed {} gradients instead of {}",
+                     status.MPI_SOURCE,
+                     messageInfo[MSG_INFO_SIZE_],
+                     nodeSize);
+
+            // Receive grads of this client chunk by chunk
+            auto push = freePush();
+            push->node = status.MPI_SOURCE;
+            push->client = messageInfo[MSG_INFO_CLIENT_];
+            push->batchWords = messageInfo[MSG_INFO_BATCHWORDS_];
+            push->sends.clear();
+            push->pendingChunks = std::vector<size_t>(shardSizes_.size(), 0);
+            for(auto& chunk : chunks)
+              if(push->pendingChunks[chunk.shard]++ == 0)
+                push->pendingShards++;
+
+            if(compressGradients_)
+              std::fill(push->buffer.begin(), push->buffer.end(), 0.f);
+
+            push->recvs.resize(chunks.size());
+            push->pendingRecvs = chunks.size();
+            for(size_t c = 0; c < chunks.size(); ++c) {
+              if(compressGradients_) {
+                MPI_Irecv(push->messages[c].data(),
+                          push->messages[c].size(),
+                          MPI_BYTE,
+                          push->node,
+                          MPI_TAG_GRAD_CHUNK_ + push->client,
+                          MPI_COMM_WORLD,
+                          &push->recvs[c]);
               } else {
-                shardOptimizers_[gpu]->update(shardParams_[gpu],
-                                              shardGrads_[gpu]);
+                MPI_Irecv(push->buffer.data() + chunks[c].offset,
+                          chunks[c].size,
+                          MPI_FLOAT,
+                          push->node,
+                          MPI_TAG_GRAD_CHUNK_ + push->client,
+                          MPI_COMM_WORLD,
+                          &push->recvs[c]);
               }
-              cudaStreamSynchronize(0);
-              // Copy params from GPU
-              cudaMemcpy(&serverShardBufferCPU_.at(offset),
-                         shardParams_[gpu]->data(),
-                         size * sizeof(float),
-                         cudaMemcpyDeviceToHost);
-              cudaStreamSynchronize(0);
-            },
-            gpu,
-            offset,
-            size,
-            messageInfo[MSG_INFO_BATCHWORDS_]));
-
-        offset += size;
-      }
-      for(auto &&t : threads) {
-        t.join();
-      }
+            }
+          }
 
-      // Send updated params to same client
-      MPI_Ssend(serverShardBufferCPU_.data(),
-                nodeSizes_[mpi_my_rank_],
-                MPI_FLOAT,
-                status.MPI_SOURCE,
-                MPI_TAG_PARAM_PUSH_,
-                MPI_COMM_WORLD);
+          if(nCommunicatingNodes != 0)
+            MPI_Irecv(&messageInfo,
+                      4,
+                      MPI_UNSIGNED_LONG,
+                      MPI_ANY_SOURCE,
+                      MPI_TAG_GRAD_PUSH_,
+                      MPI_COMM_WORLD,
+                      &infoRequest);
+          continue;
+        }
 
-    } while(nCommunicatingNodes != 0);
+        auto push = owners[index].first;
+        size_t c = owners[index].second;
+        push->recvs[c] = MPI_REQUEST_NULL;
+        push->pendingRecvs--;
+
+        const Chunk& chunk = chunks[c];
+        if(compressGradients_)
+          GradientCompressor::decompressAdd(push->messages[c].data(),
+                                            push->buffer.data() + chunk.offset,
+                                            chunk.size);
+
+        // Update the shard as soon as all of its chunks have arrived
+        if(--push->pendingChunks[chunk.shard] == 0)
+          shardPool.enqueue(updateShard, push, chunk.shard);
+      }
+    }
+
+    // All clients have received their parameters, complete the sends
+    for(auto push : pushes)
+      MPI_Waitall(push->sends.size(), push->sends.data(), MPI_STATUSES_IGNORE);
   });
 #endif
 }
@@ -379,94 +604,133 @@ void MultiNodeGraphGroup::synchronizeWithServerShards(Tensor newGrads,
                                                       int gpu,
                                                       size_t batchWords) {
 #if MPI_FOUND
+  std::vector<MPI_Request> requests;
+  size_t localOffset = 0;
+
+  if(mpi_comm_world_size_ > 1) {
+    // Copy grads from GPU to CPU (for MPI sending)
+    newGrads->copyTo(clientCommBuffersCPU_[gpu].data());
+  }
+
   size_t offset = 0;
+  size_t message = 0;
   for(int node = 0; node < mpi_comm_world_size_; node++) {
-    size_t nodeSize = nodeSizes_[node];
-
     // Update remotely if node != this node
     if(node != mpi_my_rank_) {
-      // Copy grads from GPU to CPU (for MPI sending)
-      cudaMemcpy(clientCommBuffersCPU_[gpu].data(),
-                 newGrads->subtensor(offset, nodeSize)->data(),
-                 nodeSize * sizeof(float),
-                 cudaMemcpyDeviceToHost);
-      cudaStreamSynchronize(0);
+      float* grads = clientCommBuffersCPU_[gpu].data() + offset;
+      float* params = clientParamBuffersCPU_[gpu].data() + offset;
+
+      // Receive updated params of each shard of the server node in any order
+      for(auto& chunk : nodeChunks_[node]) {
+        MPI_Request request;
+        MPI_Irecv(params + chunk.offset,
+                  chunk.size,
+                  MPI_FLOAT,
+                  node,
+                  paramTag(gpu, chunk.shard),
+                  MPI_COMM_WORLD,
+                  &request);
+        requests.push_back(request);
+      }
 
       // Send grads to server node
-      size_t messageInfo[4];
-      messageInfo[MSG_INFO_SIZE_] = nodeSize;
+      unsigned long messageInfo[4];
+      messageInfo[MSG_INFO_SIZE_] = nodeSizes_[node];
       messageInfo[MSG_INFO_CLIENT_] = gpu;
       messageInfo[MSG_INFO_BATCHWORDS_] = batchWords;
       messageInfo[MSG_INFO_STATUS_] = STATUS_NODE_TRAINING_;
-      MPI_Ssend(&messageInfo,
-                4,
-                MPI_UNSIGNED_LONG,
-                node,
-                MPI_TAG_GRAD_PUSH_,
-                MPI_COMM_WORLD);
-      MPI_Ssend(clientCommBuffersCPU_[gpu].data(),
-                nodeSize,
-                MPI_FLOAT,
-                node,
-                MPI_TAG_GRAD_PUSH_,
-                MPI_COMM_WORLD);
-
-      // Receive updated params from server node
-      MPI_Recv(clientCommBuffersCPU_[gpu].data(),
-               nodeSize,
-               MPI_FLOAT,
+      MPI_Send(&messageInfo,
+               4,
+               MPI_UNSIGNED_LONG,
                node,
-               MPI_TAG_PARAM_PUSH_,
-               MPI_COMM_WORLD,
-               MPI_STATUS_IGNORE);
-
-      // Copy params from CPU back to GPU
-      cudaMemcpy(oldParams->subtensor(offset, nodeSize)->data(),
-                 clientCommBuffersCPU_[gpu].data(),
-                 nodeSize * sizeof(float),
-                 cudaMemcpyHostToDevice);
-      cudaStreamSynchronize(0);
-
-      // Else update locally if node == this node
-    } else {
-      size_t localOffset = offset;
-      std::vector<std::thread> threads;
-
-      for(int gpu = 0; gpu < devices_.size(); gpu++) {
-        size_t gpuSize = shardSizes_[gpu];
-
-        threads.emplace_back(std::thread(
-            [=](int gpu, size_t offset, size_t size) {
-              std::lock_guard<std::mutex> guard(shardMutex_[gpu]);
-
-              // Copy grads to appropriate GPU
-              shardGrads_[gpu]->copyFrom(newGrads->subtensor(offset, size));
-              // Run optimizer on GPU
-              if(scaleLearningRate_ && batchWords > 0) {
-                shardOptimizers_[gpu]->update(shardParams_[gpu],
-                                              shardGrads_[gpu],
-                                              batchWords / avgBatchWords_);
-              } else {
-                shardOptimizers_[gpu]->update(shardParams_[gpu],
-                                              shardGrads_[gpu]);
-              }
-              cudaStreamSynchronize(0);
-              // Copy params back to current GPU
-              oldParams->subtensor(offset, size)->copyFrom(shardParams_[gpu]);
-            },
-            gpu,
-            localOffset,
-            gpuSize));
-
-        localOffset += gpuSize;
-      }
-      for(auto &&t : threads) {
-        t.join();
+               MPI_TAG_GRAD_PUSH_,
+               MPI_COMM_WORLD);
+
+      for(auto& chunk : nodeChunks_[node]) {
+        MPI_Request request;
+        if(compressGradients_) {
+          // Compress grads, keeping what is not sent for the next push
+          auto& buffer = clientMessageBuffersCPU_[gpu][message++];
+          clientCompressors_[gpu][node]->addMomentum(
+              grads + chunk.offset, chunk.offset, chunk.size);
+          clientCompressors_[gpu][node]->compress(
+              grads + chunk.offset,
+              chunk.offset,
+              chunk.size,
+              buffer,
+              clientPushSteps_[gpu] >= dropWarmup_);
+          MPI_Isend(buffer.data(),
+                    buffer.size(),
+                    MPI_BYTE,
+                    node,
+                    MPI_TAG_GRAD_CHUNK_ + gpu,
+                    MPI_COMM_WORLD,
+                    &request);
+        } else {
+          MPI_Isend(grads + chunk.offset,
+                    chunk.size,
+                    MPI_FLOAT,
+                    node,
+                    MPI_TAG_GRAD_CHUNK_ + gpu,
+                    MPI_COMM_WORLD,
+                    &request);
+        }
+        requests.push_back(request);
       }
+    } else {
+      localOffset = offset;
     }
 
+    offset += nodeSizes_[node];
+  }
+
+  // Update locally while the chunks of other nodes are being exchanged
+  std::vector<std::thread> threads;
+  for(int gpu = 0; gpu < devices_.size(); gpu++) {
+    size_t gpuSize = shardSizes_[gpu];
+
+    threads.emplace_back(std::thread(
+        [=](int gpu, size_t offset, size_t size) {
+          std::lock_guard<std::mutex> guard(shardMutex_[gpu]);
+
+          // Copy grads to appropriate GPU
+          shardGrads_[gpu]->copyFrom(newGrads->subtensor(offset, size));
+          // Run optimizer on GPU
+          if(scaleLearningRate_ && batchWords > 0) {
+            shardOptimizers_[gpu]->update(shardParams_[gpu],
+                                          shardGrads_[gpu],
+                                          batchWords / avgBatchWords_);
+          } else {
+            shardOptimizers_[gpu]->update(shardParams_[gpu], shardGrads_[gpu]);
+          }
+          // Copy params back to current GPU
+          oldParams->subtensor(offset, size)->copyFrom(shardParams_[gpu]);
+        },
+        gpu,
+        localOffset,
+        gpuSize));
+
+    localOffset += gpuSize;
+  }
+  for(auto &&t : threads) {
+    t.join();
+  }
+
+  MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+  // Copy params from CPU back to GPU
+  offset = 0;
+  for(int node = 0; node < mpi_comm_world_size_; node++) {
+    size_t nodeSize = nodeSizes_[node];
+    if(node != mpi_my_rank_) {
+      const float* params = clientParamBuffersCPU_[gpu].data() + offset;
+      oldParams->subtensor(offset, nodeSize)->set(params, params + nodeSize);
+    }
     offset += nodeSize;
   }
+
+  if(compressGradients_)
+    clientPushSteps_[gpu]++;
 #endif
 }
 
@@ -502,6 +766,7 @@ void MultiNodeGraphGroup::execute(Ptr<data::Batch> batch) {
     graph->forward();
     float cost = costNode->scalar();
     graph->backward();
+    reportMemory(graph, batch);
 
     graph->getBackend()->synchronize();
 
@@ -582,7 +847,18 @@ void MultiNodeGraphGroup::execute(Ptr<data::Batch> batch) {
     }
   };
 
-  clientThreadPool_->enqueue(task, batch);
+  {
+    std::lock_guard<std::mutex> lock(mutexClientTasks_);
+    pendingClientTasks_++;
+  }
+  clientThreadPool_->enqueue(
+      [this, task](Ptr<data::Batch> batch) {
+        task(batch);
+        std::lock_guard<std::mutex> lock(mutexClientTasks_);
+        pendingClientTasks_--;
+        cvClientTasks_.notify_all();
+      },
+      batch);
 }
 
 /**
@@ -13,6 +13,7 @@
 #include <boost/thread/shared_mutex.hpp>
 
 #include "3rd_party/threadpool.h"
+#include "training/gradient_compressor.h"
 #include "training/graph_group.h"
 
 namespace marian {
@@ -39,7 +40,14 @@ protected:
   // Client variables.
 
   /** Thread pool to enable clients to run concurrently. */
-  ThreadPool* clientThreadPool_;
+  ThreadPool* clientThreadPool_{nullptr};
+
+  /** Number of batches queued or running in the client thread pool. */
+  size_t pendingClientTasks_{0};
+
+  /** Mutex and condition variable to wait for the queued batches. */
+  std::mutex mutexClientTasks_;
+  std::condition_variable cvClientTasks_;
 
   /** Graph builders for clients (which run forward and backward passes). */
   std::vector<Ptr<models::ModelBase>> clientBuilders_;
@@ -47,8 +55,8 @@ protected:
   /** Graphs of clients. */
   std::vector<Ptr<ExpressionGraph>> clientGraphs_;
 
-  /** Devices (GPUs) on this node. */
-  std::vector<size_t> devices_;
+  /** Devices (GPUs or CPU threads) on this node. */
+  std::vector<DeviceId> devices_;
 
   /** Mutex to ensure clients are uniquely assigned to graphs and builders. */
   std::mutex mutexClientInit_;
@@ -66,17 +74,12 @@ protected:
   // Server (shard) variables.
 
   /**
-   * Main server thread that continually receives gradients from a client,
-   * copies them to the shards on this node, runs the shard optimizers and then
-   * returns the result to that client.
-   */
-  std::thread* serverShardThread_;
-
-  /**
-   * Main server CPU buffer to enable MPI sending and receiving (GPU -> CPU ->
-   * Network -> CPU -> GPU).
+   * Main server thread that continually receives gradients from clients in
+   * chunks, runs the optimizer of each shard on this node as soon as its
+   * chunks have arrived and returns the updated parameters to the client.
+   * Pushes of several clients are received at the same time.
    */
-  std::vector<float> serverShardBufferCPU_;
+  std::thread* serverShardThread_{nullptr};
 
   /**
    * Parts of the global parameters that are assigned to server shards on this
@@ -111,11 +114,59 @@ protected:
   /** Number of parameters allocated to shards on THIS node. */
   std::vector<size_t> shardSizes_;
 
+  /** Maximum number of values sent in a single MPI message. */
+  size_t chunkSize_;
+
   /**
-   * CPU buffer for sending gradients and receiving parameters via MPI.
+   * Part of the parameters of a node sent in a single MPI message. Chunks do
+   * not cross shard boundaries, so a shard can be updated as soon as its
+   * chunks have been received.
+   */
+  struct Chunk {
+    size_t shard;
+    size_t offset;  // relative to the parameters of the node
+    size_t size;
+  };
+
+  /** Chunks of the parameters of each node. */
+  std::vector<std::vector<Chunk>> nodeChunks_;
+
+  /**
+   * CPU buffers with the gradients of the whole model for sending them via
+   * MPI, one per client.
    */
   std::vector<std::vector<float>> clientCommBuffersCPU_;
 
+  /** CPU buffers for receiving the parameters via MPI, one per client. */
+  std::vector<std::vector<float>> clientParamBuffersCPU_;
+
+  /**
+   * Whether gradients are sent to other nodes compressed, i.e. dropped or
+   * quantized.
+   */
+  bool compressGradients_{false};
+
+  /** Do not drop gradients for the first pushes of each client. */
+  size_t dropWarmup_{0};
+
+  /**
+   * Compressors of the gradients each client sends to the server shards of
+   * each node, which keep what has not been sent yet as residual.
+   */
+  std::vector<std::vector<Ptr<GradientCompressor>>> clientCompressors_;
+
+  /** Number of gradient pushes of each client. */
+  std::vector<size_t> clientPushSteps_;
+
+  /**
+   * CPU buffers for the compressed gradients of each client, one per chunk of
+   * all nodes.
+   */
+  std::vector<std::vector<std::vector<char>>> clientMessageBuffersCPU_;
+
+  /** Largest number of bytes of a compressed chunk. */
+  size_t messageCapacity_{0};
+
   /** MPI rank of this node. */
   int mpi_my_rank_{0};
 
@@ -123,15 +174,23 @@ protected:
   int mpi_comm_world_size_{1};
 
   /**
-   * Flag to indicate that an MPI message contains gradients (client -> server).
+   * Flag to indicate that an MPI message contains the info of a gradient push
+   * (client -> server).
    */
   static const int MPI_TAG_GRAD_PUSH_{0};
 
   /**
-   * Flag to indicate that an MPI message contains parameters (server ->
-   * client).
+   * Flag to indicate that an MPI message contains a chunk of gradients (client
+   * -> server). The index of the client on its node is added, so that the
+   * pushes of several clients of a node are not mixed up.
    */
-  static const int MPI_TAG_PARAM_PUSH_{5};
+  static const int MPI_TAG_GRAD_CHUNK_{1};
+
+  /**
+   * Flag to indicate that an MPI message contains a chunk of parameters
+   * (server -> client). See paramTag().
+   */
+  static const int MPI_TAG_PARAM_PUSH_{16384};
 
   /**
    * Message info indices: 0 = size; 1 = originating client; 2 = number of batch
@@ -252,6 +311,18 @@ protected:
    */
   void calculateNodeSizes();
 
+  /**
+   * Split the parameters of each node into chunks of at most chunkSize_
+   * values that do not cross the boundaries of its shards.
+   */
+  void calculateChunks();
+
+  /**
+   * Sizes of the shards of the given node, the last of which may be smaller
+   * than the others.
+   */
+  std::vector<size_t> shardSizesOfNode(int node);
+
   /**
    * Initialize a CPU buffer for each client on this node for storing gradients
    * or parameters.
@@ -260,6 +331,12 @@ protected:
    */
   void initClientCpuBuffers();
 
+  /**
+   * Initialize a compressor for the gradients of each client and node if
+   * gradients are dropped or quantized.
+   */
+  void initClientCompressors();
+
   /**
    * Initialize variables required for overlapping client computations and
    * communication.
@@ -299,10 +376,18 @@ protected:
    */
   void initShardGpuTensors();
 
+  /**
+   * Tag of the parameter chunks of the given shard sent to the given client.
+   * Shards are updated and sent back in any order.
+   */
+  int paramTag(int client, size_t shard);
+
   /**
    * Launch independent thread which continually receives gradients assigned to
-   * this shard from any client, runs the shard optimizer and sends back the
-   * updated parameters.
+   * the shards on this node from any client, runs the shard optimizers and
+   * sends back the updated parameters. The chunks of several pushes are
+   * received at the same time, and shards are updated as soon as their chunks
+   * have arrived.
    */
   virtual void launchServerThread();
 
@@ -325,7 +410,8 @@ protected:
 
   /**
    * Send new gradients to the server shards and receive the updated (global)
-   * parameters.
+   * parameters. The chunks for all other nodes are sent and received without
+   * blocking while the shards of this node are updated.
    *
    * @param newGrads Gradients to send
    * @param oldParams Parameters to replace
@@ -355,25 +441,27 @@ protected:
 
   /**
    * Load the GPU configuration of this node (i.e. which GPUs to use) and the
-   * number of GPUs on the other nodes.
+   * number of GPUs on the other nodes. With CPU threads, every node uses the
+   * same number of threads.
    */
-  void loadDeviceConfig(std::vector<size_t> deviceConfig) {
-    size_t index = 0, node = 0, nClientsSeen = 0;
+  void loadDeviceConfig(const std::vector<DeviceId>& deviceConfig) {
     numberClientsOfNodes_ = std::vector<int>(mpi_comm_world_size_, 0);
-    while(index < deviceConfig.size()) {
-      if(numberClientsOfNodes_[node] == 0) {
-        numberClientsOfNodes_[node] = deviceConfig[index];
-        nClientsSeen = 0;
-      } else if(nClientsSeen < numberClientsOfNodes_[node]) {
-        if(node == mpi_my_rank_) {
+    if(options_->get<size_t>("cpu-threads") > 0) {
+      devices_ = deviceConfig;
+      for(auto& clients : numberClientsOfNodes_)
+        clients = devices_.size();
+      return;
+    }
+
+    // devices are listed per node, each list preceded by its size
+    size_t index = 0;
+    for(int node = 0; index < deviceConfig.size(); ++node) {
+      size_t count = deviceConfig[index++].no;
+      if(node < mpi_comm_world_size_)
+        numberClientsOfNodes_[node] = count;
+      for(size_t i = 0; i < count && index < deviceConfig.size(); ++i, ++index)
+        if(node == mpi_my_rank_)
           devices_.push_back(deviceConfig[index]);
-        }
-        nClientsSeen++;
-      } else {
-        node++;
-        index--;
-      }
-      index++;
     }
   }
 
@@ -383,14 +471,21 @@ public:
    */
   MultiNodeGraphGroup(Ptr<Config> options)
       : GraphGroup(options),
+        chunkSize_{options_->get<size_t>("multi-node-chunk-size")},
+        compressGradients_{options_->get<float>("grad-dropping-rate") > 0
+                           || options_->get<bool>("grad-quantize")},
+        dropWarmup_{options_->get<size_t>("grad-dropping-warmup")},
         clientCommOverlap{options_->get<bool>("multi-node-overlap")} {
     // Set up devices for this node
-    loadDeviceConfig(options_->get<std::vector<size_t>>("devices"));
+    setupMPI();
+    loadDeviceConfig(options_->getDevices());
     // Create builders and graphs for clients.
     for(int i = 0; i < devices_.size(); i++) {
       clientGraphs_.push_back(New<ExpressionGraph>());
-      clientGraphs_[i]->setDevice({devices_[i], DeviceType::gpu});
+      clientGraphs_[i]->setDevice(devices_[i]);
       clientGraphs_[i]->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+      clientGraphs_[i]->setCheckpointing(
+          options_->get<bool>("gradient-checkpointing"));
       clientBuilders_.push_back(models::from_config(options_));
     }
   }
@@ -401,6 +496,7 @@ public:
    */
   virtual ~MultiNodeGraphGroup() {
     if(initialized_) {
+      wait();  // finish queued batches before other nodes are notified
       if(clientCommOverlap) {
         shutDownCommOverlapThreads();
       }
@@ -422,6 +518,14 @@ public:
     batchIter_++;
   }
 
+  /**
+   * Wait until the clients have processed all queued batches.
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutexClientTasks_);
+    cvClientTasks_.wait(lock, [this] { return pendingClientTasks_ == 0; });
+  }
+
   /**
    * Load models from disk if file exists and setting is not disabled
    */
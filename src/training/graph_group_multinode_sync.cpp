@@ -0,0 +1,448 @@
+#include "training/graph_group_multinode_sync.h"
+
+#include <thread>
+
+namespace marian {
+
+void MultiNodeSyncGraphGroup::setScheduler(Ptr<Scheduler> scheduler) {
+  scheduler_ = scheduler;
+  // optimizer has to be registered last to see changes of learning rate
+  scheduler_->registerTrainingObserver(scheduler_);
+
+  for(auto opt : shardOpt_)
+    scheduler_->registerTrainingObserver(opt);
+}
+
+float MultiNodeSyncGraphGroup::movingAverageDecay(size_t batches) {
+  return std::max(mvDecay_, 1.f - (float)(batches + 1) / (float)(batches + 10));
+}
+
+void MultiNodeSyncGraphGroup::loadDeviceConfig() {
+  auto devices = options_->getDevices();
+  if(options_->get<size_t>("cpu-threads") > 0) {
+    devices_ = devices;
+    return;
+  }
+
+  // devices are listed per node, each list preceded by its size
+  size_t index = 0;
+  for(int node = 0; index < devices.size(); ++node) {
+    size_t count = devices[index++].no;
+    for(size_t i = 0; i < count && index < devices.size(); ++i, ++index)
+      if(node == mpiRank_)
+        devices_.push_back(devices[index]);
+  }
+
+  ABORT_IF(devices_.empty(), "No devices given for node {}", mpiRank_);
+}
+
+size_t MultiNodeSyncGraphGroup::segmentBegin(int node) {
+  return std::min(node * devices_.size() * shardSize_, totalSize_);
+}
+
+size_t MultiNodeSyncGraphGroup::segmentEnd(int node) {
+  return std::min((node + 1) * devices_.size() * shardSize_, totalSize_);
+}
+
+void MultiNodeSyncGraphGroup::init(Ptr<data::Batch> batch) {
+#if MPI_FOUND
+  // the parameters are sharded evenly over all devices of the cluster
+  int count = devices_.size(), minCount, maxCount;
+  MPI_Allreduce(&count, &minCount, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(&count, &maxCount, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  ABORT_IF(minCount != maxCount,
+           "Synchronous multi-node training requires the same number of "
+           "devices on every node");
+#endif
+
+  {
+    THREAD_GUARD(builders_[0]->build(graphs_[0], batch);
+                 graphs_[0]->forward(););
+
+    ThreadPool pool(graphs_.size() - 1, graphs_.size() - 1);
+    for(size_t i = 1; i < graphs_.size(); ++i) {
+      auto init = [&](size_t i) {
+        builders_[i]->build(graphs_[i], batch);
+        graphs_[i]->forward();
+      };
+      pool.enqueue(init, i);
+    }
+  }
+
+  totalSize_ = graphs_[0]->params()->vals()->size();
+  shardSize_ = ceil(totalSize_ / (float)(mpiWorldSize_ * devices_.size()));
+
+  // each message has a tag of its chunk in the segment, of which MPI
+  // guarantees at least 32767
+  size_t segmentSize = devices_.size() * shardSize_;
+  chunkSize_ = std::max(chunkSize_, (segmentSize + 32766) / 32767);
+
+  gradsBuffer_.resize(totalSize_);
+  paramsBuffer_.resize(totalSize_);
+  recvBuffer_.resize(std::min(segmentSize, totalSize_));
+
+  size_t localSize = ceil(totalSize_ / (float)devices_.size());
+  sumBuffers_.resize(devices_.size(), std::vector<float>(localSize));
+
+  if(options_->get<float>("grad-dropping-rate") > 0
+     || options_->get<bool>("grad-quantize")) {
+    compressor_
+        = New<GradientCompressor>(totalSize_,
+                                  options_->get<float>("grad-dropping-rate"),
+                                  options_->get<float>("grad-dropping-momentum"),
+                                  options_->get<bool>("grad-quantize"));
+
+    size_t chunks = (segmentSize + chunkSize_ - 1) / chunkSize_;
+    sendMessages_.resize(chunks * (mpiWorldSize_ - 1));
+    recvMessages_.resize(chunks,
+                         std::vector<char>(compressor_->maxBytes(chunkSize_)));
+  }
+
+  // all nodes start from the parameters of the first node
+  graphs_[0]->params()->vals()->copyTo(paramsBuffer_.data());
+#if MPI_FOUND
+  MPI_Bcast(paramsBuffer_.data(), totalSize_, MPI_FLOAT, 0, MPI_COMM_WORLD);
+#endif
+  for(auto graph : graphs_)
+    graph->params()->vals()->set(paramsBuffer_.data(),
+                                 paramsBuffer_.data() + totalSize_);
+
+  size_t pos = segmentBegin(mpiRank_);
+  for(auto graph : graphs_) {
+    int size = std::min(shardSize_, totalSize_ - pos);
+
+    auto paramsAlloc = New<TensorAllocator>(graph->getBackend());
+    paramsAllocs_.push_back(paramsAlloc);
+    paramsAlloc->reserveExact(2 * size * sizeof(float));
+
+    Tensor param, grad;
+    paramsAlloc->allocate(param, {1, size});
+    paramsAlloc->allocate(grad, {1, size});
+    params_.push_back(param);
+    grads_.push_back(grad);
+
+    param->set(paramsBuffer_.data() + pos, paramsBuffer_.data() + pos + size);
+
+    if(movingAvg_) {
+      Tensor paramAvg;
+      auto allocator = New<TensorAllocator>(graph->getBackend());
+      allocator->reserveExact(size * sizeof(float));
+      allocator->allocate(paramAvg, {1, size});
+      paramAvg->copyFrom(param);
+
+      paramsAllocAvg_.push_back(allocator);
+      paramsAvg_.push_back(paramAvg);
+    }
+
+    pos += size;
+  }
+
+  first_ = false;
+}
+
+void MultiNodeSyncGraphGroup::ringPass(std::vector<float>& buffer,
+                                       bool reduce) {
+#if MPI_FOUND
+  int size = mpiWorldSize_;
+  if(size == 1)
+    return;
+
+  int next = (mpiRank_ + 1) % size;
+  int prev = (mpiRank_ + size - 1) % size;
+
+  // In step k the segment sent to the next node is the one received from the
+  // previous node in step k - 1. A reduce-scatter starts by sending the
+  // segment of the previous node, so that the last segment received is the
+  // node's own; an all-gather starts with the node's own segment.
+  auto sendSegment = [&](int step) {
+    return ((mpiRank_ - step - (reduce ? 1 : 0)) % size + size) % size;
+  };
+
+  auto chunks = [&](int segment) {
+    size_t length = segmentEnd(segment) - segmentBegin(segment);
+    return (length + chunkSize_ - 1) / chunkSize_;
+  };
+
+  auto chunkLength = [&](int segment, size_t chunk) {
+    size_t begin = segmentBegin(segment) + chunk * chunkSize_;
+    return (int)(std::min(begin + chunkSize_, segmentEnd(segment)) - begin);
+  };
+
+  // partial sums are compressed with the residual of the positions sent
+  bool compress = reduce && compressor_;
+  bool drop = !scheduler_ || scheduler_->numberOfBatches() >= dropWarmup_;
+
+  std::vector<MPI_Request> sends;
+  auto send = [&](int segment, size_t chunk) {
+    size_t pos = segmentBegin(segment) + chunk * chunkSize_;
+    int length = chunkLength(segment, chunk);
+    sends.emplace_back();
+    if(compress) {
+      auto& message = sendMessages_[sends.size() - 1];
+      compressor_->compress(buffer.data() + pos, pos, length, message, drop);
+      MPI_Isend(message.data(),
+                message.size(),
+                MPI_BYTE,
+                next,
+                chunk,
+                MPI_COMM_WORLD,
+                &sends.back());
+    } else {
+      MPI_Isend(buffer.data() + pos,
+                length,
+                MPI_FLOAT,
+                next,
+                chunk,
+                MPI_COMM_WORLD,
+                &sends.back());
+    }
+  };
+
+  // sends.back() has to stay valid while more sends are added
+  size_t maxChunks = 0;
+  for(int segment = 0; segment < size; ++segment)
+    maxChunks = std::max(maxChunks, chunks(segment));
+  sends.reserve(maxChunks * (size - 1));
+
+  for(size_t chunk = 0; chunk < chunks(sendSegment(0)); ++chunk)
+    send(sendSegment(0), chunk);
+
+  std::vector<MPI_Request> recvs;
+  for(int step = 0; step < size - 1; ++step) {
+    int segment = sendSegment(step + 1);
+    size_t n = chunks(segment);
+
+    recvs.resize(n);
+    for(size_t chunk = 0; chunk < n; ++chunk) {
+      if(compress) {
+        MPI_Irecv(recvMessages_[chunk].data(),
+                  recvMessages_[chunk].size(),
+                  MPI_BYTE,
+                  prev,
+                  chunk,
+                  MPI_COMM_WORLD,
+                  &recvs[chunk]);
+        continue;
+      }
+
+      float* data = reduce ? recvBuffer_.data() + chunk * chunkSize_
+                           : buffer.data() + segmentBegin(segment)
+                                 + chunk * chunkSize_;
+      MPI_Irecv(data,
+                chunkLength(segment, chunk),
+                MPI_FLOAT,
+                prev,
+                chunk,
+                MPI_COMM_WORLD,
+                &recvs[chunk]);
+    }
+
+    // chunks are processed and passed on in the order they arrive
+    for(size_t i = 0; i < n; ++i) {
+      int chunk;
+      MPI_Waitany(n, recvs.data(), &chunk, MPI_STATUS_IGNORE);
+
+      if(reduce) {
+        float* sum = buffer.data() + segmentBegin(segment) + chunk * chunkSize_;
+        int length = chunkLength(segment, chunk);
+        if(compress) {
+          GradientCompressor::decompressAdd(
+              recvMessages_[chunk].data(), sum, length);
+        } else {
+          const float* received = recvBuffer_.data() + chunk * chunkSize_;
+          for(int j = 0; j < length; ++j)
+            sum[j] += received[j];
+        }
+      }
+
+      if(step < size - 2)
+        send(segment, chunk);
+    }
+  }
+
+  MPI_Waitall(sends.size(), sends.data(), MPI_STATUSES_IGNORE);
+#endif
+}
+
+void MultiNodeSyncGraphGroup::sumGrads(
+    const std::vector<Ptr<data::Batch>>& batches,
+    const std::vector<float>& weights) {
+  size_t localSize = sumBuffers_[0].size();
+
+  auto task = [this, &batches, &weights, localSize](size_t idx) {
+    size_t pos = std::min(idx * localSize, totalSize_);
+    size_t size = std::min(localSize, totalSize_ - pos);
+    if(size == 0)
+      return;
+
+    float* sum = gradsBuffer_.data() + pos;
+    float* tmp = sumBuffers_[idx].data();
+    std::fill(sum, sum + size, 0.f);
+
+    for(size_t i = 0; i < graphs_.size(); ++i) {
+      if(batches[i]->size() > 0) {
+        graphs_[i]->params()->grads()->subtensor(pos, size)->copyTo(tmp);
+        for(size_t j = 0; j < size; ++j)
+          sum[j] += tmp[j] * weights[i];
+      }
+    }
+  };
+
+  ThreadPool pool(devices_.size(), devices_.size());
+  for(size_t idx = 0; idx < devices_.size(); ++idx)
+    pool.enqueue(task, idx);
+}
+
+void MultiNodeSyncGraphGroup::distributeParams(
+    const std::vector<Tensor>& shards) {
+  size_t pos = segmentBegin(mpiRank_);
+  for(auto shard : shards) {
+    shard->copyTo(paramsBuffer_.data() + pos);
+    pos += shard->size();
+  }
+
+  ringPass(paramsBuffer_, false);
+
+  std::vector<std::thread> threads;
+  for(auto graph : graphs_)
+    threads.emplace_back([this, graph]() {
+      graph->params()->vals()->set(paramsBuffer_.data(),
+                                   paramsBuffer_.data() + totalSize_);
+    });
+  for(auto& thread : threads)
+    thread.join();
+}
+
+void MultiNodeSyncGraphGroup::validate(bool final) {
+  std::vector<float> scores;
+  std::vector<size_t> stalled;
+  if(mpiRank_ == 0) {
+    scores = scheduler_->validate(graphs_, final);
+    stalled = scheduler_->stalledValidations();
+  }
+
+#if MPI_FOUND
+  // no scores are sent if no validation was due
+  int count = scores.size();
+  MPI_Bcast(&count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if(count == 0)
+    return;
+
+  std::vector<unsigned long> stalledBuffer(stalled.begin(), stalled.end());
+  scores.resize(count);
+  stalledBuffer.resize(count);
+  MPI_Bcast(scores.data(), count, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(stalledBuffer.data(), count, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+
+  if(mpiRank_ != 0)
+    scheduler_->validated(
+        scores, std::vector<size_t>(stalledBuffer.begin(), stalledBuffer.end()));
+#endif
+}
+
+void MultiNodeSyncGraphGroup::execute(Ptr<data::Batch> batch) {
+  // every node takes its part of the same batch
+  size_t localDevices = devices_.size();
+  auto parts = batch->split(mpiWorldSize_ * localDevices);
+  std::vector<Ptr<data::Batch>> batches(parts.begin() + mpiRank_ * localDevices,
+                                        parts.begin()
+                                            + (mpiRank_ + 1) * localDevices);
+
+  // weights of the local parts among the parts of all nodes
+  auto allWeights = splitWeights(parts);
+  std::vector<float> weights(allWeights.begin() + mpiRank_ * localDevices,
+                             allWeights.begin()
+                                 + (mpiRank_ + 1) * localDevices);
+
+  if(first_)
+    init(parts[0]);
+
+  std::vector<float> costs(localDevices);
+
+  {
+    auto task = [this, &costs, &batches](size_t idx) {
+      auto graph = graphs_[idx];
+      auto batch = batches[idx];
+
+      if(batch->size() > 0) {
+        auto costNode = builders_[idx]->build(graph, batch);
+        graph->forward();
+        costs[idx] = costNode->scalar();
+        graph->backward();
+        reportMemory(graph, batch);
+      }
+    };
+
+    ThreadPool pool(localDevices, localDevices);
+    for(size_t idx = 0; idx < localDevices; ++idx)
+      pool.enqueue(task, idx);
+  }
+
+  sumGrads(batches, weights);
+
+  // momentum correction applies to the gradients of this node only, once
+  // before the ring adds those of the other nodes; the segment of this node
+  // ends up in the sum without compression
+  if(compressor_)
+    compressor_->addMomentum(gradsBuffer_.data(), 0, totalSize_);
+  ringPass(gradsBuffer_, true);
+  if(compressor_)
+    compressor_->resetMomentum(segmentBegin(mpiRank_),
+                               segmentEnd(mpiRank_) - segmentBegin(mpiRank_));
+
+  {
+    float factor
+        = scaleLearningRate_ ? batch->wordsTrg() / avgBatchWords_ : 1.f;
+
+    auto task = [this, factor](size_t idx, size_t pos) {
+      int size = params_[idx]->size();
+      grads_[idx]->set(gradsBuffer_.data() + pos,
+                       gradsBuffer_.data() + pos + size);
+
+      if(movingAvg_) {
+        shardOpt_[idx]->update(params_[idx],
+                               grads_[idx],
+                               factor,
+                               paramsAvg_[idx],
+                               movingAverageDecay(scheduler_->numberOfBatches()));
+      } else {
+        shardOpt_[idx]->update(params_[idx], grads_[idx], factor);
+      }
+    };
+
+    ThreadPool pool(localDevices, localDevices);
+    size_t pos = segmentBegin(mpiRank_);
+    for(size_t idx = 0; idx < localDevices; ++idx) {
+      pool.enqueue(task, idx, pos);
+      pos += params_[idx]->size();
+    }
+  }
+
+  distributeParams(params_);
+
+  float cost = 0;
+  for(size_t i = 0; i < localDevices; ++i)
+    cost += costs[i] * weights[i];
+#if MPI_FOUND
+  MPI_Allreduce(MPI_IN_PLACE, &cost, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+#endif
+
+  if(scheduler_) {
+    scheduler_->update(cost, parts);
+
+    if(scheduler_->saving()) {
+      this->save();
+    }
+
+    if(scheduler_->validating()) {
+      if(movingAvg_)
+        distributeParams(paramsAvg_);
+
+      validate();
+
+      if(movingAvg_)
+        distributeParams(params_);
+    }
+  }
+}
+}
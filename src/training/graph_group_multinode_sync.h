@@ -0,0 +1,273 @@
+#pragma once
+
+#if MPI_FOUND
+#include "mpi.h"
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include "3rd_party/threadpool.h"
+#include "training/gradient_compressor.h"
+#include "training/graph_group.h"
+
+namespace marian {
+
+/**
+ * Multi-node graph group for synchronous training over multiple machines
+ * each with one or multiple devices.
+ *
+ * Every node reads the same batches and computes the gradients of its part of
+ * each batch. The parameters are split into one shard per device of the
+ * cluster and the shards of a node form its segment. The gradients are summed
+ * with a ring all-reduce: a reduce-scatter leaves every node with the summed
+ * gradients of its segment, which the shard optimizers of its devices apply,
+ * and an all-gather passes the updated parameters around the ring. Messages
+ * are split into chunks, and each chunk is passed on to the next node as soon
+ * as it has been received. With gradient dropping or quantization, the
+ * partial sums of the reduce-scatter are sent compressed, and each node keeps
+ * what it has not sent as a residual for the same positions.
+ */
+class MultiNodeSyncGraphGroup : public GraphGroup {
+public:
+  virtual void setScheduler(Ptr<Scheduler> scheduler);
+
+private:
+  std::vector<Ptr<models::ModelBase>> builders_;
+  std::vector<Ptr<ExpressionGraph>> graphs_;
+  std::vector<DeviceId> devices_;
+
+  /** MPI rank of this node. */
+  int mpiRank_{0};
+
+  /** Number of nodes in MPI world (cluster). */
+  int mpiWorldSize_{1};
+
+  /** Maximum number of values sent in a single MPI message. */
+  size_t chunkSize_;
+
+  /** Shards of the parameters, gradients and optimizers on this node. */
+  std::vector<Tensor> params_;
+  std::vector<Tensor> grads_;
+  std::vector<Ptr<TensorAllocator>> paramsAllocs_;
+  std::vector<Ptr<OptimizerBase>> shardOpt_;
+
+  size_t totalSize_{0};
+  size_t shardSize_{0};
+  bool first_{true};
+
+  /** Writes the progress of the last checkpoint on the first node. */
+  std::function<void()> pendingProgress_;
+
+  /**
+   * Host buffers holding the gradients and parameters of the whole model for
+   * MPI, and the chunks of a segment received during the reduce-scatter.
+   */
+  std::vector<float> gradsBuffer_;
+  std::vector<float> paramsBuffer_;
+  std::vector<float> recvBuffer_;
+
+  /** Host buffers of the local devices to sum up their gradients. */
+  std::vector<std::vector<float>> sumBuffers_;
+
+  /** Compressor of the partial sums sent in the reduce-scatter, if any. */
+  Ptr<GradientCompressor> compressor_;
+
+  /** Do not drop gradients for the first updates. */
+  size_t dropWarmup_;
+
+  /** Compressed chunks being sent and received. */
+  std::vector<std::vector<char>> sendMessages_;
+  std::vector<std::vector<char>> recvMessages_;
+
+  std::vector<Tensor> paramsAvg_;
+  std::vector<Ptr<TensorAllocator>> paramsAllocAvg_;
+  bool movingAvg_{false};
+  float mvDecay_{1e-4};
+
+  float movingAverageDecay(size_t batches);
+
+  /**
+   * Select the devices of this node, either the CPU threads or the GPUs
+   * listed for this node in the multi-node format '0:0 1 1:0 1'.
+   */
+  void loadDeviceConfig();
+
+  /**
+   * Build the graphs with the first batch, broadcast the parameters of the
+   * first node and allocate the shards of this node.
+   */
+  void init(Ptr<data::Batch> batch);
+
+  /** First index of the parameters in the segment of the given node. */
+  size_t segmentBegin(int node);
+
+  /** End of the parameters in the segment of the given node. */
+  size_t segmentEnd(int node);
+
+  /**
+   * Ring pass over the segments of buffer. With reduce, chunks received from
+   * the previous node are added to the buffer and the node ends with the sum
+   * of its own segment over all nodes (reduce-scatter). Otherwise received
+   * chunks replace the buffer and every node ends with the segments of all
+   * nodes (all-gather).
+   */
+  void ringPass(std::vector<float>& buffer, bool reduce);
+
+  /**
+   * Sum the gradients of the local devices into gradsBuffer_, weighted by the
+   * share of their parts in the whole batch.
+   *
+   * @see GraphGroup::splitWeights
+   */
+  void sumGrads(const std::vector<Ptr<data::Batch>>& batches,
+                const std::vector<float>& weights);
+
+  /**
+   * Copy the local shards to paramsBuffer_, gather the segments of all nodes
+   * and set the parameters of all local graphs.
+   */
+  void distributeParams(const std::vector<Tensor>& shards);
+
+  /**
+   * Validate on the first node only and broadcast the scores and numbers of
+   * stalled validations, so that all nodes agree on the learning rate and on
+   * early stopping. Has to be called on all nodes at the same time.
+   */
+  void validate(bool final = false);
+
+  void execute(Ptr<data::Batch> batch);
+
+public:
+  MultiNodeSyncGraphGroup(Ptr<Config> options)
+      : GraphGroup(options),
+        chunkSize_{options_->get<size_t>("multi-node-chunk-size")},
+        dropWarmup_{options_->get<size_t>("grad-dropping-warmup")},
+        movingAvg_{options_->get<float>("exponential-smoothing") > 0},
+        mvDecay_{options_->get<float>("exponential-smoothing")} {
+#if MPI_FOUND
+    MPI_Comm_size(MPI_COMM_WORLD, &mpiWorldSize_);
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpiRank_);
+#endif
+    loadDeviceConfig();
+
+    for(auto device : devices_) {
+      auto graph = New<ExpressionGraph>();
+      graph->setDevice(device);
+      graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+      graph->setCheckpointing(options_->get<bool>("gradient-checkpointing"));
+      graphs_.push_back(graph);
+      shardOpt_.push_back(Optimizer(options_));
+      builders_.push_back(models::from_config(options_));
+    }
+  }
+
+  void update(Ptr<data::Batch> batch) { execute(batch); }
+
+  /**
+   * Load the model on every node; each node restores the optimizer state of
+   * its own shards.
+   */
+  void load() {
+    if(!options_->get<bool>("no-reload")) {
+      std::string name = options_->get<std::string>("model");
+
+      if(boost::filesystem::exists(name)) {
+        size_t i = 0;
+        if(scheduler_)
+          scheduler_->load(name);
+        for(auto graph : graphs_)
+          builders_[i++]->load(graph, name);
+
+        std::vector<Ptr<Backend>> backends;
+        for(auto graph : graphs_)
+          backends.push_back(graph->getBackend());
+        shardOpt_[0]->load(name + ".optimizer.npz",
+                           shardOpt_,
+                           backends,
+                           mpiRank_ * devices_.size(),
+                           mpiWorldSize_ * devices_.size());
+
+      } else if(options_->has("pretrained-model")) {
+        std::string init = options_->get<std::string>("pretrained-model");
+        LOG(info,
+            "Initialize model weights with the pre-trained model {}",
+            init);
+        size_t i = 0;
+        for(auto graph : graphs_)
+          builders_[i++]->load(graph, init, false);
+      }
+    }
+  }
+
+  /**
+   * Save the model and training progress from the first node and the
+   * optimizer state of the shards from every node. Has to be called on all
+   * nodes at the same time.
+   */
+  void save(bool final = false) {
+    if(final && scheduler_)
+      validate(true);
+
+    writePendingProgress();
+
+    if(!first_ && movingAvg_)
+      distributeParams(paramsAvg_);
+
+    std::string name = options_->get<std::string>("model");
+
+    if(mpiRank_ == 0) {
+      if(!options_->get<bool>("overwrite") && !final) {
+        std::string numberOfBatches
+            = scheduler_ ? std::to_string(scheduler_->numberOfBatches())
+                         : "unknown";
+        std::string nameOverwrite = name;
+        nameOverwrite.replace(
+            name.size() - 4, 4, ".iter" + numberOfBatches + ".npz");
+        builders_[0]->save(graphs_[0], nameOverwrite);
+      }
+
+      builders_[0]->save(graphs_[0], name, true);
+    }
+
+    if(!first_) {
+      if(movingAvg_)
+        distributeParams(params_);
+
+      shardOpt_[0]->save(name + ".optimizer.npz",
+                         shardOpt_,
+                         totalSize_,
+                         mpiRank_ * devices_.size(),
+                         mpiWorldSize_ * devices_.size());
+    }
+
+    // The progress refers to the optimizer shards written by all nodes, so it
+    // is only written once every node has completed its files: at the next
+    // checkpoint, when they are usually complete, or at the end of training.
+    if(mpiRank_ == 0 && scheduler_)
+      pendingProgress_ = scheduler_->progressWriter(name);
+    if(final)
+      writePendingProgress();
+  }
+
+  /**
+   * Waits until all nodes have written the files of the last checkpoint and
+   * then writes its training progress from the first node. Has to be called
+   * on all nodes at the same time.
+   */
+  void writePendingProgress() {
+    io::waitForSaves();
+#if MPI_FOUND
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
+    if(pendingProgress_) {
+      io::writeAsync(pendingProgress_);
+      pendingProgress_ = nullptr;
+    }
+  }
+
+  Ptr<data::BatchStats> collectStats() {
+    return builders_[0]->collectStats(graphs_[0],
+                                      mpiWorldSize_ * devices_.size());
+  }
+};
+}
@@ -11,12 +11,8 @@ void SingletonGraph::setScheduler(Ptr<Scheduler> scheduler) {
   scheduler_->registerTrainingObserver(opt_);
 }
 
-void SingletonGraph::updateMovingAverage(Tensor mvAvgParams,
-                                         Tensor params,
-                                         size_t batches) {
-  using namespace functional;
-  float decay = std::max(mvDecay_, 1.f - (float)(batches + 1) / (float)(batches + 10));
-  Element(_1 = ((1.f - decay) * _1) + (decay * _2), mvAvgParams, params);
+float SingletonGraph::movingAverageDecay(size_t batches) {
+  return std::max(mvDecay_, 1.f - (float)(batches + 1) / (float)(batches + 10));
 }
 
 void SingletonGraph::execute(Ptr<data::Batch> batch) {
@@ -25,28 +21,34 @@ void SingletonGraph::execute(Ptr<data::Batch> batch) {
   graph_->forward();
   float cost = costNode->scalar();
   graph_->backward();
+  reportMemory(graph_, batch);
 
   // Get batch stats
   size_t batch_words = batch->wordsTrg();
 
-  if(scaleLearningRate_) {
-    opt_->update(graph_, batch_words / avgBatchWords_);
-  } else {
-    opt_->update(graph_);
+  float factor = scaleLearningRate_ ? batch_words / avgBatchWords_ : 1.f;
+
+  // the smoothed parameters are updated in the same pass as the parameters
+  Tensor mvAvgParams;
+  float mvDecay = 0.f;
+  if(mvAvg_ && mvAvgGraph_) {
+    ABORT_IF(!scheduler_, "Scheduler is required for exponential smoothing");
+    mvAvgParams = mvAvgGraph_->params()->vals();
+    mvDecay = movingAverageDecay(scheduler_->numberOfBatches());
   }
 
-  if(mvAvg_) {
+  opt_->update(graph_->params()->vals(),
+               graph_->params()->grads(),
+               factor,
+               mvAvgParams,
+               mvDecay);
+
+  if(mvAvg_ && !mvAvgGraph_) {
     ABORT_IF(!scheduler_, "Scheduler is required for exponential smoothing");
 
-    if(!mvAvgGraph_) {
-      mvAvgGraph_ = New<ExpressionGraph>();
-      mvAvgGraph_->setDevice(graph_->getDevice());
-      mvAvgGraph_->copyParams(graph_);
-    } else {
-      updateMovingAverage(mvAvgGraph_->params()->vals(),
-                          graph_->params()->vals(),
-                          scheduler_->numberOfBatches());
-    }
+    mvAvgGraph_ = New<ExpressionGraph>();
+    mvAvgGraph_->setDevice(graph_->getDevice());
+    mvAvgGraph_->copyParams(graph_);
   }
 
   if(scheduler_) {
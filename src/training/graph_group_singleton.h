@@ -20,7 +20,7 @@ private:
   bool mvAvg_{false};
   float mvDecay_{1e-4};
 
-  void updateMovingAverage(Tensor mvAvgParams, Tensor params, size_t batches);
+  float movingAverageDecay(size_t batches);
 
   void execute(Ptr<data::Batch> batch);
 
@@ -34,6 +34,7 @@ public:
     graph_ = New<ExpressionGraph>();
     graph_->setDevice(deviceId);
     graph_->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+    graph_->setCheckpointing(options_->get<bool>("gradient-checkpointing"));
     opt_ = Optimizer(options_);
 
     builder_ = models::from_config(options_);
@@ -77,8 +78,6 @@ public:
 
     if(options_->get<bool>("overwrite")) {
       builder_->save(graph_, name, true);
-      if(scheduler_)
-        scheduler_->save(name);
     } else {
       if(!final) {
         std::string numberOfBatches
@@ -91,12 +90,14 @@ public:
       }
 
       builder_->save(graph_, name, true);
-      if(scheduler_)
-        scheduler_->save(name);
     }
 
     size_t totalSize = graph_->params()->vals()->size();
     opt_->save(name + ".optimizer.npz", {opt_}, totalSize);
+
+    // the progress is queued after the model and optimizer files
+    if(scheduler_)
+      scheduler_->save(name);
   }
 
   Ptr<data::BatchStats> collectStats() {
@@ -13,12 +13,8 @@ void SyncGraphGroup::setScheduler(Ptr<Scheduler> scheduler) {
     scheduler_->registerTrainingObserver(opt);
 }
 
-void SyncGraphGroup::updateMovingAverage(Tensor paramsAvg,
-                                         Tensor params,
-                                         size_t batches) {
-  using namespace functional;
-  float decay = std::max(mvDecay_, 1.f - (float)(batches + 1) / (float)(batches + 10));
-  Element(_1 = ((1.f - decay) * _1) + (decay * _2), paramsAvg, params);
+float SyncGraphGroup::movingAverageDecay(size_t batches) {
+  return std::max(mvDecay_, 1.f - (float)(batches + 1) / (float)(batches + 10));
 }
 
 void SyncGraphGroup::fetchParams(Tensor oldParams,
@@ -122,6 +118,7 @@ void SyncGraphGroup::execute(Ptr<data::Batch> batch) {
         batch_words_[idx] = batch->wordsTrg();
         costs[idx] = costNode->scalar();
         graph->backward();
+        reportMemory(graph, batch);
       }
     };
 
@@ -133,40 +130,38 @@ void SyncGraphGroup::execute(Ptr<data::Batch> batch) {
   for (size_t mini_batch_words : batch_words_) {
   	total_batch_words += mini_batch_words;
   }
+  // parts of the batch differ in size, so their gradients are weighted
+  auto weights = splitWeights(batches);
   {
-    auto task = [this, batches,total_batch_words](size_t idx, int pos) {
+    auto task = [this, batches, &weights, total_batch_words](size_t idx,
+                                                              int pos) {
       grads_[idx]->set(0);
       int size = params_[idx]->size();
       int i = 0;
 
-      float div = devices_.size(); // no. of GPUs
-
-      // do not average gradients if cost type is sum.
-      if (options_->get<std::string>("cost-type")  == "ce-sum") {
-        div = 1;
-      }
-
       for(auto graph : graphs_) {
         if(batches[i]->size() > 0) {
           auto subGrad = graph->params()->grads()->subtensor(pos, size);
           tmpTensors_[idx]->copyFrom(subGrad);
 
           using namespace functional;
-          Element(_1 = _1 + (_2 / div), grads_[idx], tmpTensors_[idx]);
+          Element(_1 = _1 + (_2 * weights[i]), grads_[idx], tmpTensors_[idx]);
         }
         i++;
       }
 
-      if(scaleLearningRate_) {
-        shardOpt_[idx]->update(params_[idx], grads_[idx], total_batch_words/avgBatchWords_);
+      float factor = scaleLearningRate_ ? total_batch_words / avgBatchWords_ : 1.f;
+
+      if(movingAvg_) {
+        shardOpt_[idx]->update(params_[idx],
+                               grads_[idx],
+                               factor,
+                               paramsAvg_[idx],
+                               movingAverageDecay(scheduler_->numberOfBatches()));
       } else {
-        shardOpt_[idx]->update(params_[idx], grads_[idx]);
+        shardOpt_[idx]->update(params_[idx], grads_[idx], factor);
       }
 
-      if(movingAvg_)
-        updateMovingAverage(
-            paramsAvg_[idx], params_[idx], scheduler_->numberOfBatches());
-
       for(auto graph : graphs_) {
         auto subParam = graph->params()->vals()->subtensor(pos, size);
         subParam->copyFrom(params_[idx]);
@@ -182,14 +177,11 @@ void SyncGraphGroup::execute(Ptr<data::Batch> batch) {
   }
 
   float cost = 0;
-  for(auto c : costs)
-    cost += c;
-  if (options_->get<std::string>("cost-type")  != "ce-sum") {
-    cost = cost / costs.size();
-  }
+  for(size_t i = 0; i < costs.size(); ++i)
+    cost += costs[i] * weights[i];
 
   if(scheduler_) {
-    scheduler_->update(cost, batch);
+    scheduler_->update(cost, batches);
 
     if(scheduler_->saving()) {
       this->save();
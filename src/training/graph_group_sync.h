@@ -33,7 +33,7 @@ private:
   bool movingAvg_{false};
   float mvDecay_{1e-4};
 
-  void updateMovingAverage(Tensor paramsAvg, Tensor params, size_t batches);
+  float movingAverageDecay(size_t batches);
 
   void fetchParams(Tensor oldParams, const std::vector<Tensor>& params);
 
@@ -51,6 +51,7 @@ public:
       auto graph = New<ExpressionGraph>();
       graph->setDevice(device);
       graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+      graph->setCheckpointing(options_->get<bool>("gradient-checkpointing"));
       graphs_.push_back(graph);
       shardOpt_.push_back(Optimizer(options_));
       builders_.push_back(models::from_config(options_));
@@ -111,8 +112,6 @@ public:
 
     if(options_->get<bool>("overwrite")) {
       builders_[idx]->save(graphs_[idx], name, true);
-      if(scheduler_)
-        scheduler_->save(name);
     } else {
       if(!final) {
         std::string numberOfBatches
@@ -125,8 +124,6 @@ public:
       }
 
       builders_[idx]->save(graphs_[idx], name, true);
-      if(scheduler_)
-        scheduler_->save(name);
     }
 
     if(movingAvg_)
@@ -134,6 +131,10 @@ public:
 
     size_t totalSize = graphs_[idx]->params()->vals()->size();
     shardOpt_[idx]->save(name + ".optimizer.npz", shardOpt_, totalSize);
+
+    // the progress is queued after the model and optimizer files
+    if(scheduler_)
+      scheduler_->save(name);
   }
 
   Ptr<data::BatchStats> collectStats() {
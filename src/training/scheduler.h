@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/config.h"
+#include "common/io.h"
 #include "training/training_state.h"
 #include "training/validator.h"
 
@@ -17,6 +18,32 @@ private:
 
   boost::timer::cpu_timer timer;
 
+  // Words and batch cells including padding since the last display
+  size_t tokensDisp_{0};
+  size_t cellsDisp_{0};
+
+  // Updates the training state after all validators have been updated with
+  // the given scores
+  void updateValidated(const std::vector<float>& scores,
+                       const std::vector<size_t>& stalledPrev) {
+    // the best score and stalled validations follow the first validator
+    for(size_t i = 0; i < validators_.size(); ++i) {
+      auto validator = validators_[i];
+      if(!validator)
+        continue;
+
+      if(validator->stalled() == 0)
+        state_->validBest = scores[i];
+
+      // notify training observers if the first validator did not improve
+      if(validator->stalled() > stalledPrev[i])
+        state_->newStalled(validator->stalled());
+      break;
+    }
+
+    state_->validated = true;
+  }
+
 public:
   Scheduler(Ptr<Config> options, Ptr<TrainingState> state)
       : options_(options), state_(state) {}
@@ -71,44 +98,72 @@ public:
     return (state_->batches % options_->get<size_t>("save-freq") == 0);
   }
 
-  void validate(const std::vector<Ptr<ExpressionGraph>>& graphs, bool final = false) {
+  /**
+   * @brief Runs all validators if a validation is due and returns their
+   * scores, or nothing if no validation was due.
+   */
+  std::vector<float> validate(const std::vector<Ptr<ExpressionGraph>>& graphs,
+                              bool final = false) {
     if(state_->validated
        || (state_->batches % options_->get<size_t>("valid-freq") != 0
            && !final))
-      return;
+      return {};
 
-    bool firstValidator = true;
+    std::vector<float> scores;
+    std::vector<size_t> stalledPrev;
     for(auto validator : validators_) {
+      stalledPrev.push_back(validator ? validator->stalled() : 0);
+      scores.push_back(validator ? validator->validate(graphs) : 0.f);
+
       if(!validator)
         continue;
-
-      size_t stalledPrev = validator->stalled();
-      float value = validator->validate(graphs);
       if(validator->stalled() > 0) {
         LOG_VALID(info,
                   "{} : {} : {} : stalled {} times",
                   state_->batches,
                   validator->type(),
-                  value,
+                  scores.back(),
                   validator->stalled());
       } else {
         LOG_VALID(info,
                   "{} : {} : {} : new best",
                   state_->batches,
                   validator->type(),
-                  value);
-
-        if(firstValidator)
-          state_->validBest = value;
+                  scores.back());
       }
-
-      // notify training observers if the first validator did not improve
-      if(firstValidator && validator->stalled() > stalledPrev)
-        state_->newStalled(validator->stalled());
-      firstValidator = false;
     }
 
-    state_->validated = true;
+    updateValidated(scores, stalledPrev);
+    return scores;
+  }
+
+  /**
+   * @brief Numbers of stalled validations of all validators.
+   */
+  std::vector<size_t> stalledValidations() {
+    std::vector<size_t> stalled;
+    for(auto validator : validators_)
+      stalled.push_back(validator ? validator->stalled() : 0);
+    return stalled;
+  }
+
+  /**
+   * @brief Takes over the scores and numbers of stalled validations of a
+   * validation done elsewhere, e.g. on another node, so that the training
+   * state changes as if the validation had been done here. Does nothing if
+   * no scores are given.
+   */
+  void validated(const std::vector<float>& scores,
+                 const std::vector<size_t>& stalled) {
+    if(scores.empty())
+      return;
+
+    auto stalledPrev = stalledValidations();
+    for(size_t i = 0; i < validators_.size(); ++i)
+      if(validators_[i])
+        validators_[i]->takeOver(scores[i], stalled[i]);
+
+    updateValidated(scores, stalledPrev);
   }
 
   size_t stalled() {
@@ -119,7 +174,24 @@ public:
   }
 
   void update(float cost, Ptr<data::Batch> batch) {
-    update(cost, batch->size(), batch->words());
+    update(cost, std::vector<Ptr<data::Batch>>({batch}));
+  }
+
+  /**
+   * Update with the cost of batches processed for a single update, e.g. the
+   * parts of a batch split across devices, which also counts their padding.
+   */
+  void update(float cost, const std::vector<Ptr<data::Batch>>& batches) {
+    int sentences = 0;
+    int words = 0;
+    for(auto batch : batches) {
+      sentences += batch->size();
+      words += batch->words();
+      tokensDisp_ += batch->words() + batch->wordsTrg();
+      cellsDisp_ += batch->size() * batch->width()
+                    + batch->sizeTrg() * batch->widthTrg();
+    }
+    update(cost, sentences, words);
   }
 
   void update(float cost, int sentences, int words) {
@@ -132,32 +204,39 @@ public:
     state_->newBatch();
 
     if(state_->batches % options_->get<size_t>("disp-freq") == 0) {
+      float padding = cellsDisp_ > 0
+                          ? 100.f * (cellsDisp_ - tokensDisp_) / cellsDisp_
+                          : 0.f;
       if(options_->get<bool>("lr-report")) {
         LOG(info,
             "Ep. {} : Up. {} : Sen. {} : Cost {:.2f} : Time {} : {:.2f} "
-            "words/s : L.r. {:.4e}",
+            "words/s : L.r. {:.4e} : {:.1f}% padding",
             state_->epochs,
             state_->batches,
             state_->samples,
             state_->costSum / state_->samplesDisp,
             timer.format(2, "%ws"),
             state_->wordsDisp / std::stof(timer.format(5, "%w")),
-            state_->eta);
+            state_->eta,
+            padding);
       } else {
         LOG(info,
             "Ep. {} : Up. {} : Sen. {} : Cost {:.2f} : Time {} : {:.2f} "
-            "words/s",
+            "words/s : {:.1f}% padding",
             state_->epochs,
             state_->batches,
             state_->samples,
             state_->costSum / state_->samplesDisp,
             timer.format(2, "%ws"),
-            state_->wordsDisp / std::stof(timer.format(5, "%w")));
+            state_->wordsDisp / std::stof(timer.format(5, "%w")),
+            padding);
       }
       timer.start();
       state_->costSum = 0;
       state_->wordsDisp = 0;
       state_->samplesDisp = 0;
+      tokensDisp_ = 0;
+      cellsDisp_ = 0;
     }
   }
 
@@ -177,12 +256,25 @@ public:
   }
 
   void save(const std::string& name) {
-    // Save config options
-    YAML::Node config = options_->get();
-    std::ofstream fout(name + ".yml");
-    fout << config;
-    // Save training progress
-    state_->save(name + ".progress.yml");
+    // Save config options and training progress after the model and optimizer
+    // files queued before, so that the progress never refers to files which
+    // have not been written yet
+    io::writeAsync(progressWriter(name));
+  }
+
+  /**
+   * @brief Returns a function which writes the config options and the
+   * training progress as of now, for callers which delay the write until
+   * files of other processes are complete.
+   */
+  std::function<void()> progressWriter(const std::string& name) {
+    YAML::Node config = YAML::Clone(options_->get());
+    TrainingState state = *state_;
+    return [name, config, state]() mutable {
+      std::ofstream fout(name + ".yml");
+      fout << config;
+      state.save(name + ".progress.yml");
+    };
   }
 
   size_t numberOfBatches() { return state_->batches; }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "common/config.h"
+#include "common/io.h"
 #include "data/batch_generator.h"
+#include "data/corpus_binary.h"
 #include "data/corpus_sqlite.h"
 #include "models/model_task.h"
 #include "training/scheduler.h"
@@ -23,6 +25,8 @@ public:
     Ptr<CorpusBase> dataset;
     if(!options_->get<std::string>("sqlite").empty())
       dataset = New<CorpusSQLite>(options_);
+    else if(options_->get<bool>("binary-corpus"))
+      dataset = New<CorpusBinary>(options_);
     else
       dataset = New<Corpus>(options_);
 
@@ -55,6 +59,8 @@ public:
 
     auto model = New<ModelWrapper>(options_);
     model->setScheduler(scheduler);
+    if(stats)
+      model->setBatchStats(stats);
     model->load();
 
     // @TODO: shuffle_ as a private attribute in BG
@@ -80,6 +86,7 @@ public:
 
     model->wait();
     model->save(true);
+    io::waitForSaves();
   }
 };
 }
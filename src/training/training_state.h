@@ -55,6 +55,15 @@ public:
   // The state of the random number generator from a corpus
   std::string seedCorpus;
 
+  // Position of the corpus in this epoch at the start of the maxi-batch
+  // containing the next batch
+  size_t corpusPosition{0};
+  // The number of batches in this epoch before that maxi-batch
+  size_t batchesMaxiBatch{0};
+  // The state of the random number generator from a batch generator at the
+  // start of that maxi-batch, empty if unknown
+  std::string seedMaxiBatch;
+
   bool loaded{false};
   bool validated{false};
 
@@ -120,6 +129,13 @@ public:
 
     seedBatch = config["seed-batch"].as<std::string>();
     seedCorpus = config["seed-corpus"].as<std::string>();
+
+    // not available in files from older versions
+    if(config["seed-maxi-batch"]) {
+      corpusPosition = config["corpus-position"].as<size_t>();
+      batchesMaxiBatch = config["batches-maxi-batch"].as<size_t>();
+      seedMaxiBatch = config["seed-maxi-batch"].as<std::string>();
+    }
   }
 
   void save(const std::string& name) {
@@ -147,6 +163,10 @@ public:
     config["seed-batch"] = seedBatch;
     config["seed-corpus"] = seedCorpus;
 
+    config["corpus-position"] = corpusPosition;
+    config["batches-maxi-batch"] = batchesMaxiBatch;
+    config["seed-maxi-batch"] = seedMaxiBatch;
+
     fout << config;
   }
 
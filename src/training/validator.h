@@ -33,6 +33,17 @@ public:
 
   size_t stalled() { return stalled_; }
 
+  /**
+   * @brief Takes over the result of the same validation done elsewhere, e.g.
+   * on another node: its score and the resulting number of stalled
+   * validations.
+   */
+  void takeOver(float score, size_t stalled) {
+    stalled_ = stalled;
+    if(stalled_ == 0)
+      lastBest_ = score;
+  }
+
   virtual void actAfterLoaded(TrainingState& state) {
     lastBest_ = state.validBest;
     stalled_ = state.stalled;
@@ -202,6 +213,8 @@ public:
     using namespace data;
     auto model = options_->get<std::string>("model");
     builder_->save(graphs[0], model + ".dev.npz", true);
+    // the script reads the model file
+    io::waitForSaves();
 
     auto command = options_->get<std::string>("valid-script-path");
     auto valStr = Exec(command);
@@ -1,5 +1,7 @@
 #pragma once
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 #include "marian.h"
 #include "translator/history.h"
@@ -16,6 +18,21 @@ private:
   std::vector<Ptr<Scorer>> scorers_;
   size_t beamSize_;
 
+  float pruneAbs_{0};
+  float pruneRel_{0};
+  bool earlyStop_{false};
+  float maxLengthFactor_{3};
+  size_t maxLengthOffset_{0};
+
+  // evaluates scorers with graphs of their own concurrently, kept for all
+  // batches translated with this search
+  UPtr<ThreadPool> pool_;
+
+  template <typename T>
+  T opt(const std::string& key, T value) {
+    return options_->has(key) ? options_->get<T>(key) : value;
+  }
+
 public:
   template <class... Args>
   BeamSearch(Ptr<Config> options,
@@ -25,7 +42,13 @@ public:
         scorers_(scorers),
         beamSize_(options_->has("beam-size")
                       ? options_->get<size_t>("beam-size")
-                      : 3) {}
+                      : 3) {
+    pruneAbs_ = opt<float>("beam-prune-abs", pruneAbs_);
+    pruneRel_ = opt<float>("beam-prune-rel", pruneRel_);
+    earlyStop_ = opt<bool>("beam-early-stop", earlyStop_);
+    maxLengthFactor_ = opt<float>("max-length-factor", maxLengthFactor_);
+    maxLengthOffset_ = opt<size_t>("max-length-offset", maxLengthOffset_);
+  }
 
   Beams toHyps(const std::vector<uint> keys,
                const std::vector<float> costs,
@@ -33,7 +56,8 @@ public:
                const Beams& beams,
                std::vector<Ptr<ScorerState>>& states,
                size_t beamSize,
-               bool first) {
+               bool first,
+               Hypotheses& hyps) {
 
     Beams newBeams(beams.size());
     for(int i = 0; i < keys.size(); ++i) {
@@ -59,16 +83,11 @@ public:
         if(first)
           beamHypIdx = 0;
 
-        auto hyp = New<Hypothesis>(beam[beamHypIdx], embIdx, hypIdxTrans, cost);
-        if(options_->get<bool>("n-best")) {
-          std::vector<float> breakDown(states.size(), 0);
-          beam[beamHypIdx]->GetCostBreakdown().resize(states.size(), 0);
-          for(int j = 0; j < states.size(); ++j) {
-            int key = embIdx + hypIdxTrans * vocabSize;
-            breakDown[j] = states[j]->breakDown(key)
-                           + beam[beamHypIdx]->GetCostBreakdown()[j];
-          }
-          hyp->GetCostBreakdown() = breakDown;
+        size_t hyp = hyps.add(beam[beamHypIdx], embIdx, hypIdxTrans, cost);
+        if(float* breakDown = hyps.GetCostBreakdown(hyp)) {
+          int key = embIdx + hypIdxTrans * vocabSize;
+          for(int j = 0; j < states.size(); ++j)
+            breakDown[j] += states[j]->breakDown(key);
         }
         newBeam.push_back(hyp);
       }
@@ -76,12 +95,12 @@ public:
     return newBeams;
   }
 
-  Beams pruneBeam(const Beams& beams) {
+  Beams pruneBeam(const Beams& beams, const Hypotheses& hyps) {
     Beams newBeams;
     for(auto beam: beams) {
       Beam newBeam;
       for(auto hyp : beam) {
-        if(hyp->GetWord() > 0) {
+        if(hyps.GetWord(hyp) > 0) {
           newBeam.push_back(hyp);
         }
       }
@@ -90,14 +109,68 @@ public:
     return newBeams;
   }
 
+  /**
+   * @brief Removes unfinished hypotheses of a sentence that fall below the
+   * pruning thresholds or cannot beat the best finished translation anymore.
+   *
+   * The thresholds are relative to the best hypothesis of the current step,
+   * finished or not. The early-stop criterion assumes that costs never
+   * increase when a hypothesis is extended, so that the best normalized cost
+   * a hypothesis can still reach is its current cost divided by the largest
+   * length penalty of any length it can still be finished with.
+   */
+  Beam pruneHopeless(const Beam& beam,
+                     const Beam& active,
+                     const Hypotheses& hyps,
+                     Ptr<History> history,
+                     size_t maxLength) {
+    float best = std::numeric_limits<float>::lowest();
+    for(auto hyp : beam)
+      best = std::max(best, hyps.GetCost(hyp));
+
+    float threshold = std::numeric_limits<float>::lowest();
+    if(pruneAbs_ > 0)
+      threshold = std::max(threshold, best - pruneAbs_);
+    if(pruneRel_ > 0)
+      threshold = std::max(threshold, best - pruneRel_ * std::abs(best));
+
+    // unfinished hypotheses have history->size() - 1 words
+    bool stop = earlyStop_ && history->HasFinished();
+    size_t length = history->size();
+    float penalty = std::max(history->LengthPenalty(length),
+                             history->LengthPenalty(std::max(length, maxLength)));
+
+    Beam newBeam;
+    for(auto hyp : active) {
+      float cost = hyps.GetCost(hyp);
+      if(cost < threshold)
+        continue;
+      if(stop && cost / penalty <= history->BestCost())
+        continue;
+      newBeam.push_back(hyp);
+    }
+    return newBeam;
+  }
+
   Histories search(Ptr<ExpressionGraph> graph,
                    Ptr<data::CorpusBatch> batch) {
 
+    // cost breakdowns per scorer are only needed for n-best lists
+    auto hyps = Hypotheses::forThread(
+        options_->get<bool>("n-best") ? scorers_.size() : 0);
+
     int dimBatch = batch->size();
+
+    // translations end after a multiple of their source length
+    std::vector<size_t> maxLengths;
+    for(auto length : batch->front()->lengths())
+      maxLengths.push_back(maxLengthFactor_ * length + maxLengthOffset_);
+
     Histories histories;
     for(int i = 0; i < dimBatch; ++i) {
       size_t sentId = batch->getSentenceIds()[i];
-      auto history = New<History>(sentId, options_->get<float>("normalize"));
+      auto history
+          = New<History>(sentId, hyps, options_->get<float>("normalize"));
       histories.push_back(history);
     }
 
@@ -112,39 +185,42 @@ public:
 #endif
       nth = New<NthElementCPU>(localBeamSize, dimBatch);
 
+    // On the CPU the n-best list is selected directly from the decoder
+    // outputs, which avoids building the full matrix of total costs. Cost
+    // breakdowns for n-best lists need normalized outputs, though.
+    auto fusedNth = std::dynamic_pointer_cast<NthElementCPU>(nth);
+    bool fused = (bool)fusedNth;
+    bool normalize = !fused || options_->get<bool>("n-best");
+    bool skipUnk
+        = options_->has("allow-unk") && !options_->get<bool>("allow-unk");
+
     Beams beams(dimBatch);
+    size_t start = hyps->addStart();
     for(auto& beam : beams)
-      beam.resize(localBeamSize, New<Hypothesis>());
+      beam.resize(localBeamSize, start);
 
     bool first = true;
-    bool final = false;
 
     for(int i = 0; i < dimBatch; ++i)
       histories[i]->Add(beams[i]);
 
-    std::vector<Ptr<ScorerState>> states;
+    auto states = startScorers(graph, scorers_, batch);
 
-    for(auto scorer : scorers_) {
-      scorer->clear(graph);
-    }
-
-    for(auto scorer : scorers_) {
-      states.push_back(scorer->startState(graph, batch));
-    }
+    if(!pool_)
+      pool_ = scorerPool(graph, scorers_);
 
     do {
       //**********************************************************************
       // create constant containing previous costs for current beam
       std::vector<size_t> hypIndices;
       std::vector<size_t> embIndices;
+      std::vector<float> beamCosts;
       Expr prevCosts;
       if(first) {
         // no cost
         prevCosts = graph->constant({1, 1, 1, 1},
                                     inits::from_value(0));
       } else {
-        std::vector<float> beamCosts;
-
         int dimBatch = batch->size();
 
         for(int i = 0; i < localBeamSize; ++i) {
@@ -152,9 +228,9 @@ public:
             auto& beam = beams[j];
             if(i < beam.size()) {
               auto hyp = beam[i];
-              hypIndices.push_back(hyp->GetPrevStateIndex());
-              embIndices.push_back(hyp->GetWord());
-              beamCosts.push_back(hyp->GetCost());
+              hypIndices.push_back(hyps->GetPrevStateIndex(hyp));
+              embIndices.push_back(hyps->GetWord(hyp));
+              beamCosts.push_back(hyps->GetCost(hyp));
             }
             else {
               hypIndices.push_back(0);
@@ -164,39 +240,33 @@ public:
           }
         }
 
-        prevCosts
-            = graph->constant({(int)localBeamSize, 1, dimBatch, 1},
-                              inits::from_vector(beamCosts));
+        if(!fused)
+          prevCosts
+              = graph->constant({(int)localBeamSize, 1, dimBatch, 1},
+                                inits::from_vector(beamCosts));
       }
 
       //**********************************************************************
       // prepare costs for beam search
-      auto totalCosts = prevCosts;
-
-      for(int i = 0; i < scorers_.size(); ++i) {
-        states[i] = scorers_[i]->step(graph, states[i], hypIndices, embIndices, dimBatch, localBeamSize);
-
-        if(scorers_[i]->getWeight() != 1.f)
-          totalCosts = totalCosts + scorers_[i]->getWeight() * states[i]->getProbs();
-        else
-          totalCosts = totalCosts + states[i]->getProbs();
-      }
+      stepScorers(graph, scorers_, states, hypIndices, embIndices, dimBatch,
+                  localBeamSize, normalize, first, pool_.get());
+
+      Expr totalCosts;
+      if(!fused) {
+        totalCosts = prevCosts;
+        for(int i = 0; i < scorers_.size(); ++i) {
+          if(scorers_[i]->getWeight() != 1.f)
+            totalCosts = totalCosts + scorers_[i]->getWeight() * states[i]->getProbs();
+          else
+            totalCosts = totalCosts + states[i]->getProbs();
+        }
 
-      // make beams continuous
-      if(dimBatch > 1 && localBeamSize > 1)
-        totalCosts = transpose(totalCosts, {2, 1, 0, 3});
+        // make beams continuous
+        if(dimBatch > 1 && localBeamSize > 1)
+          totalCosts = transpose(totalCosts, {2, 1, 0, 3});
 
-      if(first)
-        graph->forward();
-      else
         graph->forwardNext();
-
-      //**********************************************************************
-      // suppress specific symbols if not at right positions
-      if(options_->has("allow-unk") && !options_->get<bool>("allow-unk"))
-        suppressUnk(totalCosts);
-      for(auto state : states)
-        state->blacklist(totalCosts, batch);
+      }
 
       //**********************************************************************
       // perform beam search and pruning
@@ -204,16 +274,43 @@ public:
       std::vector<float> outCosts;
 
       std::vector<size_t> beamSizes(dimBatch, localBeamSize);
-      nth->getNBestList(beamSizes, totalCosts->val(), outCosts, outKeys, first);
+      int dimTrgVoc = states[0]->getProbs()->shape()[-1];
+
+      if(fused) {
+        // blacklisted symbols are suppressed in the decoder outputs, which
+        // are stored in the same order as before the transposition
+        std::vector<ScoreTerm> terms;
+        for(int i = 0; i < scorers_.size(); ++i) {
+          states[i]->blacklist(states[i]->getProbs(), batch);
+          terms.push_back({states[i]->getProbs()->val(),
+                           scorers_[i]->getWeight(),
+                           states[i]->needsLogSoftmax()});
+        }
+        fusedNth->getNBestListFromScores(
+            beamSizes, beamCosts, terms, outCosts, outKeys, first, skipUnk);
+      } else {
+        // suppress specific symbols if not at right positions
+        if(skipUnk)
+          suppressUnk(totalCosts);
+        for(auto state : states)
+          state->blacklist(totalCosts, batch);
 
-      int dimTrgVoc = totalCosts->shape()[-1];
-      beams = toHyps(outKeys, outCosts, dimTrgVoc, beams, states, localBeamSize, first);
+        nth->getNBestList(beamSizes, totalCosts->val(), outCosts, outKeys, first);
+      }
+
+      beams = toHyps(outKeys, outCosts, dimTrgVoc, beams, states, localBeamSize, first, *hyps);
 
-      auto prunedBeams = pruneBeam(beams);
+      auto prunedBeams = pruneBeam(beams, *hyps);
       for(int i = 0; i < dimBatch; ++i) {
         if(!beams[i].empty()) {
-          final = final || histories[i]->size() >= 3 * batch->front()->batchWidth();
+          bool final = histories[i]->size() >= maxLengths[i];
           histories[i]->Add(beams[i], prunedBeams[i].empty() || final);
+
+          if(final)
+            prunedBeams[i].clear();
+          else if(pruneAbs_ > 0 || pruneRel_ > 0 || earlyStop_)
+            prunedBeams[i] = pruneHopeless(
+                beams[i], prunedBeams[i], *hyps, histories[i], maxLengths[i]);
         }
       }
       beams = prunedBeams;
@@ -227,7 +324,7 @@ public:
       }
       first = false;
 
-    } while(localBeamSize != 0 && !final);
+    } while(localBeamSize != 0);
 
     return histories;
   }
@@ -0,0 +1,158 @@
+#include <cmath>
+#include <limits>
+
+#include "translator/greedy_search.h"
+
+namespace marian {
+
+namespace {
+
+// Finds the largest element of a row, ignoring the element at index skip,
+// and the log of the sum of exponentials of all elements in a single pass.
+void argmaxLogSumExp(const float* row,
+                     size_t n,
+                     size_t skip,
+                     size_t& best,
+                     float& logSumExp) {
+  float bestValue = std::numeric_limits<float>::lowest();
+  float max = std::numeric_limits<float>::lowest();
+  float sum = 0.f;
+  best = 0;
+  for(size_t i = 0; i < n; ++i) {
+    float value = row[i];
+    if(value > max) {
+      sum = sum * std::exp(max - value) + 1.f;
+      max = value;
+    } else {
+      sum += std::exp(value - max);
+    }
+    if(value > bestValue && i != skip) {
+      bestValue = value;
+      best = i;
+    }
+  }
+  logSumExp = max + std::log(sum);
+}
+}
+
+Histories GreedySearch::search(Ptr<ExpressionGraph> graph,
+                               Ptr<data::CorpusBatch> batch) {
+  size_t dimBatch = batch->size();
+
+  // translations end after a multiple of their source length
+  float factor = options_->has("max-length-factor")
+                     ? options_->get<float>("max-length-factor")
+                     : 3.f;
+  size_t offset = options_->has("max-length-offset")
+                      ? options_->get<size_t>("max-length-offset")
+                      : 0;
+  std::vector<size_t> maxLengths;
+  for(auto length : batch->front()->lengths())
+    maxLengths.push_back(factor * length + offset);
+
+  size_t skip = std::numeric_limits<size_t>::max();
+  if(options_->has("allow-unk") && !options_->get<bool>("allow-unk"))
+    skip = UNK_ID;
+
+  auto states = startScorers(graph, scorers_, batch);
+
+  if(!pool_)
+    pool_ = scorerPool(graph, scorers_);
+
+  // output words and their costs, indexed by step * dimBatch + sentence
+  std::vector<size_t> words;
+  std::vector<float> costs;
+  std::vector<size_t> lengths(dimBatch, 0);
+  size_t active = dimBatch;
+
+  std::vector<size_t> embIndices;
+  std::vector<const float*> rows(scorers_.size());
+  for(size_t t = 0; active > 0; ++t) {
+    // decoder states stay in batch order, so they are never reordered
+    stepScorers(graph, scorers_, states, {}, embIndices, dimBatch, 1, false,
+                t == 0, pool_.get());
+
+    size_t dimVocab = states[0]->getProbs()->shape()[-1];
+    for(size_t i = 0; i < scorers_.size(); ++i) {
+      auto probs = states[i]->getProbs();
+      states[i]->blacklist(probs, batch);
+      ABORT_IF(probs->val()->getDevice().type != DeviceType::cpu,
+               "Greedy search requires decoder outputs on the CPU");
+      rows[i] = probs->val()->data();
+    }
+
+    auto row = [&](size_t i, size_t sentence) {
+      bool broadcast = states[i]->getProbs()->shape().elements() == dimVocab;
+      return rows[i] + (broadcast ? 0 : sentence * dimVocab);
+    };
+
+    // a single scorer with a positive weight is scanned in place, otherwise
+    // the weighted sum of all scorers is accumulated into a buffer
+    bool inPlace = scorers_.size() == 1 && scorers_[0]->getWeight() > 0.f;
+    if(!inPlace)
+      rowBuffer_.resize(dimVocab);
+
+    embIndices.resize(dimBatch);
+    for(size_t j = 0; j < dimBatch; ++j) {
+      size_t word = EOS_ID;
+      float cost = 0.f;
+      if(!lengths[j]) {
+        float logSumExp;
+        if(inPlace) {
+          const float* scores = row(0, j);
+          argmaxLogSumExp(scores, dimVocab, skip, word, logSumExp);
+          cost = scores[word];
+          if(states[0]->needsLogSoftmax())
+            cost -= logSumExp;
+          cost *= scorers_[0]->getWeight();
+        } else {
+          float offset = 0.f;
+          std::fill(rowBuffer_.begin(), rowBuffer_.end(), 0.f);
+          for(size_t i = 0; i < scorers_.size(); ++i) {
+            const float* scores = row(i, j);
+            float weight = scorers_[i]->getWeight();
+            for(size_t k = 0; k < dimVocab; ++k)
+              rowBuffer_[k] += weight * scores[k];
+            if(states[i]->needsLogSoftmax()) {
+              size_t unused;
+              argmaxLogSumExp(scores, dimVocab, skip, unused, logSumExp);
+              offset -= weight * logSumExp;
+            }
+          }
+          argmaxLogSumExp(rowBuffer_.data(), dimVocab, skip, word, logSumExp);
+          cost = rowBuffer_[word] + offset;
+        }
+
+        if(word == EOS_ID || t + 1 >= maxLengths[j]) {
+          lengths[j] = t + 1;
+          active--;
+        }
+      }
+      words.push_back(word);
+      costs.push_back(cost);
+      embIndices[j] = word;
+    }
+  }
+
+  // create the hypotheses of the single translation of each sentence
+  auto hyps = Hypotheses::forThread();
+  size_t start = hyps->addStart();
+
+  Histories histories;
+  for(size_t j = 0; j < dimBatch; ++j) {
+    auto history = New<History>(
+        batch->getSentenceIds()[j], hyps, options_->get<float>("normalize"));
+    history->Add({start});
+
+    size_t hyp = start;
+    float cost = 0.f;
+    for(size_t t = 0; t < lengths[j]; ++t) {
+      cost += costs[t * dimBatch + j];
+      hyp = hyps->add(hyp, words[t * dimBatch + j], j, cost);
+      history->Add({hyp}, t + 1 == lengths[j]);
+    }
+    histories.push_back(history);
+  }
+  return histories;
+}
+}
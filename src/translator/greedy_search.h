@@ -0,0 +1,43 @@
+#pragma once
+
+#include "marian.h"
+#include "translator/history.h"
+#include "translator/scorers.h"
+
+namespace marian {
+
+/**
+ * @brief Search for beam size 1 that keeps the single best word per sentence.
+ *
+ * The same interface as BeamSearch but without beams of hypotheses: the best
+ * word of each sentence is found with a single pass over the decoder outputs
+ * which computes the argmax and the log-normalizer at the same time, and
+ * output words and costs are kept in flat arrays. Decoder states are not
+ * reordered between steps. Hypotheses for the histories are added to the
+ * table only once the whole batch has been translated. Decoding ends as soon as every
+ * sentence has produced the end-of-sentence symbol.
+ *
+ * The decoder outputs are scanned in place, so the search is only used with
+ * CPU backends, where copying them to the host at every step is not needed.
+ */
+class GreedySearch {
+private:
+  Ptr<Config> options_;
+  std::vector<Ptr<Scorer>> scorers_;
+
+  std::vector<float> rowBuffer_;
+
+  // evaluates scorers with graphs of their own concurrently, kept for all
+  // batches translated with this search
+  UPtr<ThreadPool> pool_;
+
+public:
+  template <class... Args>
+  GreedySearch(Ptr<Config> options,
+               const std::vector<Ptr<Scorer>>& scorers,
+               Args... args)
+      : options_(options), scorers_(scorers) {}
+
+  Histories search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch);
+};
+}
@@ -2,5 +2,6 @@
 
 namespace marian {
 
-History::History(size_t lineNo, float alpha) : lineNo_(lineNo), alpha_(alpha) {}
+History::History(size_t lineNo, Ptr<Hypotheses> hyps, float alpha)
+    : hyps_(hyps), lineNo_(lineNo), alpha_(alpha) {}
 }
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <queue>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 #include "hypothesis.h"
 
@@ -11,54 +13,59 @@ private:
   struct HypothesisCoord {
     bool operator<(const HypothesisCoord& hc) const { return cost < hc.cost; }
 
-    size_t i;
-    size_t j;
+    size_t hyp;
     float cost;
   };
 
 public:
-  History(size_t lineNo, float alpha = 1.f);
+  History(size_t lineNo, Ptr<Hypotheses> hyps, float alpha = 1.f);
 
   float LengthPenalty(size_t length) { return std::pow((float)length, alpha_); }
 
   void Add(const Beam& beam, bool last = false) {
-    if(beam.back()->GetPrevHyp() != nullptr) {
+    if(hyps_->GetPrevHyp(beam.back()) != Hypotheses::NONE) {
       for(size_t j = 0; j < beam.size(); ++j)
-        if(beam[j]->GetWord() == 0 || last) {
-          float cost = beam[j]->GetCost() / LengthPenalty(history_.size());
-          topHyps_.push({history_.size(), j, cost});
-          //std::cerr << "Add " << history_.size() << " " << j << " " << cost << std::endl;
+        if(hyps_->GetWord(beam[j]) == 0 || last) {
+          float cost = hyps_->GetCost(beam[j]) / LengthPenalty(size_);
+          topHyps_.push_back({beam[j], cost});
+          bestCost_ = std::max(bestCost_, cost);
         }
     }
-    history_.push_back(beam);
+    size_++;
   }
 
-  size_t size() const { return history_.size(); }
+  size_t size() const { return size_; }
+
+  bool HasFinished() const { return !topHyps_.empty(); }
+
+  /**
+   * @brief Normalized cost of the best finished translation.
+   */
+  float BestCost() const { return bestCost_; }
 
   NBestList NBest(size_t n) const {
+    // finished hypotheses sorted by normalized cost, best first
+    auto topHyps = topHyps_;
+    n = std::min(n, topHyps.size());
+    std::partial_sort(topHyps.begin(),
+                      topHyps.begin() + n,
+                      topHyps.end(),
+                      [](const HypothesisCoord& a, const HypothesisCoord& b) {
+                        return b < a;
+                      });
+
     NBestList nbest;
-    auto topHypsCopy = topHyps_;
-    while(nbest.size() < n && !topHypsCopy.empty()) {
-      auto bestHypCoord = topHypsCopy.top();
-      topHypsCopy.pop();
-
-      size_t start = bestHypCoord.i;
-      size_t j = bestHypCoord.j;
-      //float c = bestHypCoord.cost;
-      //std::cerr << "h: " << start << " " << j << " " << c << std::endl;
-
-      Words targetWords;
-      Ptr<Hypothesis> bestHyp = history_[start][j];
-      while(bestHyp->GetPrevHyp() != nullptr) {
-        targetWords.push_back(bestHyp->GetWord());
-        //std::cerr << bestHyp->GetWord() << " " << bestHyp << std::endl;
-        bestHyp = bestHyp->GetPrevHyp();
-      }
-
-      std::reverse(targetWords.begin(), targetWords.end());
-      nbest.emplace_back(targetWords,
-                         history_[bestHypCoord.i][bestHypCoord.j],
-                         bestHypCoord.cost);
+    for(size_t i = 0; i < n; ++i) {
+      size_t hyp = topHyps[i].hyp;
+
+      std::vector<float> breakdown;
+      const float* costs = hyps_->GetCostBreakdown(hyp);
+      if(costs)
+        breakdown.assign(costs, costs + hyps_->GetCostBreakdownSize());
+      else
+        breakdown.push_back(hyps_->GetCost(hyp));
+
+      nbest.emplace_back(hyps_->traceback(hyp), breakdown, topHyps[i].cost);
     }
     return nbest;
   }
@@ -68,8 +75,10 @@ public:
   size_t GetLineNum() const { return lineNo_; }
 
 private:
-  std::vector<Beam> history_;
-  std::priority_queue<HypothesisCoord> topHyps_;
+  Ptr<Hypotheses> hyps_;
+  std::vector<HypothesisCoord> topHyps_;
+  size_t size_{0};
+  float bestCost_{std::numeric_limits<float>::lowest()};
   size_t lineNo_;
   float alpha_;
 };
@@ -1,42 +1,135 @@
 #pragma once
+#include <algorithm>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 #include "common/definitions.h"
 
 namespace marian {
 
-class Hypothesis {
+typedef std::vector<size_t> Words;
+
+/**
+ * @brief Back-pointer table of all hypotheses created while translating one
+ * batch.
+ *
+ * Hypotheses are stored as a structure of arrays and refer to their
+ * predecessors by index, so creating a hypothesis appends to a few flat
+ * vectors instead of allocating a reference-counted object. The index of a
+ * hypothesis is its handle. If cost breakdowns are enabled, each hypothesis
+ * owns a slice of one flat vector with a cost per scorer. The table is
+ * cleared between batches and keeps its memory.
+ */
+class Hypotheses {
+private:
+  std::vector<size_t> words_;
+  std::vector<size_t> prevHyps_;
+  std::vector<size_t> prevIndices_;
+  std::vector<float> costs_;
+
+  size_t breakdownSize_{0};
+  std::vector<float> breakdowns_;
+
 public:
-  Hypothesis() : prevHyp_(nullptr), prevIndex_(0), word_(0), cost_(0.0) {}
+  // Predecessor of the start hypothesis
+  static const size_t NONE = (size_t)-1;
 
-  Hypothesis(const Ptr<Hypothesis> prevHyp,
-             size_t word,
-             size_t prevIndex,
-             float cost)
-      : prevHyp_(prevHyp), prevIndex_(prevIndex), word_(word), cost_(cost) {}
+  Hypotheses() {}
 
-  const Ptr<Hypothesis> GetPrevHyp() const { return prevHyp_; }
+  /**
+   * @brief Removes all hypotheses and sets the number of costs per
+   * hypothesis in the cost breakdown, 0 if not needed.
+   */
+  void clear(size_t breakdownSize = 0) {
+    words_.clear();
+    prevHyps_.clear();
+    prevIndices_.clear();
+    costs_.clear();
+    breakdowns_.clear();
+    breakdownSize_ = breakdownSize;
+  }
 
-  size_t GetWord() const { return word_; }
+  /**
+   * @brief Adds a hypothesis extending prevHyp by word, where prevIndex is
+   * the row of the decoder state of prevHyp, and returns its handle.
+   *
+   * The cost breakdown is initialized to the one of prevHyp.
+   */
+  size_t add(size_t prevHyp, size_t word, size_t prevIndex, float cost) {
+    size_t hyp = words_.size();
+    words_.push_back(word);
+    prevHyps_.push_back(prevHyp);
+    prevIndices_.push_back(prevIndex);
+    costs_.push_back(cost);
+    if(breakdownSize_ > 0) {
+      if(prevHyp == NONE)
+        breakdowns_.resize(breakdowns_.size() + breakdownSize_, 0.f);
+      else
+        for(size_t j = 0; j < breakdownSize_; ++j)
+          breakdowns_.push_back(breakdowns_[prevHyp * breakdownSize_ + j]);
+    }
+    return hyp;
+  }
 
-  size_t GetPrevStateIndex() const { return prevIndex_; }
+  /**
+   * @brief Adds a start hypothesis without predecessor.
+   */
+  size_t addStart() { return add(NONE, 0, 0, 0.f); }
 
-  float GetCost() const { return cost_; }
+  size_t size() const { return words_.size(); }
 
-  std::vector<float>& GetCostBreakdown() { return costBreakdown_; }
+  /**
+   * @brief Returns a cleared table for the calling thread. The memory of the
+   * previous batch is reused unless its histories are still alive.
+   */
+  static Ptr<Hypotheses> forThread(size_t breakdownSize = 0) {
+    thread_local Ptr<Hypotheses> table;
+    if(!table || table.use_count() > 1)
+      table = New<Hypotheses>();
+    table->clear(breakdownSize);
+    return table;
+  }
 
-private:
-  const Ptr<Hypothesis> prevHyp_;
-  const size_t prevIndex_;
-  const size_t word_;
-  const float cost_;
+  size_t GetPrevHyp(size_t hyp) const { return prevHyps_[hyp]; }
+
+  size_t GetWord(size_t hyp) const { return words_[hyp]; }
 
-  std::vector<float> costBreakdown_;
+  size_t GetPrevStateIndex(size_t hyp) const { return prevIndices_[hyp]; }
+
+  float GetCost(size_t hyp) const { return costs_[hyp]; }
+
+  /**
+   * @brief Pointer to the cost breakdown of a hypothesis, nullptr if
+   * breakdowns are not enabled.
+   */
+  float* GetCostBreakdown(size_t hyp) {
+    return breakdownSize_ > 0 ? breakdowns_.data() + hyp * breakdownSize_
+                              : nullptr;
+  }
+
+  size_t GetCostBreakdownSize() const { return breakdownSize_; }
+
+  /**
+   * @brief Words of a hypothesis from the first word after the start
+   * hypothesis to the word of the given hypothesis.
+   */
+  Words traceback(size_t hyp) const {
+    Words words;
+    for(; prevHyps_[hyp] != NONE; hyp = prevHyps_[hyp])
+      words.push_back(words_[hyp]);
+    std::reverse(words.begin(), words.end());
+    return words;
+  }
 };
 
-typedef std::vector<Ptr<Hypothesis>> Beam;
+// Handles of hypotheses in a Hypotheses table
+typedef std::vector<size_t> Beam;
 typedef std::vector<Beam> Beams;
-typedef std::vector<size_t> Words;
-typedef std::tuple<Words, Ptr<Hypothesis>, float> Result;
+
+/**
+ * @brief Translation, cost breakdown per scorer and normalized cost.
+ */
+typedef std::tuple<Words, std::vector<float>, float> Result;
 typedef std::vector<Result> NBestList;
 }
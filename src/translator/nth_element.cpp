@@ -4,9 +4,13 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 #include <limits>
 #include <numeric>
+
+#include "common/logging.h"
+#include "data/types.h"
 #include "translator/nth_element.h"
 
 namespace marian {
@@ -79,4 +83,149 @@ void NthElementCPU::getValueByKey(std::vector<float>& out, float* d_in) {
   }
 }
 
+namespace {
+
+typedef std::pair<float, unsigned> CostKey;
+
+// Orders the n-best heap such that its front is the worst kept element
+bool worse(const CostKey& a, const CostKey& b) {
+  return a.first > b.first;
+}
+
+// Log of the sum of exponentials of a row in a single pass with a running
+// maximum
+float logSumExp(const float* row, size_t n) {
+  float max = std::numeric_limits<float>::lowest();
+  float sum = 0.f;
+  for(size_t i = 0; i < n; ++i) {
+    if(row[i] > max) {
+      sum = sum * std::exp(max - row[i]) + 1.f;
+      max = row[i];
+    } else {
+      sum += std::exp(row[i] - max);
+    }
+  }
+  return max + std::log(sum);
+}
+
+// Cost of a candidate. Blacklisted scores are set to the lowest float, which
+// overflows to -inf with weights or the offset applied, so the cost is kept at
+// that finite sentinel instead.
+float candidateCost(float score, float offset) {
+  return std::max(score + offset, std::numeric_limits<float>::lowest());
+}
+
+// Pushes all elements of row[begin, end) plus offset that are better than the
+// worst element of a full heap of size n. The comparison in the inner loop is
+// done against the row values, so the offset is only added for candidates.
+void selectNBest(const float* row,
+                 size_t begin,
+                 size_t end,
+                 float offset,
+                 unsigned keyOffset,
+                 size_t n,
+                 std::vector<CostKey>& heap) {
+  size_t i = begin;
+  for(; i < end && heap.size() < n; ++i) {
+    heap.emplace_back(candidateCost(row[i], offset), keyOffset + i);
+    std::push_heap(heap.begin(), heap.end(), worse);
+  }
+
+  float threshold = heap.empty() ? std::numeric_limits<float>::lowest()
+                                 : heap.front().first - offset;
+  for(; i < end; ++i) {
+    if(row[i] > threshold) {
+      std::pop_heap(heap.begin(), heap.end(), worse);
+      heap.back() = CostKey(candidateCost(row[i], offset), keyOffset + i);
+      std::push_heap(heap.begin(), heap.end(), worse);
+      threshold = heap.front().first - offset;
+    }
+  }
+}
+}
+
+void NthElementCPU::getNBestListFromScores(
+    const std::vector<size_t>& beamSizes,
+    const std::vector<float>& prevCosts,
+    const std::vector<ScoreTerm>& terms,
+    std::vector<float>& outCosts,
+    std::vector<unsigned>& outKeys,
+    const bool isFirst,
+    const bool skipUnk) {
+  ABORT_IF(terms.empty(), "No scores to select the n-best list from");
+
+  size_t dimBatch = beamSizes.size();
+  size_t dimBeam = isFirst ? 1 : *std::max_element(beamSizes.begin(),
+                                                   beamSizes.end());
+  size_t dimVocab = terms[0].scores->shape()[-1];
+  size_t numRows = dimBeam * dimBatch;
+
+  for(auto& term : terms) {
+    size_t rows = term.scores->shape().elements() / dimVocab;
+    ABORT_IF(term.scores->shape()[-1] != dimVocab
+                 || (rows != 1 && rows != numRows),
+             "Score terms of shape {} do not match {} hypotheses",
+             term.scores->shape().toString(),
+             numRows);
+  }
+
+  // A single unweighted term is scanned in place, otherwise the weighted sum
+  // of the terms is accumulated for one row at a time.
+  bool inPlace = terms.size() == 1 && terms[0].weight == 1.f;
+  if(!inPlace)
+    rowBuffer_.resize(dimVocab);
+
+  auto termRow = [&](const ScoreTerm& term, size_t row) -> const float* {
+    bool broadcast = term.scores->shape().elements() == dimVocab;
+    return term.scores->data() + (broadcast ? 0 : row * dimVocab);
+  };
+
+  std::vector<CostKey> heap;
+  for(size_t batchIdx = 0; batchIdx < dimBatch; ++batchIdx) {
+    size_t n = beamSizes[batchIdx];
+    heap.clear();
+    heap.reserve(n);
+
+    for(size_t beamIdx = 0; beamIdx < dimBeam; ++beamIdx) {
+      size_t row = beamIdx * dimBatch + batchIdx;
+
+      // everything that is constant for a row is folded into the offset
+      float offset = prevCosts.empty() ? 0.f : prevCosts[row];
+      for(auto& term : terms)
+        if(term.logSoftmax)
+          offset -= term.weight * logSumExp(termRow(term, row), dimVocab);
+
+      const float* scores = termRow(terms[0], row);
+      if(!inPlace) {
+        float* buffer = rowBuffer_.data();
+        float weight = terms[0].weight;
+        for(size_t i = 0; i < dimVocab; ++i)
+          buffer[i] = weight * scores[i];
+        for(size_t t = 1; t < terms.size(); ++t) {
+          const float* other = termRow(terms[t], row);
+          weight = terms[t].weight;
+          for(size_t i = 0; i < dimVocab; ++i)
+            buffer[i] += weight * other[i];
+        }
+        scores = buffer;
+      }
+
+      unsigned keyOffset = (isFirst ? batchIdx : batchIdx * dimBeam + beamIdx)
+                           * dimVocab;
+      if(skipUnk && UNK_ID < dimVocab) {
+        selectNBest(scores, 0, UNK_ID, offset, keyOffset, n, heap);
+        selectNBest(scores, UNK_ID + 1, dimVocab, offset, keyOffset, n, heap);
+      } else {
+        selectNBest(scores, 0, dimVocab, offset, keyOffset, n, heap);
+      }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), worse);
+    for(auto& costKey : heap) {
+      outCosts.push_back(costKey.first);
+      outKeys.push_back(costKey.second);
+    }
+  }
+}
+
 }
@@ -12,6 +12,18 @@
 
 namespace marian {
 
+/**
+ * @brief Weighted term of the total cost of a search step.
+ *
+ * If logSoftmax is set, the scores are unnormalized decoder outputs which are
+ * normalized on the fly. A term with a single row is added to all hypotheses.
+ */
+struct ScoreTerm {
+  Tensor scores;
+  float weight;
+  bool logSoftmax;
+};
+
 struct NthElement {
   virtual ~NthElement() {}
 
@@ -57,6 +69,28 @@ public:
                 std::vector<float>& outValues);
 
   void getValueByKey(std::vector<float>& out, float* d_in);
+
+  /**
+   * @brief Selects the n-best continuations directly from the score terms of
+   * the current step without building the matrix of total costs.
+   *
+   * The total cost of word w after hypothesis h is prevCosts[h] plus the
+   * weighted sum of all terms, with log-softmax applied to terms that require
+   * it. Hypotheses are stored beam-major as produced by the decoder, i.e. row
+   * h = beamIdx * dimBatch + batchIdx, while keys are returned in the
+   * batch-major layout expected by BeamSearch::toHyps(). If prevCosts is
+   * empty, all previous costs are 0.
+   */
+  void getNBestListFromScores(const std::vector<size_t>& beamSizes,
+                              const std::vector<float>& prevCosts,
+                              const std::vector<ScoreTerm>& terms,
+                              std::vector<float>& outCosts,
+                              std::vector<unsigned>& outKeys,
+                              const bool isFirst = false,
+                              const bool skipUnk = false);
+
+private:
+  std::vector<float> rowBuffer_;
 };
 
 class NthElementGPU : public NthElement {
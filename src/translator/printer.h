@@ -23,7 +23,7 @@ void Printer(Ptr<Config> options,
     for(size_t i = 0; i < nbl.size(); ++i) {
       const auto& result = nbl[i];
       const auto& words = std::get<0>(result);
-      const auto& hypo = std::get<1>(result);
+      const auto& costs = std::get<1>(result);
 
       float realCost = std::get<2>(result);
 
@@ -31,12 +31,8 @@ void Printer(Ptr<Config> options,
 
       bestn << history->GetLineNum() << " ||| " << translation << " |||";
 
-      if(hypo->GetCostBreakdown().empty()) {
-        bestn << " F0=" << hypo->GetCost();
-      } else {
-        for(size_t j = 0; j < hypo->GetCostBreakdown().size(); ++j) {
-          bestn << " F" << j << "= " << hypo->GetCostBreakdown()[j];
-        }
+      for(size_t j = 0; j < costs.size(); ++j) {
+        bestn << " F" << j << "= " << costs[j];
       }
 
       bestn << " ||| " << realCost;
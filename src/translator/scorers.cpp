@@ -53,4 +53,102 @@ std::vector<Ptr<Scorer>> createScorers(Ptr<Config> options) {
 
   return scorers;
 }
+
+void initScorers(Ptr<ExpressionGraph> graph,
+                 const std::vector<Ptr<Scorer>>& scorers,
+                 Ptr<Config> options) {
+  bool parallel = options->has("parallel-scorers")
+                  && options->get<bool>("parallel-scorers")
+                  && graph->getDevice().type == DeviceType::cpu;
+
+  size_t graphThreads = options->has("graph-threads")
+                            ? options->get<size_t>("graph-threads")
+                            : 0;
+  graph->setForwardThreads(graphThreads);
+
+  for(auto scorer : scorers) {
+    if(parallel && std::dynamic_pointer_cast<ScorerWrapper>(scorer)) {
+      auto own = New<ExpressionGraph>(true);
+      own->setDevice(graph->getDevice());
+      own->reserveWorkspaceMB(options->get<size_t>("workspace"));
+      own->setForwardThreads(graphThreads);
+      scorer->setGraph(own);
+    }
+    scorer->init(scorer->getGraph(graph));
+  }
+}
+
+std::vector<Ptr<ScorerState>> startScorers(
+    Ptr<ExpressionGraph> graph,
+    const std::vector<Ptr<Scorer>>& scorers,
+    Ptr<data::CorpusBatch> batch) {
+  for(auto scorer : scorers)
+    scorer->clear(scorer->getGraph(graph));
+
+  std::vector<Ptr<ScorerState>> states;
+  for(auto scorer : scorers)
+    states.push_back(scorer->startState(scorer->getGraph(graph), batch));
+  return states;
+}
+
+UPtr<ThreadPool> scorerPool(Ptr<ExpressionGraph> graph,
+                            const std::vector<Ptr<Scorer>>& scorers) {
+  size_t numGraphs = 0;
+  for(auto scorer : scorers)
+    if(scorer->getGraph(graph) != graph)
+      numGraphs++;
+  if(numGraphs == 0)
+    return nullptr;
+  return UPtr<ThreadPool>(new ThreadPool(numGraphs, numGraphs));
+}
+
+void stepScorers(Ptr<ExpressionGraph> graph,
+                 const std::vector<Ptr<Scorer>>& scorers,
+                 std::vector<Ptr<ScorerState>>& states,
+                 const std::vector<size_t>& hypIndices,
+                 const std::vector<size_t>& embIndices,
+                 int dimBatch,
+                 int beamSize,
+                 bool normalize,
+                 bool first,
+                 ThreadPool* pool) {
+  auto forward = [first](Ptr<ExpressionGraph> g) {
+    if(first)
+      g->forward();
+    else
+      g->forwardNext();
+  };
+
+  std::vector<std::future<void>> results;
+  for(size_t i = 0; i < scorers.size(); ++i) {
+    auto own = scorers[i]->getGraph(graph);
+    if(own == graph)
+      continue;
+
+    auto task = [&, i, own]() {
+      states[i] = scorers[i]->step(
+          own, states[i], hypIndices, embIndices, dimBatch, beamSize, normalize);
+      forward(own);
+    };
+
+    if(pool)
+      results.emplace_back(pool->enqueue(task));
+    else
+      task();
+  }
+
+  bool shared = false;
+  for(size_t i = 0; i < scorers.size(); ++i) {
+    if(scorers[i]->getGraph(graph) == graph) {
+      states[i] = scorers[i]->step(
+          graph, states[i], hypIndices, embIndices, dimBatch, beamSize, normalize);
+      shared = true;
+    }
+  }
+  if(shared)
+    forward(graph);
+
+  for(auto& result : results)
+    result.get();
+}
 }
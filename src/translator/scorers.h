@@ -1,6 +1,7 @@
 #pragma once
 
 #include "marian.h"
+#include "3rd_party/threadpool.h"
 #include "models/model_factory.h"
 
 namespace marian {
@@ -9,6 +10,12 @@ class ScorerState {
 public:
   virtual Expr getProbs() = 0;
 
+  /**
+   * @brief Whether getProbs() returns unnormalized scores to which
+   * log-softmax still needs to be applied.
+   */
+  virtual bool needsLogSoftmax() { return false; }
+
   virtual float breakDown(size_t i) { return getProbs()->val()->get(i); }
 
   virtual void blacklist(Expr totalCosts, Ptr<data::CorpusBatch> batch){};
@@ -18,6 +25,7 @@ class Scorer {
 protected:
   std::string name_;
   float weight_;
+  Ptr<ExpressionGraph> graph_;
 
 public:
   Scorer(const std::string& name, float weight)
@@ -26,6 +34,20 @@ public:
   std::string getName() { return name_; }
   float getWeight() { return weight_; }
 
+  /**
+   * @brief Gives the scorer a graph of its own for its parameters and
+   * computations, which allows to evaluate scorers concurrently.
+   */
+  void setGraph(Ptr<ExpressionGraph> graph) { graph_ = graph; }
+
+  /**
+   * @brief The own graph of the scorer if it has one, otherwise the given
+   * shared graph.
+   */
+  Ptr<ExpressionGraph> getGraph(Ptr<ExpressionGraph> graph) {
+    return graph_ ? graph_ : graph;
+  }
+
   virtual void clear(Ptr<ExpressionGraph>) = 0;
   virtual Ptr<ScorerState> startState(Ptr<ExpressionGraph>,
                                       Ptr<data::CorpusBatch>)
@@ -34,7 +56,8 @@ public:
                                 Ptr<ScorerState>,
                                 const std::vector<size_t>&,
                                 const std::vector<size_t>&,
-                                int dimBatch, int beamSize)
+                                int dimBatch, int beamSize,
+                                bool normalize = true)
       = 0;
 
   virtual void init(Ptr<ExpressionGraph> graph) {}
@@ -43,14 +66,18 @@ public:
 class ScorerWrapperState : public ScorerState {
 protected:
   Ptr<DecoderState> state_;
+  bool normalized_;
 
 public:
-  ScorerWrapperState(Ptr<DecoderState> state) : state_(state) {}
+  ScorerWrapperState(Ptr<DecoderState> state, bool normalized = true)
+      : state_(state), normalized_(normalized) {}
 
   virtual Ptr<DecoderState> getState() { return state_; }
 
   virtual Expr getProbs() { return state_->getProbs(); };
 
+  virtual bool needsLogSoftmax() { return !normalized_; }
+
   virtual void blacklist(Expr totalCosts, Ptr<data::CorpusBatch> batch) {
     state_->blacklist(totalCosts, batch);
   }
@@ -90,12 +117,14 @@ public:
                                 Ptr<ScorerState> state,
                                 const std::vector<size_t>& hypIndices,
                                 const std::vector<size_t>& embIndices,
-                                int dimBatch, int beamSize) {
+                                int dimBatch, int beamSize,
+                                bool normalize = true) {
     graph->switchParams(getName());
     auto wrappedState
         = std::dynamic_pointer_cast<ScorerWrapperState>(state)->getState();
     return New<ScorerWrapperState>(
-        encdec_->step(graph, wrappedState, hypIndices, embIndices, dimBatch, beamSize));
+        encdec_->step(graph, wrappedState, hypIndices, embIndices, dimBatch, beamSize, normalize),
+        normalize);
   }
 };
 
@@ -141,7 +170,8 @@ public:
                                 Ptr<ScorerState> state,
                                 const std::vector<size_t>& hypIndices,
                                 const std::vector<size_t>& embIndices,
-                                int dimBatch, int beamSize) {
+                                int dimBatch, int beamSize,
+                                bool normalize = true) {
     return state;
   }
 };
@@ -177,7 +207,8 @@ public:
                                 Ptr<ScorerState> state,
                                 const std::vector<size_t>& hypIndices,
                                 const std::vector<size_t>& embIndices,
-                                int dimBatch, int beamSize) {
+                                int dimBatch, int beamSize,
+                                bool normalize = true) {
     return state;
   }
 };
@@ -188,4 +219,48 @@ Ptr<Scorer> scorerByType(std::string fname,
                          Ptr<Config> config);
 
 std::vector<Ptr<Scorer>> createScorers(Ptr<Config> options);
+
+/**
+ * @brief Loads the parameters of all scorers into the given graph.
+ *
+ * With --parallel-scorers on the CPU, every model of an ensemble gets a
+ * graph of its own on the same device instead.
+ */
+void initScorers(Ptr<ExpressionGraph> graph,
+                 const std::vector<Ptr<Scorer>>& scorers,
+                 Ptr<Config> options);
+
+/**
+ * @brief Clears the graphs of all scorers and creates their start states.
+ */
+std::vector<Ptr<ScorerState>> startScorers(
+    Ptr<ExpressionGraph> graph,
+    const std::vector<Ptr<Scorer>>& scorers,
+    Ptr<data::CorpusBatch> batch);
+
+/**
+ * @brief Creates a thread pool with one thread per scorer that has a graph of
+ * its own, or returns nullptr if all scorers share the given graph.
+ */
+UPtr<ThreadPool> scorerPool(Ptr<ExpressionGraph> graph,
+                            const std::vector<Ptr<Scorer>>& scorers);
+
+/**
+ * @brief Runs one search step of all scorers including the forward pass of
+ * their graphs.
+ *
+ * Scorers with a graph of their own are stepped and forwarded concurrently
+ * in the thread pool, if given, while the scorers on the shared graph run in
+ * the calling thread.
+ */
+void stepScorers(Ptr<ExpressionGraph> graph,
+                 const std::vector<Ptr<Scorer>>& scorers,
+                 std::vector<Ptr<ScorerState>>& states,
+                 const std::vector<size_t>& hypIndices,
+                 const std::vector<size_t>& embIndices,
+                 int dimBatch,
+                 int beamSize,
+                 bool normalize,
+                 bool first,
+                 ThreadPool* pool = nullptr);
 }
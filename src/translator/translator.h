@@ -47,8 +47,7 @@ public:
         graphs_[id] = graph;
 
         auto scorers = createScorers(options_);
-        for(auto scorer : scorers)
-          scorer->init(graph);
+        initScorers(graph, scorers, options_);
 
         scorers_[id] = scorers;
       };
@@ -77,14 +76,14 @@ public:
       auto task = [=](size_t id) {
         thread_local Ptr<ExpressionGraph> graph;
         thread_local std::vector<Ptr<Scorer>> scorers;
+        thread_local Ptr<Search> search;
 
         if(!graph) {
           graph = graphs_[id % devices.size()];
           scorers = scorers_[id % devices.size()];
+          search = New<Search>(options_, scorers);
         }
 
-        auto search = New<Search>(options_, scorers);
-
         auto histories = search->search(graph, batch);
 
         for(auto history : histories) {
@@ -143,8 +142,7 @@ public:
       graphs_.push_back(graph);
 
       auto scorers = createScorers(options_);
-      for(auto scorer : scorers)
-        scorer->init(graph);
+      initScorers(graph, scorers, options_);
       scorers_.push_back(scorers);
     }
   }
@@ -167,13 +165,14 @@ public:
         auto task = [=](size_t id) {
           thread_local Ptr<ExpressionGraph> graph;
           thread_local std::vector<Ptr<Scorer>> scorers;
+          thread_local Ptr<Search> search;
 
           if(!graph) {
             graph = graphs_[id % devices_.size()];
             scorers = scorers_[id % devices_.size()];
+            search = New<Search>(options_, scorers);
           }
 
-          auto search = New<Search>(options_, scorers);
           auto histories = search->search(graph, batch);
 
           for(auto history : histories) {